@@ -22,14 +22,185 @@
 #include "map.h"
 #include "editor.h"
 #include "gui.h"
+#include "iomap.h"
+#include "filehandle.h"
+
+#include <zlib.h>
+
+/*
+	A packed tile change holds a tile as the differences to the tile that is on
+	the map while the change is not applied. Items at the start and at the end
+	of the item list that both tiles share are taken from that tile again, only
+	the items in between are stored, encoded like the live server sends them.
+	The selection of the ground and of every item is kept as a bit each, so
+	selecting tiles only costs a few bytes per tile. A checksum of the item ids
+	of the map tile catches tiles that were replaced without going through the
+	action queue, the step is then refused instead of rebuilding the wrong tile.
+*/
+
+struct PackedTile {
+	Position position;
+	std::vector<uint8_t> data;
+};
+
+namespace {
+	enum PackedGround : uint8_t {
+		PACKED_GROUND_NONE,
+		// Copied from the tile on the map
+		PACKED_GROUND_SHARED,
+		// Stored as the first item node
+		PACKED_GROUND_STORED,
+	};
+
+	// Only the newest map version stores the whole attribute map of an item,
+	// older ones keep just the attributes they have a fixed encoding for
+	const IOMap &packingIOMap() {
+		static VirtualIOMap iomap([] {
+			MapVersion version;
+			version.otbm = MAP_OTBM_LAST_VERSION;
+			return version;
+		}());
+		return iomap;
+	}
+
+	// Items without any state besides id and count, they can be taken from the
+	// other tile instead of being stored
+	bool isPlainItem(const Item* item) {
+		const ItemType &type = item->getItemType();
+		return !item->isComplex() && !type.isContainer() && !type.isTeleport() && !type.isDoor() && !type.isDepot();
+	}
+
+	bool sameItem(const Item* item, const Item* other) {
+		return item->getID() == other->getID() && item->getSubtype() == other->getSubtype() && isPlainItem(item) && isPlainItem(other);
+	}
+
+	uint32_t itemChecksum(const Tile* tile) {
+		uint32_t hash = 2166136261U;
+		const auto add = [&hash](uint32_t value) {
+			hash = (hash ^ value) * 16777619U;
+		};
+		add(tile->ground ? tile->ground->getID() | tile->ground->getSubtype() << 16 : 0);
+		add(static_cast<uint32_t>(tile->items.size()));
+		for (const Item* item : tile->items) {
+			add(item->getID() | item->getSubtype() << 16);
+		}
+		return hash;
+	}
+
+	Item* readPackedItem(BinaryNode* node) {
+		uint8_t type;
+		if (!node->getByte(type) || type != OTBM_ITEM) {
+			return nullptr;
+		}
+
+		Item* item = Item::Create_OTBM(packingIOMap(), node);
+		if (item && !item->unserializeItemNode_OTBM(packingIOMap(), node)) {
+			delete item;
+			return nullptr;
+		}
+		return item;
+	}
+
+#ifdef __DEBUG__
+	// Reading a packed item back has to give the same attributes
+	bool keepsAttributes(const Item* item) {
+		MemoryNodeFileWriteHandle writer;
+		writer.addNode(0);
+		item->serializeItemNode_OTBM(packingIOMap(), writer);
+		writer.endNode();
+
+		MemoryNodeFileReadHandle reader(writer.getMemory(), writer.getSize());
+		Item* copy = readPackedItem(reader.getRootNode()->getChild());
+		if (!copy) {
+			return false;
+		}
+
+		const ItemAttributeMap attributes = item->getAttributes();
+		const ItemAttributeMap copied = copy->getAttributes();
+		delete copy;
+		return std::equal(attributes.begin(), attributes.end(), copied.begin(), copied.end(), [](const auto &left, const auto &right) {
+			return left.first == right.first && left.second.type == right.second.type;
+		});
+	}
+#endif
+
+	// Spilled steps are read back by the same process, so the native byte
+	// order is used
+	template <typename T>
+	void writeValue(std::vector<uint8_t> &buffer, const T &value) {
+		const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	template <typename T>
+	bool readValue(const uint8_t*&data, const uint8_t* end, T &value) {
+		if (static_cast<size_t>(end - data) < sizeof(T)) {
+			return false;
+		}
+		memcpy(&value, data, sizeof(T));
+		data += sizeof(T);
+		return true;
+	}
+
+	void writePosition(std::vector<uint8_t> &buffer, const Position &position) {
+		writeValue<int32_t>(buffer, position.x);
+		writeValue<int32_t>(buffer, position.y);
+		writeValue<int32_t>(buffer, position.z);
+	}
+
+	bool readPosition(const uint8_t*&data, const uint8_t* end, Position &position) {
+		int32_t x, y, z;
+		if (!readValue(data, end, x) || !readValue(data, end, y) || !readValue(data, end, z)) {
+			return false;
+		}
+		position = Position(x, y, z);
+		return true;
+	}
+
+	void writeBytes(std::vector<uint8_t> &buffer, const uint8_t* bytes, size_t size) {
+		writeValue<uint32_t>(buffer, static_cast<uint32_t>(size));
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+
+	template <typename Container>
+	bool readBytes(const uint8_t*&data, const uint8_t* end, Container &bytes) {
+		uint32_t size;
+		if (!readValue(data, end, size) || static_cast<size_t>(end - data) < size) {
+			return false;
+		}
+		bytes.assign(data, data + size);
+		data += size;
+		return true;
+	}
+
+	// House membership changes of a commit or undo, gathered per house and
+	// applied once all tiles were swapped
+	struct HouseTileChanges {
+		std::unordered_map<uint32_t, PositionVector> removed;
+		std::unordered_map<uint32_t, std::vector<Tile*>> added;
+
+		void apply(Houses &houses) {
+			for (const auto &[id, positions] : removed) {
+				if (House* house = houses.getHouse(id)) {
+					house->removeTiles(positions);
+				}
+			}
+			for (const auto &[id, tiles] : added) {
+				if (House* house = houses.getHouse(id)) {
+					house->addTiles(tiles);
+				}
+			}
+		}
+	};
+}
 
 Change::Change() :
-	type(CHANGE_NONE), data(nullptr) {
+	type(CHANGE_NONE), data(nullptr), packed(false) {
 	////
 }
 
 Change::Change(Tile* tile) :
-	type(CHANGE_TILE) {
+	type(CHANGE_TILE), packed(false) {
 	ASSERT(tile);
 	data = tile;
 }
@@ -56,7 +227,11 @@ void Change::clear() {
 	switch (type) {
 		case CHANGE_TILE:
 			ASSERT(data);
-			delete reinterpret_cast<Tile*>(data);
+			if (packed) {
+				delete reinterpret_cast<PackedTile*>(data);
+			} else {
+				delete reinterpret_cast<Tile*>(data);
+			}
 			break;
 		case CHANGE_MOVE_HOUSE_EXIT:
 			ASSERT(data);
@@ -79,16 +254,205 @@ void Change::clear() {
 
 	type = CHANGE_NONE;
 	data = nullptr;
+	packed = false;
 }
 
 uint32_t Change::memsize() const {
 	uint32_t mem = sizeof(*this);
 	if (type == CHANGE_TILE) {
-		mem += reinterpret_cast<Tile*>(data)->memsize();
+		if (packed) {
+			mem += sizeof(PackedTile) + reinterpret_cast<PackedTile*>(data)->data.capacity();
+		} else {
+			mem += reinterpret_cast<Tile*>(data)->memsize();
+		}
 	}
 	return mem;
 }
 
+void Change::pack(const Tile* current) {
+	ASSERT(type == CHANGE_TILE && !packed);
+	Tile* tile = reinterpret_cast<Tile*>(data);
+	ASSERT(tile && current);
+
+	// Creatures and spawns aren't part of the item encoding
+	if (!tile->getLocation() || tile->spawnMonster || tile->spawnNpc || tile->npc || !tile->monsters.empty()) {
+		return;
+	}
+	if (tile->items.size() > 0xFFFF || current->items.size() > 0xFFFF) {
+		return;
+	}
+
+	const size_t count = std::min(tile->items.size(), current->items.size());
+	size_t prefix = 0;
+	while (prefix < count && sameItem(tile->items[prefix], current->items[prefix])) {
+		++prefix;
+	}
+	size_t suffix = 0;
+	while (prefix + suffix < count && sameItem(tile->items[tile->items.size() - suffix - 1], current->items[current->items.size() - suffix - 1])) {
+		++suffix;
+	}
+
+	PackedGround ground = PACKED_GROUND_NONE;
+	if (tile->ground) {
+		ground = current->ground && sameItem(tile->ground, current->ground) ? PACKED_GROUND_SHARED : PACKED_GROUND_STORED;
+	}
+
+	static thread_local MemoryNodeFileWriteHandle writer;
+	writer.reset();
+	writer.addNode(0);
+	writer.addU32(itemChecksum(current));
+	writer.addU16(tile->getMapFlags());
+	writer.addU16(tile->getStatFlags());
+	writer.addU32(tile->house_id);
+	writer.addU16(static_cast<uint16_t>(tile->zones.size()));
+	for (unsigned int zone : tile->zones) {
+		writer.addU32(zone);
+	}
+	writer.addU8(ground);
+	writer.addU16(static_cast<uint16_t>(prefix));
+	writer.addU16(static_cast<uint16_t>(suffix));
+	writer.addU16(static_cast<uint16_t>(tile->items.size() - prefix - suffix));
+
+	// Selection of the ground followed by every item
+	uint8_t bits = tile->ground && tile->ground->isSelected() ? 1 : 0;
+	for (size_t i = 0; i < tile->items.size(); ++i) {
+		if ((i + 1) % 8 == 0) {
+			writer.addU8(bits);
+			bits = 0;
+		}
+		if (tile->items[i]->isSelected()) {
+			bits |= 1 << ((i + 1) % 8);
+		}
+	}
+	writer.addU8(bits);
+
+	if (ground == PACKED_GROUND_STORED) {
+		ASSERT(keepsAttributes(tile->ground));
+		tile->ground->serializeItemNode_OTBM(packingIOMap(), writer);
+	}
+	for (size_t i = prefix; i < tile->items.size() - suffix; ++i) {
+		ASSERT(keepsAttributes(tile->items[i]));
+		tile->items[i]->serializeItemNode_OTBM(packingIOMap(), writer);
+	}
+	writer.endNode();
+
+	PackedTile* packedTile = newd PackedTile;
+	packedTile->position = tile->getPosition();
+	packedTile->data.assign(writer.getMemory(), writer.getMemory() + writer.getSize());
+
+	delete tile;
+	data = packedTile;
+	packed = true;
+}
+
+bool Change::unpack(Map &map) {
+	if (type != CHANGE_TILE || !packed) {
+		return true;
+	}
+
+	PackedTile* packedTile = reinterpret_cast<PackedTile*>(data);
+	const Position position = packedTile->position;
+	Tile* current = map.getTile(position);
+
+	MemoryNodeFileReadHandle reader(packedTile->data.data(), packedTile->data.size());
+	BinaryNode* root = reader.getRootNode();
+
+	uint32_t checksum = 0;
+	if (!current || !root->getU32(checksum) || checksum != itemChecksum(current)) {
+		spdlog::warn("Can not restore tile {}:{}:{}, it was changed outside of the undo history", position.x, position.y, position.z);
+		return false;
+	}
+
+	Tile* tile = map.allocator(current->getLocation());
+	uint16_t mapFlags = 0, statFlags = 0;
+	uint16_t zones = 0;
+	uint8_t ground = PACKED_GROUND_NONE;
+	uint16_t prefix = 0, suffix = 0, stored = 0;
+	bool valid = root->getU16(mapFlags) && root->getU16(statFlags) && root->getU32(tile->house_id) && root->getU16(zones);
+	for (uint16_t i = 0; valid && i < zones; ++i) {
+		uint32_t zone;
+		valid = root->getU32(zone);
+		tile->zones.insert(zone);
+	}
+	valid = valid && root->getU8(ground) && root->getU16(prefix) && root->getU16(suffix) && root->getU16(stored);
+	valid = valid && prefix + suffix <= current->items.size();
+	if (valid && ground == PACKED_GROUND_SHARED) {
+		valid = current->ground != nullptr;
+	}
+
+	const size_t count = prefix + stored + suffix;
+	std::vector<uint8_t> selection((count + 1 + 7) / 8);
+	for (size_t i = 0; valid && i < selection.size(); ++i) {
+		valid = root->getU8(selection[i]);
+	}
+
+	std::vector<Item*> storedItems;
+	if (valid) {
+		for (BinaryNode* itemNode = root->getChild(); itemNode != nullptr; itemNode = itemNode->advance()) {
+			Item* item = readPackedItem(itemNode);
+			if (!item) {
+				valid = false;
+				continue;
+			}
+			storedItems.push_back(item);
+		}
+		valid = valid && storedItems.size() == stored + (ground == PACKED_GROUND_STORED ? 1 : 0);
+	}
+
+	if (valid) {
+		auto storedItem = storedItems.begin();
+		if (ground == PACKED_GROUND_STORED) {
+			tile->ground = *storedItem++;
+		} else if (ground == PACKED_GROUND_SHARED) {
+			tile->ground = current->ground->deepCopy();
+		}
+
+		tile->items.reserve(count);
+		for (size_t i = 0; i < prefix; ++i) {
+			tile->items.push_back(current->items[i]->deepCopy());
+		}
+		tile->items.insert(tile->items.end(), storedItem, storedItems.end());
+		for (size_t i = current->items.size() - suffix; i < current->items.size(); ++i) {
+			tile->items.push_back(current->items[i]->deepCopy());
+		}
+	} else {
+		for (Item* item : storedItems) {
+			delete item;
+		}
+	}
+
+	if (!valid) {
+		spdlog::error("Can not restore tile {}:{}:{}, its stored data is invalid", position.x, position.y, position.z);
+		delete tile;
+		return false;
+	}
+
+	const auto selected = [&selection](size_t index) {
+		return (selection[index / 8] >> (index % 8)) & 1;
+	};
+	if (tile->ground) {
+		if (selected(0)) {
+			tile->ground->select();
+		} else {
+			tile->ground->deselect();
+		}
+	}
+	for (size_t i = 0; i < tile->items.size(); ++i) {
+		if (selected(i + 1)) {
+			tile->items[i]->select();
+		} else {
+			tile->items[i]->deselect();
+		}
+	}
+	tile->setMapFlags(mapFlags);
+	tile->setStatFlags(statFlags);
+
+	delete packedTile;
+	data = tile;
+	packed = false;
+	return true;
+}
+
 Action::Action(Editor &editor, ActionIdentifier ident) :
 	commited(false),
 	editor(editor),
@@ -102,29 +466,148 @@ Action::~Action() {
 	changes.clear();
 }
 
-size_t Action::approx_memsize() const {
-	uint32_t mem = sizeof(*this);
-	mem += changes.size() * (sizeof(Change) + sizeof(Tile) + sizeof(Item) + 6 /* approx overhead*/);
+size_t Action::memsize() const {
+	size_t mem = sizeof(*this);
+	mem += sizeof(Change*) * changes.capacity();
+
+	for (const Change* change : changes) {
+		if (change) {
+			mem += change->memsize();
+		}
+	}
+
 	return mem;
 }
 
-size_t Action::memsize() const {
-	uint32_t mem = sizeof(*this);
-	mem += sizeof(Change*) * 3 * changes.size();
+bool Action::canSpill() const {
+	for (const Change* change : changes) {
+		if (change->getType() == CHANGE_TILE && !change->isPacked()) {
+			return false;
+		}
+	}
+	return true;
+}
 
+void Action::serialize(std::vector<uint8_t> &buffer) const {
+	writeValue<uint8_t>(buffer, commited);
+	writeValue<uint32_t>(buffer, static_cast<uint32_t>(changes.size()));
 	for (const Change* change : changes) {
-		if (change && change->getType() == CHANGE_TILE) {
-			mem += reinterpret_cast<Tile*>(change->getData())->memsize();
+		writeValue<uint8_t>(buffer, change->getType());
+		switch (change->getType()) {
+			case CHANGE_TILE: {
+				const PackedTile* packedTile = reinterpret_cast<const PackedTile*>(change->getData());
+				writePosition(buffer, packedTile->position);
+				writeBytes(buffer, packedTile->data.data(), packedTile->data.size());
+				break;
+			}
+			case CHANGE_MOVE_HOUSE_EXIT: {
+				const HouseData* houseData = reinterpret_cast<const HouseData*>(change->getData());
+				writeValue<uint32_t>(buffer, houseData->id);
+				writePosition(buffer, houseData->position);
+				break;
+			}
+			case CHANGE_MOVE_WAYPOINT: {
+				const WaypointData* waypointData = reinterpret_cast<const WaypointData*>(change->getData());
+				writeBytes(buffer, reinterpret_cast<const uint8_t*>(waypointData->id.data()), waypointData->id.size());
+				writePosition(buffer, waypointData->position);
+				break;
+			}
+			default:
+				break;
 		}
 	}
+}
+
+bool Action::unserialize(const uint8_t*&data, const uint8_t* end) {
+	uint8_t isCommited;
+	uint32_t count;
+	if (!readValue(data, end, isCommited) || !readValue(data, end, count)) {
+		return false;
+	}
+	commited = isCommited != 0;
 
-	return mem;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint8_t type;
+		if (!readValue(data, end, type)) {
+			return false;
+		}
+
+		Change* change = new Change();
+		changes.push_back(change);
+		switch (type) {
+			case CHANGE_TILE: {
+				PackedTile* packedTile = newd PackedTile;
+				change->type = CHANGE_TILE;
+				change->data = packedTile;
+				change->packed = true;
+				if (!readPosition(data, end, packedTile->position) || !readBytes(data, end, packedTile->data)) {
+					return false;
+				}
+				break;
+			}
+			case CHANGE_MOVE_HOUSE_EXIT: {
+				HouseData* houseData = new HouseData {};
+				change->type = CHANGE_MOVE_HOUSE_EXIT;
+				change->data = houseData;
+				if (!readValue(data, end, houseData->id) || !readPosition(data, end, houseData->position)) {
+					return false;
+				}
+				break;
+			}
+			case CHANGE_MOVE_WAYPOINT: {
+				WaypointData* waypointData = new WaypointData {};
+				change->type = CHANGE_MOVE_WAYPOINT;
+				change->data = waypointData;
+				if (!readBytes(data, end, waypointData->id) || !readPosition(data, end, waypointData->position)) {
+					return false;
+				}
+				break;
+			}
+			case CHANGE_NONE:
+				break;
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+bool Action::canPack() const {
+	// Live editors send the tiles of changes around, remote actions are
+	// discarded right after they were applied
+	return !editor.IsLive() && type != ACTION_REMOTE;
+}
+
+bool Action::unpackChanges() {
+	Map &map = editor.getMap();
+	std::vector<Change*> unpacked;
+	for (Change* change : changes) {
+		if (!change->isPacked()) {
+			continue;
+		}
+		if (!change->unpack(map)) {
+			// Nothing was applied yet, pack the changes again against the same tiles
+			for (Change* done : unpacked) {
+				const Tile* tile = reinterpret_cast<Tile*>(done->data);
+				done->pack(map.getTile(tile->getPosition()));
+			}
+			return false;
+		}
+		unpacked.push_back(change);
+	}
+	return true;
 }
 
-void Action::commit(DirtyList* dirty_list) {
+bool Action::commit(DirtyList* dirty_list) {
+	if (!unpackChanges()) {
+		return false;
+	}
+
 	Map &map = editor.getMap();
 	Selection &selection = editor.getSelection();
 	selection.start(Selection::INTERNAL);
+	const bool pack = canPack();
+	HouseTileChanges house_changes;
 
 	for (Change* change : changes) {
 		switch (change->getType()) {
@@ -161,14 +644,11 @@ void Action::commit(DirtyList* dirty_list) {
 				if (old_tile) {
 					if (new_tile->getHouseID() != old_tile->getHouseID()) {
 						// oooooomggzzz we need to add it to the appropriate house!
-						House* house = map.houses.getHouse(old_tile->getHouseID());
-						if (house) {
-							house->removeTile(old_tile);
+						if (old_tile->getHouseID() != 0) {
+							house_changes.removed[old_tile->getHouseID()].push_back(pos);
 						}
-
-						house = map.houses.getHouse(new_tile->getHouseID());
-						if (house) {
-							house->addTile(new_tile);
+						if (new_tile->getHouseID() != 0) {
+							house_changes.added[new_tile->getHouseID()].push_back(new_tile);
 						}
 					}
 					if (old_tile->spawnMonster) {
@@ -208,10 +688,7 @@ void Action::commit(DirtyList* dirty_list) {
 					*data = map.allocator(location);
 					if (new_tile->getHouseID() != 0) {
 						// oooooomggzzz we need to add it to the appropriate house!
-						House* house = map.houses.getHouse(new_tile->getHouseID());
-						if (house) {
-							house->addTile(new_tile);
-						}
+						house_changes.added[new_tile->getHouseID()].push_back(new_tile);
 					}
 
 					if (new_tile->spawnMonster) {
@@ -228,6 +705,10 @@ void Action::commit(DirtyList* dirty_list) {
 				if (editor.IsLiveClient() && dirty_list && type != ACTION_REMOTE) {
 					dirty_list->AddChange(change);
 				}
+
+				if (pack) {
+					change->pack(new_tile);
+				}
 				break;
 			}
 
@@ -270,18 +751,25 @@ void Action::commit(DirtyList* dirty_list) {
 				break;
 		}
 	}
+	house_changes.apply(map.houses);
 	selection.finish(Selection::INTERNAL);
 	commited = true;
+	return true;
 }
 
-void Action::undo(DirtyList* dirty_list) {
+bool Action::undo(DirtyList* dirty_list) {
 	if (changes.empty()) {
-		return;
+		return true;
+	}
+	if (!unpackChanges()) {
+		return false;
 	}
 
 	Map &map = editor.getMap();
 	Selection &selection = editor.getSelection();
 	selection.start(Selection::INTERNAL);
+	const bool pack = canPack();
+	HouseTileChanges house_changes;
 
 	for (Change* change : changes) {
 		switch (change->getType()) {
@@ -316,16 +804,14 @@ void Action::undo(DirtyList* dirty_list) {
 
 				if (new_tile->getHouseID() != old_tile->getHouseID()) {
 					// oooooomggzzz we need to remove it from the appropriate house!
-					House* house = map.houses.getHouse(new_tile->getHouseID());
-					if (house) {
-						house->removeTile(new_tile);
+					if (map.houses.getHouse(new_tile->getHouseID())) {
+						house_changes.removed[new_tile->getHouseID()].push_back(pos);
 					} else {
 						new_tile->setHouse(nullptr);
 					}
 
-					house = map.houses.getHouse(old_tile->getHouseID());
-					if (house) {
-						house->addTile(old_tile);
+					if (old_tile->getHouseID() != 0) {
+						house_changes.added[old_tile->getHouseID()].push_back(old_tile);
 					}
 				}
 
@@ -360,6 +846,10 @@ void Action::undo(DirtyList* dirty_list) {
 				if (editor.IsLiveClient() && dirty_list && type != ACTION_REMOTE) {
 					dirty_list->AddChange(change);
 				}
+
+				if (pack) {
+					change->pack(old_tile);
+				}
 				break;
 			}
 
@@ -403,15 +893,19 @@ void Action::undo(DirtyList* dirty_list) {
 		}
 	}
 
+	house_changes.apply(map.houses);
 	selection.finish(Selection::INTERNAL);
 	commited = false;
+	return true;
 }
 
 BatchAction::BatchAction(Editor &editor, ActionIdentifier ident) :
 	editor(editor),
 	timestamp(0),
 	memory_size(0),
-	type(ident) {
+	type(ident),
+	spilled(false),
+	spill {} {
 	////
 }
 
@@ -428,16 +922,11 @@ size_t BatchAction::memsize(bool recalc) const {
 		return memory_size;
 	}
 
-	uint32_t mem = sizeof(*this);
-	mem += sizeof(Action*) * 3 * batch.size();
+	size_t mem = sizeof(*this);
+	mem += sizeof(Action*) * batch.capacity();
 
 	for (const Action* action : batch) {
-#ifdef __USE_EXACT_MEMSIZE__
 		mem += action->memsize();
-#else
-		// Less exact but MUCH faster
-		mem += action->approx_memsize();
-#endif
 	}
 
 	const_cast<BatchAction*>(this)->memory_size = mem;
@@ -487,16 +976,28 @@ void BatchAction::commit() {
 	}
 }
 
-void BatchAction::undo() {
-	for (Action* action : std::views::reverse(batch)) {
-		action->undo(nullptr);
+bool BatchAction::undo() {
+	for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+		if (!(*it)->undo(nullptr)) {
+			for (auto undone = it.base(); undone != batch.end(); ++undone) {
+				(*undone)->redo(nullptr);
+			}
+			return false;
+		}
 	}
+	return true;
 }
 
-void BatchAction::redo() {
-	for (Action* action : batch) {
-		action->redo(nullptr);
+bool BatchAction::redo() {
+	for (size_t index = 0; index < batch.size(); ++index) {
+		if (!batch[index]->redo(nullptr)) {
+			for (size_t redone = index; redone-- > 0;) {
+				batch[redone]->undo(nullptr);
+			}
+			return false;
+		}
 	}
+	return true;
 }
 
 void BatchAction::merge(BatchAction* other) {
@@ -505,7 +1006,7 @@ void BatchAction::merge(BatchAction* other) {
 }
 
 ActionQueue::ActionQueue(Editor &editor) :
-	current(0), memory_size(0), editor(editor) {
+	current(0), memory_size(0), editor(editor), spill_end(0), spill_used(0), spill_failed(false) {
 	////
 }
 
@@ -514,6 +1015,7 @@ ActionQueue::~ActionQueue() {
 		delete batch;
 	}
 	actions.clear();
+	closeSpillFile();
 }
 
 Action* ActionQueue::createAction(ActionIdentifier identifier) const {
@@ -547,7 +1049,7 @@ void ActionQueue::addBatch(BatchAction* batch, int stacking_delay) {
 	batch->commit();
 
 	// Update title
-	if (batch->isNoSelection() && editor.getMap().doChange()) {
+	if (batch->isNoSelection() && editor.getMap().doTileChange()) {
 		g_gui.UpdateTitle();
 	}
 
@@ -557,31 +1059,36 @@ void ActionQueue::addBatch(BatchAction* batch, int stacking_delay) {
 	}
 
 	while (current != actions.size()) {
-		memory_size -= actions.back()->memsize();
 		BatchAction* todelete = actions.back();
 		actions.pop_back();
-		delete todelete;
+		deleteBatch(todelete);
 	}
 
 	while (memory_size > size_t(1024 * 1024 * g_settings.getInteger(Config::UNDO_MEM_SIZE)) && !actions.empty()) {
-		memory_size -= actions.front()->memsize();
-		delete actions.front();
+		BatchAction* todelete = actions.front();
 		actions.pop_front();
+		deleteBatch(todelete);
 		current--;
 	}
 
 	if (actions.size() > size_t(g_settings.getInteger(Config::UNDO_SIZE)) && !actions.empty()) {
-		memory_size -= actions.front()->memsize();
 		BatchAction* todelete = actions.front();
 		actions.pop_front();
-		delete todelete;
+		deleteBatch(todelete);
 		current--;
 	}
 
+	// Dropped steps leave holes in the spill file
+	if (spill_used == 0) {
+		spill_end = 0;
+	} else if (spill_end > 64 * 1024 * 1024 && spill_used < spill_end / 2) {
+		compactSpillFile();
+	}
+
 	do {
 		if (!actions.empty()) {
 			BatchAction* lastAction = actions.back();
-			if (lastAction->type == batch->type && g_settings.getInteger(Config::GROUP_ACTIONS) && time(nullptr) - stacking_delay < lastAction->timestamp) {
+			if (lastAction->type == batch->type && !lastAction->isSpilled() && g_settings.getInteger(Config::GROUP_ACTIONS) && time(nullptr) - stacking_delay < lastAction->timestamp) {
 				lastAction->merge(batch);
 				lastAction->timestamp = time(nullptr);
 				memory_size -= lastAction->memsize();
@@ -595,6 +1102,8 @@ void ActionQueue::addBatch(BatchAction* batch, int stacking_delay) {
 		batch->timestamp = time(nullptr);
 		current++;
 	} while (false);
+
+	spillHistory();
 }
 
 void ActionQueue::addAction(Action* action, int stacking_delay) {
@@ -625,14 +1134,29 @@ void ActionQueue::generateLabels() {
 
 bool ActionQueue::undo() {
 	if (current > 0) {
-		current--;
-		BatchAction* batch = actions.at(current);
+		BatchAction* batch = actions.at(current - 1);
+		if (batch && batch->isSpilled() && !restoreBatch(batch)) {
+			// Nothing before this step can be undone anymore
+			discardUndoSteps();
+			g_gui.PopupDialog("Error", "The undo history could not be read back from disk, older steps were discarded.", wxOK);
+			return false;
+		}
+
 		if (batch) {
-			batch->undo();
+			// Which tiles are packed changes with the direction
+			memory_size -= batch->memsize();
+			const bool undone = batch->undo();
+			memory_size += batch->memsize(true);
+			if (!undone) {
+				discardUndoSteps();
+				g_gui.PopupDialog("Error", "The map was changed outside of the undo history, the step can not be undone. It and all older steps were discarded.", wxOK);
+				return false;
+			}
 		}
+		current--;
 
 		// Update title
-		if (batch && batch->isNoSelection() && editor.getMap().doChange()) {
+		if (batch && batch->isNoSelection() && editor.getMap().doTileChange()) {
 			g_gui.UpdateTitle();
 		}
 		return true;
@@ -644,12 +1168,19 @@ bool ActionQueue::redo() {
 	if (current < actions.size()) {
 		BatchAction* batch = actions.at(current);
 		if (batch) {
-			batch->redo();
+			memory_size -= batch->memsize();
+			const bool redone = batch->redo();
+			memory_size += batch->memsize(true);
+			if (!redone) {
+				discardRedoSteps();
+				g_gui.PopupDialog("Error", "The map was changed outside of the undo history, the step can not be redone. It and all newer steps were discarded.", wxOK);
+				return false;
+			}
 		}
 		current++;
 
 		// Update title
-		if (batch && batch->isNoSelection() && editor.getMap().doChange()) {
+		if (batch && batch->isNoSelection() && editor.getMap().doTileChange()) {
 			g_gui.UpdateTitle();
 		}
 		return true;
@@ -673,6 +1204,175 @@ void ActionQueue::clear() {
 	actions.clear();
 	memory_size = 0;
 	current = 0;
+	closeSpillFile();
+}
+
+void ActionQueue::deleteBatch(BatchAction* batch) {
+	memory_size -= batch->memsize();
+	if (batch->isSpilled()) {
+		spill_used -= batch->spill.length;
+	}
+	delete batch;
+}
+
+void ActionQueue::discardUndoSteps() {
+	while (current > 0) {
+		BatchAction* todelete = actions.front();
+		actions.pop_front();
+		deleteBatch(todelete);
+		current--;
+	}
+}
+
+void ActionQueue::discardRedoSteps() {
+	while (actions.size() > current) {
+		BatchAction* todelete = actions.back();
+		actions.pop_back();
+		deleteBatch(todelete);
+	}
+}
+
+void ActionQueue::spillHistory() {
+	const size_t limit = size_t(1024 * 1024) * g_settings.getInteger(Config::UNDO_RESIDENT_SIZE);
+	if (limit == 0 || spill_failed) {
+		return;
+	}
+
+	// The latest step stays in memory, the next one may still be merged into it
+	for (size_t index = 0; index + 1 < current && memory_size > limit && !spill_failed; ++index) {
+		BatchAction* batch = actions[index];
+		if (batch && !batch->isSpilled()) {
+			spillBatch(batch);
+		}
+	}
+}
+
+bool ActionQueue::spillBatch(BatchAction* batch) {
+	for (const Action* action : batch->batch) {
+		if (!action->canSpill()) {
+			return false;
+		}
+	}
+
+	std::vector<uint8_t> raw;
+	for (const Action* action : batch->batch) {
+		action->serialize(raw);
+	}
+	if (raw.size() > std::numeric_limits<uint32_t>::max()) {
+		return false;
+	}
+
+	uLongf length = compressBound(raw.size());
+	std::vector<uint8_t> compressed(length);
+	if (compress2(compressed.data(), &length, raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK) {
+		return false;
+	}
+
+	if (!spill_file.IsOpened()) {
+		spill_path = wxFileName::CreateTempFileName("rme-undo", &spill_file);
+		if (spill_path.IsEmpty()) {
+			spdlog::warn("Could not create the undo spill file, the undo history stays in memory");
+			spill_failed = true;
+			return false;
+		}
+	}
+
+	if (spill_file.Seek(spill_end) == wxInvalidOffset || spill_file.Write(compressed.data(), length) != length) {
+		spdlog::warn("Could not write to the undo spill file {}, the undo history stays in memory", spill_path.ToStdString());
+		spill_failed = true;
+		return false;
+	}
+
+	batch->spill = { spill_end, static_cast<uint32_t>(length), static_cast<uint32_t>(raw.size()), batch->batch.size() };
+	spill_end += length;
+	spill_used += length;
+
+	memory_size -= batch->memsize();
+	for (Action* action : batch->batch) {
+		delete action;
+	}
+	batch->batch.clear();
+	batch->batch.shrink_to_fit();
+	batch->spilled = true;
+	memory_size += batch->memsize(true);
+	return true;
+}
+
+bool ActionQueue::restoreBatch(BatchAction* batch) {
+	const BatchAction::SpillLocation &spill = batch->spill;
+	std::vector<uint8_t> compressed(spill.length);
+	std::vector<uint8_t> raw(spill.raw_length);
+	uLongf length = raw.size();
+
+	bool ok = spill_file.Seek(spill.offset) != wxInvalidOffset && spill_file.Read(compressed.data(), compressed.size()) == static_cast<ssize_t>(compressed.size());
+	ok = ok && uncompress(raw.data(), &length, compressed.data(), compressed.size()) == Z_OK && length == raw.size();
+
+	ActionVector restored;
+	const uint8_t* data = raw.data();
+	const uint8_t* end = data + raw.size();
+	for (size_t i = 0; ok && i < spill.actions; ++i) {
+		Action* action = createAction(batch);
+		restored.push_back(action);
+		ok = action->unserialize(data, end);
+	}
+
+	if (!ok || data != end) {
+		spdlog::error("Could not read the undo history back from {}", spill_path.ToStdString());
+		for (Action* action : restored) {
+			delete action;
+		}
+		return false;
+	}
+
+	spill_used -= spill.length;
+	if (spill_used == 0) {
+		spill_end = 0;
+	}
+
+	memory_size -= batch->memsize();
+	batch->batch = std::move(restored);
+	batch->spilled = false;
+	memory_size += batch->memsize(true);
+	return true;
+}
+
+void ActionQueue::compactSpillFile() {
+	std::vector<BatchAction*> spilled;
+	for (BatchAction* batch : actions) {
+		if (batch && batch->isSpilled()) {
+			spilled.push_back(batch);
+		}
+	}
+	std::ranges::sort(spilled, {}, [](const BatchAction* batch) { return batch->spill.offset; });
+
+	// Moving every block to the front in file order never overwrites a block
+	// that wasn't moved yet
+	std::vector<uint8_t> buffer;
+	wxFileOffset offset = 0;
+	for (BatchAction* batch : spilled) {
+		BatchAction::SpillLocation &spill = batch->spill;
+		if (spill.offset != offset) {
+			buffer.resize(spill.length);
+			if (spill_file.Seek(spill.offset) == wxInvalidOffset || spill_file.Read(buffer.data(), buffer.size()) != static_cast<ssize_t>(buffer.size()) || spill_file.Seek(offset) == wxInvalidOffset || spill_file.Write(buffer.data(), buffer.size()) != buffer.size()) {
+				spdlog::warn("Could not compact the undo spill file {}", spill_path.ToStdString());
+				return;
+			}
+			spill.offset = offset;
+		}
+		offset += spill.length;
+	}
+	spill_end = offset;
+}
+
+void ActionQueue::closeSpillFile() {
+	if (spill_file.IsOpened()) {
+		spill_file.Close();
+		wxRemoveFile(spill_path);
+	}
+	spill_path.Clear();
+	spill_end = 0;
+	spill_used = 0;
+	spill_failed = false;
 }
 
 wxString ActionQueue::createLabel(ActionIdentifier type) {
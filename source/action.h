@@ -20,6 +20,8 @@
 
 #include "position.h"
 
+#include <wx/file.h>
+
 class Editor;
 class Tile;
 class House;
@@ -77,16 +79,29 @@ public:
 	ChangeType getType() const noexcept {
 		return type;
 	}
+	// For tile changes this is only a Tile* while the change isn't packed,
+	// changes of live editors are never packed
 	void* getData() const noexcept {
 		return data;
 	}
+	bool isPacked() const noexcept {
+		return packed;
+	}
 
 	uint32_t memsize() const;
 
 private:
 	Change();
+
+	// Once a tile change has been applied, the tile it holds is no longer on the
+	// map. pack keeps only its differences to the tile that replaced it, unpack
+	// rebuilds it from the tile that is on the map when the change is reverted.
+	void pack(const Tile* current);
+	bool unpack(Map &map);
+
 	ChangeType type;
 	void* data;
+	bool packed;
 
 	friend class Action;
 };
@@ -135,7 +150,6 @@ public:
 	}
 
 	// Get memory footprint
-	size_t approx_memsize() const;
 	size_t memsize() const;
 	size_t size() const noexcept {
 		return changes.size();
@@ -147,18 +161,31 @@ public:
 		return type;
 	}
 
-	void commit(DirtyList* dirty_list);
+	// These return false and leave the map untouched if a packed change no
+	// longer fits the tile on the map
+	bool commit(DirtyList* dirty_list);
 	bool isCommited() const noexcept {
 		return commited;
 	}
-	void undo(DirtyList* dirty_list);
-	void redo(DirtyList* dirty_list) {
-		commit(dirty_list);
+	bool undo(DirtyList* dirty_list);
+	bool redo(DirtyList* dirty_list) {
+		return commit(dirty_list);
 	}
 
 protected:
 	Action(Editor &editor, ActionIdentifier ident);
 
+	// Whether changes are packed after they were applied
+	bool canPack() const;
+	// Unpacks every tile change before any of them is applied
+	bool unpackChanges();
+
+	// Actions whose tile changes are all packed can be written to the spill
+	// file of the history
+	bool canSpill() const;
+	void serialize(std::vector<uint8_t> &buffer) const;
+	bool unserialize(const uint8_t*&data, const uint8_t* end);
+
 	bool commited;
 	ChangeList changes;
 	Editor &editor;
@@ -180,10 +207,15 @@ public:
 	// Get memory footprint
 	size_t memsize(bool resize = false) const;
 	size_t size() const noexcept {
-		return batch.size();
+		return spilled ? spill.actions : batch.size();
 	}
 	bool empty() const noexcept {
-		return batch.empty();
+		return size() == 0;
+	}
+	// Spilled batches only keep their place in the spill file of the history
+	// in memory, their actions are read back before they are undone
+	bool isSpilled() const noexcept {
+		return spilled;
 	}
 	ActionIdentifier getType() const noexcept {
 		return type;
@@ -200,17 +232,27 @@ protected:
 	BatchAction(Editor &editor, ActionIdentifier ident);
 
 	virtual void commit();
-	virtual void undo();
-	virtual void redo();
+	// A failed step puts back the actions it already undid or redid
+	virtual bool undo();
+	virtual bool redo();
 
 	void merge(BatchAction* other);
 
+	struct SpillLocation {
+		wxFileOffset offset;
+		uint32_t length;
+		uint32_t raw_length;
+		size_t actions;
+	};
+
 	Editor &editor;
 	int timestamp;
 	uint32_t memory_size;
 	ActionIdentifier type;
 	ActionVector batch;
 	wxString label;
+	bool spilled;
+	SpillLocation spill;
 
 	friend class ActionQueue;
 };
@@ -262,10 +304,31 @@ public:
 protected:
 	static wxString createLabel(ActionIdentifier type);
 
+	void deleteBatch(BatchAction* batch);
+	// Drops every step that can no longer be undone or redone
+	void discardUndoSteps();
+	void discardRedoSteps();
+
+	// Older steps are compressed into a temporary file once the history uses
+	// more memory than the resident limit
+	void spillHistory();
+	bool spillBatch(BatchAction* batch);
+	bool restoreBatch(BatchAction* batch);
+	void compactSpillFile();
+	void closeSpillFile();
+
 	size_t current;
 	size_t memory_size;
 	Editor &editor;
 	ActionList actions;
+
+	wxFile spill_file;
+	wxString spill_path;
+	// End of the written part of the spill file and the bytes of it that still
+	// belong to spilled batches
+	wxFileOffset spill_end;
+	wxFileOffset spill_used;
+	bool spill_failed;
 };
 
 #endif
@@ -63,7 +63,15 @@ void HistoryListBox::OnDrawItem(wxDC &dc, const wxRect &rect, size_t index) cons
 	if (action) {
 		const wxBitmap &bitmap = getIconBitmap(action->getType());
 		dc.DrawBitmap(bitmap, rect.GetX() + 4, rect.GetY() + 4, true);
-		dc.DrawText(action->getLabel(), rect.GetX() + 28, rect.GetY() + 3);
+		if (action->isSpilled()) {
+			// Steps that have to be read back from disk before they are undone
+			if (!IsSelected(index)) {
+				dc.SetTextForeground(wxSystemSettings::GetColour(wxSYS_COLOUR_GRAYTEXT));
+			}
+			dc.DrawText(action->getLabel() + " (on disk)", rect.GetX() + 28, rect.GetY() + 3);
+		} else {
+			dc.DrawText(action->getLabel(), rect.GetX() + 28, rect.GetY() + 3);
+		}
 	} else {
 		dc.DrawBitmap(open_bitmap, rect.GetX() + 4, rect.GetY() + 4, true);
 		dc.DrawText("Open Map", rect.GetX() + 28, rect.GetY() + 3);
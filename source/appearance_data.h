@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_APPEARANCE_DATA_H_
+#define RME_APPEARANCE_DATA_H_
+
+#include "items.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// What the editor uses of the appearances file. It is read from the protobuf,
+// or from the startup cache when the file didn't change since the last launch.
+
+struct AppearanceSprites {
+	uint32_t layers = 0;
+	uint32_t pattern_width = 0;
+	uint32_t pattern_height = 0;
+	uint32_t pattern_depth = 0;
+	uint32_t start_phase = 0;
+	uint32_t loop_count = 0;
+	bool async_animation = false;
+	// Minimum and maximum duration of every phase
+	std::vector<std::pair<int, int>> phases;
+	std::vector<uint32_t> sprite_ids;
+};
+
+enum ItemAppearanceFlags : uint32_t {
+	APPEARANCE_ALWAYS_ON_BOTTOM = 1 << 0,
+	APPEARANCE_NO_MOVE_ANIMATION = 1 << 1,
+	APPEARANCE_CORPSE = 1 << 2,
+	APPEARANCE_FORCE_USE = 1 << 3,
+	APPEARANCE_HAS_HEIGHT = 1 << 4,
+	APPEARANCE_UNPASSABLE = 1 << 5,
+	APPEARANCE_BLOCK_MISSILES = 1 << 6,
+	APPEARANCE_BLOCK_PATHFINDER = 1 << 7,
+	APPEARANCE_PICKUPABLE = 1 << 8,
+	APPEARANCE_MOVEABLE = 1 << 9,
+	APPEARANCE_READABLE = 1 << 10,
+	APPEARANCE_HANGABLE = 1 << 11,
+	APPEARANCE_STACKABLE = 1 << 12,
+	APPEARANCE_PODIUM = 1 << 13,
+	APPEARANCE_ROTATABLE = 1 << 14,
+	APPEARANCE_IGNORE_LOOK = 1 << 15,
+	APPEARANCE_SHIFT = 1 << 16,
+	APPEARANCE_LIGHT = 1 << 17,
+};
+
+struct ItemAppearance {
+	uint16_t id = 0;
+	std::string name;
+	std::string description;
+	ItemGroup_t group = ITEM_GROUP_NONE;
+	ItemTypes_t type = ITEM_TYPE_NONE;
+	ItemHook_t hook = ITEM_HOOK_NONE;
+	int alwaysOnTopOrder = 0;
+	uint32_t flags = 0;
+
+	// Phases are collected over all frame groups, the rest is the one of the last group
+	AppearanceSprites sprites;
+	uint32_t sprite_id = 0;
+
+	uint16_t minimap_color = 0;
+	uint16_t draw_height = 0;
+	int shift_x = 0;
+	int shift_y = 0;
+	uint8_t light_color = 0;
+	uint8_t light_intensity = 0;
+
+	bool hasFlag(ItemAppearanceFlags flag) const noexcept {
+		return (flags & flag) != 0;
+	}
+};
+
+struct OutfitAppearance {
+	uint32_t id = 0;
+	// Only the first frame group, idle and moving look the same in the editor
+	AppearanceSprites sprites;
+
+	uint16_t minimap_color = 0;
+	uint16_t draw_height = 0;
+	bool has_shift = false;
+	int shift_x = 0;
+	int shift_y = 0;
+};
+
+#endif
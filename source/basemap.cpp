@@ -20,32 +20,91 @@
 #include "tile.h"
 #include "basemap.h"
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
 BaseMap::BaseMap() :
 	allocator(),
 	tilecount(0),
+	render_epoch(0),
+	leaf_directory_outdated(true),
 	root(*this) {
 	////
 }
 
 BaseMap::~BaseMap() {
-	////
+	releaseTree(true, false);
 }
 
 void BaseMap::clear(bool del) {
-	PositionVector pos_vec;
-	for (MapIterator map_iter = begin(); map_iter != end(); ++map_iter) {
-		Tile* t = (*map_iter)->get();
-		pos_vec.push_back(t->getPosition());
+	releaseTree(del, true);
+}
+
+void BaseMap::releaseTree(bool del, bool notify) {
+	std::vector<QTreeNode*> leaves;
+	leaves.reserve(leaf_directory ? leaf_directory->size() : 0);
+	root.getLeaves(leaves);
+
+	for (QTreeNode* leaf : leaves) {
+		for (Floor* floor : leaf->array) {
+			if (!floor) {
+				continue;
+			}
+			for (TileLocation &location : floor->locs) {
+				if (!location.tile) {
+					continue;
+				}
+				if (!del) {
+					location.tile = nullptr;
+				} else if (notify) {
+					onTileReplaced(location.tile, nullptr);
+				}
+			}
+			// Deletes the tiles left in it and the house exit lists
+			floor->~Floor();
+		}
 	}
-	for (PositionVector::iterator pos_iter = pos_vec.begin(); pos_iter != pos_vec.end(); ++pos_iter) {
-		setTile(*pos_iter, nullptr, del);
+
+	for (QTreeNode*&child : root.child) {
+		child = nullptr;
 	}
+	root.changed_floors = 0;
+	allocator.releaseNodes();
+	tilecount = 0;
+
+	std::scoped_lock lock(leaf_directory_mutex);
+	leaf_directory = nullptr;
+	leaf_directory_outdated = true;
 }
 
 void BaseMap::clearVisible(uint32_t mask) {
 	root.clearVisible(mask);
 }
 
+std::vector<MapArea> BaseMap::getAreas() {
+	std::vector<MapArea> areas;
+	// Every level of the tree takes two bits of each coordinate, the nodes four
+	// levels below the root cover 256x256 tiles
+	const auto visit = [&areas](const auto &self, QTreeNode* node, int x, int y, int shift) -> void {
+		if (shift == 8) {
+			areas.push_back({ node, x, y });
+			return;
+		}
+		for (int i = 0; i < rme::MapLayers; ++i) {
+			if (QTreeNode* child = node->child[i]) {
+				self(self, child, x | (i & 3) << (shift - 2), y | (i >> 2) << (shift - 2), shift - 2);
+			}
+		}
+	};
+	visit(visit, &root, 0, 0, 16);
+	return areas;
+}
+
+void BaseMap::markSaved() {
+	root.clearChanged();
+}
+
 Tile* BaseMap::createTile(int x, int y, int z) {
 	ASSERT(z < rme::MapLayers);
 	QTreeNode* leaf = root.getLeafForce(x, y);
@@ -55,6 +114,7 @@ Tile* BaseMap::createTile(int x, int y, int z) {
 	}
 	Tile* t = allocator(loc);
 	leaf->setTile(x, y, z, t);
+	root.setChanged(x, y, z);
 	return t;
 }
 
@@ -106,9 +166,10 @@ void BaseMap::setTile(int x, int y, int z, Tile* new_tile, bool remove) {
 
 	QTreeNode* leaf = root.getLeafForce(x, y);
 	Tile* old_tile = leaf->setTile(x, y, z, new_tile);
+	root.setChanged(x, y, z);
 
 	if ((remove && old_tile) || new_tile) {
-		updateUniqueIds(remove ? old_tile : nullptr, new_tile);
+		onTileReplaced(remove ? old_tile : nullptr, new_tile);
 	}
 
 	if (remove) {
@@ -135,9 +196,10 @@ Tile* BaseMap::swapTile(int x, int y, int z, Tile* new_tile) {
 
 	QTreeNode* leaf = root.getLeafForce(x, y);
 	Tile* old_tile = leaf->setTile(x, y, z, new_tile);
+	root.setChanged(x, y, z);
 
 	if (old_tile || new_tile) {
-		updateUniqueIds(old_tile, new_tile);
+		onTileReplaced(old_tile, new_tile);
 	}
 
 	return old_tile;
@@ -149,7 +211,18 @@ Tile* BaseMap::swapTile(const Position &position, Tile* new_tile) {
 
 // Iterators
 
+namespace {
+	void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#endif
+	}
+}
+
 MapIterator::MapIterator(BaseMap* _map) :
+	leaf_index(0),
 	local_i(0),
 	local_z(0),
 	current_tile(nullptr),
@@ -157,70 +230,20 @@ MapIterator::MapIterator(BaseMap* _map) :
 	////
 }
 
-MapIterator::~MapIterator() {
-	////
-}
-
-MapIterator::MapIterator(const MapIterator &other) {
-	for (std::vector<MapIterator::NodeIndex>::const_iterator it = other.nodestack.begin(); it != other.nodestack.end(); it++) {
-		nodestack.push_back(MapIterator::NodeIndex(*it));
-	}
-	local_i = other.local_i;
-	local_z = other.local_z;
-	map = other.map;
-	current_tile = other.current_tile;
-}
-
 MapIterator BaseMap::begin() {
 	MapIterator it(this);
-	it.nodestack.push_back(MapIterator::NodeIndex(&root));
-
-	while (true) {
-		MapIterator::NodeIndex &current = it.nodestack.back();
-		QTreeNode* node = current.node;
-		int &index = current.index;
-		// printf("Contemplating %p of %p (stack size %d)\n", node, this, it.nodestack.size());
-
-		bool unwind = false;
-		for (; index < 16; ++index) {
-			// printf("\tChecking index %d of %p\n", index, node);
-			if (QTreeNode* child = node->child[index]) {
-				if (child->isLeaf) {
-					QTreeNode* leaf = child;
-					// printf("\t%p is leaf\n", child);
-					for (it.local_z = 0; it.local_z < rme::MapLayers; ++it.local_z) {
-						if (Floor* floor = leaf->array[it.local_z]) {
-							for (it.local_i = 0; it.local_i < 16; ++it.local_i) {
-								// printf("\tit(%d;%d;%d)\n", it.local_x, it.local_y, it.local_z);
-								TileLocation &t = floor->locs[it.local_i];
-								if (t.get()) {
-									// printf("return it\n");
-									it.current_tile = &t;
-									return it;
-								}
-							}
-						}
-					}
-				} else {
-					// printf("\tAdding %p\n", child);
-					++index;
-					it.nodestack.push_back(MapIterator::NodeIndex(child));
-					unwind = true;
-					break;
-				}
-			}
-		}
-		if (unwind) {
-			continue;
-		}
-
-		// printf("Discarding dead node %p\n", node);
-		it.nodestack.pop_back();
-		if (it.nodestack.empty()) {
-			break;
+	{
+		std::scoped_lock lock(leaf_directory_mutex);
+		if (leaf_directory_outdated.exchange(false)) {
+			auto leaves = std::make_shared<std::vector<QTreeNode*>>();
+			leaves->reserve(leaf_directory ? leaf_directory->size() : 0);
+			root.getLeaves(*leaves);
+			leaf_directory = std::move(leaves);
 		}
+		it.leaves = leaf_directory;
 	}
-	return end();
+	it.seek();
+	return it;
 }
 
 MapIterator BaseMap::end() {
@@ -238,78 +261,50 @@ TileLocation* MapIterator::operator->() {
 	return current_tile;
 }
 
-MapIterator &MapIterator::operator++() {
-	// printf("MapIterator::operator++");
-	bool increased = false;
-	bool first = true;
-	while (true) {
-		MapIterator::NodeIndex &current = nodestack.back();
-		QTreeNode* node = current.node;
-		int &index = current.index;
-		// printf("Contemplating %p (stack size %d)\n", node, nodestack.size());
-
-		bool unwind = false;
-		for (; index < rme::MapLayers; ++index) {
-			// printf("\tChecking index %d of %p\n", index, node);
-			if (QTreeNode* child = node->child[index]) {
-				if (child->isLeaf) {
-					QTreeNode* leaf = child;
-					// printf("\t%p is leaf\n", child);
-					for (; local_z < rme::MapLayers; ++local_z) {
-						// printf("\t\tIterating over Z:%d of %p", local_z, child);
-						if (Floor* floor = leaf->array[local_z]) {
-							// printf("\n");
-							for (; local_i < rme::MapLayers; ++local_i) {
-								// printf("\t\tIterating over Y:%d of %p\n", local_y, child);
-								TileLocation &t = floor->locs[local_i];
-								if (t.get()) {
-									if (increased) {
-										// printf("Modified %p to %p\n", current_tile, t);
-										current_tile = &t;
-										return *this;
-									} else {
-										increased = true;
-									}
-								} else if (first) {
-									increased = true;
-									first = false;
-								}
-							}
-
-							if (local_i > rme::MapMaxLayer) {
-								// printf("\t\tReset local_x\n");
-								local_i = 0;
-							}
-						} else {
-							// printf(":dead floor\n");
-						}
-					}
-					if (local_z == rme::MapLayers) {
-						// printf("\t\tReset local_z\n");
-						local_z = 0;
+void MapIterator::seek() {
+	const LeafDirectory &directory = *leaves;
+	for (; leaf_index < directory.size(); ++leaf_index) {
+		QTreeNode* leaf = directory[leaf_index];
+		if (local_z == 0 && local_i == 0) {
+			// Entering a leaf, the node after the next one is loaded while this
+			// one is walked and the floors of the next one, whose node was loaded
+			// while the previous leaf was walked
+			if (leaf_index + 2 < directory.size()) {
+				prefetch(directory[leaf_index + 2]);
+			}
+			if (leaf_index + 1 < directory.size()) {
+				for (Floor* floor : directory[leaf_index + 1]->array) {
+					if (floor) {
+						prefetch(floor);
 					}
-				} else {
-					// printf("\tAdding %p\n", child);
-					++index;
-					nodestack.push_back(MapIterator::NodeIndex(child));
-					unwind = true;
-					break;
 				}
 			}
 		}
-		if (unwind) {
-			continue;
-		}
 
-		// printf("Discarding dead node %p\n", node);
-		nodestack.pop_back();
-		if (nodestack.size() == 0) {
-			// Set all values to "end"
-			// printf("END\n");
-			local_z = -1;
-			local_i = -1;
-			return *this;
+		for (; local_z < rme::MapLayers; ++local_z) {
+			if (Floor* floor = leaf->array[local_z]) {
+				for (; local_i < rme::MapLayers; ++local_i) {
+					TileLocation &location = floor->locs[local_i];
+					if (location.get()) {
+						current_tile = &location;
+						return;
+					}
+				}
+			}
+			local_i = 0;
 		}
+		local_z = 0;
+	}
+
+	current_tile = nullptr;
+	local_z = -1;
+	local_i = -1;
+}
+
+MapIterator &MapIterator::operator++() {
+	if (current_tile) {
+		++local_i;
+		seek();
 	}
 	return *this;
 }
@@ -24,6 +24,10 @@
 #include "map_allocator.h"
 #include "tile.h"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 // Class declarations
 class QTreeNode;
 class BaseMap;
@@ -32,50 +36,31 @@ class Floor;
 class QTreeNode;
 class TileLocation;
 
+// Goes through the leaves of the tree in the order of the leaf directory the map
+// had when begin() was called, leaves created afterwards are not visited
 class MapIterator {
 public:
 	MapIterator(BaseMap* _map = nullptr);
-	~MapIterator();
-	MapIterator(const MapIterator &other);
 
 	TileLocation* operator*();
 	TileLocation* operator->();
 	MapIterator &operator++();
 	MapIterator operator++(int);
-	bool operator==(const MapIterator &other) const {
-		if (other.local_z != local_z) {
-			return false;
-		}
-		if (other.local_i != local_i) {
-			return false;
-		}
-		if (other.nodestack == nodestack) {
-			return true;
-		}
-		if (other.current_tile == current_tile) {
-			return true;
-		}
-		return false;
+	bool operator==(const MapIterator &other) const noexcept {
+		return other.current_tile == current_tile;
 	}
-	bool operator!=(const MapIterator &other) const {
+	bool operator!=(const MapIterator &other) const noexcept {
 		return !(other == *this);
 	}
 
-	struct NodeIndex {
-		NodeIndex(QTreeNode* _node) :
-			index(0), node(_node) { }
-		NodeIndex(const NodeIndex &other) :
-			index(other.index), node(other.node) { }
-		int index;
-		QTreeNode* node;
+private:
+	using LeafDirectory = std::vector<QTreeNode*>;
 
-		bool operator==(const NodeIndex &n) const {
-			return n.node == node && n.index == index;
-		}
-	};
+	// Moves on to the first tile at or after the current place, or to the end
+	void seek();
 
-private:
-	std::vector<NodeIndex> nodestack;
+	std::shared_ptr<const LeafDirectory> leaves;
+	size_t leaf_index;
 	int local_i, local_z;
 	TileLocation* current_tile;
 	BaseMap* map;
@@ -83,12 +68,20 @@ private:
 	friend class BaseMap;
 };
 
+// A tree node covering 256x256 tiles on every floor, which is the extent of
+// an OTBM tile area
+struct MapArea {
+	QTreeNode* node;
+	int x, y;
+};
+
 class BaseMap {
 public:
 	BaseMap();
 	virtual ~BaseMap();
 
-	// This doesn't destroy the map structure, just clears it, if param is true, delete all tiles too.
+	// Removes every tile and drops the whole tree, if param is true, delete all tiles too.
+	// Tiles that are kept must not refer to locations of this map anymore.
 	void clear(bool del = true);
 	MapIterator begin();
 	MapIterator end();
@@ -128,17 +121,49 @@ public:
 	// Clears the visiblity according to the mask passed
 	void clearVisible(uint32_t mask);
 
+	// Tile areas in the order the map iterator visits them, their nodes know the
+	// floors that had tiles replaced since markSaved was last called
+	std::vector<MapArea> getAreas();
+	void markSaved();
+	// For edits that change a tile in place instead of replacing it
+	void markChanged(const Position &position) {
+		root.setChanged(position.x, position.y, position.z);
+	}
+
 	uint64_t getTileCount() const noexcept {
 		return tilecount;
 	}
 
+	// Bumped for edits that change tiles in place instead of going through actions,
+	// anything cached for drawing the map is rebuilt when it changes
+	void invalidateRender() noexcept {
+		++render_epoch;
+	}
+	uint32_t getRenderEpoch() const noexcept {
+		return render_epoch;
+	}
+
 public:
 	MapAllocator allocator;
 
 protected:
-	virtual void updateUniqueIds(Tile* old_tile, Tile* new_tile) { }
+	// Called whenever setTile or swapTile put new_tile in place of old_tile, old_tile
+	// is null unless it left the map
+	virtual void onTileReplaced(Tile* old_tile, Tile* new_tile) { }
+
+	// Destroys the locations, and the tiles too if del is set, then gives the memory
+	// of all floors and nodes back at once instead of taking the tree apart
+	void releaseTree(bool del, bool notify);
 
 	uint64_t tilecount;
+	uint32_t render_epoch;
+
+	// Leaves in the order the map iterator visits them, built again by begin() once
+	// a leaf was added. Leaves live as long as the map, iterators keep the directory
+	// they started with.
+	std::shared_ptr<const std::vector<QTreeNode*>> leaf_directory;
+	std::atomic<bool> leaf_directory_outdated;
+	std::mutex leaf_directory_mutex;
 
 	QTreeNode root; // The Quad Tree root
 
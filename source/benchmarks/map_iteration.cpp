@@ -0,0 +1,373 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+// Times full passes over every tile of a map with the tree walk MapIterator used
+// before the leaf directory, against the leaf directory walk it uses now, and
+// checks that both visit the same locations in the same order.
+//
+// The map is built from stand-ins with the layout of the nodes, floors and tile
+// locations in map_region.h, so the benchmark does not need the editor itself.
+//
+// Usage: map-iteration-benchmark [width] [height] [fill percentage] [seed]
+// Returns 1 if the two walks differ on the benchmark map or on any of the small
+// random maps checked before it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+	constexpr int MapLayers = 16;
+	constexpr int MapMaxLayer = MapLayers - 1;
+	constexpr int GroundLayer = 7;
+
+	struct Tile { };
+
+	struct TileLocation {
+		Tile* tile = nullptr;
+		int x = 0, y = 0, z = 0;
+		size_t spawn_monster_count = 0;
+		size_t spawn_npc_count = 0;
+		size_t waypoint_count = 0;
+		void* house_exits = nullptr;
+		uint32_t revision = 0;
+
+		Tile* get() noexcept {
+			return tile;
+		}
+	};
+
+	struct Floor {
+		TileLocation locs[MapLayers];
+	};
+
+	struct QTreeNode {
+		bool isLeaf = false;
+		QTreeNode* child[MapLayers] = {};
+		Floor* array[MapLayers] = {};
+
+		~QTreeNode() {
+			for (QTreeNode* node : child) {
+				delete node;
+			}
+			for (Floor* floor : array) {
+				delete floor;
+			}
+		}
+
+		// Same child order as QTreeNode::getLeafForce
+		QTreeNode* getLeafForce(int x, int y) {
+			QTreeNode* node = this;
+			uint32_t cx = x, cy = y;
+			for (int level = 6; level >= 0; --level) {
+				QTreeNode*&next = node->child[((cx & 0xC000) >> 14) | ((cy & 0xC000) >> 12)];
+				if (!next) {
+					next = new QTreeNode;
+					next->isLeaf = level == 0;
+				}
+				node = next;
+				cx <<= 2;
+				cy <<= 2;
+			}
+			return node;
+		}
+
+		void getLeaves(std::vector<QTreeNode*> &leaves) {
+			if (isLeaf) {
+				leaves.push_back(this);
+				return;
+			}
+			for (QTreeNode* node : child) {
+				if (node) {
+					node->getLeaves(leaves);
+				}
+			}
+		}
+
+		void createTile(int x, int y, int z, Tile* tile) {
+			QTreeNode* leaf = getLeafForce(x, y);
+			if (!leaf->array[z]) {
+				leaf->array[z] = new Floor;
+			}
+			TileLocation &location = leaf->array[z]->locs[(x & 3) * 4 + (y & 3)];
+			location.tile = tile;
+			location.x = x;
+			location.y = y;
+			location.z = z;
+		}
+	};
+
+	// MapIterator as it was before the leaf directory, every step searches the
+	// tree again from a stack of node indices
+	struct TreeIterator {
+		struct NodeIndex {
+			QTreeNode* node;
+			int index;
+		};
+
+		std::vector<NodeIndex> nodestack;
+		int local_i = 0, local_z = 0;
+		TileLocation* current_tile = nullptr;
+
+		explicit TreeIterator(QTreeNode* root) {
+			nodestack.push_back({ root, 0 });
+			while (!nodestack.empty()) {
+				NodeIndex &current = nodestack.back();
+				QTreeNode* node = current.node;
+				int &index = current.index;
+
+				bool unwind = false;
+				for (; index < 16; ++index) {
+					if (QTreeNode* child = node->child[index]) {
+						if (child->isLeaf) {
+							for (local_z = 0; local_z < MapLayers; ++local_z) {
+								if (Floor* floor = child->array[local_z]) {
+									for (local_i = 0; local_i < 16; ++local_i) {
+										if (floor->locs[local_i].get()) {
+											current_tile = &floor->locs[local_i];
+											return;
+										}
+									}
+								}
+							}
+						} else {
+							++index;
+							nodestack.push_back({ child, 0 });
+							unwind = true;
+							break;
+						}
+					}
+				}
+				if (!unwind) {
+					nodestack.pop_back();
+				}
+			}
+		}
+
+		bool atEnd() const noexcept {
+			return nodestack.empty();
+		}
+
+		void next() {
+			bool increased = false;
+			bool first = true;
+			while (true) {
+				NodeIndex &current = nodestack.back();
+				QTreeNode* node = current.node;
+				int &index = current.index;
+
+				bool unwind = false;
+				for (; index < MapLayers; ++index) {
+					if (QTreeNode* child = node->child[index]) {
+						if (child->isLeaf) {
+							for (; local_z < MapLayers; ++local_z) {
+								if (Floor* floor = child->array[local_z]) {
+									for (; local_i < MapLayers; ++local_i) {
+										TileLocation &location = floor->locs[local_i];
+										if (location.get()) {
+											if (increased) {
+												current_tile = &location;
+												return;
+											}
+											increased = true;
+										} else if (first) {
+											increased = true;
+											first = false;
+										}
+									}
+									if (local_i > MapMaxLayer) {
+										local_i = 0;
+									}
+								}
+							}
+							if (local_z == MapLayers) {
+								local_z = 0;
+							}
+						} else {
+							++index;
+							nodestack.push_back({ child, 0 });
+							unwind = true;
+							break;
+						}
+					}
+				}
+				if (unwind) {
+					continue;
+				}
+
+				nodestack.pop_back();
+				if (nodestack.empty()) {
+					current_tile = nullptr;
+					return;
+				}
+			}
+		}
+	};
+
+	// The walk of MapIterator::seek over a leaf directory, without the prefetching
+	template <typename Visit>
+	void walkLeaves(const std::vector<QTreeNode*> &leaves, Visit &&visit) {
+		for (QTreeNode* leaf : leaves) {
+			for (Floor* floor : leaf->array) {
+				if (!floor) {
+					continue;
+				}
+				for (TileLocation &location : floor->locs) {
+					if (location.get()) {
+						visit(&location);
+					}
+				}
+			}
+		}
+	}
+
+	template <typename Visit>
+	void walkTree(QTreeNode* root, Visit &&visit) {
+		for (TreeIterator it(root); !it.atEnd(); it.next()) {
+			visit(it.current_tile);
+		}
+	}
+
+	// Ground floor filled to the given percentage, the floors around it more sparsely
+	std::unique_ptr<QTreeNode> buildMap(int width, int height, int fill, uint32_t seed, Tile* tile) {
+		auto root = std::make_unique<QTreeNode>();
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<int> percent(0, 99);
+		for (int z = 0; z < MapLayers; ++z) {
+			const int floor_fill = z == GroundLayer ? fill : fill / (2 + std::abs(z - GroundLayer));
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; ++x) {
+					if (percent(random) < floor_fill) {
+						root->createTile(x, y, z, tile);
+					}
+				}
+			}
+		}
+		return root;
+	}
+
+	std::vector<TileLocation*> collectTree(QTreeNode* root) {
+		std::vector<TileLocation*> order;
+		walkTree(root, [&](TileLocation* location) { order.push_back(location); });
+		return order;
+	}
+
+	std::vector<TileLocation*> collectLeaves(QTreeNode* root) {
+		std::vector<QTreeNode*> leaves;
+		root->getLeaves(leaves);
+		std::vector<TileLocation*> order;
+		walkLeaves(leaves, [&](TileLocation* location) { order.push_back(location); });
+		return order;
+	}
+
+	// Small maps at random places, with empty floors and leaves the walks have to skip
+	bool checkOrder(Tile* tile) {
+		std::mt19937 random(1);
+		for (int round = 0; round < 200; ++round) {
+			auto root = std::make_unique<QTreeNode>();
+			const int tiles = random() % 400;
+			for (int i = 0; i < tiles; ++i) {
+				root->createTile(random() % 0x10000, random() % 0x10000, random() % MapLayers, tile);
+				// Clusters, so that leaves hold more than one tile
+				if (random() % 2) {
+					root->createTile(random() % 64, random() % 64, GroundLayer, tile);
+				}
+			}
+			if (collectTree(root.get()) != collectLeaves(root.get())) {
+				std::printf("Order check failed on random map %d\n", round);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct Run {
+		const char* name;
+		double seconds = std::numeric_limits<double>::max();
+		uint64_t tiles = 0;
+		uint64_t checksum = 0;
+	};
+}
+
+int main(int argc, char** argv) {
+	const int width = argc > 1 ? std::atoi(argv[1]) : 2048;
+	const int height = argc > 2 ? std::atoi(argv[2]) : 2048;
+	const int fill = argc > 3 ? std::atoi(argv[3]) : 60;
+	const uint32_t seed = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 1;
+	if (width <= 0 || height <= 0 || width > 0x10000 || height > 0x10000 || fill < 0 || fill > 100) {
+		std::printf("Usage: %s [width] [height] [fill percentage] [seed]\n", argv[0]);
+		return 2;
+	}
+
+	Tile tile;
+	if (!checkOrder(&tile)) {
+		return 1;
+	}
+
+	const auto root = buildMap(width, height, fill, seed, &tile);
+	std::vector<QTreeNode*> leaves;
+	root->getLeaves(leaves);
+
+	Run runs[] = { { "Tree walk" }, { "Leaf directory" } };
+
+	// Best of a few passes, the first one also warms the caches for the others
+	constexpr int Passes = 3;
+	for (int pass = 0; pass < Passes; ++pass) {
+		for (Run &run : runs) {
+			run.tiles = 0;
+			run.checksum = 0;
+			// Order sensitive, both passes have to visit the same locations one after another
+			const auto visit = [&run](const TileLocation* location) {
+				++run.tiles;
+				run.checksum = run.checksum * 31 + reinterpret_cast<uintptr_t>(location);
+			};
+
+			const auto start = std::chrono::steady_clock::now();
+			if (&run == &runs[0]) {
+				walkTree(root.get(), visit);
+			} else {
+				walkLeaves(leaves, visit);
+			}
+			run.seconds = std::min(run.seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+	}
+
+	const Run &tree = runs[0];
+	const Run &directory = runs[1];
+	const bool identical = tree.tiles == directory.tiles && tree.checksum == directory.checksum;
+
+	std::printf("Map iteration benchmark\n");
+	std::printf("\tMap: %dx%d, %d%% of the ground floor filled\n", width, height, fill);
+	std::printf("\tBest of %d full passes over every tile.\n", Passes);
+	std::printf("\tLeaves: %zu\n", leaves.size());
+	for (const Run &run : runs) {
+		std::printf("\t%s:\n", run.name);
+		std::printf("\t\tTime: %.3f ms\n", run.seconds * 1000.0);
+		std::printf("\t\tTiles: %llu\n", static_cast<unsigned long long>(run.tiles));
+	}
+	if (directory.seconds > 0.0) {
+		std::printf("\tSpeedup: %.2fx\n", tree.seconds / directory.seconds);
+	}
+	std::printf("\tResult: %s\n", identical ? "identical" : "DIFFERENT");
+	return identical ? 0 : 1;
+}
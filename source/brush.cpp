@@ -91,6 +91,7 @@ void Brushes::init() {
 	addBrush(g_gui.zone_brush = newd ZoneBrush());
 
 	GroundBrush::init();
+	GroundBrush::compileBorderRules();
 	WallBrush::init();
 	TableBrush::init();
 	CarpetBrush::init();
@@ -25,6 +25,8 @@
 #include "sprite_appearances.h"
 #include "gui.h"
 #include "otml.h"
+#include "appearance_data.h"
+#include "startup_cache.h"
 
 #include <appearances.pb.h>
 
@@ -34,6 +36,286 @@ namespace {
 		error = message;
 		return false;
 	}
+
+	namespace proto = canary::protobuf::appearances;
+
+	// Phases are added to the ones of earlier frame groups, the rest is replaced
+	void readSpriteInfo(const proto::SpriteInfo &spriteInfo, AppearanceSprites &sprites) {
+		sprites.layers = spriteInfo.layers();
+		sprites.pattern_width = spriteInfo.pattern_width();
+		sprites.pattern_height = spriteInfo.pattern_height();
+		sprites.pattern_depth = spriteInfo.pattern_depth();
+
+		const auto &animation = spriteInfo.animation();
+		if (animation.sprite_phase().size() > 0) {
+			sprites.start_phase = animation.default_start_phase();
+			sprites.loop_count = animation.loop_count();
+			sprites.async_animation = !animation.synchronized();
+			for (const auto &phase : animation.sprite_phase()) {
+				sprites.phases.emplace_back(static_cast<int>(phase.duration_min()), static_cast<int>(phase.duration_max()));
+			}
+		}
+
+		sprites.sprite_ids.assign(spriteInfo.sprite_id().begin(), spriteInfo.sprite_id().end());
+	}
+
+	void readItemAppearance(const proto::Appearance &object, ItemAppearance &item) {
+		const auto &flags = object.flags();
+		item.id = static_cast<uint16_t>(object.id());
+		item.name = object.name();
+		item.description = object.description();
+
+		if (flags.container()) {
+			item.type = ITEM_TYPE_CONTAINER;
+			item.group = ITEM_GROUP_CONTAINER;
+		} else if (flags.has_bank()) {
+			item.group = ITEM_GROUP_GROUND;
+		} else if (flags.liquidcontainer()) {
+			item.group = ITEM_GROUP_FLUID;
+		} else if (flags.liquidpool()) {
+			item.group = ITEM_GROUP_SPLASH;
+		}
+
+		if (flags.clip()) {
+			item.alwaysOnTopOrder = 1;
+		} else if (flags.top()) {
+			item.alwaysOnTopOrder = 3;
+		} else if (flags.bottom()) {
+			item.alwaysOnTopOrder = 2;
+		}
+
+		for (const auto &frameGroup : object.frame_group()) {
+			readSpriteInfo(frameGroup.sprite_info(), item.sprites);
+			item.sprite_id = frameGroup.sprite_info().sprite_id_size() > 0 ? frameGroup.sprite_info().sprite_id(0) : 0;
+		}
+
+		const std::pair<bool, ItemAppearanceFlags> itemFlags[] = {
+			{ flags.has_clip() || flags.has_top() || flags.has_bottom(), APPEARANCE_ALWAYS_ON_BOTTOM },
+			{ flags.no_movement_animation(), APPEARANCE_NO_MOVE_ANIMATION },
+			{ flags.corpse() || flags.player_corpse(), APPEARANCE_CORPSE },
+			{ flags.forceuse(), APPEARANCE_FORCE_USE },
+			{ flags.has_height(), APPEARANCE_HAS_HEIGHT },
+			{ flags.unpass(), APPEARANCE_UNPASSABLE },
+			{ flags.unsight(), APPEARANCE_BLOCK_MISSILES },
+			{ flags.avoid(), APPEARANCE_BLOCK_PATHFINDER },
+			{ flags.take(), APPEARANCE_PICKUPABLE },
+			{ !flags.unmove(), APPEARANCE_MOVEABLE },
+			{ flags.has_write() || flags.has_write_once(), APPEARANCE_READABLE },
+			{ flags.hang(), APPEARANCE_HANGABLE },
+			{ flags.cumulative(), APPEARANCE_STACKABLE },
+			{ flags.show_off_socket(), APPEARANCE_PODIUM },
+			{ flags.rotate(), APPEARANCE_ROTATABLE },
+			{ flags.ignore_look(), APPEARANCE_IGNORE_LOOK },
+			{ flags.has_shift(), APPEARANCE_SHIFT },
+			{ flags.has_light(), APPEARANCE_LIGHT },
+		};
+		for (const auto &[set, flag] : itemFlags) {
+			if (set) {
+				item.flags |= flag;
+			}
+		}
+
+		if (flags.has_hook()) {
+			item.hook = flags.hook().direction() == proto::HOOK_TYPE_SOUTH ? ITEM_HOOK_SOUTH : ITEM_HOOK_EAST;
+		}
+
+		item.minimap_color = flags.has_automap() ? static_cast<uint16_t>(flags.automap().color()) : 0;
+		item.draw_height = flags.has_height() ? static_cast<uint16_t>(flags.height().elevation()) : 0;
+		if (flags.has_shift()) {
+			item.shift_x = flags.shift().x();
+			item.shift_y = flags.shift().y();
+		}
+		if (flags.has_light()) {
+			item.light_color = flags.light().color();
+			item.light_intensity = flags.light().brightness();
+		}
+	}
+
+	void readOutfitAppearance(const proto::Appearance &outfit, OutfitAppearance &appearance) {
+		appearance.id = outfit.id();
+		// We dont need to worry about IDLE or MOVING frame group
+		if (outfit.frame_group_size() > 0) {
+			readSpriteInfo(outfit.frame_group(0).sprite_info(), appearance.sprites);
+		}
+
+		const auto &flags = outfit.flags();
+		appearance.minimap_color = flags.has_automap() ? static_cast<uint16_t>(flags.automap().color()) : 0;
+		appearance.draw_height = flags.has_height() ? static_cast<uint16_t>(flags.height().elevation()) : 0;
+		appearance.has_shift = flags.has_shift();
+		if (appearance.has_shift) {
+			appearance.shift_x = flags.shift().x();
+			appearance.shift_y = flags.shift().y();
+		}
+	}
+
+	void readAppearances(const proto::Appearances &appearances, std::vector<ItemAppearance> &items, std::vector<OutfitAppearance> &outfits) {
+		for (const proto::Appearance &object : appearances.object()) {
+			// This scenario should never happen but on custom assets this can break the loader.
+			if (!object.has_flags()) {
+				spdlog::error("[ClientAssets::loadAppearanceProtobuf] - Item with id {} is invalid and was ignored.", object.id());
+				wxLogError("[ClientAssets::loadAppearanceProtobuf] - Item with id %i is invalid and was ignored.", object.id());
+				continue;
+			}
+			if (object.has_id()) {
+				readItemAppearance(object, items.emplace_back());
+			}
+		}
+
+		for (const proto::Appearance &outfit : appearances.outfit()) {
+			readOutfitAppearance(outfit, outfits.emplace_back());
+		}
+	}
+
+	// Startup cache section of the appearances, an item or outfit node each
+	enum AppearanceCacheNode : uint8_t {
+		APPEARANCE_CACHE_ITEM = 1,
+		APPEARANCE_CACHE_OUTFIT = 2,
+	};
+
+	void writeSprites(NodeFileWriteHandle &writer, const AppearanceSprites &sprites) {
+		writer.addU32(sprites.layers);
+		writer.addU32(sprites.pattern_width);
+		writer.addU32(sprites.pattern_height);
+		writer.addU32(sprites.pattern_depth);
+		writer.addU32(sprites.start_phase);
+		writer.addU32(sprites.loop_count);
+		writer.addU8(sprites.async_animation);
+		writer.addU32(static_cast<uint32_t>(sprites.phases.size()));
+		for (const auto &[minimum, maximum] : sprites.phases) {
+			writer.addU32(static_cast<uint32_t>(minimum));
+			writer.addU32(static_cast<uint32_t>(maximum));
+		}
+		writer.addU32(static_cast<uint32_t>(sprites.sprite_ids.size()));
+		for (const uint32_t spriteId : sprites.sprite_ids) {
+			writer.addU32(spriteId);
+		}
+	}
+
+	bool readSprites(BinaryNode* node, AppearanceSprites &sprites) {
+		uint8_t async = 0;
+		uint32_t phases = 0;
+		uint32_t spriteIds = 0;
+		if (!node->getU32(sprites.layers) || !node->getU32(sprites.pattern_width) || !node->getU32(sprites.pattern_height) || !node->getU32(sprites.pattern_depth) || !node->getU32(sprites.start_phase) || !node->getU32(sprites.loop_count) || !node->getU8(async) || !node->getU32(phases)) {
+			return false;
+		}
+		sprites.async_animation = async != 0;
+
+		sprites.phases.resize(phases);
+		for (auto &[minimum, maximum] : sprites.phases) {
+			uint32_t value = 0;
+			if (!node->getU32(value)) {
+				return false;
+			}
+			minimum = static_cast<int>(value);
+			if (!node->getU32(value)) {
+				return false;
+			}
+			maximum = static_cast<int>(value);
+		}
+
+		if (!node->getU32(spriteIds)) {
+			return false;
+		}
+		sprites.sprite_ids.resize(spriteIds);
+		for (uint32_t &spriteId : sprites.sprite_ids) {
+			if (!node->getU32(spriteId)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void writeAppearanceCache(NodeFileWriteHandle &writer, const std::vector<ItemAppearance> &items, const std::vector<OutfitAppearance> &outfits) {
+		writer.addNode(0);
+		for (const ItemAppearance &item : items) {
+			writer.addNode(APPEARANCE_CACHE_ITEM);
+			writer.addU16(item.id);
+			writer.addString(item.name);
+			writer.addLongString(item.description);
+			writer.addU8(static_cast<uint8_t>(item.group));
+			writer.addU8(static_cast<uint8_t>(item.type));
+			writer.addU8(static_cast<uint8_t>(item.hook));
+			writer.addU8(static_cast<uint8_t>(item.alwaysOnTopOrder));
+			writer.addU32(item.flags);
+			writeSprites(writer, item.sprites);
+			writer.addU32(item.sprite_id);
+			writer.addU16(item.minimap_color);
+			writer.addU16(item.draw_height);
+			writer.addU32(static_cast<uint32_t>(item.shift_x));
+			writer.addU32(static_cast<uint32_t>(item.shift_y));
+			writer.addU8(item.light_color);
+			writer.addU8(item.light_intensity);
+			writer.endNode();
+		}
+		for (const OutfitAppearance &outfit : outfits) {
+			writer.addNode(APPEARANCE_CACHE_OUTFIT);
+			writer.addU32(outfit.id);
+			writeSprites(writer, outfit.sprites);
+			writer.addU16(outfit.minimap_color);
+			writer.addU16(outfit.draw_height);
+			writer.addU8(outfit.has_shift);
+			writer.addU32(static_cast<uint32_t>(outfit.shift_x));
+			writer.addU32(static_cast<uint32_t>(outfit.shift_y));
+			writer.endNode();
+		}
+		writer.endNode();
+	}
+
+	bool readItemNode(BinaryNode* node, ItemAppearance &item) {
+		uint8_t group = 0;
+		uint8_t type = 0;
+		uint8_t hook = 0;
+		uint8_t topOrder = 0;
+		uint32_t shiftX = 0;
+		uint32_t shiftY = 0;
+		if (!node->getU16(item.id) || !node->getString(item.name) || !node->getLongString(item.description) || !node->getU8(group) || !node->getU8(type) || !node->getU8(hook) || !node->getU8(topOrder) || !node->getU32(item.flags)) {
+			return false;
+		}
+		if (!readSprites(node, item.sprites) || !node->getU32(item.sprite_id) || !node->getU16(item.minimap_color) || !node->getU16(item.draw_height) || !node->getU32(shiftX) || !node->getU32(shiftY) || !node->getU8(item.light_color) || !node->getU8(item.light_intensity)) {
+			return false;
+		}
+		item.group = static_cast<ItemGroup_t>(group);
+		item.type = static_cast<ItemTypes_t>(type);
+		item.hook = static_cast<ItemHook_t>(hook);
+		item.alwaysOnTopOrder = topOrder;
+		item.shift_x = static_cast<int32_t>(shiftX);
+		item.shift_y = static_cast<int32_t>(shiftY);
+		return true;
+	}
+
+	bool readOutfitNode(BinaryNode* node, OutfitAppearance &outfit) {
+		uint8_t hasShift = 0;
+		uint32_t shiftX = 0;
+		uint32_t shiftY = 0;
+		if (!node->getU32(outfit.id) || !readSprites(node, outfit.sprites) || !node->getU16(outfit.minimap_color) || !node->getU16(outfit.draw_height) || !node->getU8(hasShift) || !node->getU32(shiftX) || !node->getU32(shiftY)) {
+			return false;
+		}
+		outfit.has_shift = hasShift != 0;
+		outfit.shift_x = static_cast<int32_t>(shiftX);
+		outfit.shift_y = static_cast<int32_t>(shiftY);
+		return true;
+	}
+
+	bool readAppearanceCache(BinaryNode* root, std::vector<ItemAppearance> &items, std::vector<OutfitAppearance> &outfits) {
+		for (BinaryNode* node = root->getChild(); node != nullptr; node = node->advance()) {
+			uint8_t type = 0;
+			bool read = node->getU8(type);
+			if (read && type == APPEARANCE_CACHE_ITEM) {
+				read = readItemNode(node, items.emplace_back());
+			} else if (read && type == APPEARANCE_CACHE_OUTFIT) {
+				read = readOutfitNode(node, outfits.emplace_back());
+			} else {
+				read = false;
+			}
+
+			if (!read) {
+				items.clear();
+				outfits.clear();
+				return false;
+			}
+		}
+		return true;
+	}
 } // namespace (internal use only)
 
 using json = nlohmann::json;
@@ -59,7 +341,6 @@ void ClientAssets::load() {
 }
 
 bool ClientAssets::loadAppearanceProtobuf(wxString &error, wxArrayString &warnings) {
-	using namespace canary::protobuf::appearances;
 	using json = nlohmann::json;
 
 	auto clientDirectory = ClientAssets::getPath().ToStdString() + "/";
@@ -101,51 +382,62 @@ bool ClientAssets::loadAppearanceProtobuf(wxString &error, wxArrayString &warnin
 	version_name = version;
 
 	const std::string appearanceFileName = g_spriteAppearances.getAppearanceFileName();
+	const FileName appearanceFile(wxstr(assetsDirectory + appearanceFileName));
 
-	std::fstream fileStream(assetsDirectory + appearanceFileName, std::ios::in | std::ios::binary);
-	if (!fileStream.is_open()) {
-		error = "Failed to load " + appearanceFileName + " from the client folder, file cannot be oppened";
-		spdlog::error("[{}] - Failed to load {}, file cannot be oppened", __func__, appearanceFileName);
-		fileStream.close();
-		return false;
-	}
+	std::vector<ItemAppearance> itemAppearances;
+	std::vector<OutfitAppearance> outfitAppearances;
+	BinaryNode* root = g_startupCache.getSection(StartupCache::SECTION_APPEARANCES, appearanceFile);
+	if (root && readAppearanceCache(root, itemAppearances, outfitAppearances)) {
+		spdlog::info("[{}] - Read {} from the startup cache", __func__, appearanceFileName);
+	} else {
+		std::fstream fileStream(assetsDirectory + appearanceFileName, std::ios::in | std::ios::binary);
+		if (!fileStream.is_open()) {
+			error = "Failed to load " + appearanceFileName + " from the client folder, file cannot be oppened";
+			spdlog::error("[{}] - Failed to load {}, file cannot be oppened", __func__, appearanceFileName);
+			fileStream.close();
+			return false;
+		}
 
-	// Verify that the version of the library that we linked against is
-	// compatible with the version of the headers we compiled against.
-	GOOGLE_PROTOBUF_VERIFY_VERSION;
-	g_gui.m_appearancesPtr = std::make_unique<Appearances>();
-	if (!g_gui.m_appearancesPtr->ParseFromIstream(&fileStream)) {
-		error = "Failed to parse binary file " + appearanceFileName + ", file is invalid";
-		spdlog::error("[{}] - Failed to parse binary file {}, file is invalid", __func__, appearanceFileName);
+		// Verify that the version of the library that we linked against is
+		// compatible with the version of the headers we compiled against.
+		GOOGLE_PROTOBUF_VERIFY_VERSION;
+		g_gui.m_appearancesPtr = std::make_unique<proto::Appearances>();
+		if (!g_gui.m_appearancesPtr->ParseFromIstream(&fileStream)) {
+			error = "Failed to parse binary file " + appearanceFileName + ", file is invalid";
+			spdlog::error("[{}] - Failed to parse binary file {}, file is invalid", __func__, appearanceFileName);
+			fileStream.close();
+			return false;
+		}
 		fileStream.close();
-		return false;
+
+		readAppearances(*g_gui.m_appearancesPtr, itemAppearances, outfitAppearances);
+
+		MemoryNodeFileWriteHandle writer;
+		writeAppearanceCache(writer, itemAppearances, outfitAppearances);
+		g_startupCache.setSection(StartupCache::SECTION_APPEARANCES, { appearanceFile }, writer);
+
+		// Disposing allocated objects.
+		g_gui.m_appearancesPtr.reset();
+		google::protobuf::ShutdownProtobufLibrary();
 	}
 
 	// Parsing all items into ItemType
-	bool rt = g_items.loadFromProtobuf(error, warnings, *g_gui.m_appearancesPtr);
+	bool rt = g_items.loadFromAppearances(itemAppearances, error, warnings);
 	if (!rt) {
 		error = "Failed to parse item types from protobuf";
 		spdlog::error("[{}] - Failed to parse item types from protobuf", __func__);
-		fileStream.close();
 		return false;
 	}
 
 	// Load looktypes
-	for (int i = 0; i < g_gui.m_appearancesPtr->outfit().size(); i++) {
-		const auto &outfit = g_gui.m_appearancesPtr->outfit().Get(i);
+	for (const OutfitAppearance &outfit : outfitAppearances) {
 		if (!g_gui.gfx.loadOutfitSpriteMetadata(outfit, error, warnings)) {
 			error = "Failed to parse outfit types from protobuf";
 			spdlog::error("[{}] - Failed to parse outfit types from protobuf", __func__);
-			fileStream.close();
 			return false;
 		}
 	}
 
-	fileStream.close();
-
-	// Disposing allocated objects.
-	google::protobuf::ShutdownProtobufLibrary();
-
 	// Client loaded
 	setLoaded(true);
 	return true;
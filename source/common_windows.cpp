@@ -179,7 +179,7 @@ struct MapConversionContext {
 	typedef std::map<std::string, NpcInfo> NpcMap;
 	NpcMap npcType;
 
-	void operator()(Map &map, Tile* tile, long long done) {
+	void operator()(Tile* tile) {
 		for (const auto monster : tile->monsters) {
 			const auto it = monsterType.find(monster->getName());
 			if (it == monsterType.end()) {
@@ -201,6 +201,12 @@ struct MapConversionContext {
 			}
 		}
 	}
+
+	// Keeps the entries already known, like visiting the tiles one by one would
+	void merge(const MapConversionContext &other) {
+		monsterType.insert(other.monsterType.begin(), other.monsterType.end());
+		npcType.insert(other.npcType.begin(), other.npcType.end());
+	}
 };
 
 void MapPropertiesWindow::OnClickOK(wxCommandEvent &WXUNUSED(event)) {
@@ -245,7 +251,15 @@ void MapPropertiesWindow::OnClickOK(wxCommandEvent &WXUNUSED(event)) {
 
 			// Remember all monsters types on the map
 			MapConversionContext conversion_context;
-			foreach_TileOnMap(map, conversion_context);
+			parallel_foreach_TileOnMap<MapConversionContext>(
+				map,
+				[](Tile* tile, MapConversionContext &context) {
+					context(tile);
+				},
+				[&conversion_context](const MapConversionContext &context, uint64_t) {
+					conversion_context.merge(context);
+				}
+			);
 
 			// Perform the conversion
 			map.convert(new_ver, true);
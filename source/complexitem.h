@@ -89,9 +89,9 @@ public:
 	}
 	void setDestination(const Position &position) noexcept {
 		destination = position;
-		setAttribute("destination.x", position.x);
-		setAttribute("destination.y", position.y);
-		setAttribute("destination.z", position.z);
+		setAttribute(ItemAttributeKeys::DestinationX, position.x);
+		setAttribute(ItemAttributeKeys::DestinationY, position.y);
+		setAttribute(ItemAttributeKeys::DestinationZ, position.z);
 	}
 	bool hasDestination() const noexcept {
 		return destination.isValid();
@@ -115,7 +115,7 @@ public:
 	}
 	void setDoorID(uint8_t id) {
 		doorId = id;
-		setAttribute("doorid", doorId);
+		setAttribute(ItemAttributeKeys::DoorId, doorId);
 	}
 
 	virtual void serializeItemAttributes_OTBM(const IOMap &maphandle, NodeFileWriteHandle &f) const override;
@@ -139,7 +139,7 @@ public:
 	}
 	void setDepotID(uint8_t id) {
 		depotId = id;
-		setAttribute("depotid", depotId);
+		setAttribute(ItemAttributeKeys::DepotId, depotId);
 	}
 
 	virtual void serializeItemAttributes_OTBM(const IOMap &maphandle, NodeFileWriteHandle &f) const override;
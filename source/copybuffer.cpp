@@ -22,19 +22,64 @@
 #include "gui.h"
 #include "monster.h"
 #include "npc.h"
+#include "iomap.h"
+#include "filehandle.h"
+#include "parallel.h"
+
+namespace {
+	constexpr uint32_t NoCreatures = 0xFFFFFFFF;
+	// Tiles decoded by one task of a parallel decode
+	constexpr size_t DecodeChunkSize = 1024;
+
+	// The newest map version, it is the only one that keeps the whole
+	// attribute map of an item
+	const IOMap &bufferIOMap() {
+		static VirtualIOMap iomap([] {
+			MapVersion version;
+			version.otbm = MAP_OTBM_LAST_VERSION;
+			return version;
+		}());
+		return iomap;
+	}
+
+	Item* readBufferItem(BinaryNode* node) {
+		uint8_t type;
+		if (!node->getByte(type) || type != OTBM_ITEM) {
+			return nullptr;
+		}
+
+		Item* item = Item::Create_OTBM(bufferIOMap(), node);
+		if (item && !item->unserializeItemNode_OTBM(bufferIOMap(), node)) {
+			delete item;
+			return nullptr;
+		}
+		return item;
+	}
+}
 
 CopyBuffer::CopyBuffer() :
-	tiles(newd BaseMap()) {
+	bufferMap(nullptr) {
 	;
 }
 
 size_t CopyBuffer::GetTileCount() {
-	return tiles ? (size_t)tiles->size() : 0;
+	return tileOffsets.size();
 }
 
 BaseMap &CopyBuffer::getBufferMap() {
-	ASSERT(tiles);
-	return *tiles;
+	if (!bufferMap) {
+		bufferMap = newd BaseMap();
+		for (const BufferTile &bufferTile : decodeTiles()) {
+			bufferTile.tile->setLocation(bufferMap->createTileL(bufferTile.position));
+			bufferMap->setTile(bufferTile.tile);
+		}
+	}
+	return *bufferMap;
+}
+
+void CopyBuffer::releaseBufferMap() {
+	delete bufferMap;
+	bufferMap = nullptr;
 }
 
 CopyBuffer::~CopyBuffer() {
@@ -42,74 +87,179 @@ CopyBuffer::~CopyBuffer() {
 }
 
 Position CopyBuffer::getPosition() const {
-	ASSERT(tiles);
 	return copyPos;
 }
 
 void CopyBuffer::clear() {
-	delete tiles;
-	tiles = nullptr;
+	releaseBufferMap();
+	buffer.clear();
+	buffer.shrink_to_fit();
+	tileOffsets.clear();
+	tileOffsets.shrink_to_fit();
+	for (Tile* tile : creatureTiles) {
+		delete tile;
+	}
+	creatureTiles.clear();
 }
 
-void CopyBuffer::copy(Editor &editor, int floor) {
-	if (!editor.hasSelection()) {
-		g_gui.SetStatusText("No tiles to copy.");
-		return;
+void CopyBuffer::addTile(Tile* tile, bool cut, int &item_count, int &monster_count) {
+	static MemoryNodeFileWriteHandle writer;
+	writer.reset();
+
+	const Position &position = tile->getPosition();
+	writer.addNode(0);
+	writer.addU16(position.x);
+	writer.addU16(position.y);
+	writer.addU8(position.z);
+
+	if (tile->ground && tile->ground->isSelected()) {
+		writer.addU8(1);
+		writer.addU16(tile->getMapFlags());
+		writer.addU32(tile->house_id);
+		if (cut) {
+			tile->house_id = 0;
+			tile->setMapFlags(TILESTATE_NONE);
+		}
+	} else {
+		writer.addU8(0);
 	}
 
-	clear();
-	tiles = newd BaseMap();
+	Tile* creatures = nullptr;
+	const auto getCreatures = [&]() {
+		if (!creatures) {
+			creatures = newd Tile(position.x, position.y, position.z);
+		}
+		return creatures;
+	};
 
-	int tile_count = 0;
-	int item_count = 0;
-	int monsterCount = 0;
-	copyPos = Position(0xFFFF, 0xFFFF, floor);
+	const auto monsters = cut ? tile->popSelectedMonsters() : tile->getSelectedMonsters();
+	for (Monster* monster : monsters) {
+		++monster_count;
+		getCreatures()->monsters.push_back(cut ? monster : monster->deepCopy());
+	}
 
-	for (Tile* tile : editor.getSelection()) {
-		++tile_count;
+	if (tile->spawnMonster && tile->spawnMonster->isSelected()) {
+		getCreatures()->spawnMonster = cut ? tile->spawnMonster : tile->spawnMonster->deepCopy();
+		if (cut) {
+			tile->spawnMonster = nullptr;
+		}
+	}
+	if (tile->npc && tile->npc->isSelected()) {
+		getCreatures()->npc = cut ? tile->npc : tile->npc->deepCopy();
+		if (cut) {
+			tile->npc = nullptr;
+		}
+	}
+	if (tile->spawnNpc && tile->spawnNpc->isSelected()) {
+		getCreatures()->spawnNpc = cut ? tile->spawnNpc : tile->spawnNpc->deepCopy();
+		if (cut) {
+			tile->spawnNpc = nullptr;
+		}
+	}
 
-		TileLocation* newlocation = tiles->createTileL(tile->getPosition());
-		Tile* copied_tile = tiles->allocator(newlocation);
+	if (creatures) {
+		writer.addU32(static_cast<uint32_t>(creatureTiles.size()));
+		creatureTiles.push_back(creatures);
+	} else {
+		writer.addU32(NoCreatures);
+	}
 
-		if (tile->ground && tile->ground->isSelected()) {
-			copied_tile->house_id = tile->house_id;
-			copied_tile->setMapFlags(tile->getMapFlags());
+	const ItemVector items = cut ? tile->popSelectedItems() : tile->getSelectedItems();
+	for (Item* item : items) {
+		item->serializeItemNode_OTBM(bufferIOMap(), writer);
+		if (cut) {
+			delete item;
 		}
+	}
+	item_count += static_cast<int>(items.size());
+	writer.endNode();
 
-		ItemVector tile_selection = tile->getSelectedItems();
-		for (ItemVector::iterator iit = tile_selection.begin(); iit != tile_selection.end(); ++iit) {
-			++item_count;
-			// Copy items to copybuffer
-			copied_tile->addItem((*iit)->deepCopy());
-		}
+	tileOffsets.push_back(buffer.size());
+	buffer.insert(buffer.end(), writer.getMemory(), writer.getMemory() + writer.getSize());
 
-		// Monster
-		const auto monstersSelection = tile->getSelectedMonsters();
-		std::ranges::for_each(monstersSelection, [&](const auto monster) {
-			++monsterCount;
-			copied_tile->addMonster(monster->deepCopy());
-		});
+	copyPos.x = std::min(copyPos.x, position.x);
+	copyPos.y = std::min(copyPos.y, position.y);
+}
+
+CopyBuffer::BufferTile CopyBuffer::decodeTile(size_t index) const {
+	const size_t start = tileOffsets[index];
+	const size_t end = index + 1 < tileOffsets.size() ? tileOffsets[index + 1] : buffer.size();
+
+	MemoryNodeFileReadHandle reader(buffer.data() + start, end - start);
+	BinaryNode* node = reader.getRootNode();
+	ASSERT(node);
+
+	uint16_t x = 0, y = 0;
+	uint8_t z = 0, properties = 0;
+	uint32_t creatures = NoCreatures;
+	node->getU16(x);
+	node->getU16(y);
+	node->getU8(z);
+	node->getU8(properties);
+
+	Tile* tile = newd Tile(x, y, z);
+	if (properties) {
+		uint16_t mapFlags = 0;
+		node->getU16(mapFlags);
+		node->getU32(tile->house_id);
+		tile->setMapFlags(mapFlags);
+	}
 
-		if (tile->spawnMonster && tile->spawnMonster->isSelected()) {
-			copied_tile->spawnMonster = tile->spawnMonster->deepCopy();
+	node->getU32(creatures);
+	if (creatures != NoCreatures) {
+		const Tile* creatureTile = creatureTiles[creatures];
+		for (const Monster* monster : creatureTile->monsters) {
+			tile->monsters.push_back(monster->deepCopy());
 		}
-		// Npc
-		if (tile->npc && tile->npc->isSelected()) {
-			copied_tile->npc = tile->npc->deepCopy();
+		if (creatureTile->spawnMonster) {
+			tile->spawnMonster = creatureTile->spawnMonster->deepCopy();
 		}
-		if (tile->spawnNpc && tile->spawnNpc->isSelected()) {
-			copied_tile->spawnNpc = tile->spawnNpc->deepCopy();
+		if (creatureTile->npc) {
+			tile->npc = creatureTile->npc->deepCopy();
 		}
+		if (creatureTile->spawnNpc) {
+			tile->spawnNpc = creatureTile->spawnNpc->deepCopy();
+		}
+	}
 
-		tiles->setTile(copied_tile);
-
-		if (copied_tile->getX() < copyPos.x) {
-			copyPos.x = copied_tile->getX();
+	// Only selected items are copied, they are pasted selected again
+	for (BinaryNode* itemNode = node->getChild(); itemNode != nullptr; itemNode = itemNode->advance()) {
+		if (Item* item = readBufferItem(itemNode)) {
+			item->select();
+			tile->addItem(item);
 		}
+	}
+	return { Position(x, y, z), tile };
+}
 
-		if (copied_tile->getY() < copyPos.y) {
-			copyPos.y = copied_tile->getY();
+std::vector<CopyBuffer::BufferTile> CopyBuffer::decodeTiles() const {
+	std::vector<BufferTile> tiles(tileOffsets.size());
+	const size_t chunks = (tiles.size() + DecodeChunkSize - 1) / DecodeChunkSize;
+	rme::parallelFor(chunks, [&](size_t chunk) {
+		const size_t end = std::min((chunk + 1) * DecodeChunkSize, tiles.size());
+		for (size_t index = chunk * DecodeChunkSize; index < end; ++index) {
+			tiles[index] = decodeTile(index);
 		}
+	});
+	return tiles;
+}
+
+void CopyBuffer::copy(Editor &editor, int floor) {
+	if (!editor.hasSelection()) {
+		g_gui.SetStatusText("No tiles to copy.");
+		return;
+	}
+
+	clear();
+
+	int tile_count = 0;
+	int item_count = 0;
+	int monsterCount = 0;
+	copyPos = Position(0xFFFF, 0xFFFF, floor);
+
+	for (Tile* tile : editor.getSelection()) {
+		++tile_count;
+		addTile(tile, false, item_count, monsterCount);
 	}
 
 	fmt::dynamic_format_arg_store<fmt::format_context> store;
@@ -131,7 +281,6 @@ void CopyBuffer::cut(Editor &editor, int floor) {
 	}
 
 	clear();
-	tiles = newd BaseMap();
 
 	Map &map = editor.getMap();
 	int tile_count = 0;
@@ -148,54 +297,7 @@ void CopyBuffer::cut(Editor &editor, int floor) {
 		tile_count++;
 
 		Tile* newtile = tile->deepCopy(map);
-		Tile* copied_tile = tiles->allocator(tile->getLocation());
-
-		if (tile->ground && tile->ground->isSelected()) {
-			copied_tile->house_id = newtile->house_id;
-			newtile->house_id = 0;
-			copied_tile->setMapFlags(tile->getMapFlags());
-			newtile->setMapFlags(TILESTATE_NONE);
-		}
-
-		ItemVector tile_selection = newtile->popSelectedItems();
-		for (ItemVector::iterator iit = tile_selection.begin(); iit != tile_selection.end(); ++iit) {
-			item_count++;
-			// Add items to copybuffer
-			copied_tile->addItem(*iit);
-		}
-
-		// Monster
-		const auto monsterSelection = newtile->popSelectedMonsters();
-		for (auto monsterIt = monsterSelection.begin(); monsterIt != monsterSelection.end(); ++monsterIt) {
-			++monsterCount;
-			copied_tile->monsters.emplace_back(*monsterIt);
-		}
-
-		if (newtile->spawnMonster && newtile->spawnMonster->isSelected()) {
-			copied_tile->spawnMonster = newtile->spawnMonster;
-			newtile->spawnMonster = nullptr;
-		}
-
-		// Npc
-		if (newtile->npc && newtile->npc->isSelected()) {
-			copied_tile->npc = newtile->npc;
-			newtile->npc = nullptr;
-		}
-
-		if (newtile->spawnNpc && newtile->spawnNpc->isSelected()) {
-			copied_tile->spawnNpc = newtile->spawnNpc;
-			newtile->spawnNpc = nullptr;
-		}
-
-		tiles->setTile(copied_tile->getPosition(), copied_tile);
-
-		if (copied_tile->getX() < copyPos.x) {
-			copyPos.x = copied_tile->getX();
-		}
-
-		if (copied_tile->getY() < copyPos.y) {
-			copyPos.y = copied_tile->getY();
-		}
+		addTile(newtile, true, item_count, monsterCount);
 
 		if (g_settings.getInteger(Config::USE_AUTOMAGIC)) {
 			for (int y = -1; y <= 1; y++) {
@@ -252,24 +354,25 @@ void CopyBuffer::cut(Editor &editor, int floor) {
 }
 
 void CopyBuffer::paste(Editor &editor, const Position &toPosition) {
-	if (!tiles) {
+	if (tileOffsets.empty()) {
 		return;
 	}
 
 	Map &map = editor.getMap();
+	const std::vector<BufferTile> bufferTiles = decodeTiles();
 
 	BatchAction* batchAction = editor.createBatch(ACTION_PASTE_TILES);
 	Action* action = editor.createAction(batchAction);
-	for (MapIterator it = tiles->begin(); it != tiles->end(); ++it) {
-		Tile* buffer_tile = (*it)->get();
-		Position pos = buffer_tile->getPosition() - copyPos + toPosition;
+	for (const BufferTile &bufferTile : bufferTiles) {
+		Tile* copy_tile = bufferTile.tile;
+		Position pos = bufferTile.position - copyPos + toPosition;
 
 		if (!pos.isValid()) {
+			delete copy_tile;
 			continue;
 		}
 
 		TileLocation* location = map.createTileL(pos);
-		Tile* copy_tile = buffer_tile->deepCopy(map);
 		Tile* old_dest_tile = location->get();
 		Tile* new_dest_tile = nullptr;
 		copy_tile->setLocation(location);
@@ -306,9 +409,9 @@ void CopyBuffer::paste(Editor &editor, const Position &toPosition) {
 		TileList borderize_tiles;
 
 		// Go through all modified (selected) tiles (might be slow)
-		for (MapIterator it = tiles->begin(); it != tiles->end(); ++it) {
+		for (const BufferTile &bufferTile : bufferTiles) {
 			bool add_me = false; // If this tile is touched
-			Position pos = (*it)->getPosition() - copyPos + toPosition;
+			Position pos = bufferTile.position - copyPos + toPosition;
 			if (pos.z < rme::MapMinLayer || pos.z > rme::MapMaxLayer) {
 				continue;
 			}
@@ -385,5 +488,5 @@ void CopyBuffer::paste(Editor &editor, const Position &toPosition) {
 }
 
 bool CopyBuffer::canPaste() const {
-	return tiles && tiles->size() != 0;
+	return !tileOffsets.empty();
 }
@@ -23,6 +23,13 @@
 
 class Editor;
 
+/*
+	The copybuffer keeps every copied tile as a standalone OTBM node with its
+	items as child nodes, one after another in a single block. Monsters, npcs
+	and spawns aren't part of the item encoding, a tile that has any of them
+	refers to a tile without location that holds them. Tiles are only created
+	again when they are pasted, or for the paste preview.
+*/
 class CopyBuffer {
 public:
 	CopyBuffer();
@@ -41,11 +48,29 @@ public:
 
 	size_t GetTileCount();
 
+	// Tiles of the copybuffer for the paste preview, decoded on first use
 	BaseMap &getBufferMap();
+	// Frees the preview tiles, the copybuffer itself is kept
+	void releaseBufferMap();
 
 private:
+	struct BufferTile {
+		Position position;
+		Tile* tile;
+	};
+
+	// Appends the selected parts of the tile and counts them, items and
+	// creatures are moved out of it if cut is set and copied otherwise
+	void addTile(Tile* tile, bool cut, int &item_count, int &monster_count);
+	// Safe to call from several threads at once
+	BufferTile decodeTile(size_t index) const;
+	std::vector<BufferTile> decodeTiles() const;
+
 	Position copyPos;
-	BaseMap* tiles;
+	std::vector<uint8_t> buffer;
+	std::vector<size_t> tileOffsets;
+	std::vector<Tile*> creatureTiles;
+	BaseMap* bufferMap;
 };
 
 #endif
@@ -42,13 +42,28 @@
 #include "live_server.h"
 #include "live_client.h"
 #include "live_action.h"
+#include "parallel.h"
 
+#include <atomic>
 #include <filesystem>
 #include <chrono>
 #include <iostream>
 
 namespace fs = std::filesystem;
 
+namespace {
+	// The map is saved into temporary files that replace the originals in one
+	// step, the originals only get a second name to keep the old version around.
+	void makeTemporaryBackup(const std::string &file, const std::string &backup) {
+		std::error_code ec;
+		fs::remove(backup, ec);
+		fs::create_hard_link(file, backup, ec);
+		if (ec) {
+			fs::copy_file(file, backup, fs::copy_options::overwrite_existing, ec);
+		}
+	}
+}
+
 Editor::Editor(CopyBuffer &copybuffer) :
 	live_server(nullptr),
 	live_client(nullptr),
@@ -221,6 +236,9 @@ void Editor::resetActionsTimer() {
 
 void Editor::clearActions() {
 	actionQueue->clear();
+	// Callers are about to change tiles in place, bypassing the action queue
+	map.invalidateRender();
+	map.clearSaveCache();
 	g_gui.UpdateActions();
 }
 
@@ -281,42 +299,36 @@ void Editor::saveMap(FileName filename, bool showdialog) {
 		save_otgz = true;
 		if (converter.FileExists()) {
 			backup_otbm = map_path + nstr(converter.GetName()) + ".otgz~";
-			std::remove(backup_otbm.c_str());
-			std::rename(savefile.c_str(), backup_otbm.c_str());
+			makeTemporaryBackup(savefile, backup_otbm);
 		}
 	} else {
 		if (converter.FileExists()) {
 			backup_otbm = map_path + nstr(converter.GetName()) + ".otbm~";
-			std::remove(backup_otbm.c_str());
-			std::rename(savefile.c_str(), backup_otbm.c_str());
+			makeTemporaryBackup(savefile, backup_otbm);
 		}
 
 		converter.SetFullName(wxstr(map.housefile));
 		if (converter.FileExists()) {
 			backup_house = map_path + nstr(converter.GetName()) + ".xml~";
-			std::remove(backup_house.c_str());
-			std::rename((map_path + map.housefile).c_str(), backup_house.c_str());
+			makeTemporaryBackup(map_path + map.housefile, backup_house);
 		}
 
 		converter.SetFullName(wxstr(map.spawnmonsterfile));
 		if (converter.FileExists()) {
 			backup_spawn = map_path + nstr(converter.GetName()) + ".xml~";
-			std::remove(backup_spawn.c_str());
-			std::rename((map_path + map.spawnmonsterfile).c_str(), backup_spawn.c_str());
+			makeTemporaryBackup(map_path + map.spawnmonsterfile, backup_spawn);
 		}
 
 		converter.SetFullName(wxstr(map.spawnnpcfile));
 		if (converter.FileExists()) {
 			backup_spawn_npc = map_path + nstr(converter.GetName()) + ".xml~";
-			std::remove(backup_spawn_npc.c_str());
-			std::rename((map_path + map.spawnnpcfile).c_str(), backup_spawn_npc.c_str());
+			makeTemporaryBackup(map_path + map.spawnnpcfile, backup_spawn_npc);
 		}
 
 		converter.SetFullName(wxstr(map.zonefile));
 		if (converter.FileExists()) {
 			backup_zones = map_path + nstr(converter.GetName()) + ".xml~";
-			std::remove(backup_zones.c_str());
-			std::rename((map_path + map.zonefile).c_str(), backup_zones.c_str());
+			makeTemporaryBackup(map_path + map.zonefile, backup_zones);
 		}
 	}
 
@@ -351,36 +363,12 @@ void Editor::saveMap(FileName filename, bool showdialog) {
 
 		// Check for errors...
 		if (!success) {
-			// Rename the temporary backup files back to their previous names
-			if (!backup_otbm.empty()) {
-				converter.SetFullName(wxstr(savefile));
-				std::string otbm_filename = map_path + nstr(converter.GetName());
-				std::rename(backup_otbm.c_str(), std::string(otbm_filename + (save_otgz ? ".otgz" : ".otbm")).c_str());
-			}
-
-			if (!backup_house.empty()) {
-				converter.SetFullName(wxstr(map.housefile));
-				std::string house_filename = map_path + nstr(converter.GetName());
-				std::rename(backup_house.c_str(), std::string(house_filename + ".xml").c_str());
-			}
-
-			if (!backup_spawn.empty()) {
-				converter.SetFullName(wxstr(map.spawnmonsterfile));
-				std::string spawn_filename = map_path + nstr(converter.GetName());
-				std::rename(backup_spawn.c_str(), std::string(spawn_filename + ".xml").c_str());
-			}
-
-			if (!backup_spawn_npc.empty()) {
-				converter.SetFullName(wxstr(map.spawnnpcfile));
-				std::string spawnnpc_filename = map_path + nstr(converter.GetName());
-				std::rename(backup_spawn_npc.c_str(), std::string(spawnnpc_filename + ".xml").c_str());
-			}
-
-			if (!backup_zones.empty()) {
-				converter.SetFullName(wxstr(map.zonefile));
-				std::string zones_filename = map_path + nstr(converter.GetName());
-				std::rename(backup_zones.c_str(), std::string(zones_filename + ".xml").c_str());
-			}
+			// The files weren't replaced, so the backups aren't needed
+			std::remove(backup_otbm.c_str());
+			std::remove(backup_house.c_str());
+			std::remove(backup_spawn.c_str());
+			std::remove(backup_spawn_npc.c_str());
+			std::remove(backup_zones.c_str());
 
 			// Display the error
 			g_gui.PopupDialog("Error", "Could not save, unable to open target for writing.", wxOK);
@@ -883,27 +871,49 @@ void Editor::borderizeSelection() {
 	updateActions();
 }
 
-void Editor::borderizeMap(bool showdialog) {
-	if (showdialog) {
-		g_gui.CreateLoadBar("Borderizing map...");
-	}
+/*
+	The whole map passes work on copies of the tiles, the map itself is only
+	read until the kept copies are committed as one action. Tiles only look at
+	the grounds of their neighbours, which neither pass changes, so the map is
+	split into stripes of consecutive map iterator steps that are processed on
+	the worker threads, and tiles at the edge of a stripe read their neighbours
+	in the next one without any locking. The result is the same as processing
+	the tiles one by one.
+*/
 
-	uint64_t tiles_done = 0;
-	for (TileLocation* tileLocation : map) {
-		if (showdialog && tiles_done % 4096 == 0) {
-			g_gui.SetLoadDone(static_cast<int32_t>(tiles_done / double(map.tilecount) * 100.0));
-		}
+namespace {
+	constexpr size_t MapStripeSteps = 4096;
 
-		Tile* tile = tileLocation->get();
-		ASSERT(tile);
+	struct MapStripe {
+		MapIterator begin;
+		size_t steps = 0;
+		std::vector<Tile*> changed;
+	};
 
-		tile->borderize(&map);
-		++tiles_done;
+	// Whether both tiles hold the same ground and items, borderizing only
+	// ever adds, removes or replaces items
+	bool sameItems(const Tile* tile, const Tile* other) {
+		if ((tile->ground ? tile->ground->getID() : 0) != (other->ground ? other->ground->getID() : 0)) {
+			return false;
+		}
+		if (tile->items.size() != other->items.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < tile->items.size(); ++i) {
+			if (tile->items[i]->getID() != other->items[i]->getID()) {
+				return false;
+			}
+		}
+		return true;
 	}
+}
 
-	if (showdialog) {
-		g_gui.DestroyLoadBar();
-	}
+void Editor::borderizeMap(bool showdialog) {
+	processMap(ACTION_BORDERIZE, "Borderizing map...", showdialog, [this](Tile* tile) {
+		const Tile* old_tile = tile->location->get();
+		tile->borderize(&map);
+		return !sameItems(old_tile, tile);
+	});
 }
 
 void Editor::randomizeSelection() {
@@ -935,46 +945,104 @@ void Editor::randomizeSelection() {
 }
 
 void Editor::randomizeMap(bool showdialog) {
-	if (showdialog) {
-		g_gui.CreateLoadBar("Randomizing map...");
-	}
+	processMap(ACTION_RANDOMIZE, "Randomizing map...", showdialog, [this](Tile* tile) {
+		GroundBrush* groundBrush = tile->getGroundBrush();
+		if (!groundBrush) {
+			return false;
+		}
 
-	uint64_t tiles_done = 0;
-	for (TileLocation* tileLocation : map) {
-		if (showdialog && tiles_done % 4096 == 0) {
-			g_gui.SetLoadDone(static_cast<int32_t>(tiles_done / double(map.tilecount) * 100.0));
+		Item* oldGround = tile->ground;
+		const uint16_t oldGroundId = oldGround ? oldGround->getID() : 0;
+		uint16_t actionId, uniqueId;
+		if (oldGround) {
+			actionId = oldGround->getActionID();
+			uniqueId = oldGround->getUniqueID();
+		} else {
+			actionId = 0;
+			uniqueId = 0;
 		}
+		groundBrush->draw(&map, tile, nullptr);
 
-		Tile* tile = tileLocation->get();
-		ASSERT(tile);
+		Item* newGround = tile->ground;
+		if (!newGround || newGround->getID() == oldGroundId) {
+			return false;
+		}
+		newGround->setActionID(actionId);
+		newGround->setUniqueID(uniqueId);
+		tile->update();
+		return true;
+	});
+}
 
-		GroundBrush* groundBrush = tile->getGroundBrush();
-		if (groundBrush) {
-			Item* oldGround = tile->ground;
+bool Editor::processMap(ActionIdentifier type, const wxString &message, bool showdialog, const std::function<bool(Tile*)> &process) {
+	std::vector<MapStripe> stripes;
+	const MapIterator end = map.end();
+	for (MapIterator it = map.begin(); it != end; ++it) {
+		if (stripes.empty() || stripes.back().steps == MapStripeSteps) {
+			stripes.emplace_back().begin = it;
+		}
+		++stripes.back().steps;
+	}
 
-			uint16_t actionId, uniqueId;
-			if (oldGround) {
-				actionId = oldGround->getActionID();
-				uniqueId = oldGround->getUniqueID();
-			} else {
-				actionId = 0;
-				uniqueId = 0;
-			}
-			groundBrush->draw(&map, tile, nullptr);
+	if (showdialog) {
+		g_gui.CreateLoadBar(message, true);
+	}
 
-			Item* newGround = tile->ground;
-			if (newGround) {
-				newGround->setActionID(actionId);
-				newGround->setUniqueID(uniqueId);
+	std::atomic<bool> cancelled = false;
+	std::function<void(size_t)> progress;
+	if (showdialog) {
+		progress = [&](size_t done) {
+			if (!g_gui.SetLoadDone(static_cast<int32_t>(100.0 * done / stripes.size()))) {
+				cancelled = true;
 			}
-			tile->update();
-		}
-		++tiles_done;
+		};
 	}
 
+	rme::parallelFor(
+		stripes.size(),
+		[&](size_t index) {
+			if (cancelled) {
+				return;
+			}
+			MapStripe &stripe = stripes[index];
+			MapIterator it = stripe.begin;
+			for (size_t step = 0; step < stripe.steps; ++step, ++it) {
+				Tile* tile = (*it)->get();
+				ASSERT(tile);
+
+				Tile* new_tile = tile->deepCopy(map);
+				if (process(new_tile)) {
+					stripe.changed.push_back(new_tile);
+				} else {
+					delete new_tile;
+				}
+			}
+		},
+		progress
+	);
+
 	if (showdialog) {
 		g_gui.DestroyLoadBar();
 	}
+
+	if (cancelled) {
+		for (MapStripe &stripe : stripes) {
+			for (Tile* tile : stripe.changed) {
+				delete tile;
+			}
+		}
+		return false;
+	}
+
+	Action* action = actionQueue->createAction(type);
+	for (MapStripe &stripe : stripes) {
+		for (Tile* tile : stripe.changed) {
+			action->addChange(newd Change(tile));
+		}
+	}
+	addAction(action);
+	updateActions();
+	return true;
 }
 
 void Editor::clearInvalidHouseTiles(bool showdialog) {
@@ -1005,6 +1073,7 @@ void Editor::clearInvalidHouseTiles(bool showdialog) {
 		if (tile->isHouseTile()) {
 			if (houses.getHouse(tile->getHouseID()) == nullptr) {
 				tile->setHouse(nullptr);
+				map.markChanged(tile->getPosition());
 			}
 		}
 		++tiles_done;
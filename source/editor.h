@@ -132,8 +132,9 @@ public: // Functions
 	// Randomizes the ground in the selected region
 	void randomizeSelection();
 
-	// Same as above although it applies to the entire map
-	// action queue is flushed when these functions are called
+	// Same as above although it applies to the entire map, borderizing and
+	// randomizing the map are a single action that can be cancelled while running
+	// action queue is flushed when the others are called
 	// showdialog is whether a progress bar should be shown
 	void borderizeMap(bool showdialog);
 	void randomizeMap(bool showdialog);
@@ -156,6 +157,10 @@ protected:
 	void drawInternal(const Position offset, bool alt, bool dodraw);
 	void drawInternal(const PositionVector &posvec, bool alt, bool dodraw);
 	void drawInternal(const PositionVector &todraw, PositionVector &toborder, bool alt, bool dodraw);
+	// Runs process on a copy of every tile on the worker threads, the copies it
+	// returns true for replace the originals in one action of the given type.
+	// Returns false if the user cancelled, the map is left untouched then.
+	bool processMap(ActionIdentifier type, const wxString &message, bool showdialog, const std::function<bool(Tile*)> &process);
 
 	Editor(const Editor &);
 	Editor &operator=(const Editor &);
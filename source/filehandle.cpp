@@ -19,6 +19,15 @@
 
 #include "filehandle.h"
 
+#ifdef __WINDOWS__
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
 uint8_t NodeFileWriteHandle::NODE_START = ::NODE_START;
 uint8_t NodeFileWriteHandle::NODE_END = ::NODE_END;
 uint8_t NodeFileWriteHandle::ESCAPE_CHAR = ::ESCAPE_CHAR;
@@ -473,6 +482,76 @@ void BinaryNode::load() {
 	}
 }
 
+//=============================================================================
+// Memory mapped file
+
+MappedFile::MappedFile(const std::string &name) {
+#ifdef __WINDOWS__
+	#if defined __VISUALC__ && defined _UNICODE
+	HANDLE file = CreateFileW(string2wstring(name).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	#else
+	HANDLE file = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	#endif
+	if (file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		return;
+	}
+	mapping_handle = mapping;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view) {
+		data = static_cast<const uint8_t*>(view);
+		length = static_cast<size_t>(file_size.QuadPart);
+	}
+#else
+	int fd = open(name.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED) {
+			// The file is mostly read front to back, let the kernel read ahead
+			madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+			data = static_cast<const uint8_t*>(view);
+			length = static_cast<size_t>(info.st_size);
+		}
+	}
+	// The mapping stays valid after the descriptor is closed
+	close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef __WINDOWS__
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping_handle) {
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle) {
+		CloseHandle(file_handle);
+	}
+#else
+	if (data) {
+		munmap(const_cast<uint8_t*>(data), length);
+	}
+#endif
+}
+
 //=============================================================================
 // node file binary write handle
 
@@ -566,9 +645,11 @@ DiskNodeFileWriteHandle::~DiskNodeFileWriteHandle() {
 void DiskNodeFileWriteHandle::close() {
 	if (file) {
 		renewCache();
-		fclose(file);
+		// Kept, so a failed final flush can still be noticed after closing
+		if (fclose(file) != 0) {
+			error_code = FILE_WRITE_ERROR;
+		}
 		file = nullptr;
-		error_code = FILE_NO_ERROR;
 	}
 }
 
@@ -599,7 +680,6 @@ MemoryNodeFileWriteHandle::~MemoryNodeFileWriteHandle() {
 }
 
 void MemoryNodeFileWriteHandle::reset() {
-	memset(cache, 0xAA, cache_size);
 	local_write_index = 0;
 }
 
@@ -715,3 +795,17 @@ bool NodeFileWriteHandle::addRAW(const uint8_t* ptr, size_t sz) {
 	writeBytes(ptr, sz);
 	return error_code == FILE_NO_ERROR;
 }
+
+bool NodeFileWriteHandle::addSerialized(const uint8_t* ptr, size_t sz) {
+	while (sz != 0) {
+		const size_t count = std::min(sz, cache_size - local_write_index);
+		memcpy(cache + local_write_index, ptr, count);
+		local_write_index += count;
+		ptr += count;
+		sz -= count;
+		if (local_write_index >= cache_size) {
+			renewCache();
+		}
+	}
+	return error_code == FILE_NO_ERROR;
+}
@@ -266,6 +266,36 @@ protected:
 	uint8_t* index;
 };
 
+// Read-only view of a whole file, mapped into memory when the platform allows it.
+// Meant to be wrapped in MemoryNodeFileReadHandles, which may then read the same
+// mapping from several threads at once.
+class MappedFile {
+public:
+	explicit MappedFile(const std::string &name);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool isOk() const noexcept {
+		return data != nullptr;
+	}
+	const uint8_t* getData() const noexcept {
+		return data;
+	}
+	size_t size() const noexcept {
+		return length;
+	}
+
+protected:
+	const uint8_t* data = nullptr;
+	size_t length = 0;
+#ifdef __WINDOWS__
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
+
 class FileWriteHandle : public FileHandle {
 public:
 	explicit FileWriteHandle(const std::string &name);
@@ -324,6 +354,8 @@ public:
 	bool addRAW(const char* c) {
 		return addRAW(reinterpret_cast<const uint8_t*>(c), strlen(c));
 	}
+	// Appends nodes another handle has already written, as they are
+	bool addSerialized(const uint8_t* ptr, size_t sz);
 
 protected:
 	virtual void renewCache() = 0;
@@ -336,22 +368,48 @@ protected:
 	size_t cache_size;
 	size_t local_write_index;
 
+	// Length of the leading run of bytes that can be written without escaping.
+	// The three node markers are the only bytes >= 0xFD, so eight bytes are
+	// tested at once for a byte with the top bit set and the low seven >= 0x7D.
+	static FORCEINLINE size_t plainRunLength(const uint8_t* ptr, size_t sz) {
+		size_t run = 0;
+		for (; run + sizeof(uint64_t) <= sz; run += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, ptr + run, sizeof(word));
+			if ((((word & 0x7F7F7F7F7F7F7F7FULL) + 0x0303030303030303ULL) & word & 0x8080808080808080ULL) != 0) {
+				break;
+			}
+		}
+		while (run < sz && ptr[run] < ::ESCAPE_CHAR) {
+			++run;
+		}
+		return run;
+	}
+
 	FORCEINLINE void writeBytes(const uint8_t* ptr, size_t sz) {
-		if (sz) {
-			do {
-				if (*ptr == NODE_START || *ptr == NODE_END || *ptr == ESCAPE_CHAR) {
-					cache[local_write_index++] = ESCAPE_CHAR;
-					if (local_write_index >= cache_size) {
-						renewCache();
-					}
-				}
-				cache[local_write_index++] = *ptr;
+		while (sz != 0) {
+			const size_t run = plainRunLength(ptr, std::min(sz, cache_size - local_write_index));
+			if (run != 0) {
+				memcpy(cache + local_write_index, ptr, run);
+				local_write_index += run;
+				ptr += run;
+				sz -= run;
 				if (local_write_index >= cache_size) {
 					renewCache();
 				}
-				++ptr;
-				--sz;
-			} while (sz != 0);
+				continue;
+			}
+
+			cache[local_write_index++] = ESCAPE_CHAR;
+			if (local_write_index >= cache_size) {
+				renewCache();
+			}
+			cache[local_write_index++] = *ptr;
+			if (local_write_index >= cache_size) {
+				renewCache();
+			}
+			++ptr;
+			--sz;
 		}
 	}
 };
@@ -28,11 +28,10 @@
 #include "sprite_appearances.h"
 #include "sprites.h"
 #include "pngfiles.h"
+#include "appearance_data.h"
 
 #include <wx/rawbmp.h>
 
-#include <appearances.pb.h>
-
 GraphicManager g_graphics;
 GameSprite g_gameSprite;
 
@@ -230,6 +229,7 @@ void GraphicManager::clear() {
 	item_count = 0;
 	creature_count = 0;
 	loaded_textures = 0;
+	atlas.clear();
 	lastclean = time(nullptr);
 }
 
@@ -797,7 +797,7 @@ bool GraphicManager::loadSpriteData(const FileName &datafile, wxString &error, w
 	return true;
 }
 
-bool GraphicManager::loadSpriteDump(uint8_t*&target, uint16_t &size, int sprite_id) {
+bool GraphicManager::loadSpriteDump(uint8_t*&target, uint16_t &size, int sprite_id, std::shared_ptr<Sprites> &owner) {
 	if (g_settings.getInteger(Config::USE_MEMCACHED_SPRITES)) {
 		return false;
 	}
@@ -882,34 +882,31 @@ bool GraphicManager::loadItemSpriteMetadata(const std::shared_ptr<ItemType> &t,
 	return true;
 }
 
-bool GraphicManager::loadOutfitSpriteMetadata(canary::protobuf::appearances::Appearance outfit, wxString &error, wxArrayString &warnings) {
+bool GraphicManager::loadOutfitSpriteMetadata(const OutfitAppearance &outfit, wxString &error, wxArrayString &warnings) {
 	GameSprite* sType = newd GameSprite();
-	sType->id = outfit.id() + getItemSpriteMaxID();
-	sprite_space[outfit.id() + getItemSpriteMaxID()] = sType;
-	creature_count = std::max<uint16_t>(creature_count, outfit.id());
+	sType->id = outfit.id + getItemSpriteMaxID();
+	sprite_space[outfit.id + getItemSpriteMaxID()] = sType;
+	creature_count = std::max<uint16_t>(creature_count, outfit.id);
 
-	// We dont need to worry about IDLE or MOVING frame group
-	const auto &frameGroup = outfit.frame_group().Get(0);
-	const auto &spriteInfo = frameGroup.sprite_info();
-	const auto &animation = spriteInfo.animation();
+	const AppearanceSprites &sprites = outfit.sprites;
 
 	// Number of blendframes (some sprites consist of several merged sprites
-	sType->layers = spriteInfo.layers();
-	sType->pattern_x = spriteInfo.pattern_width();
-	sType->pattern_y = spriteInfo.pattern_height();
-	sType->pattern_z = spriteInfo.pattern_depth();
+	sType->layers = sprites.layers;
+	sType->pattern_x = sprites.pattern_width;
+	sType->pattern_y = sprites.pattern_height;
+	sType->pattern_z = sprites.pattern_depth;
 
 	// Length of animation
-	sType->sprite_phase_size = animation.sprite_phase().size();
-	has_frame_durations = animation.sprite_phase().size() > 0;
+	sType->sprite_phase_size = sprites.phases.size();
+	has_frame_durations = sprites.phases.size() > 0;
 
 	if (sType->sprite_phase_size > 0) {
-		sType->animator = newd Animator(sType->sprite_phase_size, animation.default_start_phase(), animation.loop_count(), !animation.synchronized());
+		sType->animator = newd Animator(sType->sprite_phase_size, sprites.start_phase, sprites.loop_count, sprites.async_animation);
 		if (has_frame_durations) {
 			int frameIndex = 0;
-			for (const auto &phase : animation.sprite_phase()) {
+			for (const auto &phase : sprites.phases) {
 				FrameDuration* frame_duration = sType->animator->getFrameDuration(frameIndex);
-				frame_duration->setValues(phase.duration_min(), phase.duration_max());
+				frame_duration->setValues(phase.first, phase.second);
 				frameIndex++;
 			}
 			sType->animator->reset();
@@ -917,22 +914,26 @@ bool GraphicManager::loadOutfitSpriteMetadata(canary::protobuf::appearances::App
 	}
 
 	sType->numsprites = (int)sType->layers * (int)sType->pattern_x * (int)sType->pattern_y * sType->pattern_z * std::max<int>(1, sType->sprite_phase_size);
+	if (sprites.sprite_ids.size() < sType->numsprites) {
+		warnings.push_back(wxString::Format("Outfit %d has %d of its %d sprites", static_cast<int>(outfit.id), static_cast<int>(sprites.sprite_ids.size()), static_cast<int>(sType->numsprites)));
+		sType->numsprites = static_cast<uint32_t>(sprites.sprite_ids.size());
+	}
 
-	sType->minimap_color = outfit.flags().has_automap() ? static_cast<uint16_t>(outfit.flags().automap().color()) : 0;
-	sType->draw_height = outfit.flags().has_height() ? static_cast<uint16_t>(outfit.flags().height().elevation()) : 0;
-	if (outfit.flags().has_shift()) {
+	sType->minimap_color = outfit.minimap_color;
+	sType->draw_height = outfit.draw_height;
+	if (outfit.has_shift) {
 		wxPoint drawOffset(0, 0);
 		if (sType->width > 32 || sType->height > 32) {
 			drawOffset = sType->getDrawOffset();
 		}
-		drawOffset.x += outfit.flags().shift().x();
-		drawOffset.y += outfit.flags().shift().y();
+		drawOffset.x += outfit.shift_x;
+		drawOffset.y += outfit.shift_y;
 		sType->draw_offset = drawOffset;
 	}
 
 	// Read the sprite ids
 	for (uint32_t i = 0; i < sType->numsprites; ++i) {
-		uint32_t sprite_id = spriteInfo.sprite_id().Get(i);
+		uint32_t sprite_id = sprites.sprite_ids[i];
 
 		if (image_space[sprite_id] == nullptr) {
 			GameSprite::NormalImage* img = newd GameSprite::NormalImage();
@@ -944,21 +945,22 @@ bool GraphicManager::loadOutfitSpriteMetadata(canary::protobuf::appearances::App
 	return true;
 }
 
-bool GraphicManager::loadSpriteDump(uint8_t*&target, uint16_t &size, int sprite_id) {
+bool GraphicManager::loadSpriteDump(uint8_t*&target, uint16_t &size, int sprite_id, std::shared_ptr<Sprites> &owner) {
 	// Empty GameSprite
 	if (sprite_id == 0) {
 		size = 0;
 		target = nullptr;
+		owner = nullptr;
 		return true;
 	}
 
-	const auto &spritePtr = g_spriteAppearances.getSprite(sprite_id);
-	if (!spritePtr) {
+	owner = g_spriteAppearances.getSprite(sprite_id);
+	if (!owner) {
 		return false;
 	}
 
-	size = spritePtr->pixels.size();
-	target = spritePtr->pixels.data();
+	size = owner->pixels.size();
+	target = owner->pixels.data();
 	return true;
 }
 
@@ -974,14 +976,19 @@ void GraphicManager::addSpriteToCleanup(GameSprite* spr) {
 }
 
 void GraphicManager::garbageCollection() {
+	int t = time(nullptr);
+	atlas.nextFrame(t);
+
 	if (g_settings.getInteger(Config::TEXTURE_MANAGEMENT)) {
-		int t = time(nullptr);
-		if (loaded_textures > g_settings.getInteger(Config::TEXTURE_CLEAN_THRESHOLD) && t - lastclean > g_settings.getInteger(Config::TEXTURE_CLEAN_PULSE)) {
+		const int loaded = loaded_textures + static_cast<int>(atlas.getResidentCount());
+		if (loaded > g_settings.getInteger(Config::TEXTURE_CLEAN_THRESHOLD) && t - lastclean > g_settings.getInteger(Config::TEXTURE_CLEAN_PULSE)) {
 			ImageMap::iterator iit = image_space.begin();
 			while (iit != image_space.end()) {
 				iit->second->clean(t);
 				++iit;
 			}
+			// Atlas pages are dropped as a whole once none of their sprites was drawn for a while
+			atlas.collect(t, g_settings.getInteger(Config::TEXTURE_LONGEVITY));
 			lastclean = t;
 		}
 	}
@@ -1039,7 +1046,7 @@ uint16_t GameSprite::getDrawHeight() const {
 
 wxPoint GameSprite::getDrawOffset() {
 	if (!isDrawOffsetLoaded && !spriteList.empty()) {
-		const auto &sheet = g_spriteAppearances.getSheetBySpriteId(spriteList[0]->getHardwareID());
+		const auto &sheet = g_spriteAppearances.getSheetBySpriteId(spriteList[0]->getHardwareID(), false);
 		if (!sheet) {
 			return wxPoint(0, 0);
 		}
@@ -1076,6 +1083,12 @@ uint8_t GameSprite::getHeight() {
 	return height;
 }
 
+void GameSprite::prefetchSheets() const {
+	for (const NormalImage* image : spriteList) {
+		g_spriteAppearances.prefetchSheet(image->id);
+	}
+}
+
 void GameSprite::unloadDC() {
 	delete m_wxMemoryDc[SPRITE_SIZE_16x16];
 	delete m_wxMemoryDc[SPRITE_SIZE_32x32];
@@ -1176,7 +1189,7 @@ void GameSprite::DrawTo(wxDC* dcWindow, SpriteSize spriteSize, int start_x, int
 			return;
 		}
 
-		const auto &sheet = g_spriteAppearances.getSheetBySpriteId(spriteList[0]->getHardwareID());
+		const auto &sheet = g_spriteAppearances.getSheetBySpriteId(spriteList[0]->getHardwareID(), false);
 		if (!sheet) {
 			return;
 		}
@@ -1225,7 +1238,7 @@ void GameSprite::Image::createGLTexture(GLuint textureId) {
 		return;
 	}
 
-	const auto &sheet = g_spriteAppearances.getSheetBySpriteId(textureId);
+	const auto &sheet = g_spriteAppearances.getSheetBySpriteId(textureId, false);
 	if (!sheet) {
 		return;
 	}
@@ -1270,19 +1283,22 @@ GameSprite::NormalImage::NormalImage() :
 
 GameSprite::NormalImage::~NormalImage() {
 	m_cachedData = nullptr;
+	m_cachedSprite = nullptr;
 }
 
 void GameSprite::NormalImage::clean(int time) {
+	// Only editor images own a texture here, game sprites are collected per atlas page
 	Image::clean(time);
 	// We keep dumps around for 5 seconds.
 	if (time - lastaccess > 5) {
 		m_cachedData = nullptr;
+		m_cachedSprite = nullptr;
 	}
 }
 
 uint8_t* GameSprite::NormalImage::getRGBAData() {
 	if (!m_cachedData) {
-		if (!g_gui.gfx.loadSpriteDump(m_cachedData, size, id)) {
+		if (!g_gui.gfx.loadSpriteDump(m_cachedData, size, id, m_cachedSprite)) {
 			spdlog::error("[GameSprite::NormalImage::getRGBAData] - Failed when parsing sprite id {}", id);
 			return nullptr;
 		}
@@ -1292,7 +1308,7 @@ uint8_t* GameSprite::NormalImage::getRGBAData() {
 }
 
 GLuint GameSprite::NormalImage::getHardwareID() {
-	if (!isGLLoaded) {
+	if (!isGLLoaded && !g_gui.gfx.atlas.isResident(id)) {
 		createGLTexture(id);
 	}
 	visit();
@@ -1300,11 +1316,27 @@ GLuint GameSprite::NormalImage::getHardwareID() {
 }
 
 void GameSprite::NormalImage::createGLTexture(GLuint) {
-	Image::createGLTexture(id);
+	uint8_t* rgba = getRGBAData();
+	if (!rgba) {
+		return;
+	}
+
+	const auto &sheet = g_spriteAppearances.getSheetBySpriteId(id, false);
+	if (!sheet) {
+		return;
+	}
+
+	auto spriteWidth = sheet->getSpriteSize().width;
+	auto spriteHeight = sheet->getSpriteSize().height;
+	auto invertedBuffer = invertGLColors(spriteHeight, spriteWidth, rgba);
+	if (!g_gui.gfx.atlas.insert(id, spriteWidth, spriteHeight, invertedBuffer)) {
+		spdlog::error("[GameSprite::NormalImage::createGLTexture] - Failed to pack sprite id {} into the texture atlas", id);
+	}
+	delete[] invertedBuffer;
 }
 
 void GameSprite::NormalImage::unloadGLTexture(GLuint) {
-	Image::unloadGLTexture(id);
+	// Atlas cells are only released together with their page
 }
 
 GameSprite::EditorImage::EditorImage(const wxArtID &bitmapId) :
@@ -1477,7 +1509,7 @@ void GameSprite::OutfitImage::createGLTexture(GLuint spriteId, GLuint textureId)
 		return;
 	}
 
-	const auto &sheet = g_spriteAppearances.getSheetBySpriteId(spriteId);
+	const auto &sheet = g_spriteAppearances.getSheetBySpriteId(spriteId, false);
 	if (!sheet) {
 		return;
 	}
@@ -21,17 +21,13 @@
 #include "outfit.h"
 #include "common.h"
 #include "enums.h"
+#include "texture_atlas.h"
 
 #include <wx/artprov.h>
 
 // Forward declarations
-namespace canary {
-	namespace protobuf {
-		namespace appearances {
-			class Appearance;
-		}
-	}
-}
+struct Sprites;
+struct OutfitAppearance;
 
 enum SpriteSize {
 	SPRITE_SIZE_16x16,
@@ -111,6 +107,9 @@ public:
 
 	static GameSprite* createFromBitmap(const wxArtID &bitmapId);
 
+	// Starts decoding the sprite sheets of all frames in the background
+	void prefetchSheets() const;
+
 protected:
 	class Image;
 	class NormalImage;
@@ -145,12 +144,14 @@ protected:
 		NormalImage();
 		virtual ~NormalImage();
 
-		// We use the sprite id as GL texture id
+		// The sprite id, which is also the key of the sprite in the texture atlas
 		uint32_t id;
 
 		// This contains the pixel data
 		uint16_t size;
 		uint8_t* m_cachedData;
+		// Owns the pixels m_cachedData points to, the sprite cache may drop them first
+		std::shared_ptr<Sprites> m_cachedSprite;
 
 		virtual void clean(int time);
 
@@ -334,7 +335,12 @@ public:
 	bool loadSpriteData(const FileName &datafile, wxString &error, wxArrayString &warnings);
 
 	bool loadItemSpriteMetadata(const std::shared_ptr<ItemType> &t, wxString &error, wxArrayString &warnings);
-	bool loadOutfitSpriteMetadata(canary::protobuf::appearances::Appearance outfit, wxString &error, wxArrayString &warnings);
+	bool loadOutfitSpriteMetadata(const OutfitAppearance &outfit, wxString &error, wxArrayString &warnings);
+
+	// Game sprites are packed into shared atlas pages instead of one texture each
+	TextureAtlas &getTextureAtlas() noexcept {
+		return atlas;
+	}
 
 	// Cleans old & unused textures according to config settings
 	void garbageCollection();
@@ -351,7 +357,7 @@ private:
 	bool unloaded;
 	// This is used if memcaching is NOT on
 	std::string spritefile;
-	bool loadSpriteDump(uint8_t*&target, uint16_t &size, int sprite_id);
+	bool loadSpriteDump(uint8_t*&target, uint16_t &size, int sprite_id, std::shared_ptr<Sprites> &owner);
 
 	typedef std::map<int, Sprite*> SpriteMap;
 	SpriteMap sprite_space;
@@ -370,6 +376,7 @@ private:
 
 	int loaded_textures;
 	int lastclean;
+	TextureAtlas atlas;
 
 	wxStopWatch* animation_timer;
 
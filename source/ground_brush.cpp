@@ -22,6 +22,8 @@
 #include "basemap.h"
 
 uint32_t GroundBrush::border_types[256];
+std::vector<GroundBrush::BorderRule> GroundBrush::border_rules;
+uint32_t GroundBrush::border_rule_stride = 0;
 
 int AutoBorder::edgeNameToID(const std::string &edgename) {
 	if (edgename == "n") {
@@ -122,7 +124,8 @@ GroundBrush::GroundBrush() :
 	optional_border(nullptr),
 	use_only_optional(false),
 	randomize(true),
-	total_chance(0) {
+	total_chance(0),
+	rule_index(0) {
 	////
 }
 
@@ -629,15 +632,104 @@ const GroundBrush::BorderBlock* GroundBrush::getBrushTo(GroundBrush* first, Grou
 	return nullptr;
 }
 
-void GroundBrush::doBorders(BaseMap* map, Tile* tile) {
-	static const auto extractGroundBrushFromTile = [](BaseMap* map, uint32_t x, uint32_t y, uint32_t z) -> GroundBrush* {
-		Tile* tile = map->getTile(x, y, z);
-		if (tile) {
-			return tile->getGroundBrush();
+GroundBrush::BorderRule GroundBrush::makeBorderRule(GroundBrush* first, GroundBrush* second) {
+	BorderRule rule;
+	rule.block = getBrushTo(first, second);
+	rule.friends = first && second && (second->friendOf(first) || first->friendOf(second));
+	return rule;
+}
+
+GroundBrush::BorderRule GroundBrush::getBorderRule(GroundBrush* first, GroundBrush* second) {
+	const uint32_t row = first ? first->rule_index : 0;
+	const uint32_t column = second ? second->rule_index : 0;
+	if ((first && row == 0) || (second && column == 0)) {
+		return makeBorderRule(first, second);
+	}
+	return border_rules[row * border_rule_stride + column];
+}
+
+void GroundBrush::compileBorderRules() {
+	std::vector<GroundBrush*> grounds;
+	for (const auto &brushEntry : g_brushes.getMap()) {
+		if (brushEntry.second->isGround()) {
+			GroundBrush* groundBrush = brushEntry.second->asGround();
+			groundBrush->rule_index = 0;
+			grounds.push_back(groundBrush);
+		}
+	}
+
+	// Index 0 stands for no brush
+	std::vector<GroundBrush*> indexed = { nullptr };
+	for (GroundBrush* groundBrush : grounds) {
+		if (groundBrush->rule_index == 0) {
+			groundBrush->rule_index = static_cast<uint32_t>(indexed.size());
+			indexed.push_back(groundBrush);
+		}
+	}
+
+	border_rule_stride = static_cast<uint32_t>(indexed.size());
+	border_rules.assign(indexed.size() * indexed.size(), BorderRule());
+	for (size_t row = 0; row < indexed.size(); ++row) {
+		for (size_t column = 0; column < indexed.size(); ++column) {
+			border_rules[row * border_rule_stride + column] = makeBorderRule(indexed[row], indexed[column]);
+		}
+	}
+}
+
+namespace {
+	// Ground brushes of the eight neighbours of a tile, in the order doBorders
+	// numbers them. A leaf holds 4x4 tiles so the neighbours lie in at most four
+	// leaves, each of them is only looked up once.
+	void getNeighbourBrushes(BaseMap* map, uint32_t x, uint32_t y, uint32_t z, GroundBrush* brushes[8]) {
+		static constexpr int32_t offsets[8][2] = {
+			{ -1, -1 },
+			{ 0, -1 },
+			{ 1, -1 },
+			{ -1, 0 },
+			{ 1, 0 },
+			{ -1, 1 },
+			{ 0, 1 },
+			{ 1, 1 },
+		};
+
+		struct CachedFloor {
+			uint32_t leaf_x;
+			uint32_t leaf_y;
+			Floor* floor;
+		};
+		CachedFloor floors[4];
+		size_t cached = 0;
+
+		for (int32_t i = 0; i < 8; ++i) {
+			if ((x == 0 && offsets[i][0] < 0) || (y == 0 && offsets[i][1] < 0)) {
+				brushes[i] = nullptr;
+				continue;
+			}
+
+			const uint32_t nx = x + offsets[i][0];
+			const uint32_t ny = y + offsets[i][1];
+
+			Floor* floor = nullptr;
+			size_t index = 0;
+			for (; index < cached; ++index) {
+				if (floors[index].leaf_x == (nx >> 2) && floors[index].leaf_y == (ny >> 2)) {
+					floor = floors[index].floor;
+					break;
+				}
+			}
+			if (index == cached) {
+				QTreeNode* leaf = map->getLeaf(nx, ny);
+				floor = leaf ? leaf->getFloor(z) : nullptr;
+				floors[cached++] = { nx >> 2, ny >> 2, floor };
+			}
+
+			Tile* tile = floor ? floor->locs[(nx & 3) * 4 + (ny & 3)].get() : nullptr;
+			brushes[i] = tile ? tile->getGroundBrush() : nullptr;
 		}
-		return nullptr;
-	};
+	}
+}
 
+void GroundBrush::doBorders(BaseMap* map, Tile* tile) {
 	ASSERT(tile);
 
 	GroundBrush* borderBrush;
@@ -653,52 +745,21 @@ void GroundBrush::doBorders(BaseMap* map, Tile* tile) {
 	uint32_t y = position.y;
 	uint32_t z = position.z;
 
+	GroundBrush* neighbourBrushes[8];
+	getNeighbourBrushes(map, x, y, z, neighbourBrushes);
+
 	// Pair of visited / what border type
 	std::pair<bool, GroundBrush*> neighbours[8];
-	if (x == 0) {
-		if (y == 0) {
-			neighbours[0] = { false, nullptr };
-			neighbours[1] = { false, nullptr };
-			neighbours[2] = { false, nullptr };
-			neighbours[3] = { false, nullptr };
-			neighbours[4] = { false, extractGroundBrushFromTile(map, x + 1, y, z) };
-			neighbours[5] = { false, nullptr };
-			neighbours[6] = { false, extractGroundBrushFromTile(map, x, y + 1, z) };
-			neighbours[7] = { false, extractGroundBrushFromTile(map, x + 1, y + 1, z) };
-		} else {
-			neighbours[0] = { false, nullptr };
-			neighbours[1] = { false, extractGroundBrushFromTile(map, x, y - 1, z) };
-			neighbours[2] = { false, extractGroundBrushFromTile(map, x + 1, y - 1, z) };
-			neighbours[3] = { false, nullptr };
-			neighbours[4] = { false, extractGroundBrushFromTile(map, x + 1, y, z) };
-			neighbours[5] = { false, nullptr };
-			neighbours[6] = { false, extractGroundBrushFromTile(map, x, y + 1, z) };
-			neighbours[7] = { false, extractGroundBrushFromTile(map, x + 1, y + 1, z) };
-		}
-	} else if (y == 0) {
-		neighbours[0] = { false, nullptr };
-		neighbours[1] = { false, nullptr };
-		neighbours[2] = { false, nullptr };
-		neighbours[3] = { false, extractGroundBrushFromTile(map, x - 1, y, z) };
-		neighbours[4] = { false, extractGroundBrushFromTile(map, x + 1, y, z) };
-		neighbours[5] = { false, extractGroundBrushFromTile(map, x - 1, y + 1, z) };
-		neighbours[6] = { false, extractGroundBrushFromTile(map, x, y + 1, z) };
-		neighbours[7] = { false, extractGroundBrushFromTile(map, x + 1, y + 1, z) };
-	} else {
-		neighbours[0] = { false, extractGroundBrushFromTile(map, x - 1, y - 1, z) };
-		neighbours[1] = { false, extractGroundBrushFromTile(map, x, y - 1, z) };
-		neighbours[2] = { false, extractGroundBrushFromTile(map, x + 1, y - 1, z) };
-		neighbours[3] = { false, extractGroundBrushFromTile(map, x - 1, y, z) };
-		neighbours[4] = { false, extractGroundBrushFromTile(map, x + 1, y, z) };
-		neighbours[5] = { false, extractGroundBrushFromTile(map, x - 1, y + 1, z) };
-		neighbours[6] = { false, extractGroundBrushFromTile(map, x, y + 1, z) };
-		neighbours[7] = { false, extractGroundBrushFromTile(map, x + 1, y + 1, z) };
+	for (int32_t i = 0; i < 8; ++i) {
+		neighbours[i] = { false, neighbourBrushes[i] };
 	}
 
-	static std::vector<const BorderBlock*> specificList;
+	// Whole map borderizing runs on several threads at once
+	static thread_local std::vector<const BorderBlock*> specificList;
 	specificList.clear();
 
-	std::vector<BorderCluster> borderList;
+	static thread_local std::vector<BorderCluster> borderList;
+	borderList.clear();
 	for (int32_t i = 0; i < 8; ++i) {
 		auto &neighbourPair = neighbours[i];
 		if (neighbourPair.first) {
@@ -718,8 +779,9 @@ void GroundBrush::doBorders(BaseMap* map, Tile* tile) {
 				}
 
 				if (other->hasOuterBorder() || borderBrush->hasInnerBorder()) {
+					const BorderRule rule = getBorderRule(borderBrush, other);
 					bool only_mountain = false;
-					if (/*!borderBrush->hasInnerBorder() && */ (other->friendOf(borderBrush) || borderBrush->friendOf(other))) {
+					if (/*!borderBrush->hasInnerBorder() && */ rule.friends) {
 						if (!other->hasOptionalBorder()) {
 							continue;
 						}
@@ -750,7 +812,7 @@ void GroundBrush::doBorders(BaseMap* map, Tile* tile) {
 						}
 
 						if (!only_mountain) {
-							const BorderBlock* borderBlock = getBrushTo(borderBrush, other);
+							const BorderBlock* borderBlock = rule.block;
 							if (borderBlock) {
 								bool found = false;
 								for (BorderCluster &borderCluster : borderList) {
@@ -800,7 +862,7 @@ void GroundBrush::doBorders(BaseMap* map, Tile* tile) {
 				}
 
 				if (tiledata != 0) {
-					const BorderBlock* borderBlock = getBrushTo(borderBrush, nullptr);
+					const BorderBlock* borderBlock = getBorderRule(borderBrush, nullptr).block;
 					if (!borderBlock) {
 						continue;
 					}
@@ -834,7 +896,7 @@ void GroundBrush::doBorders(BaseMap* map, Tile* tile) {
 			}
 
 			if (tiledata != 0) {
-				const BorderBlock* borderBlock = getBrushTo(nullptr, other);
+				const BorderBlock* borderBlock = getBorderRule(nullptr, other).block;
 				if (borderBlock) {
 					if (borderBlock->autoborder) {
 						BorderCluster borderCluster;
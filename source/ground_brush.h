@@ -45,6 +45,9 @@ public:
 	virtual void undraw(BaseMap* map, Tile* tile);
 	static void doBorders(BaseMap* map, Tile* tile);
 	static const BorderBlock* getBrushTo(GroundBrush* first, GroundBrush* second);
+	// Resolves the border rules of every pair of ground brushes up front, has to
+	// be called again whenever ground brushes were added
+	static void compileBorderRules();
 
 	virtual int32_t getZ() const {
 		return z_order;
@@ -117,9 +120,24 @@ protected: // Members
 		}
 	};
 
+	// How a tile of the first brush borders a neighbour of the second one,
+	// either of them may be no brush at all
+	struct BorderRule {
+		const BorderBlock* block = nullptr;
+		bool friends = false;
+	};
+
+	static BorderRule makeBorderRule(GroundBrush* first, GroundBrush* second);
+	static BorderRule getBorderRule(GroundBrush* first, GroundBrush* second);
+
 	std::vector<BorderBlock*> borders;
 	std::vector<ItemChanceBlock> border_items;
 	int total_chance;
+	// Row and column in border_rules, 0 until the rules have been compiled
+	uint32_t rule_index;
+
+	static std::vector<BorderRule> border_rules;
+	static uint32_t border_rule_stride;
 
 public: // Static global members
 	static uint32_t border_types[256];
@@ -46,6 +46,8 @@
 #include "live_client.h"
 #include "live_tab.h"
 #include "live_server.h"
+#include "parallel.h"
+#include "startup_cache.h"
 
 #ifdef __WXOSX__
 	#include <AGL/agl.h>
@@ -60,6 +62,16 @@ namespace InternalGUI {
 		g_gui.DestroyLoadBar();
 		g_gui.unloadMapWindow();
 	}
+
+	// Runs one stage of the startup loading and logs how long it took
+	template <typename Function>
+	auto timeLoadStage(const std::string &name, Function &&function) {
+		const auto start = std::chrono::steady_clock::now();
+		auto result = function();
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		spdlog::info("[GUI::LoadDataFiles] {} took {} ms", name, elapsed.count());
+		return result;
+	}
 } // namespace (internal use only)
 
 const wxEventType EVT_UPDATE_MENUS = wxNewEventType();
@@ -298,61 +310,87 @@ bool GUI::LoadDataFiles(wxString &error, wxArrayString &warnings) {
 	g_gui.SetLoadDone(0, "Loading assets file");
 	spdlog::info("Loading assets");
 
+	const auto loadStart = std::chrono::steady_clock::now();
+
+	FileName startupCacheFile(GUI::GetLocalDataDirectory());
+	startupCacheFile.SetFullName("startup.cache");
+	g_startupCache.open(startupCacheFile);
+
 	g_gui.SetLoadDone(20, "Loading client assets...");
 	spdlog::info("Loading appearances");
-	if (!ClientAssets::loadAppearanceProtobuf(error, warnings)) {
-
+	if (!InternalGUI::timeLoadStage("appearances", [&]() { return ClientAssets::loadAppearanceProtobuf(error, warnings); })) {
+		g_startupCache.close();
 		InternalGUI::logErrorAndSetMessage("Couldn't load catalog-content.json", error);
 		return false;
 	}
 
-	g_gui.SetLoadDone(30, "Loading items.xml ...");
-	spdlog::info("Loading items");
-	if (!g_items.loadFromGameXml(wxString("data/items/items.xml"), error, warnings)) {
-		warnings.push_back("Couldn't load items.xml: " + error);
-		spdlog::warn("[GUI::LoadDataFiles] {}: {}", wxString("data/items/items.xml").ToStdString(), error.ToStdString());
-	}
-
-	g_gui.SetLoadDone(45, "Loading monsters.xml ...");
-	spdlog::info("Loading monsters");
-	if (!g_monsters.loadFromXML(wxString("data/creatures/monsters.xml"), true, error, warnings)) {
-		warnings.push_back("Couldn't load monsters.xml: " + error);
-		spdlog::warn("[GUI::LoadDataFiles] {}: {}", wxString("data/creatures/monsters.xml").ToStdString(), error.ToStdString());
-	}
+	// Items, monsters and npcs only depend on the appearances and are parsed
+	// at the same time, every stage collects its own messages. Materials
+	// create brushes out of all of them, so they wait for the whole group.
+	struct LoadStage {
+		std::string name;
+		std::function<bool(wxString &, wxArrayString &)> load;
+		wxString error;
+		wxArrayString warnings;
+		bool loaded = false;
+	};
 
-	g_gui.SetLoadDone(45, "Loading user monsters.xml ...");
-	spdlog::info("Loading user monsters");
-	{
+	const auto loadUserFile = [](const wxString &name, auto &database, wxArrayString &fileWarnings) {
 		FileName cdb = ClientAssets::getLocalPath();
 		cdb.AppendDir("materials");
-		cdb.SetFullName("monsters.xml");
+		cdb.SetFullName(name);
 		wxString nerr;
-		wxArrayString nwarn;
-		g_monsters.loadFromXML(cdb, false, nerr, nwarn);
-	}
+		database.loadFromXML(cdb, false, nerr, fileWarnings);
+	};
 
-	g_gui.SetLoadDone(45, "Loading npcs.xml ...");
-	spdlog::info("Loading npcs");
-	if (!g_npcs.loadFromXML(wxString("data/creatures/npcs.xml"), true, error, warnings)) {
-		warnings.push_back("Couldn't load npcs.xml: " + error);
-		spdlog::warn("[GUI::LoadDataFiles] {}: {}", wxString("data/creatures/npcs.xml").ToStdString(), error.ToStdString());
-	}
+	std::vector<LoadStage> stages(3);
+	stages[0].name = "data/items/items.xml";
+	stages[0].load = [](wxString &stageError, wxArrayString &stageWarnings) {
+		return g_items.loadFromGameXml(wxString("data/items/items.xml"), stageError, stageWarnings);
+	};
+	stages[1].name = "data/creatures/monsters.xml";
+	stages[1].load = [&](wxString &stageError, wxArrayString &stageWarnings) {
+		const bool loaded = g_monsters.loadFromXML(wxString("data/creatures/monsters.xml"), true, stageError, stageWarnings);
+		wxArrayString userWarnings;
+		loadUserFile("monsters.xml", g_monsters, userWarnings);
+		return loaded;
+	};
+	stages[2].name = "data/creatures/npcs.xml";
+	stages[2].load = [&](wxString &stageError, wxArrayString &stageWarnings) {
+		const bool loaded = g_npcs.loadFromXML(wxString("data/creatures/npcs.xml"), true, stageError, stageWarnings);
+		loadUserFile("npcs.xml", g_npcs, stageWarnings);
+		return loaded;
+	};
 
-	g_gui.SetLoadDone(45, "Loading user npcs.xml ...");
-	spdlog::info("Loading user npcs");
-	{
-		FileName cdb = ClientAssets::getLocalPath();
-		cdb.AppendDir("materials");
-		cdb.SetFullName("npcs.xml");
-		wxString nerr;
-		wxArrayString nwarn;
-		g_npcs.loadFromXML(cdb, false, nerr, warnings);
+	g_gui.SetLoadDone(30, "Loading items, monsters and npcs...");
+	spdlog::info("Loading items, monsters and npcs");
+	InternalGUI::timeLoadStage("items, monsters and npcs", [&]() {
+		rme::parallelFor(
+			stages.size(), [&](size_t index) {
+				LoadStage &stage = stages[index];
+				stage.loaded = InternalGUI::timeLoadStage(stage.name, [&]() { return stage.load(stage.error, stage.warnings); });
+			},
+			[&](size_t done) {
+				g_gui.SetLoadDone(30 + static_cast<int32_t>(done * 20 / stages.size()));
+			}
+		);
+		return true;
+	});
+
+	for (const LoadStage &stage : stages) {
+		warnings.insert(warnings.end(), stage.warnings.begin(), stage.warnings.end());
+		if (!stage.loaded) {
+			wxString fileName = wxString(stage.name).AfterLast('/');
+			warnings.push_back("Couldn't load " + fileName + ": " + stage.error);
+			spdlog::warn("[GUI::LoadDataFiles] {}: {}", stage.name, stage.error.ToStdString());
+			error = stage.error;
+		}
 	}
 
 	g_gui.SetLoadDone(50, "Loading materials.xml ...");
 	spdlog::info("Loading materials");
 	auto materialsPath = wxString(data_path.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) + "materials/materials.xml");
-	if (!g_materials.loadMaterials(materialsPath, error, warnings)) {
+	if (!InternalGUI::timeLoadStage("materials", [&]() { return g_materials.loadMaterials(materialsPath, error, warnings); })) {
 		warnings.push_back("Couldn't load materials.xml: " + error);
 		spdlog::warn("[GUI::LoadDataFiles] {}: {}", materialsPath.ToStdString(), error.ToStdString());
 	}
@@ -360,9 +398,18 @@ bool GUI::LoadDataFiles(wxString &error, wxArrayString &warnings) {
 	g_gui.SetLoadDone(70, "Finishing...");
 	spdlog::info("Finishing load map...");
 
-	g_brushes.init();
-	g_materials.createOtherTileset();
-	g_materials.createNpcTileset();
+	InternalGUI::timeLoadStage("brushes and tilesets", [&]() {
+		g_brushes.init();
+		g_materials.createOtherTileset();
+		g_materials.createNpcTileset();
+		return true;
+	});
+
+	// Sections that were made again from their files are kept for the next launch
+	g_startupCache.save();
+
+	const auto loadTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - loadStart);
+	spdlog::info("[GUI::LoadDataFiles] Loading took {} ms in total", loadTime.count());
 
 	g_gui.DestroyLoadBar();
 	spdlog::info("Assets loaded");
@@ -1103,12 +1150,11 @@ bool GUI::SetLoadDone(int32_t done, const wxString &newMessage) {
 	int32_t newProgress = progressFrom + static_cast<int32_t>((done / 100.f) * (progressTo - progressFrom));
 	newProgress = std::max<int32_t>(0, std::min<int32_t>(100, newProgress));
 
-	bool skip = false;
+	bool keepGoing = true;
 	if (progressBar) {
-		progressBar->Update(
+		keepGoing = progressBar->Update(
 			newProgress,
-			wxString::Format("%s (%d%%)", progressText, newProgress),
-			&skip
+			wxString::Format("%s (%d%%)", progressText, newProgress)
 		);
 		currentProgress = newProgress;
 	}
@@ -1123,7 +1169,7 @@ bool GUI::SetLoadDone(int32_t done, const wxString &newMessage) {
 		}
 	}
 
-	return skip;
+	return keepGoing;
 }
 
 void GUI::DestroyLoadBar() {
@@ -1134,6 +1180,11 @@ void GUI::DestroyLoadBar() {
 		progressBar->Destroy();
 		progressBar = nullptr;
 
+		// Long operations modify the map in place and may have been drawn half way through
+		if (IsEditorOpen()) {
+			GetCurrentMap().invalidateRender();
+		}
+
 		if (root->IsActive()) {
 			root->Raise();
 		} else {
@@ -1249,6 +1300,7 @@ void GUI::EndPasting() {
 	if (pasting) {
 		pasting = false;
 		secondary_map = nullptr;
+		copybuffer.releaseBufferMap();
 	}
 }
 
@@ -85,17 +85,20 @@ House::House(Map &map) :
 	clientid(0),
 	beds(0),
 	map(&map),
-	exit(0, 0, 0) {
+	exit(0, 0, 0),
+	bounds_dirty(false) {
 	////
 }
 
 void House::clean() {
-	for (PositionList::const_iterator pos_iter = tiles.begin(); pos_iter != tiles.end(); ++pos_iter) {
-		Tile* tile = map->getTile(*pos_iter);
+	for (const Position &position : tiles) {
+		Tile* tile = map->getTile(position);
 		if (tile) {
 			tile->setHouse(nullptr);
+			map->markChanged(position);
 		}
 	}
+	map->invalidateRender();
 
 	Tile* tile = map->getTile(exit);
 	if (tile) {
@@ -105,10 +108,14 @@ void House::clean() {
 
 size_t House::size() const {
 	size_t count = 0;
-	for (PositionList::const_iterator pos_iter = tiles.begin(); pos_iter != tiles.end(); ++pos_iter) {
-		auto tile = map->getTile(*pos_iter);
-		auto topItem = tile->getTopItem();
-		if (tile && (!tile->getWall() || tile->getTable() || topItem->isDoor())) {
+	for (const Position &position : tiles) {
+		const Tile* tile = map->getTile(position);
+		if (!tile) {
+			continue;
+		}
+
+		const Item* topItem = tile->getTopItem();
+		if (!tile->getWall() || tile->getTable() || (topItem && topItem->isDoor())) {
 			++count;
 		}
 	}
@@ -118,24 +125,94 @@ size_t House::size() const {
 void House::addTile(Tile* tile) {
 	ASSERT(tile);
 	tile->setHouse(this);
-	tiles.push_back(tile->getPosition());
+	if (tiles.insert(tile->getPosition()).second) {
+		extendBounds(tile->getPosition());
+	}
 }
 
 void House::removeTile(Tile* tile) {
 	ASSERT(tile);
-	for (PositionList::iterator tile_iter = tiles.begin(); tile_iter != tiles.end(); ++tile_iter) {
-		if (*tile_iter == tile->getPosition()) {
-			tiles.erase(tile_iter);
-			tile->setHouse(nullptr);
-			return;
+	if (tiles.erase(tile->getPosition()) != 0) {
+		tile->setHouse(nullptr);
+		bounds_dirty = true;
+	}
+}
+
+void House::addTiles(const std::vector<Tile*> &new_tiles) {
+	tiles.reserve(tiles.size() + new_tiles.size());
+	for (Tile* tile : new_tiles) {
+		tile->setHouse(this);
+		if (tiles.insert(tile->getPosition()).second) {
+			extendBounds(tile->getPosition());
+		}
+	}
+}
+
+void House::removeTiles(const PositionVector &positions) {
+	for (const Position &position : positions) {
+		if (tiles.erase(position) != 0) {
+			bounds_dirty = true;
 		}
 	}
 }
 
+void House::extendBounds(const Position &position) {
+	if (bounds_dirty) {
+		return;
+	}
+
+	if (tiles.size() == 1) {
+		bounds_start = position;
+		bounds_end = position;
+		return;
+	}
+
+	bounds_start.x = std::min(bounds_start.x, position.x);
+	bounds_start.y = std::min(bounds_start.y, position.y);
+	bounds_start.z = std::min(bounds_start.z, position.z);
+	bounds_end.x = std::max(bounds_end.x, position.x);
+	bounds_end.y = std::max(bounds_end.y, position.y);
+	bounds_end.z = std::max(bounds_end.z, position.z);
+}
+
+void House::updateBounds() const {
+	if (!bounds_dirty) {
+		return;
+	}
+
+	bounds_dirty = false;
+	if (tiles.empty()) {
+		bounds_start = Position();
+		bounds_end = Position();
+		return;
+	}
+
+	bounds_start = *tiles.begin();
+	bounds_end = bounds_start;
+	for (const Position &position : tiles) {
+		bounds_start.x = std::min(bounds_start.x, position.x);
+		bounds_start.y = std::min(bounds_start.y, position.y);
+		bounds_start.z = std::min(bounds_start.z, position.z);
+		bounds_end.x = std::max(bounds_end.x, position.x);
+		bounds_end.y = std::max(bounds_end.y, position.y);
+		bounds_end.z = std::max(bounds_end.z, position.z);
+	}
+}
+
+const Position &House::getBoundsStart() const {
+	updateBounds();
+	return bounds_start;
+}
+
+const Position &House::getBoundsEnd() const {
+	updateBounds();
+	return bounds_end;
+}
+
 uint8_t House::getEmptyDoorID() const {
 	std::set<uint8_t> taken;
-	for (PositionList::const_iterator tile_iter = tiles.begin(); tile_iter != tiles.end(); ++tile_iter) {
-		if (const Tile* tile = map->getTile(*tile_iter)) {
+	for (const Position &position : tiles) {
+		if (const Tile* tile = map->getTile(position)) {
 			for (ItemVector::const_iterator item_iter = tile->items.begin(); item_iter != tile->items.end(); ++item_iter) {
 				if (Door* door = dynamic_cast<Door*>(*item_iter)) {
 					taken.insert(door->getDoorID());
@@ -155,12 +232,12 @@ uint8_t House::getEmptyDoorID() const {
 }
 
 Position House::getDoorPositionByID(uint8_t id) const {
-	for (PositionList::const_iterator tile_iter = tiles.begin(); tile_iter != tiles.end(); ++tile_iter) {
-		if (const Tile* tile = map->getTile(*tile_iter)) {
+	for (const Position &position : tiles) {
+		if (const Tile* tile = map->getTile(position)) {
 			for (ItemVector::const_iterator item_iter = tile->items.begin(); item_iter != tile->items.end(); ++item_iter) {
 				if (Door* door = dynamic_cast<Door*>(*item_iter)) {
 					if (door->getDoorID() == id) {
-						return *tile_iter;
+						return position;
 					}
 				}
 			}
@@ -172,7 +249,7 @@ Position House::getDoorPositionByID(uint8_t id) const {
 std::string House::getDescription() {
 	std::ostringstream os;
 	os << name;
-	os << " (ID:" << id << "; Rent: " << rent << "; Max Beds: " << beds << ")";
+	os << " (ID:" << id << "; Rent: " << rent << "; Max Beds: " << beds << "; Tiles: " << tiles.size() << ")";
 	return os.str();
 }
 
@@ -20,6 +20,8 @@
 
 #include "position.h"
 
+#include <unordered_set>
+
 class Map;
 class Tile;
 class Door;
@@ -33,6 +35,17 @@ public:
 	void clean();
 	void addTile(Tile* tile);
 	void removeTile(Tile* tile);
+	// Bulk versions of the above, the tiles at removed positions keep their
+	// house ID so undo can put them back
+	void addTiles(const std::vector<Tile*> &new_tiles);
+	void removeTiles(const PositionVector &positions);
+	bool hasTile(const Position &position) const {
+		return tiles.contains(position);
+	}
+	size_t getTileCount() const noexcept {
+		return tiles.size();
+	}
+	// Counts the tiles that are not walls, only doors and tables are
 	size_t size() const;
 	std::string getDescription();
 
@@ -53,15 +66,27 @@ public:
 	uint8_t getEmptyDoorID() const;
 	Position getDoorPositionByID(uint8_t id) const;
 
-	const PositionList &getTiles() const {
+	const std::unordered_set<Position> &getTiles() const {
 		return tiles;
 	}
 
+	// Corners of the box around all house tiles, both invalid without tiles
+	const Position &getBoundsStart() const;
+	const Position &getBoundsEnd() const;
+
 protected:
+	void extendBounds(const Position &position);
+	void updateBounds() const;
+
 	Map* map;
-	PositionList tiles;
+	std::unordered_set<Position> tiles;
 	Position exit;
 
+	// Grown by new tiles, recomputed on demand once tiles were removed
+	mutable Position bounds_start;
+	mutable Position bounds_end;
+	mutable bool bounds_dirty;
+
 	friend class Houses;
 };
 
@@ -31,6 +31,13 @@
 #include "item.h"
 #include "complexitem.h"
 #include "town.h"
+#include "parallel.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
 
 typedef uint8_t attribute_t;
 typedef uint32_t flags_t;
@@ -616,13 +623,7 @@ bool IOMapOTBM::loadMap(Map &map, const FileName &filename) {
 	}
 #endif
 
-	DiskNodeFileReadHandle f(nstr(filename.GetFullPath()), StringVector(1, "OTBM"));
-	if (!f.isOk()) {
-		error(("Couldn't open file for reading\nThe error reported was: " + wxstr(f.getErrorMessage())).wc_str());
-		return false;
-	}
-
-	if (!loadMap(map, f)) {
+	if (!loadMapFile(map, filename)) {
 		return false;
 	}
 
@@ -646,11 +647,224 @@ bool IOMapOTBM::loadMap(Map &map, const FileName &filename) {
 	return true;
 }
 
+/*
+	Memory mapped loading
+
+	indexMapNodes walks the node structure of the mapped file once, without
+	decoding anything, and records where every child of the map data node
+	starts and ends. The tile areas among them are decoded on the worker threads,
+	each into its own OTBMTileArea, while the main thread merges the finished
+	ones into the map in file order. Everything that depends on the map, like
+	the duplicate check and the houses, only happens while merging, so the
+	result and the warnings are the same as when reading the file serially.
+	Files the index doesn't understand are left to the serial loader.
+*/
+
+struct OTBMNodeSpan {
+	// Offset of the NODE_START byte
+	size_t begin;
+	// One past the matching NODE_END byte
+	size_t end;
+	// Type byte of the node, -1 if the node holds no data
+	int type;
+};
+
+struct OTBMTileArea {
+	struct Entry {
+		// Entries without a position only carry the warnings of skipped nodes
+		bool positioned = false;
+		Position pos;
+		// nullptr if the tile was discarded while it was read
+		Tile* tile = nullptr;
+		uint32_t house_id = 0;
+		std::vector<wxString> warnings;
+	};
+
+	OTBMTileArea() = default;
+	~OTBMTileArea() {
+		clear();
+	}
+
+	OTBMTileArea(const OTBMTileArea &) = delete;
+	OTBMTileArea &operator=(const OTBMTileArea &) = delete;
+
+	void warning(const wxString &message) {
+		entries.emplace_back().warnings.push_back(message);
+	}
+
+	void clear() {
+		for (Entry &entry : entries) {
+			delete entry.tile;
+		}
+		std::vector<Entry>().swap(entries);
+	}
+
+	std::vector<Entry> entries;
+};
+
+namespace {
+	// Returns false if the structure is broken in any way, the serial loader
+	// then reports it the way it always has
+	bool indexMapNodes(const uint8_t* data, size_t size, std::vector<OTBMNodeSpan> &spans) {
+		if (size == 0 || data[0] != NODE_START) {
+			return false;
+		}
+
+		// Root is depth 1, the map data node 2 and its children 3
+		int depth = 0;
+		bool after_end = false;
+		OTBMNodeSpan span = { 0, 0, -1 };
+		for (size_t i = 0; i < size; ++i) {
+			const uint8_t op = data[i];
+			if (op == NODE_START) {
+				if (++depth == 3) {
+					span.begin = i;
+					span.type = -1;
+					if (i + 1 < size && data[i + 1] != NODE_START && data[i + 1] != NODE_END) {
+						if (data[i + 1] != ESCAPE_CHAR) {
+							span.type = data[i + 1];
+						} else if (i + 2 < size) {
+							span.type = data[i + 2];
+						}
+					}
+				}
+				after_end = false;
+			} else if (op == NODE_END) {
+				if (depth == 3) {
+					span.end = i + 1;
+					spans.push_back(span);
+				} else if (depth == 2) {
+					// The serial loader stops reading after the first map data node
+					return true;
+				} else if (depth == 1) {
+					// Root without a map data node
+					return false;
+				}
+				--depth;
+				after_end = true;
+			} else if (after_end) {
+				// Only another node or the end of the parent may follow a node
+				return false;
+			} else if (op == ESCAPE_CHAR) {
+				++i;
+			}
+		}
+		// Premature end of file
+		return false;
+	}
+
+	bool hasOTBMIdentifier(const MappedFile &file) {
+		if (file.size() < 4) {
+			return false;
+		}
+		// 0x00 00 00 00 is accepted as a wildcard version
+		const uint8_t* identifier = file.getData();
+		return memcmp(identifier, "OTBM", 4) == 0 || (identifier[0] == 0 && identifier[1] == 0 && identifier[2] == 0 && identifier[3] == 0);
+	}
+}
+
+bool IOMapOTBM::loadMapFile(Map &map, const FileName &filename) {
+	const std::string path = nstr(filename.GetFullPath());
+	if (parallel_loading) {
+		MappedFile file(path);
+		if (file.isOk() && hasOTBMIdentifier(file)) {
+			std::vector<OTBMNodeSpan> spans;
+			if (indexMapNodes(file.getData() + 4, file.size() - 4, spans)) {
+				return loadMap(map, file, spans);
+			}
+			spdlog::info("Map file {} could not be indexed, loading it serially", path);
+		}
+	}
+
+	DiskNodeFileReadHandle f(path, StringVector(1, "OTBM"));
+	if (!f.isOk()) {
+		error(("Couldn't open file for reading\nThe error reported was: " + wxstr(f.getErrorMessage())).wc_str());
+		return false;
+	}
+	return loadMap(map, f);
+}
+
 bool IOMapOTBM::loadMap(Map &map, NodeFileReadHandle &f) {
+	BinaryNode* mapHeaderNode = loadMapHeader(map, f);
+	if (!mapHeaderNode) {
+		return false;
+	}
+
+	int nodes_loaded = 0;
+
+	for (BinaryNode* mapNode = mapHeaderNode->getChild(); mapNode != nullptr; mapNode = mapNode->advance()) {
+		++nodes_loaded;
+		if (nodes_loaded % 15 == 0) {
+			g_gui.SetLoadDone(static_cast<int32_t>(100.0 * f.tell() / f.size()));
+		}
+		loadMapNode(map, mapNode);
+	}
+
+	if (!f.isOk()) {
+		warning(wxstr(f.getErrorMessage()).wc_str());
+	}
+	return true;
+}
+
+bool IOMapOTBM::loadMap(Map &map, const MappedFile &file, const std::vector<OTBMNodeSpan> &spans) {
+	const uint8_t* data = file.getData() + 4;
+
+	MemoryNodeFileReadHandle f(data, file.size() - 4);
+	if (!loadMapHeader(map, f)) {
+		return false;
+	}
+
+	std::vector<size_t> area_spans;
+	for (size_t i = 0; i < spans.size(); ++i) {
+		if (spans[i].type == OTBM_TILE_AREA) {
+			area_spans.push_back(i);
+		}
+	}
+
+	std::vector<OTBMTileArea> areas(area_spans.size());
+	std::vector<std::atomic<bool>> decoded(area_spans.size());
+
+	// Merges every node up to the first area that isn't decoded yet
+	size_t next_span = 0;
+	size_t next_area = 0;
+	const auto mergeDecoded = [&]() {
+		for (; next_span < spans.size(); ++next_span) {
+			const OTBMNodeSpan &span = spans[next_span];
+			if (span.type == OTBM_TILE_AREA) {
+				if (!decoded[next_area].load(std::memory_order_acquire)) {
+					break;
+				}
+				mergeTileArea(map, areas[next_area]);
+				++next_area;
+			} else {
+				MemoryNodeFileReadHandle node_handle(data + span.begin, span.end - span.begin);
+				loadMapNode(map, node_handle.getRootNode());
+			}
+		}
+		g_gui.SetLoadDone(static_cast<int32_t>(100.0 * next_span / std::max<size_t>(spans.size(), 1)));
+	};
+
+	rme::parallelFor(
+		area_spans.size(),
+		[&](size_t index) {
+			const OTBMNodeSpan &span = spans[area_spans[index]];
+			MemoryNodeFileReadHandle node_handle(data + span.begin, span.end - span.begin);
+			BinaryNode* mapNode = node_handle.getRootNode();
+			mapNode->skip(1); // Skip the type byte
+			decodeTileArea(mapNode, areas[index]);
+			decoded[index].store(true, std::memory_order_release);
+		},
+		[&](size_t) { mergeDecoded(); }
+	);
+	mergeDecoded();
+	return true;
+}
+
+BinaryNode* IOMapOTBM::loadMapHeader(Map &map, NodeFileReadHandle &f) {
 	BinaryNode* root = f.getRootNode();
 	if (!root) {
 		error("Could not read root node.");
-		return false;
+		return nullptr;
 	}
 	root->skip(1); // Skip the type byte
 
@@ -659,7 +873,7 @@ bool IOMapOTBM::loadMap(Map &map, NodeFileReadHandle &f) {
 	uint32_t u32;
 
 	if (!root->getU32(u32)) {
-		return false;
+		return nullptr;
 	}
 
 	version.otbm = (MapVersionID)u32;
@@ -673,17 +887,17 @@ bool IOMapOTBM::loadMap(Map &map, NodeFileReadHandle &f) {
 			warning("Unsupported or damaged map version");
 		} else {
 			error("Unsupported OTBM version, could not load map");
-			return false;
+			return nullptr;
 		}
 	}
 
 	if (!root->getU16(u16)) {
-		return false;
+		return nullptr;
 	}
 
 	map.width = u16;
 	if (!root->getU16(u16)) {
-		return false;
+		return nullptr;
 	}
 
 	map.height = u16;
@@ -691,7 +905,7 @@ bool IOMapOTBM::loadMap(Map &map, NodeFileReadHandle &f) {
 	BinaryNode* mapHeaderNode = root->getChild();
 	if (mapHeaderNode == nullptr || !mapHeaderNode->getByte(u8) || u8 != OTBM_MAP_DATA) {
 		error("Could not get root child node. Cannot recover from fatal error!");
-		return false;
+		return nullptr;
 	}
 
 	uint8_t attribute;
@@ -734,231 +948,325 @@ bool IOMapOTBM::loadMap(Map &map, NodeFileReadHandle &f) {
 			}
 		}
 	}
+	return mapHeaderNode;
+}
 
-	int nodes_loaded = 0;
+void IOMapOTBM::loadMapNode(Map &map, BinaryNode* mapNode) {
+	uint8_t node_type;
+	if (!mapNode->getByte(node_type)) {
+		warning("Invalid map node");
+		return;
+	}
+	if (node_type == OTBM_TILE_AREA) {
+		OTBMTileArea area;
+		decodeTileArea(mapNode, area);
+		mergeTileArea(map, area);
+	} else if (node_type == OTBM_TOWNS) {
+		loadTowns(map, mapNode);
+	} else if (node_type == OTBM_WAYPOINTS) {
+		loadWaypoints(map, mapNode);
+	}
+}
 
-	for (BinaryNode* mapNode = mapHeaderNode->getChild(); mapNode != nullptr; mapNode = mapNode->advance()) {
-		++nodes_loaded;
-		if (nodes_loaded % 15 == 0) {
-			g_gui.SetLoadDone(static_cast<int32_t>(100.0 * f.tell() / f.size()));
-		}
+void IOMapOTBM::decodeTileArea(BinaryNode* mapNode, OTBMTileArea &area) const {
+	uint16_t base_x, base_y;
+	uint8_t base_z;
+	if (!mapNode->getU16(base_x) || !mapNode->getU16(base_y) || !mapNode->getU8(base_z)) {
+		area.warning("Invalid map node, no base coordinate");
+		return;
+	}
 
-		uint8_t node_type;
-		if (!mapNode->getByte(node_type)) {
-			warning("Invalid map node");
+	for (BinaryNode* tileNode = mapNode->getChild(); tileNode != nullptr; tileNode = tileNode->advance()) {
+		uint8_t tile_type;
+		if (!tileNode->getByte(tile_type)) {
+			area.warning("Invalid tile type");
+			continue;
+		}
+		if (tile_type != OTBM_TILE && tile_type != OTBM_HOUSETILE) {
+			area.warning("Unknown type of tile node");
 			continue;
 		}
-		if (node_type == OTBM_TILE_AREA) {
-			uint16_t base_x, base_y;
-			uint8_t base_z;
-			if (!mapNode->getU16(base_x) || !mapNode->getU16(base_y) || !mapNode->getU8(base_z)) {
-				warning("Invalid map node, no base coordinate");
-				continue;
-			}
-
-			for (BinaryNode* tileNode = mapNode->getChild(); tileNode != nullptr; tileNode = tileNode->advance()) {
-				Tile* tile = nullptr;
-				uint8_t tile_type;
-				if (!tileNode->getByte(tile_type)) {
-					warning("Invalid tile type");
-					continue;
-				}
-				if (tile_type == OTBM_TILE || tile_type == OTBM_HOUSETILE) {
-					// printf("Start\n");
-					uint8_t x_offset, y_offset;
-					if (!tileNode->getU8(x_offset) || !tileNode->getU8(y_offset)) {
-						warning("Could not read position of tile");
-						continue;
-					}
-					const Position pos(base_x + x_offset, base_y + y_offset, base_z);
-
-					if (map.getTile(pos)) {
-						warning("Duplicate tile at %d:%d:%d, discarding duplicate", pos.x, pos.y, pos.z);
-						continue;
-					}
 
-					tile = map.allocator(map.createTileL(pos));
-					House* house = nullptr;
-					if (tile_type == OTBM_HOUSETILE) {
-						uint32_t house_id;
-						if (!tileNode->getU32(house_id)) {
-							warning("House tile without house data, discarding tile");
-							delete tile;
-							continue;
-						}
-						if (house_id) {
-							house = map.houses.getHouse(house_id);
-							if (!house) {
-								house = newd House(map);
-								house->id = house_id;
-								map.houses.addHouse(house);
-							}
-						} else {
-							warning("Invalid house id from tile %d:%d:%d", pos.x, pos.y, pos.z);
-						}
-					}
+		uint8_t x_offset, y_offset;
+		if (!tileNode->getU8(x_offset) || !tileNode->getU8(y_offset)) {
+			area.warning("Could not read position of tile");
+			continue;
+		}
+		const Position pos(base_x + x_offset, base_y + y_offset, base_z);
 
-					// printf("So far so good\n");
-
-					uint8_t attribute;
-					while (tileNode->getU8(attribute)) {
-						switch (attribute) {
-							case OTBM_ATTR_TILE_FLAGS: {
-								uint32_t flags = 0;
-								if (!tileNode->getU32(flags)) {
-									warning("Invalid tile flags of tile on %d:%d:%d", pos.x, pos.y, pos.z);
-								}
-								tile->setMapFlags(flags);
-								break;
-							}
-							case OTBM_ATTR_ITEM: {
-								Item* item = Item::Create_OTBM(*this, tileNode);
-								if (item == nullptr) {
-									warning("Invalid item at tile %d:%d:%d", pos.x, pos.y, pos.z);
-								}
-								tile->addItem(item);
-								break;
-							}
-							default: {
-								warning("Unknown tile attribute at %d:%d:%d", pos.x, pos.y, pos.z);
-								break;
-							}
-						}
-					}
+		// Duplicates are only known once the tile is merged into the map
+		OTBMTileArea::Entry &entry = area.entries.emplace_back();
+		entry.positioned = true;
+		entry.pos = pos;
+		std::vector<wxString> &tile_warnings = entry.warnings;
 
-					// printf("Didn't die in loop\n");
+		if (tile_type == OTBM_HOUSETILE) {
+			if (!tileNode->getU32(entry.house_id)) {
+				tile_warnings.push_back("House tile without house data, discarding tile");
+				continue;
+			}
+			if (!entry.house_id) {
+				tile_warnings.push_back(wxString::Format("Invalid house id from tile %d:%d:%d", pos.x, pos.y, pos.z));
+			}
+		}
 
-					for (BinaryNode* childNode = tileNode->getChild(); childNode != nullptr; childNode = childNode->advance()) {
-						Item* item = nullptr;
-						uint8_t node_type;
-						if (!childNode->getByte(node_type)) {
-							warning("Unknown item type %d:%d:%d", pos.x, pos.y, pos.z);
-							continue;
-						}
-						if (node_type == OTBM_ITEM) {
-							item = Item::Create_OTBM(*this, childNode);
-							if (item) {
-								if (!item->unserializeItemNode_OTBM(*this, childNode)) {
-									warning("Couldn't unserialize item attributes at %d:%d:%d", pos.x, pos.y, pos.z);
-								}
-								// reform(&map, tile, item);
-								tile->addItem(item);
-							}
-						} else if (node_type == OTBM_TILE_ZONE) {
-							uint16_t zone_count;
-							if (!childNode->getU16(zone_count)) {
-								warning("Invalid zone count at %d:%d:%d", pos.x, pos.y, pos.z);
-								continue;
-							}
-							for (uint16_t i = 0; i < zone_count; ++i) {
-								uint16_t zone_id;
-								if (!childNode->getU16(zone_id)) {
-									warning("Invalid zone id at %d:%d:%d", pos.x, pos.y, pos.z);
-									continue;
-								}
-								tile->addZone(zone_id);
-							}
-						} else {
-							warning("Unknown type of tile child node");
-						}
-					}
+		Tile* tile = newd Tile(pos.x, pos.y, pos.z);
+		entry.tile = tile;
 
-					tile->update();
-					if (house) {
-						house->addTile(tile);
+		uint8_t attribute;
+		while (tileNode->getU8(attribute)) {
+			switch (attribute) {
+				case OTBM_ATTR_TILE_FLAGS: {
+					uint32_t flags = 0;
+					if (!tileNode->getU32(flags)) {
+						tile_warnings.push_back(wxString::Format("Invalid tile flags of tile on %d:%d:%d", pos.x, pos.y, pos.z));
 					}
-
-					map.setTile(pos.x, pos.y, pos.z, tile);
-				} else {
-					warning("Unknown type of tile node");
-				}
-			}
-		} else if (node_type == OTBM_TOWNS) {
-			for (BinaryNode* townNode = mapNode->getChild(); townNode != nullptr; townNode = townNode->advance()) {
-				Town* town = nullptr;
-				uint8_t town_type;
-				if (!townNode->getByte(town_type)) {
-					warning("Invalid town type (1)");
-					continue;
+					tile->setMapFlags(flags);
+					break;
 				}
-				if (town_type != OTBM_TOWN) {
-					warning("Invalid town type (2)");
-					continue;
+				case OTBM_ATTR_ITEM: {
+					Item* item = Item::Create_OTBM(*this, tileNode);
+					if (item == nullptr) {
+						tile_warnings.push_back(wxString::Format("Invalid item at tile %d:%d:%d", pos.x, pos.y, pos.z));
+					}
+					tile->addItem(item);
+					break;
 				}
-				uint32_t town_id;
-				if (!townNode->getU32(town_id)) {
-					warning("Invalid town id");
-					continue;
+				default: {
+					tile_warnings.push_back(wxString::Format("Unknown tile attribute at %d:%d:%d", pos.x, pos.y, pos.z));
+					break;
 				}
+			}
+		}
 
-				town = map.towns.getTown(town_id);
-				if (town) {
-					warning("Duplicate town id %d, discarding duplicate", town_id);
-					continue;
-				} else {
-					town = newd Town(town_id);
-					if (!map.towns.addTown(town)) {
-						delete town;
-						continue;
+		for (BinaryNode* childNode = tileNode->getChild(); childNode != nullptr; childNode = childNode->advance()) {
+			Item* item = nullptr;
+			uint8_t node_type;
+			if (!childNode->getByte(node_type)) {
+				tile_warnings.push_back(wxString::Format("Unknown item type %d:%d:%d", pos.x, pos.y, pos.z));
+				continue;
+			}
+			if (node_type == OTBM_ITEM) {
+				item = Item::Create_OTBM(*this, childNode);
+				if (item) {
+					if (!item->unserializeItemNode_OTBM(*this, childNode)) {
+						tile_warnings.push_back(wxString::Format("Couldn't unserialize item attributes at %d:%d:%d", pos.x, pos.y, pos.z));
 					}
+					// reform(&map, tile, item);
+					tile->addItem(item);
 				}
-				std::string town_name;
-				if (!townNode->getString(town_name)) {
-					warning("Invalid town name");
-					continue;
-				}
-				town->setName(town_name);
-				Position pos;
-				uint16_t x;
-				uint16_t y;
-				uint8_t z;
-				if (!townNode->getU16(x) || !townNode->getU16(y) || !townNode->getU8(z)) {
-					warning("Invalid town temple position");
-					continue;
-				}
-				pos.x = x;
-				pos.y = y;
-				pos.z = z;
-				town->setTemplePosition(pos);
-			}
-		} else if (node_type == OTBM_WAYPOINTS) {
-			for (BinaryNode* waypointNode = mapNode->getChild(); waypointNode != nullptr; waypointNode = waypointNode->advance()) {
-				uint8_t waypoint_type;
-				if (!waypointNode->getByte(waypoint_type)) {
-					warning("Invalid waypoint type (1)");
+			} else if (node_type == OTBM_TILE_ZONE) {
+				uint16_t zone_count;
+				if (!childNode->getU16(zone_count)) {
+					tile_warnings.push_back(wxString::Format("Invalid zone count at %d:%d:%d", pos.x, pos.y, pos.z));
 					continue;
 				}
-				if (waypoint_type != OTBM_WAYPOINT) {
-					warning("Invalid waypoint type (2)");
-					continue;
+				for (uint16_t i = 0; i < zone_count; ++i) {
+					uint16_t zone_id;
+					if (!childNode->getU16(zone_id)) {
+						tile_warnings.push_back(wxString::Format("Invalid zone id at %d:%d:%d", pos.x, pos.y, pos.z));
+						continue;
+					}
+					tile->addZone(zone_id);
 				}
+			} else {
+				tile_warnings.push_back("Unknown type of tile child node");
+			}
+		}
 
-				Waypoint wp;
+		tile->update();
+	}
+}
 
-				if (!waypointNode->getString(wp.name)) {
-					warning("Invalid waypoint name");
-					continue;
-				}
-				uint16_t x;
-				uint16_t y;
-				uint8_t z;
-				if (!waypointNode->getU16(x) || !waypointNode->getU16(y) || !waypointNode->getU8(z)) {
-					warning("Invalid waypoint position");
-					continue;
+void IOMapOTBM::mergeTileArea(Map &map, OTBMTileArea &area) {
+	for (OTBMTileArea::Entry &entry : area.entries) {
+		if (entry.positioned) {
+			const Position &pos = entry.pos;
+			if (map.getTile(pos)) {
+				warning("Duplicate tile at %d:%d:%d, discarding duplicate", pos.x, pos.y, pos.z);
+				continue;
+			}
+
+			TileLocation* location = map.createTileL(pos);
+			House* house = nullptr;
+			if (entry.house_id) {
+				house = map.houses.getHouse(entry.house_id);
+				if (!house) {
+					house = newd House(map);
+					house->id = entry.house_id;
+					map.houses.addHouse(house);
 				}
-				wp.pos.x = x;
-				wp.pos.y = y;
-				wp.pos.z = z;
+			}
+			for (const wxString &message : entry.warnings) {
+				warnings.push_back(message);
+			}
+
+			Tile* tile = entry.tile;
+			if (!tile) {
+				continue;
+			}
+			entry.tile = nullptr;
 
-				map.waypoints.addWaypoint(newd Waypoint(wp));
+			tile->setLocation(location);
+			if (house) {
+				house->addTile(tile);
+			}
+			map.setTile(pos.x, pos.y, pos.z, tile);
+		} else {
+			for (const wxString &message : entry.warnings) {
+				warnings.push_back(message);
 			}
 		}
 	}
+	area.clear();
+}
 
-	if (!f.isOk()) {
-		warning(wxstr(f.getErrorMessage()).wc_str());
+void IOMapOTBM::loadTowns(Map &map, BinaryNode* mapNode) {
+	for (BinaryNode* townNode = mapNode->getChild(); townNode != nullptr; townNode = townNode->advance()) {
+		Town* town = nullptr;
+		uint8_t town_type;
+		if (!townNode->getByte(town_type)) {
+			warning("Invalid town type (1)");
+			continue;
+		}
+		if (town_type != OTBM_TOWN) {
+			warning("Invalid town type (2)");
+			continue;
+		}
+		uint32_t town_id;
+		if (!townNode->getU32(town_id)) {
+			warning("Invalid town id");
+			continue;
+		}
+
+		town = map.towns.getTown(town_id);
+		if (town) {
+			warning("Duplicate town id %d, discarding duplicate", town_id);
+			continue;
+		} else {
+			town = newd Town(town_id);
+			if (!map.towns.addTown(town)) {
+				delete town;
+				continue;
+			}
+		}
+		std::string town_name;
+		if (!townNode->getString(town_name)) {
+			warning("Invalid town name");
+			continue;
+		}
+		town->setName(town_name);
+		Position pos;
+		uint16_t x;
+		uint16_t y;
+		uint8_t z;
+		if (!townNode->getU16(x) || !townNode->getU16(y) || !townNode->getU8(z)) {
+			warning("Invalid town temple position");
+			continue;
+		}
+		pos.x = x;
+		pos.y = y;
+		pos.z = z;
+		town->setTemplePosition(pos);
 	}
-	return true;
+}
+
+void IOMapOTBM::loadWaypoints(Map &map, BinaryNode* mapNode) {
+	for (BinaryNode* waypointNode = mapNode->getChild(); waypointNode != nullptr; waypointNode = waypointNode->advance()) {
+		uint8_t waypoint_type;
+		if (!waypointNode->getByte(waypoint_type)) {
+			warning("Invalid waypoint type (1)");
+			continue;
+		}
+		if (waypoint_type != OTBM_WAYPOINT) {
+			warning("Invalid waypoint type (2)");
+			continue;
+		}
+
+		Waypoint wp;
+
+		if (!waypointNode->getString(wp.name)) {
+			warning("Invalid waypoint name");
+			continue;
+		}
+		uint16_t x;
+		uint16_t y;
+		uint8_t z;
+		if (!waypointNode->getU16(x) || !waypointNode->getU16(y) || !waypointNode->getU8(z)) {
+			warning("Invalid waypoint position");
+			continue;
+		}
+		wp.pos.x = x;
+		wp.pos.y = y;
+		wp.pos.z = z;
+
+		map.waypoints.addWaypoint(newd Waypoint(wp));
+	}
+}
+
+bool IOMapOTBM::benchmarkLoad(const FileName &filename, wxString &report) {
+	struct Run {
+		const char* name;
+		bool parallel;
+		bool success = false;
+		double seconds = 0.0;
+		size_t tiles = 0;
+		size_t houses = 0;
+		std::vector<wxString> warnings;
+		std::vector<uint8_t> data;
+	};
+	Run runs[] = { { "Serial", false }, { "Memory mapped", true } };
+
+	for (Run &run : runs) {
+		Map map;
+		IOMapOTBM loader(map.getVersion());
+		loader.setParallelLoading(run.parallel);
+
+		const auto start = std::chrono::steady_clock::now();
+		run.success = loader.loadMapFile(map, filename);
+		run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (!run.success) {
+			report = wxString::Format("%s loading failed: %s", run.name, loader.getError());
+			return false;
+		}
+
+		run.tiles = map.getTileCount();
+		run.houses = map.houses.count();
+		for (const wxString &message : loader.getWarnings()) {
+			run.warnings.push_back(message);
+		}
+
+		// Both maps are compared by what they would save
+		MemoryNodeFileWriteHandle handle;
+		loader.saveMap(map, handle);
+		run.data.assign(handle.getMemory(), handle.getMemory() + handle.getSize());
+	}
+
+	const Run &serial = runs[0];
+	const Run &parallel = runs[1];
+	const bool identical = serial.tiles == parallel.tiles && serial.houses == parallel.houses && serial.warnings == parallel.warnings && serial.data == parallel.data;
+
+	std::ostringstream os;
+	os.setf(std::ios::fixed, std::ios::floatfield);
+	os.precision(3);
+	os << "Map loading benchmark for \"" << nstr(filename.GetFullName()) << "\"\n";
+	os << "\tOTBM data only, houses, spawns and zones are not loaded.\n";
+	os << "\tWorker threads: " << rme::getWorkerThreadCount() << "\n";
+	for (const Run &run : runs) {
+		os << "\t" << run.name << ":\n";
+		os << "\t\tTime: " << run.seconds << " s\n";
+		os << "\t\tTiles: " << run.tiles << "\n";
+		os << "\t\tHouses: " << run.houses << "\n";
+		os << "\t\tWarnings: " << run.warnings.size() << "\n";
+	}
+	if (parallel.seconds > 0.0) {
+		os.precision(2);
+		os << "\tSpeedup: " << serial.seconds / parallel.seconds << "x\n";
+	}
+	os << "\tResult: " << (identical ? "identical" : "DIFFERENT") << "\n";
+
+	report = wxstr(os.str());
+	return identical;
 }
 
 bool IOMapOTBM::loadSpawnsMonster(Map &map, const FileName &dir) {
@@ -1379,6 +1687,39 @@ bool IOMapOTBM::loadSpawnsNpc(Map &map, pugi::xml_document &doc) {
 	return true;
 }
 
+namespace {
+	// Files are written next to their target first and then moved over it in one
+	// step, so the target holds either the old or the new version at any time.
+	wxString temporaryPath(const wxString &path) {
+		return path + ".tmp";
+	}
+
+	bool replaceWithTemporary(const wxString &path) {
+#ifdef __WINDOWS__
+		const std::filesystem::path target(path.ToStdWstring());
+		const std::filesystem::path temporary(temporaryPath(path).ToStdWstring());
+#else
+		const std::filesystem::path target(nstr(path));
+		const std::filesystem::path temporary(nstr(temporaryPath(path)));
+#endif
+		std::error_code ec;
+		std::filesystem::rename(temporary, target, ec);
+		if (ec) {
+			spdlog::error("Could not move {} over {}: {}", temporary.string(), target.string(), ec.message());
+			std::filesystem::remove(temporary, ec);
+			return false;
+		}
+		return true;
+	}
+
+	bool saveXmlDocument(const pugi::xml_document &doc, const wxString &path) {
+		if (!doc.save_file(temporaryPath(path).wc_str(), "\t", pugi::format_default, pugi::encoding_utf8)) {
+			return false;
+		}
+		return replaceWithTemporary(path);
+	}
+}
+
 bool IOMapOTBM::saveMap(Map &map, const FileName &identifier) {
 #if OTGZ_SUPPORT > 0
 	if (identifier.GetExt() == "otgz") {
@@ -1389,7 +1730,7 @@ bool IOMapOTBM::saveMap(Map &map, const FileName &identifier) {
 
 		archive_write_set_compression_gzip(a);
 		archive_write_set_format_pax_restricted(a);
-		archive_write_open_filename(a, nstr(identifier.GetFullPath()).c_str());
+		archive_write_open_filename(a, nstr(temporaryPath(identifier.GetFullPath())).c_str());
 
 		g_gui.SetLoadDone(0, "Saving monsters...");
 
@@ -1487,25 +1828,43 @@ bool IOMapOTBM::saveMap(Map &map, const FileName &identifier) {
 		archive_entry_free(entry);
 
 		// Free / close the archive
-		archive_write_close(a);
+		const bool closed = archive_write_close(a) == ARCHIVE_OK;
 		archive_write_free(a);
 
 		g_gui.DestroyLoadBar();
+		if (!closed) {
+			wxRemoveFile(temporaryPath(identifier.GetFullPath()));
+		}
+		if (!closed || !replaceWithTemporary(identifier.GetFullPath())) {
+			error("Could not write file %s", (const char*)identifier.GetFullPath().mb_str(wxConvUTF8));
+			return false;
+		}
 		return true;
 	}
 #endif
 
-	DiskNodeFileWriteHandle f(
-		nstr(identifier.GetFullPath()),
-		(g_settings.getInteger(Config::SAVE_WITH_OTB_MAGIC_NUMBER) ? "OTBM" : std::string(4, '\0'))
-	);
+	{
+		DiskNodeFileWriteHandle f(
+			nstr(temporaryPath(identifier.GetFullPath())),
+			(g_settings.getInteger(Config::SAVE_WITH_OTB_MAGIC_NUMBER) ? "OTBM" : std::string(4, '\0'))
+		);
 
-	if (!f.isOk()) {
-		error("Can not open file %s for writing", (const char*)identifier.GetFullPath().mb_str(wxConvUTF8));
-		return false;
+		if (!f.isOk()) {
+			error("Can not open file %s for writing", (const char*)identifier.GetFullPath().mb_str(wxConvUTF8));
+			return false;
+		}
+
+		bool written = saveMap(map, f);
+		f.close();
+		if (!written || f.error_code != FILE_NO_ERROR) {
+			wxRemoveFile(temporaryPath(identifier.GetFullPath()));
+			error("Could not write file %s", (const char*)identifier.GetFullPath().mb_str(wxConvUTF8));
+			return false;
+		}
 	}
 
-	if (!saveMap(map, f)) {
+	if (!replaceWithTemporary(identifier.GetFullPath())) {
+		error("Could not replace file %s", (const char*)identifier.GetFullPath().mb_str(wxConvUTF8));
 		return false;
 	}
 
@@ -1535,8 +1894,6 @@ bool IOMapOTBM::saveMap(Map &map, NodeFileWriteHandle &f) {
 	 * format.
 	 */
 
-	const IOMapOTBM &self = *this;
-
 	FileName tmpName;
 	f.addNode(0);
 	{
@@ -1575,117 +1932,15 @@ bool IOMapOTBM::saveMap(Map &map, NodeFileWriteHandle &f) {
 			f.addString(nstr(tmpName.GetFullName()));
 
 			// Start writing tiles
-			uint32_t tiles_saved = 0;
-			bool first = true;
-
-			int local_x = -1, local_y = -1, local_z = -1;
-
-			MapIterator map_iterator = map.begin();
-			while (map_iterator != map.end()) {
-				// Update progressbar
-				++tiles_saved;
-				if (tiles_saved % 8192 == 0) {
-					g_gui.SetLoadDone(int(tiles_saved / double(map.getTileCount()) * 100.0));
-				}
-
-				// Get tile
-				Tile* save_tile = (*map_iterator)->get();
-
-				// Is it an empty tile that we can skip? (Leftovers...)
-				if (!save_tile || save_tile->size() == 0) {
-					++map_iterator;
-					continue;
-				}
-
-				const Position &pos = save_tile->getPosition();
-
-				// Decide if newd node should be created
-				if (pos.x < local_x || pos.x >= local_x + 256 || pos.y < local_y || pos.y >= local_y + 256 || pos.z != local_z) {
-					// End last node
-					if (!first) {
-						f.endNode();
-					}
-					first = false;
-
-					// Start newd node
-					f.addNode(OTBM_TILE_AREA);
-					f.addU16(local_x = pos.x & 0xFF00);
-					f.addU16(local_y = pos.y & 0xFF00);
-					f.addU8(local_z = pos.z);
-				}
-				f.addNode(save_tile->isHouseTile() ? OTBM_HOUSETILE : OTBM_TILE);
-
-				f.addU8(save_tile->getX() & 0xFF);
-				f.addU8(save_tile->getY() & 0xFF);
-
-				if (save_tile->isHouseTile()) {
-					f.addU32(save_tile->getHouseID());
-				}
-
-				if (save_tile->getMapFlags()) {
-					f.addByte(OTBM_ATTR_TILE_FLAGS);
-					f.addU32(save_tile->getMapFlags());
-				}
-
-				if (save_tile->ground) {
-					Item* ground = save_tile->ground;
-					if (ground->isMetaItem()) {
-						// Do nothing, we don't save metaitems...
-					} else if (ground->hasBorderEquivalent()) {
-						bool found = false;
-						for (Item* item : save_tile->items) {
-							if (item->getGroundEquivalent() == ground->getID()) {
-								// Do nothing
-								// Found equivalent
-								found = true;
-								break;
-							}
-						}
-
-						if (!found) {
-							if (ground->getID() == 0) {
-								continue;
-							}
-							ground->serializeItemNode_OTBM(self, f);
-						}
-					} else if (ground->isComplex()) {
-						if (ground->getID() == 0) {
-							continue;
-						}
-						ground->serializeItemNode_OTBM(self, f);
-					} else {
-						f.addByte(OTBM_ATTR_ITEM);
-						if (ground->getID() == 0) {
-							continue;
-						}
-						ground->serializeItemCompact_OTBM(self, f);
-					}
-				}
-
-				for (Item* item : save_tile->items) {
-					if (!item->isMetaItem()) {
-						if (item->getID() == 0) {
-							continue;
-						}
-						item->serializeItemNode_OTBM(self, f);
-					}
-				}
-				if (!save_tile->zones.empty()) {
-					f.addNode(OTBM_TILE_ZONE);
-					f.addU16(save_tile->zones.size());
-					for (const auto &zoneId : save_tile->zones) {
-						f.addU16(zoneId);
-					}
-					f.endNode();
-				}
-
-				f.endNode();
-				++map_iterator;
+			bool tilesSaved;
+			if (g_settings.getBoolean(Config::INCREMENTAL_SAVE)) {
+				tilesSaved = saveTileAreas(map, f);
+			} else {
+				map.save_cache.reset();
+				tilesSaved = saveTiles(map, f);
 			}
-
-			// Only close the last node if one has actually been created
-			if (!first) {
-				f.endNode();
+			if (!tilesSaved) {
+				return false;
 			}
 
 			f.addNode(OTBM_TOWNS);
@@ -1719,7 +1974,311 @@ bool IOMapOTBM::saveMap(Map &map, NodeFileWriteHandle &f) {
 		f.endNode();
 	}
 	f.endNode();
-	return true;
+	return f.error_code == FILE_NO_ERROR;
+}
+
+/*
+	Tiles are saved in chunks of consecutive map iterator steps. A first pass
+	over the map only records where each chunk starts and which tile area the
+	tile before it was written into. The chunks are then serialized on the
+	worker threads into their own memory handles, area nodes included, and the
+	calling thread appends the finished ones to the file in order. Only a few
+	chunks per thread may wait for the writer, so memory use doesn't grow with
+	the size of the map.
+*/
+
+struct OTBMSaveChunk {
+	MapIterator begin;
+	// Number of map iterator steps, empty locations included
+	size_t steps = 0;
+	// Tile area open before the first tile of the chunk, if any
+	bool area_open = false;
+	Position area;
+};
+
+namespace {
+	constexpr size_t SaveChunkSteps = 4096;
+
+	// Whether the tile at pos doesn't fit into the area node that is open
+	bool startsTileArea(const OTBMSaveChunk &state, const Position &pos) {
+		return !state.area_open || pos.x < state.area.x || pos.x >= state.area.x + 256 || pos.y < state.area.y || pos.y >= state.area.y + 256 || pos.z != state.area.z;
+	}
+}
+
+bool IOMapOTBM::saveTiles(Map &map, NodeFileWriteHandle &f) {
+	std::vector<OTBMSaveChunk> chunks;
+	OTBMSaveChunk state;
+	const MapIterator end = map.end();
+	for (MapIterator it = map.begin(); it != end; ++it) {
+		if (chunks.empty() || chunks.back().steps == SaveChunkSteps) {
+			OTBMSaveChunk &chunk = chunks.emplace_back(state);
+			chunk.begin = it;
+			chunk.steps = 0;
+		}
+		++chunks.back().steps;
+
+		Tile* tile = (*it)->get();
+		if (tile && tile->size() != 0) {
+			const Position &pos = tile->getPosition();
+			if (startsTileArea(state, pos)) {
+				state.area_open = true;
+				state.area = Position(pos.x & 0xFF00, pos.y & 0xFF00, pos.z);
+			}
+		}
+	}
+
+	const size_t window = rme::getWorkerThreadCount() * 4;
+	std::vector<std::unique_ptr<MemoryNodeFileWriteHandle>> buffers(chunks.size());
+	std::vector<std::atomic<bool>> serialized(chunks.size());
+	std::mutex window_mutex;
+	std::condition_variable window_moved;
+	size_t written = 0;
+	bool failed = false;
+
+	const auto writeSerialized = [&]() {
+		while (written < chunks.size() && serialized[written].load(std::memory_order_acquire)) {
+			MemoryNodeFileWriteHandle &buffer = *buffers[written];
+			f.addSerialized(buffer.getMemory(), buffer.getSize());
+			buffers[written].reset();
+			{
+				std::scoped_lock lock(window_mutex);
+				++written;
+			}
+			window_moved.notify_all();
+		}
+		g_gui.SetLoadDone(static_cast<int32_t>(100.0 * written / std::max<size_t>(chunks.size(), 1)));
+	};
+
+	rme::parallelFor(
+		chunks.size(),
+		[&](size_t index) {
+			{
+				std::unique_lock lock(window_mutex);
+				window_moved.wait(lock, [&]() { return failed || index < written + window; });
+				if (failed) {
+					return;
+				}
+			}
+			try {
+				auto buffer = std::make_unique<MemoryNodeFileWriteHandle>();
+				serializeTiles(chunks[index], *buffer);
+				buffers[index] = std::move(buffer);
+			} catch (...) {
+				{
+					std::scoped_lock lock(window_mutex);
+					failed = true;
+				}
+				window_moved.notify_all();
+				throw;
+			}
+			serialized[index].store(true, std::memory_order_release);
+		},
+		[&](size_t) { writeSerialized(); }
+	);
+	writeSerialized();
+
+	// Only close the last node if one has actually been created
+	if (state.area_open) {
+		f.endNode();
+	}
+	return f.error_code == FILE_NO_ERROR;
+}
+
+void IOMapOTBM::serializeTiles(const OTBMSaveChunk &chunk, NodeFileWriteHandle &f) const {
+	OTBMSaveChunk state = chunk;
+	MapIterator it = chunk.begin;
+	for (size_t step = 0; step < chunk.steps; ++step, ++it) {
+		Tile* tile = (*it)->get();
+
+		// Is it an empty tile that we can skip? (Leftovers...)
+		if (!tile || tile->size() == 0) {
+			continue;
+		}
+
+		const Position &pos = tile->getPosition();
+
+		// Decide if newd node should be created
+		if (startsTileArea(state, pos)) {
+			// End last node
+			if (state.area_open) {
+				f.endNode();
+			}
+			state.area_open = true;
+			state.area = Position(pos.x & 0xFF00, pos.y & 0xFF00, pos.z);
+
+			// Start newd node
+			f.addNode(OTBM_TILE_AREA);
+			f.addU16(state.area.x);
+			f.addU16(state.area.y);
+			f.addU8(state.area.z);
+		}
+		serializeTile(tile, f);
+	}
+}
+
+/*
+	Areas are written as a whole, one area node per floor, instead of following
+	the map iterator which switches floors every 4x4 tiles. The bytes of every
+	area node are kept with the map, and tree nodes remember the floors that had
+	tiles replaced since. Saving again only serializes those floors and copies
+	the others, so it takes about as long as the edits were big. Edits that
+	change tiles in place either mark their tiles or drop the kept areas.
+*/
+
+bool IOMapOTBM::saveTileAreas(Map &map, NodeFileWriteHandle &f) {
+	const OTBMSaveCache* previous = map.save_cache.get();
+	if (previous && previous->otbm != version.otbm) {
+		previous = nullptr;
+	}
+
+	const std::vector<MapArea> areas = map.getAreas();
+	const auto areaKey = [](const MapArea &area) {
+		return static_cast<uint32_t>(area.x >> 8 | (area.y >> 8) << 8);
+	};
+
+	std::vector<OTBMSaveCache::Area> serialized(areas.size());
+	rme::parallelFor(
+		areas.size(),
+		[&](size_t index) {
+			const MapArea &area = areas[index];
+			const uint16_t changed = area.node->getChangedFloors();
+			const OTBMSaveCache::Area* saved = nullptr;
+			if (previous) {
+				const auto it = previous->areas.find(areaKey(area));
+				if (it != previous->areas.end()) {
+					saved = &it->second;
+				}
+			}
+
+			std::vector<QTreeNode*> leaves;
+			for (int z = 0; z < rme::MapLayers; ++z) {
+				if (saved && (changed & (1 << z)) == 0) {
+					serialized[index][z] = (*saved)[z];
+					continue;
+				}
+				if (leaves.empty()) {
+					area.node->getLeaves(leaves);
+				}
+				serialized[index][z] = serializeTileArea(area, z, leaves);
+			}
+		},
+		[&](size_t done) {
+			g_gui.SetLoadDone(static_cast<int32_t>(100.0 * done / areas.size()));
+		}
+	);
+
+	auto cache = std::make_unique<OTBMSaveCache>();
+	cache->otbm = version.otbm;
+	cache->areas.reserve(areas.size());
+	for (size_t index = 0; index < areas.size(); ++index) {
+		for (const auto &data : serialized[index]) {
+			if (data) {
+				f.addSerialized(data->data(), data->size());
+			}
+		}
+		cache->areas.emplace(areaKey(areas[index]), std::move(serialized[index]));
+	}
+
+	// The kept areas match the tiles no matter if the file could be written
+	map.save_cache = std::move(cache);
+	map.markSaved();
+	return f.error_code == FILE_NO_ERROR;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> IOMapOTBM::serializeTileArea(const MapArea &area, int z, const std::vector<QTreeNode*> &leaves) const {
+	MemoryNodeFileWriteHandle handle;
+	bool empty = true;
+	for (QTreeNode* leaf : leaves) {
+		Floor* floor = leaf->getFloor(z);
+		if (!floor) {
+			continue;
+		}
+		for (TileLocation &location : floor->locs) {
+			Tile* tile = location.get();
+			// Is it an empty tile that we can skip? (Leftovers...)
+			if (!tile || tile->size() == 0) {
+				continue;
+			}
+			if (empty) {
+				handle.addNode(OTBM_TILE_AREA);
+				handle.addU16(area.x);
+				handle.addU16(area.y);
+				handle.addU8(z);
+				empty = false;
+			}
+			serializeTile(tile, handle);
+		}
+	}
+
+	if (empty) {
+		return nullptr;
+	}
+	handle.endNode();
+	return std::make_shared<const std::vector<uint8_t>>(handle.getMemory(), handle.getMemory() + handle.getSize());
+}
+
+void IOMapOTBM::serializeTile(Tile* save_tile, NodeFileWriteHandle &f) const {
+	const IOMapOTBM &self = *this;
+
+	f.addNode(save_tile->isHouseTile() ? OTBM_HOUSETILE : OTBM_TILE);
+
+	f.addU8(save_tile->getX() & 0xFF);
+	f.addU8(save_tile->getY() & 0xFF);
+
+	if (save_tile->isHouseTile()) {
+		f.addU32(save_tile->getHouseID());
+	}
+
+	if (save_tile->getMapFlags()) {
+		f.addByte(OTBM_ATTR_TILE_FLAGS);
+		f.addU32(save_tile->getMapFlags());
+	}
+
+	// Grounds without an id are left out
+	Item* ground = save_tile->ground;
+	if (ground && ground->getID() != 0) {
+		if (ground->isMetaItem()) {
+			// Do nothing, we don't save metaitems...
+		} else if (ground->hasBorderEquivalent()) {
+			bool found = false;
+			for (Item* item : save_tile->items) {
+				if (item->getGroundEquivalent() == ground->getID()) {
+					// Do nothing
+					// Found equivalent
+					found = true;
+					break;
+				}
+			}
+
+			if (!found) {
+				ground->serializeItemNode_OTBM(self, f);
+			}
+		} else if (ground->isComplex()) {
+			ground->serializeItemNode_OTBM(self, f);
+		} else {
+			f.addByte(OTBM_ATTR_ITEM);
+			ground->serializeItemCompact_OTBM(self, f);
+		}
+	}
+
+	for (Item* item : save_tile->items) {
+		if (!item->isMetaItem()) {
+			if (item->getID() == 0) {
+				continue;
+			}
+			item->serializeItemNode_OTBM(self, f);
+		}
+	}
+	if (!save_tile->zones.empty()) {
+		f.addNode(OTBM_TILE_ZONE);
+		f.addU16(save_tile->zones.size());
+		for (const auto &zoneId : save_tile->zones) {
+			f.addU16(zoneId);
+		}
+		f.endNode();
+	}
+
+	f.endNode();
 }
 
 bool IOMapOTBM::saveSpawns(Map &map, const FileName &dir) {
@@ -1729,7 +2288,7 @@ bool IOMapOTBM::saveSpawns(Map &map, const FileName &dir) {
 	// Create the XML file
 	pugi::xml_document doc;
 	if (saveSpawns(map, doc)) {
-		return doc.save_file(filepath.wc_str(), "\t", pugi::format_default, pugi::encoding_utf8);
+		return saveXmlDocument(doc, filepath);
 	}
 	return false;
 }
@@ -1806,7 +2365,7 @@ bool IOMapOTBM::saveHouses(Map &map, const FileName &dir) {
 	// Create the XML file
 	pugi::xml_document doc;
 	if (saveHouses(map, doc)) {
-		return doc.save_file(filepath.wc_str(), "\t", pugi::format_default, pugi::encoding_utf8);
+		return saveXmlDocument(doc, filepath);
 	}
 	return false;
 }
@@ -1852,7 +2411,7 @@ bool IOMapOTBM::saveZones(Map &map, const FileName &dir) {
 	// Create the XML file
 	pugi::xml_document doc;
 	if (saveZones(map, doc)) {
-		return doc.save_file(filepath.wc_str(), "\t", pugi::format_default, pugi::encoding_utf8);
+		return saveXmlDocument(doc, filepath);
 	}
 	return false;
 }
@@ -1885,7 +2444,7 @@ bool IOMapOTBM::saveSpawnsNpc(Map &map, const FileName &dir) {
 	// Create the XML file
 	pugi::xml_document doc;
 	if (saveSpawnsNpc(map, doc)) {
-		return doc.save_file(filepath.wc_str(), "\t", pugi::format_default, pugi::encoding_utf8);
+		return saveXmlDocument(doc, filepath);
 	}
 	return false;
 }
@@ -19,6 +19,11 @@
 #define RME_OTBM_MAP_IO_H_
 
 #include "iomap.h"
+#include "const.h"
+
+#include <array>
+#include <memory>
+#include <unordered_map>
 
 enum OTBM_ItemAttribute {
 	OTBM_ATTR_DESCRIPTION = 1,
@@ -108,10 +113,27 @@ struct OTBM_HouseTile_coords {
 	uint32_t houseid;
 };
 
+// Tile area nodes of the last save of a map, by area and floor. Floors
+// without tiles have no data.
+struct OTBMSaveCache {
+	using Area = std::array<std::shared_ptr<const std::vector<uint8_t>>, rme::MapLayers>;
+
+	MapVersionID otbm;
+	std::unordered_map<uint32_t, Area> areas;
+};
+
 struct MapVersion;
+struct OTBMNodeSpan;
+struct OTBMTileArea;
+struct OTBMSaveChunk;
+struct MapArea;
+class BinaryNode;
 class NodeFileReadHandle;
 class NodeFileWriteHandle;
+class MappedFile;
 class Map;
+class Tile;
+class QTreeNode;
 
 class IOMapOTBM : public IOMap {
 public:
@@ -123,10 +145,31 @@ public:
 	virtual bool loadMap(Map &map, const FileName &identifier);
 	virtual bool saveMap(Map &map, const FileName &identifier);
 
+	// Tile areas of memory mapped files are decoded on the worker threads, this
+	// switches back to reading the file through a single stream
+	void setParallelLoading(bool enabled) noexcept {
+		parallel_loading = enabled;
+	}
+
+	// Loads the OTBM data of the file once through each path, compares the
+	// resulting maps and describes the outcome in report
+	static bool benchmarkLoad(const FileName &identifier, wxString &report);
+
 protected:
 	static bool getVersionInfo(NodeFileReadHandle* f, MapVersion &out_ver);
 
+	// Reads the OTBM file itself, without houses, spawns and zones
+	bool loadMapFile(Map &map, const FileName &identifier);
 	virtual bool loadMap(Map &map, NodeFileReadHandle &handle);
+	bool loadMap(Map &map, const MappedFile &file, const std::vector<OTBMNodeSpan> &spans);
+	// Reads the root and map data attributes, returns the map data node or nullptr
+	BinaryNode* loadMapHeader(Map &map, NodeFileReadHandle &handle);
+	void loadMapNode(Map &map, BinaryNode* mapNode);
+	// Only reads from the node, so several areas may be decoded at once
+	void decodeTileArea(BinaryNode* mapNode, OTBMTileArea &area) const;
+	void mergeTileArea(Map &map, OTBMTileArea &area);
+	void loadTowns(Map &map, BinaryNode* mapNode);
+	void loadWaypoints(Map &map, BinaryNode* mapNode);
 	bool loadSpawnsMonster(Map &map, const FileName &dir);
 	bool loadSpawnsMonster(Map &map, pugi::xml_document &doc);
 	bool loadHouses(Map &map, const FileName &dir);
@@ -137,6 +180,14 @@ protected:
 	bool loadZones(Map &map, pugi::xml_document &doc);
 
 	virtual bool saveMap(Map &map, NodeFileWriteHandle &handle);
+	// Serializes the tiles on the worker threads, the handle is only written from the calling thread
+	bool saveTiles(Map &map, NodeFileWriteHandle &handle);
+	void serializeTiles(const OTBMSaveChunk &chunk, NodeFileWriteHandle &handle) const;
+	// Writes one tile area node per area and floor, areas without changes since
+	// the last save are copied from the save cache of the map
+	bool saveTileAreas(Map &map, NodeFileWriteHandle &handle);
+	std::shared_ptr<const std::vector<uint8_t>> serializeTileArea(const MapArea &area, int z, const std::vector<QTreeNode*> &leaves) const;
+	void serializeTile(Tile* tile, NodeFileWriteHandle &handle) const;
 	bool saveSpawns(Map &map, const FileName &dir);
 	bool saveSpawns(Map &map, pugi::xml_document &doc);
 	bool saveHouses(Map &map, const FileName &dir);
@@ -145,6 +196,8 @@ protected:
 	bool saveSpawnsNpc(Map &map, pugi::xml_document &doc);
 	bool saveZones(Map &map, const FileName &dir);
 	bool saveZones(Map &map, pugi::xml_document &doc);
+
+	bool parallel_loading = true;
 };
 
 #endif
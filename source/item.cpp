@@ -85,7 +85,7 @@ Item* Item::deepCopy() const {
 	if (copy) {
 		copy->selected = selected;
 		if (attributes) {
-			copy->attributes = newd ItemAttributeMap(*attributes);
+			copy->attributes = newd ItemAttributeList(*attributes);
 		}
 	}
 	return copy;
@@ -158,7 +158,7 @@ void Item::setID(uint16_t new_id) {
 
 void Item::setSubtype(uint16_t _subtype) {
 	subtype = _subtype;
-	setAttribute("subtype", subtype);
+	setAttribute(ItemAttributeKeys::Subtype, subtype);
 }
 
 bool Item::hasSubtype() const {
@@ -268,19 +268,19 @@ double Item::getWeight() const {
 }
 
 void Item::setUniqueID(unsigned short n) {
-	setAttribute("uid", n);
+	setAttribute(ItemAttributeKeys::UniqueId, n);
 }
 
 void Item::setActionID(unsigned short n) {
-	setAttribute("aid", n);
+	setAttribute(ItemAttributeKeys::ActionId, n);
 }
 
 void Item::setText(const std::string &str) {
-	setAttribute("text", str);
+	setAttribute(ItemAttributeKeys::Text, str);
 }
 
 void Item::setDescription(const std::string &str) {
-	setAttribute("desc", str);
+	setAttribute(ItemAttributeKeys::Description, str);
 }
 
 double Item::getWeight() {
@@ -402,7 +402,7 @@ inline int Item::getCount() const {
 }
 
 inline uint16_t Item::getUniqueID() const {
-	const int32_t* a = getIntegerAttribute("uid");
+	const int32_t* a = getIntegerAttribute(ItemAttributeKeys::UniqueId);
 	if (a) {
 		return *a;
 	}
@@ -410,7 +410,7 @@ inline uint16_t Item::getUniqueID() const {
 }
 
 inline uint16_t Item::getActionID() const {
-	const int32_t* a = getIntegerAttribute("aid");
+	const int32_t* a = getIntegerAttribute(ItemAttributeKeys::ActionId);
 	if (a) {
 		return *a;
 	}
@@ -418,7 +418,7 @@ inline uint16_t Item::getActionID() const {
 }
 
 inline std::string Item::getText() const {
-	const std::string* a = getStringAttribute("text");
+	const std::string* a = getStringAttribute(ItemAttributeKeys::Text);
 	if (a) {
 		return *a;
 	}
@@ -426,7 +426,7 @@ inline std::string Item::getText() const {
 }
 
 inline std::string Item::getDescription() const {
-	const std::string* a = getStringAttribute("desc");
+	const std::string* a = getStringAttribute(ItemAttributeKeys::Description);
 	if (a) {
 		return *a;
 	}
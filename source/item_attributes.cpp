@@ -20,14 +20,77 @@
 #include "item_attributes.h"
 #include "filehandle.h"
 
+#include <deque>
+#include <shared_mutex>
+
+namespace {
+	// Stable references, names are only ever added
+	struct AttributeKeyTable {
+		std::shared_mutex mutex;
+		std::deque<std::string> names { "aid", "uid", "text", "desc", "doorid", "depotid", "keyid", "subtype", "destination.x", "destination.y", "destination.z" };
+		std::unordered_map<std::string, ItemAttributeKey> ids;
+
+		AttributeKeyTable() {
+			for (size_t i = 0; i < names.size(); ++i) {
+				ids.emplace(names[i], static_cast<ItemAttributeKey>(i));
+			}
+		}
+	};
+
+	AttributeKeyTable &getAttributeKeyTable() {
+		static AttributeKeyTable table;
+		return table;
+	}
+}
+
+ItemAttributeKey ItemAttributeKeys::intern(const std::string &name) {
+	AttributeKeyTable &table = getAttributeKeyTable();
+	{
+		std::shared_lock lock(table.mutex);
+		const auto it = table.ids.find(name);
+		if (it != table.ids.end()) {
+			return it->second;
+		}
+	}
+
+	std::unique_lock lock(table.mutex);
+	const auto it = table.ids.find(name);
+	if (it != table.ids.end()) {
+		return it->second;
+	}
+	if (table.names.size() >= Invalid) {
+		spdlog::error("[ItemAttributeKeys::intern] Too many different item attribute names, dropping \"{}\"", name);
+		return Invalid;
+	}
+
+	const auto key = static_cast<ItemAttributeKey>(table.names.size());
+	table.names.push_back(name);
+	table.ids.emplace(name, key);
+	return key;
+}
+
+ItemAttributeKey ItemAttributeKeys::find(const std::string &name) {
+	AttributeKeyTable &table = getAttributeKeyTable();
+	std::shared_lock lock(table.mutex);
+	const auto it = table.ids.find(name);
+	return it != table.ids.end() ? it->second : Invalid;
+}
+
+const std::string &ItemAttributeKeys::getName(ItemAttributeKey key) {
+	AttributeKeyTable &table = getAttributeKeyTable();
+	std::shared_lock lock(table.mutex);
+	return table.names[key];
+}
+
 ItemAttributes::ItemAttributes() :
 	attributes(nullptr) {
 	////
 }
 
-ItemAttributes::ItemAttributes(const ItemAttributes &o) {
+ItemAttributes::ItemAttributes(const ItemAttributes &o) :
+	attributes(nullptr) {
 	if (o.attributes) {
-		attributes = newd ItemAttributeMap(*o.attributes);
+		attributes = newd ItemAttributeList(*o.attributes);
 	}
 }
 
@@ -37,7 +100,7 @@ ItemAttributes::~ItemAttributes() {
 
 void ItemAttributes::createAttributes() {
 	if (!attributes) {
-		attributes = newd ItemAttributeMap;
+		attributes = newd ItemAttributeList;
 	}
 }
 
@@ -49,95 +112,137 @@ void ItemAttributes::clearAllAttributes() {
 }
 
 ItemAttributeMap ItemAttributes::getAttributes() const {
+	ItemAttributeMap map;
 	if (attributes) {
-		return *attributes;
+		for (const auto &[key, attribute] : *attributes) {
+			map.emplace(ItemAttributeKeys::getName(key), attribute);
+		}
 	}
-	return ItemAttributeMap();
+	return map;
 }
 
-void ItemAttributes::setAttribute(const std::string &key, const ItemAttribute &value) {
+const ItemAttribute* ItemAttributes::findAttribute(ItemAttributeKey key) const {
+	if (!attributes) {
+		return nullptr;
+	}
+
+	for (const auto &[attributeKey, attribute] : *attributes) {
+		if (attributeKey == key) {
+			return &attribute;
+		}
+	}
+	return nullptr;
+}
+
+ItemAttribute &ItemAttributes::getOrCreateAttribute(ItemAttributeKey key) {
 	createAttributes();
-	(*attributes)[key] = value;
+	for (auto &[attributeKey, attribute] : *attributes) {
+		if (attributeKey == key) {
+			return attribute;
+		}
+	}
+	return attributes->emplace_back(key, ItemAttribute()).second;
+}
+
+void ItemAttributes::setAttribute(ItemAttributeKey key, const ItemAttribute &value) {
+	if (key != ItemAttributeKeys::Invalid) {
+		getOrCreateAttribute(key) = value;
+	}
+}
+
+void ItemAttributes::setAttribute(ItemAttributeKey key, const std::string &value) {
+	if (key != ItemAttributeKeys::Invalid) {
+		getOrCreateAttribute(key).set(value);
+	}
+}
+
+void ItemAttributes::setAttribute(ItemAttributeKey key, int32_t value) {
+	if (key != ItemAttributeKeys::Invalid) {
+		getOrCreateAttribute(key).set(value);
+	}
+}
+
+void ItemAttributes::setAttribute(ItemAttributeKey key, double value) {
+	if (key != ItemAttributeKeys::Invalid) {
+		getOrCreateAttribute(key).set(value);
+	}
+}
+
+void ItemAttributes::setAttribute(ItemAttributeKey key, bool value) {
+	if (key != ItemAttributeKeys::Invalid) {
+		getOrCreateAttribute(key).set(value);
+	}
+}
+
+void ItemAttributes::setAttribute(const std::string &key, const ItemAttribute &value) {
+	setAttribute(ItemAttributeKeys::intern(key), value);
 }
 
 void ItemAttributes::setAttribute(const std::string &key, const std::string &value) {
-	createAttributes();
-	(*attributes)[key].set(value);
+	setAttribute(ItemAttributeKeys::intern(key), value);
 }
 
 void ItemAttributes::setAttribute(const std::string &key, int32_t value) {
-	createAttributes();
-	(*attributes)[key].set(value);
+	setAttribute(ItemAttributeKeys::intern(key), value);
 }
 
 void ItemAttributes::setAttribute(const std::string &key, double value) {
-	createAttributes();
-	(*attributes)[key].set(value);
+	setAttribute(ItemAttributeKeys::intern(key), value);
 }
 
 void ItemAttributes::setAttribute(const std::string &key, bool value) {
-	createAttributes();
-	(*attributes)[key].set(value);
+	setAttribute(ItemAttributeKeys::intern(key), value);
 }
 
-void ItemAttributes::eraseAttribute(const std::string &key) {
+void ItemAttributes::eraseAttribute(ItemAttributeKey key) {
 	if (!attributes) {
 		return;
 	}
 
-	ItemAttributeMap::iterator iter = attributes->find(key);
+	std::erase_if(*attributes, [key](const auto &attribute) { return attribute.first == key; });
+}
 
-	if (iter != attributes->end()) {
-		attributes->erase(iter);
+void ItemAttributes::eraseAttribute(const std::string &key) {
+	const ItemAttributeKey id = ItemAttributeKeys::find(key);
+	if (id != ItemAttributeKeys::Invalid) {
+		eraseAttribute(id);
 	}
 }
 
-const std::string* ItemAttributes::getStringAttribute(const std::string &key) const {
-	if (!attributes) {
-		return nullptr;
-	}
+const std::string* ItemAttributes::getStringAttribute(ItemAttributeKey key) const {
+	const ItemAttribute* attribute = findAttribute(key);
+	return attribute ? attribute->getString() : nullptr;
+}
 
-	ItemAttributeMap::iterator iter = attributes->find(key);
-	if (iter != attributes->end()) {
-		return iter->second.getString();
-	}
-	return nullptr;
+const int32_t* ItemAttributes::getIntegerAttribute(ItemAttributeKey key) const {
+	const ItemAttribute* attribute = findAttribute(key);
+	return attribute ? attribute->getInteger() : nullptr;
 }
 
-const int32_t* ItemAttributes::getIntegerAttribute(const std::string &key) const {
-	if (!attributes) {
-		return nullptr;
-	}
+const double* ItemAttributes::getFloatAttribute(ItemAttributeKey key) const {
+	const ItemAttribute* attribute = findAttribute(key);
+	return attribute ? attribute->getFloat() : nullptr;
+}
 
-	ItemAttributeMap::iterator iter = attributes->find(key);
-	if (iter != attributes->end()) {
-		return iter->second.getInteger();
-	}
-	return nullptr;
+const bool* ItemAttributes::getBooleanAttribute(ItemAttributeKey key) const {
+	const ItemAttribute* attribute = findAttribute(key);
+	return attribute ? attribute->getBoolean() : nullptr;
 }
 
-const double* ItemAttributes::getFloatAttribute(const std::string &key) const {
-	if (!attributes) {
-		return nullptr;
-	}
+const std::string* ItemAttributes::getStringAttribute(const std::string &key) const {
+	return attributes ? getStringAttribute(ItemAttributeKeys::find(key)) : nullptr;
+}
 
-	ItemAttributeMap::iterator iter = attributes->find(key);
-	if (iter != attributes->end()) {
-		return iter->second.getFloat();
-	}
-	return nullptr;
+const int32_t* ItemAttributes::getIntegerAttribute(const std::string &key) const {
+	return attributes ? getIntegerAttribute(ItemAttributeKeys::find(key)) : nullptr;
 }
 
-const bool* ItemAttributes::getBooleanAttribute(const std::string &key) const {
-	if (!attributes) {
-		return nullptr;
-	}
+const double* ItemAttributes::getFloatAttribute(const std::string &key) const {
+	return attributes ? getFloatAttribute(ItemAttributeKeys::find(key)) : nullptr;
+}
 
-	ItemAttributeMap::iterator iter = attributes->find(key);
-	if (iter != attributes->end()) {
-		return iter->second.getBoolean();
-	}
-	return nullptr;
+const bool* ItemAttributes::getBooleanAttribute(const std::string &key) const {
+	return attributes ? getBooleanAttribute(ItemAttributeKeys::find(key)) : nullptr;
 }
 
 bool ItemAttributes::hasStringAttribute(const std::string &key) const {
@@ -291,7 +396,7 @@ bool ItemAttributes::unserializeAttributeMap(const IOMap &maphandle, BinaryNode*
 			if (!attrib.unserialize(maphandle, stream)) {
 				return false;
 			}
-			(*attributes)[key] = attrib;
+			setAttribute(key, attrib);
 		}
 	}
 	return true;
@@ -301,17 +406,27 @@ void ItemAttributes::serializeAttributeMap(const IOMap &maphandle, NodeFileWrite
 	// Maximum of 65535 attributes per item
 	f.addU16(std::min((size_t)0xFFFF, attributes->size()));
 
-	ItemAttributeMap::const_iterator attribute = attributes->begin();
+	// Written in the order of their names, like they were stored before
+	std::vector<std::pair<const std::string*, const ItemAttribute*>> sorted;
+	sorted.reserve(attributes->size());
+	for (const auto &[key, attribute] : *attributes) {
+		sorted.emplace_back(&ItemAttributeKeys::getName(key), &attribute);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const auto &first, const auto &second) {
+		return *first.first < *second.first;
+	});
+
+	auto attribute = sorted.begin();
 	int i = 0;
-	while (attribute != attributes->end() && i <= 0xFFFF) {
-		const std::string &key = attribute->first;
+	while (attribute != sorted.end() && i <= 0xFFFF) {
+		const std::string &key = *attribute->first;
 		if (key.size() > 0xFFFF) {
 			f.addString(key.substr(0, 65535));
 		} else {
 			f.addString(key);
 		}
 
-		attribute->second.serialize(maphandle, f);
+		attribute->second->serialize(maphandle, f);
 		++attribute, ++i;
 	}
 }
@@ -20,6 +20,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "filehandle.h"
 
@@ -70,6 +71,37 @@ private:
 
 typedef std::map<std::string, ItemAttribute> ItemAttributeMap;
 
+// Attribute names are interned, items only store the id of a name. The names
+// the editor uses itself have fixed ids, so looking them up needs no string.
+typedef uint16_t ItemAttributeKey;
+
+namespace ItemAttributeKeys {
+	enum : ItemAttributeKey {
+		ActionId,
+		UniqueId,
+		Text,
+		Description,
+		DoorId,
+		DepotId,
+		KeyId,
+		Subtype,
+		DestinationX,
+		DestinationY,
+		DestinationZ,
+		// Ids from here on are handed out for other names as they are seen
+		FirstCustom,
+		Invalid = 0xFFFF
+	};
+
+	// Returns the id of the name, interning it first if needed
+	ItemAttributeKey intern(const std::string &name);
+	// Returns Invalid for names that were never interned
+	ItemAttributeKey find(const std::string &name);
+	const std::string &getName(ItemAttributeKey key);
+}
+
+typedef std::vector<std::pair<ItemAttributeKey, ItemAttribute>> ItemAttributeList;
+
 class ItemAttributes {
 public:
 	ItemAttributes();
@@ -86,12 +118,21 @@ public:
 	void setAttribute(const std::string &key, int32_t value);
 	void setAttribute(const std::string &key, double value);
 	void setAttribute(const std::string &key, bool set);
+	void setAttribute(ItemAttributeKey key, const ItemAttribute &attr);
+	void setAttribute(ItemAttributeKey key, const std::string &value);
+	void setAttribute(ItemAttributeKey key, int32_t value);
+	void setAttribute(ItemAttributeKey key, double value);
+	void setAttribute(ItemAttributeKey key, bool set);
 
 	// returns nullptr if the attribute is not set
 	const std::string* getStringAttribute(const std::string &key) const;
 	const int32_t* getIntegerAttribute(const std::string &key) const;
 	const double* getFloatAttribute(const std::string &key) const;
 	const bool* getBooleanAttribute(const std::string &key) const;
+	const std::string* getStringAttribute(ItemAttributeKey key) const;
+	const int32_t* getIntegerAttribute(ItemAttributeKey key) const;
+	const double* getFloatAttribute(ItemAttributeKey key) const;
+	const bool* getBooleanAttribute(ItemAttributeKey key) const;
 
 	// Returns true if the attribute (of that type) exists
 	bool hasStringAttribute(const std::string &key) const;
@@ -100,14 +141,18 @@ public:
 	bool hasBooleanAttribute(const std::string &key) const;
 
 	void eraseAttribute(const std::string &key);
+	void eraseAttribute(ItemAttributeKey key);
 
 	void clearAllAttributes();
 	ItemAttributeMap getAttributes() const;
 
 protected:
-	ItemAttributeMap* attributes;
+	// nullptr while the item has no attributes, which is the common case
+	ItemAttributeList* attributes;
 
 	void createAttributes();
+	const ItemAttribute* findAttribute(ItemAttributeKey key) const;
+	ItemAttribute &getOrCreateAttribute(ItemAttributeKey key);
 };
 
 #endif
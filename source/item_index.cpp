@@ -0,0 +1,231 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "item_index.h"
+#include "basemap.h"
+#include "complexitem.h"
+#include "parallel.h"
+
+#include <mutex>
+
+namespace {
+	// Ground, items and everything inside containers, like foreach_ItemOnMap
+	template <typename Callback>
+	void forEachItem(const Tile* tile, Callback &&callback) {
+		const auto visit = [&callback](const auto &self, Item* item) -> void {
+			callback(item);
+			if (Container* container = dynamic_cast<Container*>(item)) {
+				for (Item* content : container->getVector()) {
+					self(self, content);
+				}
+			}
+		};
+
+		if (tile->ground) {
+			visit(visit, tile->ground);
+		}
+		for (Item* item : tile->items) {
+			visit(visit, item);
+		}
+	}
+}
+
+uint64_t ItemIndex::pack(const Position &position) noexcept {
+	return static_cast<uint64_t>(position.z) << 32 | static_cast<uint64_t>(position.x & 0xFFFF) << 16 | static_cast<uint64_t>(position.y & 0xFFFF);
+}
+
+Position ItemIndex::unpack(uint64_t key) noexcept {
+	return Position(static_cast<int>(key >> 16 & 0xFFFF), static_cast<int>(key & 0xFFFF), static_cast<int>(key >> 32));
+}
+
+uint16_t ItemIndex::getKey(const Item* item, Kind kind) {
+	switch (kind) {
+		case ItemId:
+			return item->getID();
+		case ActionId:
+			return item->getActionID();
+		case UniqueId:
+			return item->getUniqueID();
+		default:
+			return 0;
+	}
+}
+
+std::vector<uint32_t> ItemIndex::getKeys(const Tile* tile) {
+	// A tile rarely holds more than a handful of them
+	std::vector<uint32_t> keys;
+	if (!tile) {
+		return keys;
+	}
+
+	forEachItem(tile, [&keys](const Item* item) {
+		keys.push_back(static_cast<uint32_t>(ItemId) << 16 | item->getID());
+		if (const uint16_t actionId = item->getActionID()) {
+			keys.push_back(static_cast<uint32_t>(ActionId) << 16 | actionId);
+		}
+		if (const uint16_t uniqueId = item->getUniqueID()) {
+			keys.push_back(static_cast<uint32_t>(UniqueId) << 16 | uniqueId);
+		}
+	});
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	return keys;
+}
+
+void ItemIndex::compact(Entries &entries) {
+	std::vector<uint64_t> &positions = entries.positions;
+	const auto middle = positions.end() - entries.unchecked;
+	std::sort(middle, positions.end());
+	std::inplace_merge(positions.begin(), middle, positions.end());
+	positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+	entries.unchecked = 0;
+}
+
+void ItemIndex::build(BaseMap &map) {
+	clear();
+
+	const std::vector<MapArea> areas = map.getAreas();
+	std::mutex mutex;
+	rme::parallelFor(areas.size(), [&](size_t index) {
+		std::array<std::unordered_map<uint16_t, std::vector<uint64_t>>, KindCount> found;
+
+		std::vector<QTreeNode*> leaves;
+		areas[index].node->getLeaves(leaves);
+		for (QTreeNode* leaf : leaves) {
+			for (int z = 0; z < rme::MapLayers; ++z) {
+				Floor* floor = leaf->getFloor(z);
+				if (!floor) {
+					continue;
+				}
+				for (TileLocation &location : floor->locs) {
+					const Tile* tile = location.get();
+					if (!tile) {
+						continue;
+					}
+
+					const uint64_t position = pack(tile->getPosition());
+					for (const uint32_t key : getKeys(tile)) {
+						found[key >> 16][key & 0xFFFF].push_back(position);
+					}
+				}
+			}
+		}
+
+		std::scoped_lock lock(mutex);
+		for (int kind = 0; kind < KindCount; ++kind) {
+			for (auto &[key, positions] : found[kind]) {
+				Entries &entries = tables[kind][key];
+				entries.positions.insert(entries.positions.end(), positions.begin(), positions.end());
+				entries.unchecked += positions.size();
+			}
+		}
+	});
+
+	built = true;
+}
+
+void ItemIndex::clear() {
+	for (Table &table : tables) {
+		table.clear();
+	}
+	built = false;
+}
+
+void ItemIndex::replaceTile(const Tile* old_tile, const Tile* new_tile) {
+	if (!built || !new_tile) {
+		return;
+	}
+
+	// Selecting, undoing and redoing mostly swap in tiles holding the same ids,
+	// those are indexed already
+	const std::vector<uint32_t> old_keys = getKeys(old_tile);
+	const std::vector<uint32_t> new_keys = getKeys(new_tile);
+	std::vector<uint32_t> added;
+	std::set_difference(new_keys.begin(), new_keys.end(), old_keys.begin(), old_keys.end(), std::back_inserter(added));
+
+	const uint64_t position = pack(new_tile->getPosition());
+	for (const uint32_t key : added) {
+		Entries &entries = tables[key >> 16][key & 0xFFFF];
+		entries.positions.push_back(position);
+		++entries.unchecked;
+		// A tile losing and regaining an id appends it again, sorting drops the copies
+		if (entries.unchecked > std::max(MinUnchecked, entries.positions.size() - entries.unchecked)) {
+			compact(entries);
+		}
+	}
+}
+
+bool ItemIndex::find(BaseMap &map, Kind kind, uint16_t key, const Visitor &visitor) {
+	const auto it = tables[kind].find(key);
+	if (it == tables[kind].end()) {
+		return true;
+	}
+
+	Entries &entries = it->second;
+	std::vector<uint64_t> &positions = entries.positions;
+	if (entries.unchecked > 0) {
+		compact(entries);
+	}
+
+	// Drops the positions whose tile no longer holds a matching item
+	bool proceed = true;
+	auto kept = positions.begin();
+	auto next = positions.begin();
+	for (; next != positions.end() && proceed; ++next) {
+		Tile* tile = map.getTile(unpack(*next));
+		if (!tile) {
+			continue;
+		}
+
+		bool matched = false;
+		forEachItem(tile, [&](Item* item) {
+			if (proceed && getKey(item, kind) == key) {
+				proceed = visitor(tile, item);
+				matched = true;
+			}
+		});
+		if (matched) {
+			*kept++ = *next;
+		}
+	}
+	positions.erase(kept, next);
+
+	if (positions.empty()) {
+		tables[kind].erase(it);
+	}
+	return proceed;
+}
+
+bool ItemIndex::find(BaseMap &map, Kind kind, const std::function<bool(uint16_t)> &filter, const Visitor &visitor) {
+	std::vector<uint16_t> keys;
+	for (const auto &[key, entries] : tables[kind]) {
+		if (filter(key)) {
+			keys.push_back(key);
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+
+	for (const uint16_t key : keys) {
+		if (!find(map, kind, key, visitor)) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_ITEM_INDEX_H_
+#define RME_ITEM_INDEX_H_
+
+#include "position.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class BaseMap;
+class Item;
+class Tile;
+
+// Positions of the tiles holding items with a given item, action or unique id,
+// container contents included. A tile put on the map only appends its position
+// for the ids the tile it replaced didn't hold. Entries left behind for ids that
+// are gone are dropped once a search finds them outdated, so an entry never holds
+// more than the distinct tiles that ever had the id.
+class ItemIndex {
+public:
+	enum Kind {
+		ItemId,
+		ActionId,
+		UniqueId,
+		KindCount
+	};
+
+	// Called for every item found, returning false ends the search
+	using Visitor = std::function<bool(Tile*, Item*)>;
+
+	bool isBuilt() const noexcept {
+		return built;
+	}
+
+	// Indexes every tile of the map, one tile area per task on the worker threads
+	void build(BaseMap &map);
+	// Forgets everything, tiles replaced afterwards are ignored until the next build
+	void clear();
+
+	// old_tile was replaced by new_tile, either may be nullptr
+	void replaceTile(const Tile* old_tile, const Tile* new_tile);
+
+	// Visits the items whose id of that kind is key, ordered by floor and position
+	bool find(BaseMap &map, Kind kind, uint16_t key, const Visitor &visitor);
+	// Same for every key accepted by filter, in increasing key order
+	bool find(BaseMap &map, Kind kind, const std::function<bool(uint16_t)> &filter, const Visitor &visitor);
+
+private:
+	struct Entries {
+		// Packed positions, a tile appears once per key even if it holds several matching items
+		std::vector<uint64_t> positions;
+		// Positions appended since the entry was last sorted, the ones before are sorted
+		size_t unchecked = 0;
+	};
+
+	// Entries are sorted again once more positions were appended than were sorted,
+	// but not while they are smaller than this
+	static constexpr size_t MinUnchecked = 64;
+
+	using Table = std::unordered_map<uint16_t, Entries>;
+
+	static uint64_t pack(const Position &position) noexcept;
+	static Position unpack(uint64_t key) noexcept;
+	static uint16_t getKey(const Item* item, Kind kind);
+	// Every key found on the tile once, kind in the upper half, sorted
+	static std::vector<uint32_t> getKeys(const Tile* tile);
+	// Sorts the appended positions into the rest, dropping duplicates
+	static void compact(Entries &entries);
+
+	std::array<Table, KindCount> tables;
+	bool built = false;
+};
+
+#endif
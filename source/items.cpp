@@ -23,11 +23,37 @@
 #include "items.h"
 #include "item.h"
 #include "sprite_appearances.h"
+#include "appearance_data.h"
+#include "startup_cache.h"
 
-#include <appearances.pb.h>
+#include <chrono>
 
 ItemDatabase g_items;
 
+namespace {
+	// Same conversions pugixml applies to attribute values
+	bool isXmlHexNumber(const std::string &value) {
+		const size_t start = !value.empty() && (value[0] == '-' || value[0] == '+') ? 1 : 0;
+		return value.size() > start + 1 && value[start] == '0' && (value[start + 1] == 'x' || value[start + 1] == 'X');
+	}
+
+	int xmlToInt(const std::string &value) {
+		return static_cast<int>(std::strtol(value.c_str(), nullptr, isXmlHexNumber(value) ? 16 : 10));
+	}
+
+	unsigned int xmlToUInt(const std::string &value) {
+		return static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, isXmlHexNumber(value) ? 16 : 10));
+	}
+
+	bool xmlToBool(const std::string &value) {
+		if (value.empty()) {
+			return false;
+		}
+		const char first = value[0];
+		return first == '1' || first == 't' || first == 'T' || first == 'y' || first == 'Y';
+	}
+}
+
 bool ItemType::isFloorChange() const noexcept {
 	return floorChange
 		|| floorChangeDown
@@ -453,289 +479,189 @@ bool ItemDatabase::loadFromOtb(const FileName &datafile, wxString &error, wxArra
 }
 #endif
 
-bool ItemDatabase::loadFromProtobuf(wxString &error, wxArrayString &warnings, canary::protobuf::appearances::Appearances &appearances) {
-	using namespace canary::protobuf::appearances;
-
-	for (uint16_t it = 0; it < static_cast<uint16_t>(appearances.object_size()); ++it) {
-		Appearance object = appearances.object(it);
-
-		// This scenario should never happen but on custom assets this can break the loader.
-		if (!object.has_flags()) {
-			spdlog::error("[ItemDatabase::loadFromProtobuf] - Item with id {} is invalid and was ignored.", object.id());
-			wxLogError("[ItemDatabase::loadFromProtobuf] - Item with id %i is invalid and was ignored.", object.id());
-			continue;
-		}
-
-		if (object.id() >= items.size()) {
-			items.resize(object.id() + 1);
-		}
-
-		if (!object.has_id()) {
-			continue;
+bool ItemDatabase::loadFromAppearances(const std::vector<ItemAppearance> &appearances, wxString &error, wxArrayString &warnings) {
+	for (const ItemAppearance &appearance : appearances) {
+		if (appearance.id >= items.size()) {
+			items.resize(appearance.id + 1);
 		}
 
 		auto t = std::make_shared<ItemType>();
-		t->id = static_cast<uint16_t>(object.id());
+		t->id = appearance.id;
 		// Save max item id from the object size iteraction
 		if (maxItemId < t->id) {
 			maxItemId = t->id;
-			spdlog::debug("[ItemDatabase::loadFromProtobuf] - Loading item with id {}.", t->id);
-		}
-		t->clientID = static_cast<uint16_t>(object.id());
-		t->name = object.name();
-		t->description = object.description();
-
-		if (object.flags().container()) {
-			t->type = ITEM_TYPE_CONTAINER;
-			t->group = ITEM_GROUP_CONTAINER;
-		} else if (object.flags().has_bank()) {
-			t->group = ITEM_GROUP_GROUND;
-		} else if (object.flags().liquidcontainer()) {
-			t->group = ITEM_GROUP_FLUID;
-		} else if (object.flags().liquidpool()) {
-			t->group = ITEM_GROUP_SPLASH;
-		}
-
-		if (object.flags().has_clip() || object.flags().has_top() || object.flags().has_bottom()) {
-			t->alwaysOnBottom = true;
-		}
-
-		if (object.flags().clip()) {
-			t->alwaysOnTopOrder = 1;
-		} else if (object.flags().top()) {
-			t->alwaysOnTopOrder = 3;
-		} else if (object.flags().bottom()) {
-			t->alwaysOnTopOrder = 2;
+			spdlog::debug("[ItemDatabase::loadFromAppearances] - Loading item with id {}.", t->id);
 		}
+		t->clientID = appearance.id;
+		t->name = appearance.name;
+		t->description = appearance.description;
+		t->type = appearance.type;
+		t->group = appearance.group;
+		t->alwaysOnBottom = appearance.hasFlag(APPEARANCE_ALWAYS_ON_BOTTOM);
+		t->alwaysOnTopOrder = appearance.alwaysOnTopOrder;
 
 		// now lets parse sprite data
-		t->m_animationPhases.clear();
-
-		for (const auto &framegroup : object.frame_group()) {
-			const auto &frameGroupType = framegroup.fixed_frame_group();
-			const auto &spriteInfo = framegroup.sprite_info();
-			const auto &animation = spriteInfo.animation();
-			const auto &sprites = spriteInfo.sprite_id();
-
-			t->pattern_width = spriteInfo.pattern_width();
-			t->pattern_height = spriteInfo.pattern_height();
-			t->pattern_depth = spriteInfo.pattern_depth();
-			t->layers = spriteInfo.layers();
-
-			if (animation.sprite_phase().size() > 0) {
-				const auto &spritesPhases = animation.sprite_phase();
-				t->start_frame = animation.default_start_phase();
-				t->loop_count = animation.loop_count();
-				t->async_animation = !animation.synchronized();
-				for (int k = 0; k < spritesPhases.size(); k++) {
-					t->m_animationPhases.push_back(std::pair<int, int>(static_cast<int>(spritesPhases[k].duration_min()), static_cast<int>(spritesPhases[k].duration_max())));
-				}
-			}
-
-			t->sprite_id = spriteInfo.sprite_id(0);
-
-			t->m_sprites.clear();
-			t->m_sprites.resize(sprites.size());
-			for (int i = 0; i < sprites.size(); i++) {
-				t->m_sprites[i] = sprites[i];
-			}
-		}
-
-		t->noMoveAnimation = object.flags().no_movement_animation();
-		t->isCorpse = object.flags().corpse() || object.flags().player_corpse();
-		t->forceUse = object.flags().forceuse();
-		t->hasHeight = object.flags().has_height();
-		t->unpassable = object.flags().unpass();
-		t->blockMissiles = object.flags().unsight();
-		t->blockPathfinder = object.flags().avoid();
-		t->pickupable = object.flags().take();
-		t->moveable = object.flags().unmove() == false;
-		t->canReadText = (object.flags().has_lenshelp() && object.flags().lenshelp().id() == 1112) || (object.flags().has_write() && object.flags().write().max_text_length() != 0) || (object.flags().has_write_once() && object.flags().write_once().max_text_length_once() != 0);
-		t->canReadText = object.flags().has_write() || object.flags().has_write_once();
-		t->isHangable = object.flags().hang();
-		t->stackable = object.flags().cumulative();
-		t->isPodium = object.flags().show_off_socket();
-		t->rotable = object.flags().rotate();
-		t->ignoreLook = object.flags().ignore_look();
-		t->hasElevation = object.flags().has_height();
-
-		if (object.flags().has_hook()) {
-			t->hook = object.flags().hook().direction() == HOOK_TYPE_SOUTH ? ITEM_HOOK_SOUTH : ITEM_HOOK_EAST;
-		}
+		const AppearanceSprites &sprites = appearance.sprites;
+		t->pattern_width = sprites.pattern_width;
+		t->pattern_height = sprites.pattern_height;
+		t->pattern_depth = sprites.pattern_depth;
+		t->layers = sprites.layers;
+		t->start_frame = sprites.start_phase;
+		t->loop_count = sprites.loop_count;
+		t->async_animation = sprites.async_animation;
+		t->m_animationPhases = sprites.phases;
+		t->sprite_id = appearance.sprite_id;
+		t->m_sprites.assign(sprites.sprite_ids.begin(), sprites.sprite_ids.end());
+
+		t->noMoveAnimation = appearance.hasFlag(APPEARANCE_NO_MOVE_ANIMATION);
+		t->isCorpse = appearance.hasFlag(APPEARANCE_CORPSE);
+		t->forceUse = appearance.hasFlag(APPEARANCE_FORCE_USE);
+		t->hasHeight = appearance.hasFlag(APPEARANCE_HAS_HEIGHT);
+		t->unpassable = appearance.hasFlag(APPEARANCE_UNPASSABLE);
+		t->blockMissiles = appearance.hasFlag(APPEARANCE_BLOCK_MISSILES);
+		t->blockPathfinder = appearance.hasFlag(APPEARANCE_BLOCK_PATHFINDER);
+		t->pickupable = appearance.hasFlag(APPEARANCE_PICKUPABLE);
+		t->moveable = appearance.hasFlag(APPEARANCE_MOVEABLE);
+		t->canReadText = appearance.hasFlag(APPEARANCE_READABLE);
+		t->isHangable = appearance.hasFlag(APPEARANCE_HANGABLE);
+		t->stackable = appearance.hasFlag(APPEARANCE_STACKABLE);
+		t->isPodium = appearance.hasFlag(APPEARANCE_PODIUM);
+		t->rotable = appearance.hasFlag(APPEARANCE_ROTATABLE);
+		t->ignoreLook = appearance.hasFlag(APPEARANCE_IGNORE_LOOK);
+		t->hasElevation = t->hasHeight;
+		t->hook = appearance.hook;
 
 		g_gui.gfx.loadItemSpriteMetadata(t, error, warnings);
 		t->sprite = static_cast<GameSprite*>(g_gui.gfx.getSprite(t->id));
 		if (t->sprite) {
-			t->sprite->minimap_color = object.flags().has_automap() ? static_cast<uint16_t>(object.flags().automap().color()) : 0;
-			t->sprite->draw_height = object.flags().has_height() ? static_cast<uint16_t>(object.flags().height().elevation()) : 0;
-			if (object.flags().has_shift()) {
-				t->sprite->draw_offset = wxPoint(object.flags().shift().x(), object.flags().shift().y());
+			t->sprite->minimap_color = appearance.minimap_color;
+			t->sprite->draw_height = appearance.draw_height;
+			if (appearance.hasFlag(APPEARANCE_SHIFT)) {
+				t->sprite->draw_offset = wxPoint(appearance.shift_x, appearance.shift_y);
 			}
 
-			if (object.flags().has_light()) {
-				t->sprite->light.color = object.flags().light().color();
-				t->sprite->light.intensity = object.flags().light().brightness();
+			if (appearance.hasFlag(APPEARANCE_LIGHT)) {
+				t->sprite->light.color = appearance.light_color;
+				t->sprite->light.intensity = appearance.light_intensity;
 				t->sprite->has_light = true;
 			}
 		}
 
-		if (t) {
-			if (items[t->id]) {
-				wxLogWarning("appearances.dat: Duplicate items");
-				items[t->id].reset();
-			}
-			items.set(t->id, t);
+		if (items[t->id]) {
+			wxLogWarning("appearances.dat: Duplicate items");
+			items[t->id].reset();
 		}
+		items.set(t->id, t);
 	}
 
-	spdlog::debug("[ItemDatabase::loadFromProtobuf] - Last loaded item: {}", maxItemId);
+	spdlog::debug("[ItemDatabase::loadFromAppearances] - Last loaded item: {}", maxItemId);
 	return true;
 }
 
-bool ItemDatabase::loadItemFromGameXml(pugi::xml_node itemNode, uint16_t id) {
+bool ItemDatabase::loadItemFromGameXml(const GameXmlItem &entry, uint16_t id) {
 	if (!(id >= LIQUID_FIRST && id <= LIQUID_LAST) && !isValidID(id)) {
 		return false;
 	}
 
 	auto &item = getItemType(id);
-	item.name = itemNode.attribute("name").as_string();
-	item.editorsuffix = itemNode.attribute("editorsuffix").as_string();
-
-	pugi::xml_attribute attribute;
-	for (auto itemAttributesNode = itemNode.first_child(); itemAttributesNode; itemAttributesNode = itemAttributesNode.next_sibling()) {
-		if (!(attribute = itemAttributesNode.attribute("key"))) {
-			continue;
-		}
+	item.name = entry.name;
+	item.editorsuffix = entry.editorSuffix;
 
-		std::string key = attribute.as_string();
-		to_lower_str(key);
+	for (const auto &[key, value] : entry.attributes) {
 		if (key == "type") {
-			if (!(attribute = itemAttributesNode.attribute("value"))) {
-				continue;
-			}
-
-			std::string typeValue = attribute.as_string();
-			to_lower_str(key);
-			if (typeValue == "depot") {
+			if (value == "depot") {
 				item.type = ITEM_TYPE_DEPOT;
-			} else if (typeValue == "mailbox") {
+			} else if (value == "mailbox") {
 				item.type = ITEM_TYPE_MAILBOX;
-			} else if (typeValue == "trashholder") {
+			} else if (value == "trashholder") {
 				item.type = ITEM_TYPE_TRASHHOLDER;
-			} else if (typeValue == "container") {
+			} else if (value == "container") {
 				item.type = ITEM_TYPE_CONTAINER;
-			} else if (typeValue == "door") {
+			} else if (value == "door") {
 				item.type = ITEM_TYPE_DOOR;
-			} else if (typeValue == "magicfield") {
+			} else if (value == "magicfield") {
 				item.group = ITEM_GROUP_MAGICFIELD;
 				item.type = ITEM_TYPE_MAGICFIELD;
-			} else if (typeValue == "teleport") {
+			} else if (value == "teleport") {
 				item.type = ITEM_TYPE_TELEPORT;
-			} else if (typeValue == "bed") {
+			} else if (value == "bed") {
 				item.type = ITEM_TYPE_BED;
-			} else if (typeValue == "key") {
+			} else if (value == "key") {
 				item.type = ITEM_TYPE_KEY;
 			}
 		} else if (key == "name") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.name = attribute.as_string();
-			}
+			item.name = value;
 		} else if (key == "description") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.description = attribute.as_string();
-			}
+			item.description = value;
 		} else if (key == "runespellName") {
 			/*if((attribute = itemAttributesNode.attribute("value"))) {
 				it.runeSpellName = attribute.as_string();
 			}*/
 		} else if (key == "weight") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.weight = attribute.as_int() / 100.f;
-			}
+			item.weight = xmlToInt(value) / 100.f;
 		} else if (key == "armor") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.armor = attribute.as_int();
-			}
+			item.armor = xmlToInt(value);
 		} else if (key == "defense") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.defense = attribute.as_int();
-			}
+			item.defense = xmlToInt(value);
 		} else if (key == "rotateto") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.rotateTo = attribute.as_uint();
-			}
+			item.rotateTo = xmlToUInt(value);
 		} else if (key == "containersize") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.volume = attribute.as_uint();
-			}
+			item.volume = xmlToUInt(value);
 		} else if (key == "readable") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.canReadText = attribute.as_bool();
-			}
+			item.canReadText = xmlToBool(value);
 		} else if (key == "writeable") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.canWriteText = item.canReadText = attribute.as_bool();
-			}
+			item.canWriteText = item.canReadText = xmlToBool(value);
 		} else if (key == "decayto") {
 			item.decays = true;
 		} else if (key == "maxtextlen" || key == "maxtextlength") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.maxTextLen = attribute.as_uint();
-				item.canReadText = item.maxTextLen > 0;
-			}
+			item.maxTextLen = xmlToUInt(value);
+			item.canReadText = item.maxTextLen > 0;
 		} else if (key == "writeonceitemid") {
 			/*if((attribute = itemAttributesNode.attribute("value"))) {
 				it.writeOnceItemId = pugi::cast<int32_t>(attribute.value());
 			}*/
 		} else if (key == "allowdistread") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.allowDistRead = attribute.as_bool();
-			}
+			item.allowDistRead = xmlToBool(value);
 		} else if (key == "charges") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				item.charges = attribute.as_uint();
-				item.extra_chargeable = true;
-			}
+			item.charges = xmlToUInt(value);
+			item.extra_chargeable = true;
 		} else if (key == "floorchange") {
-			if ((attribute = itemAttributesNode.attribute("value"))) {
-				std::string value = attribute.as_string();
-				if (value == "down") {
-					item.floorChangeDown = true;
-					item.floorChange = true;
-				} else if (value == "north") {
-					item.floorChangeNorth = true;
-					item.floorChange = true;
-				} else if (value == "south") {
-					item.floorChangeSouth = true;
-					item.floorChange = true;
-				} else if (value == "west") {
-					item.floorChangeWest = true;
-					item.floorChange = true;
-				} else if (value == "east") {
-					item.floorChangeEast = true;
-					item.floorChange = true;
-				} else if (value == "northex") {
-					item.floorChange = true;
-				} else if (value == "southex") {
-					item.floorChange = true;
-				} else if (value == "westex") {
-					item.floorChange = true;
-				} else if (value == "eastex") {
-					item.floorChange = true;
-				} else if (value == "southalt") {
-					item.floorChange = true;
-				} else if (value == "eastalt") {
-					item.floorChange = true;
-				}
+			if (value == "down") {
+				item.floorChangeDown = true;
+				item.floorChange = true;
+			} else if (value == "north") {
+				item.floorChangeNorth = true;
+				item.floorChange = true;
+			} else if (value == "south") {
+				item.floorChangeSouth = true;
+				item.floorChange = true;
+			} else if (value == "west") {
+				item.floorChangeWest = true;
+				item.floorChange = true;
+			} else if (value == "east") {
+				item.floorChangeEast = true;
+				item.floorChange = true;
+			} else if (value == "northex") {
+				item.floorChange = true;
+			} else if (value == "southex") {
+				item.floorChange = true;
+			} else if (value == "westex") {
+				item.floorChange = true;
+			} else if (value == "eastex") {
+				item.floorChange = true;
+			} else if (value == "southalt") {
+				item.floorChange = true;
+			} else if (value == "eastalt") {
+				item.floorChange = true;
 			}
 		}
 	}
 	return true;
 }
 
-bool ItemDatabase::loadFromGameXml(const FileName &identifier, wxString &error, wxArrayString &warnings) {
+bool ItemDatabase::parseGameXml(const FileName &datafile, std::vector<GameXmlItem> &entries, wxString &error) {
 	pugi::xml_document doc;
-	const auto result = doc.load_file(identifier.GetFullPath().mb_str());
+	const auto result = doc.load_file(datafile.GetFullPath().mb_str());
 	if (!result) {
 		error = "Could not load items.xml (Syntax error?)";
 		return false;
@@ -752,29 +678,112 @@ bool ItemDatabase::loadFromGameXml(const FileName &identifier, wxString &error,
 			continue;
 		}
 
-		uint16_t fromId = 0;
-		uint16_t toId = 0;
+		GameXmlItem &entry = entries.emplace_back();
 		if (const auto attribute = itemNode.attribute("id")) {
-			fromId = toId = attribute.as_uint();
+			entry.fromId = entry.toId = attribute.as_uint();
 		} else {
-			fromId = itemNode.attribute("fromid").as_uint();
-			toId = itemNode.attribute("toid").as_uint();
+			entry.fromId = itemNode.attribute("fromid").as_uint();
+			entry.toId = itemNode.attribute("toid").as_uint();
+		}
+
+		if (entry.fromId == 0 || entry.toId == 0) {
+			error = wxString::Format("Could not read item id from item node, fromid %d, toid %d.", entry.fromId, entry.toId);
+			entries.pop_back();
+			return false;
+		}
+
+		entry.name = itemNode.attribute("name").as_string();
+		entry.editorSuffix = itemNode.attribute("editorsuffix").as_string();
+
+		for (auto itemAttributesNode = itemNode.first_child(); itemAttributesNode; itemAttributesNode = itemAttributesNode.next_sibling()) {
+			const pugi::xml_attribute keyAttribute = itemAttributesNode.attribute("key");
+			if (!keyAttribute) {
+				continue;
+			}
+
+			std::string key = keyAttribute.as_string();
+			to_lower_str(key);
+			if (const pugi::xml_attribute valueAttribute = itemAttributesNode.attribute("value")) {
+				entry.attributes.emplace_back(key, valueAttribute.as_string());
+			} else if (key == "decayto") {
+				entry.attributes.emplace_back(key, std::string());
+			}
 		}
+	}
+	return true;
+}
 
-		if (fromId == 0 || toId == 0) {
-			error = wxString::Format("Could not read item id from item node, fromid %d, toid %d.", fromId, toId);
+bool ItemDatabase::readGameXmlCache(BinaryNode* root, std::vector<GameXmlItem> &entries) {
+	for (BinaryNode* itemNode = root->getChild(); itemNode != nullptr; itemNode = itemNode->advance()) {
+		GameXmlItem &entry = entries.emplace_back();
+		uint8_t type = 0;
+		uint16_t attributes = 0;
+		if (!itemNode->getU8(type) || !itemNode->getU16(entry.fromId) || !itemNode->getU16(entry.toId) || !itemNode->getString(entry.name) || !itemNode->getString(entry.editorSuffix) || !itemNode->getU16(attributes)) {
+			entries.clear();
 			return false;
 		}
 
-		for (auto id = fromId; id <= toId; ++id) {
-			if (!loadItemFromGameXml(itemNode, id)) {
+		entry.attributes.resize(attributes);
+		for (auto &[key, value] : entry.attributes) {
+			if (!itemNode->getString(key) || !itemNode->getString(value)) {
+				entries.clear();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void ItemDatabase::writeGameXmlCache(NodeFileWriteHandle &writer, const std::vector<GameXmlItem> &entries) {
+	writer.addNode(0);
+	for (const GameXmlItem &entry : entries) {
+		writer.addNode(1);
+		writer.addU16(entry.fromId);
+		writer.addU16(entry.toId);
+		writer.addString(entry.name);
+		writer.addString(entry.editorSuffix);
+		writer.addU16(static_cast<uint16_t>(entry.attributes.size()));
+		for (const auto &[key, value] : entry.attributes) {
+			writer.addString(key);
+			writer.addString(value);
+		}
+		writer.endNode();
+	}
+	writer.endNode();
+}
+
+bool ItemDatabase::loadFromGameXml(const FileName &identifier, wxString &error, wxArrayString &warnings) {
+	// Entries in front of an invalid one are still loaded, like they were
+	// when items.xml was read node by node
+	std::vector<GameXmlItem> entries;
+	bool parsed = true;
+	const auto start = std::chrono::steady_clock::now();
+	const auto elapsed = [&start]() {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	};
+	BinaryNode* root = g_startupCache.getSection(StartupCache::SECTION_ITEMS_XML, identifier);
+	if (root && readGameXmlCache(root, entries)) {
+		spdlog::info("[ItemDatabase::loadFromGameXml] Read {} from the startup cache in {} ms", nstr(identifier.GetFullPath()), elapsed());
+	} else {
+		parsed = parseGameXml(identifier, entries, error);
+		spdlog::info("[ItemDatabase::loadFromGameXml] Parsed {} in {} ms", nstr(identifier.GetFullPath()), elapsed());
+		if (parsed) {
+			MemoryNodeFileWriteHandle writer;
+			writeGameXmlCache(writer, entries);
+			g_startupCache.setSection(StartupCache::SECTION_ITEMS_XML, { identifier }, writer);
+		}
+	}
+
+	for (const GameXmlItem &entry : entries) {
+		for (auto id = entry.fromId; id <= entry.toId; ++id) {
+			if (!loadItemFromGameXml(entry, id)) {
 				error = wxString::Format("Could not load item id %d. Item id not found.", id);
 				return false;
 			}
 		}
 	}
 
-	return true;
+	return parsed;
 }
 
 bool ItemDatabase::loadMetaItem(pugi::xml_node node) {
@@ -21,13 +21,7 @@
 #include "filehandle.h"
 #include "brush_enums.h"
 
-namespace canary {
-	namespace protobuf {
-		namespace appearances {
-			class Appearances;
-		}
-	}
-}
+struct ItemAppearance;
 
 class Brush;
 class GroundBrush;
@@ -420,6 +414,17 @@ public:
 	ItemHook_t hook = ITEM_HOOK_NONE;
 };
 
+// An item node of items.xml, these are kept in the startup cache so an
+// unchanged file doesn't have to be parsed again
+struct GameXmlItem {
+	uint16_t fromId = 0;
+	uint16_t toId = 0;
+	std::string name;
+	std::string editorSuffix;
+	// Lower case keys with their values, keys that need no value have an empty one
+	std::vector<std::pair<std::string, std::string>> attributes;
+};
+
 class ItemDatabase {
 public:
 	~ItemDatabase();
@@ -440,9 +445,9 @@ public:
 	bool isValidID(uint16_t id) const;
 
 	bool loadFromOtb(const FileName &datafile, wxString &error, wxArrayString &warnings);
-	bool loadFromProtobuf(wxString &error, wxArrayString &warnings, canary::protobuf::appearances::Appearances &appearances);
+	bool loadFromAppearances(const std::vector<ItemAppearance> &appearances, wxString &error, wxArrayString &warnings);
 	bool loadFromGameXml(const FileName &datafile, wxString &error, wxArrayString &warnings);
-	bool loadItemFromGameXml(pugi::xml_node itemNode, uint16_t id);
+	bool loadItemFromGameXml(const GameXmlItem &entry, uint16_t id);
 	bool loadMetaItem(pugi::xml_node node);
 
 	// typedef std::map<int32_t, std::shared_ptr<ItemType>> ItemMap;
@@ -455,6 +460,10 @@ public:
 	uint32_t BuildNumber;
 
 protected:
+	static bool parseGameXml(const FileName &datafile, std::vector<GameXmlItem> &entries, wxString &error);
+	static bool readGameXmlCache(BinaryNode* root, std::vector<GameXmlItem> &entries);
+	static void writeGameXmlCache(NodeFileWriteHandle &writer, const std::vector<GameXmlItem> &entries);
+
 	bool loadGroupByOtbVersion(const std::shared_ptr<ItemType> &item, wxArrayString &warnings) const;
 
 	bool loadFlagsByOtbVersion(const std::shared_ptr<ItemType> &item, BinaryNode* itemNode) const;
@@ -18,9 +18,34 @@
 #include "main.h"
 #include "light_drawer.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define RME_LIGHT_SSE2 1
+#endif
+
+namespace {
+	// dst = max(dst, src) per byte, the lighting only ever brightens a pixel
+	void blendRow(uint8_t* dst, const uint8_t* src, size_t bytes) {
+		size_t i = 0;
+#ifdef RME_LIGHT_SSE2
+		for (; i + 16 <= bytes; i += 16) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_max_epu8(a, b));
+		}
+#endif
+		for (; i < bytes; ++i) {
+			dst[i] = std::max(dst[i], src[i]);
+		}
+	}
+}
+
 LightDrawer::LightDrawer() {
 	texture = 0;
+	texture_width = 0;
+	texture_height = 0;
 	buffer.resize(static_cast<size_t>(rme::ClientMapWidth * rme::ClientMapHeight * rme::PixelFormatRGBA));
+	row.resize(static_cast<size_t>((rme::MaxLightIntensity * 2 + 1) * rme::PixelFormatRGBA));
 	global_color = wxColor(50, 50, 50, 255);
 
 	createGLTexture();
@@ -39,35 +64,21 @@ void LightDrawer::draw(int map_x, int map_y, int end_x, int end_y, int scroll_x,
 
 	int w = end_x - map_x;
 	int h = end_y - map_y;
+	if (w <= 0 || h <= 0) {
+		return;
+	}
 
-	buffer.resize(static_cast<size_t>(w * h * rme::PixelFormatRGBA));
-
-	for (int x = 0; x < w; ++x) {
-		for (int y = 0; y < h; ++y) {
-			int mx = (map_x + x);
-			int my = (map_y + y);
-			int index = (y * w + x);
-			int color_index = index * rme::PixelFormatRGBA;
-
-			buffer[color_index] = global_color.Red();
-			buffer[color_index + 1] = global_color.Green();
-			buffer[color_index + 2] = global_color.Blue();
-			buffer[color_index + 3] = global_color.Alpha();
-
-			for (auto &light : lights) {
-				float intensity = calculateIntensity(mx, my, light);
-				if (intensity == 0.f) {
-					continue;
-				}
-				wxColor light_color = colorFromEightBit(light.color);
-				uint8_t red = static_cast<uint8_t>(light_color.Red() * intensity);
-				uint8_t green = static_cast<uint8_t>(light_color.Green() * intensity);
-				uint8_t blue = static_cast<uint8_t>(light_color.Blue() * intensity);
-				buffer[color_index] = std::max(buffer[color_index], red);
-				buffer[color_index + 1] = std::max(buffer[color_index + 1], green);
-				buffer[color_index + 2] = std::max(buffer[color_index + 2], blue);
-			}
-		}
+	const size_t pixels = static_cast<size_t>(w * h);
+	buffer.resize(pixels * rme::PixelFormatRGBA);
+
+	const uint8_t global[rme::PixelFormatRGBA] = { global_color.Red(), global_color.Green(), global_color.Blue(), global_color.Alpha() };
+	uint8_t* pixel = buffer.data();
+	for (size_t index = 0; index < pixels; ++index, pixel += rme::PixelFormatRGBA) {
+		std::memcpy(pixel, global, rme::PixelFormatRGBA);
+	}
+
+	for (const Light &light : lights) {
+		splatLight(light, map_x, map_y, w, h);
 	}
 
 	const int draw_x = map_x * rme::TileSize - scroll_x;
@@ -77,11 +88,17 @@ void LightDrawer::draw(int map_x, int map_y, int end_x, int end_y, int scroll_x,
 
 	glBindTexture(GL_TEXTURE_2D, texture);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, 0x812F);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, 0x812F);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer.data());
+	if (w != texture_width || h != texture_height) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, 0x812F);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, 0x812F);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer.data());
+		texture_width = w;
+		texture_height = h;
+	} else {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buffer.data());
+	}
 	glBlendFunc(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA);
 
 	glColor4ub(255, 255, 255, 255); // reset color
@@ -101,6 +118,42 @@ void LightDrawer::draw(int map_x, int map_y, int end_x, int end_y, int scroll_x,
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
+void LightDrawer::splatLight(const Light &light, int map_x, int map_y, int w, int h) {
+	// Nothing is lit at a distance of intensity or more, see calculateIntensity
+	const int radius = light.intensity;
+	const int center_x = light.map_x - map_x;
+	const int center_y = light.map_y - map_y;
+
+	const int first_x = std::max(center_x - radius, 0);
+	const int last_x = std::min(center_x + radius, w - 1);
+	const int first_y = std::max(center_y - radius, 0);
+	const int last_y = std::min(center_y + radius, h - 1);
+	if (first_x > last_x || first_y > last_y) {
+		return;
+	}
+
+	const wxColor light_color = colorFromEightBit(light.color);
+	const float red = light_color.Red();
+	const float green = light_color.Green();
+	const float blue = light_color.Blue();
+
+	const int width = last_x - first_x + 1;
+	const size_t bytes = static_cast<size_t>(width * rme::PixelFormatRGBA);
+	for (int y = first_y; y <= last_y; ++y) {
+		uint8_t* color = row.data();
+		for (int x = first_x; x <= last_x; ++x, color += rme::PixelFormatRGBA) {
+			const float intensity = calculateIntensity(x - center_x, y - center_y, light);
+			color[0] = static_cast<uint8_t>(red * intensity);
+			color[1] = static_cast<uint8_t>(green * intensity);
+			color[2] = static_cast<uint8_t>(blue * intensity);
+			color[3] = 0;
+		}
+
+		uint8_t* destination = buffer.data() + static_cast<size_t>((y * w + first_x) * rme::PixelFormatRGBA);
+		blendRow(destination, row.data(), bytes);
+	}
+}
+
 void LightDrawer::setGlobalLightColor(uint8_t color) {
 	global_color = colorFromEightBit(color);
 }
@@ -139,5 +192,8 @@ void LightDrawer::createGLTexture() {
 void LightDrawer::unloadGLTexture() {
 	if (texture != 0) {
 		glDeleteTextures(1, &texture);
+		texture = 0;
 	}
+	texture_width = 0;
+	texture_height = 0;
 }
@@ -43,10 +43,11 @@ private:
 	void createGLTexture();
 	void unloadGLTexture();
 
-	inline float calculateIntensity(int map_x, int map_y, const Light &light) {
-		int dx = map_x - light.map_x;
-		int dy = map_y - light.map_y;
-		float distance = std::sqrt(dx * dx + dy * dy);
+	// Max-blends the light's square of influence into the buffer, w/h are the buffer size in tiles
+	void splatLight(const Light &light, int map_x, int map_y, int w, int h);
+
+	inline float calculateIntensity(int dx, int dy, const Light &light) {
+		float distance = std::sqrt(static_cast<float>(dx * dx + dy * dy));
 		if (distance > rme::MaxLightIntensity) {
 			return 0.f;
 		}
@@ -58,8 +59,13 @@ private:
 	}
 
 	GLuint texture;
+	// Size the texture storage was allocated with, equal sized frames only update it
+	int texture_width;
+	int texture_height;
 	std::vector<Light> lights;
 	std::vector<uint8_t> buffer;
+	// One light's contribution to a buffer row, alpha is kept at 0 so blending leaves the global alpha alone
+	std::vector<uint8_t> row;
 	wxColor global_color;
 };
 
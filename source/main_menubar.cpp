@@ -35,9 +35,11 @@
 
 #include "items.h"
 #include "editor.h"
+#include "iomap_otbm.h"
 #include "materials.h"
 #include "live_client.h"
 #include "live_server.h"
+#include "parallel.h"
 
 BEGIN_EVENT_TABLE(MainMenuBar, wxEvtHandler)
 END_EVENT_TABLE()
@@ -125,6 +127,7 @@ MainMenuBar::MainMenuBar(MainFrame* frame) :
 	MAKE_ACTION(MAP_CLEAN_HOUSE_ITEMS, wxITEM_NORMAL, OnMapCleanHouseItems);
 	MAKE_ACTION(MAP_PROPERTIES, wxITEM_NORMAL, OnMapProperties);
 	MAKE_ACTION(MAP_STATISTICS, wxITEM_NORMAL, OnMapStatistics);
+	MAKE_ACTION(MAP_BENCHMARK_LOADING, wxITEM_NORMAL, OnMapBenchmarkLoading);
 
 	MAKE_ACTION(VIEW_TOOLBARS_BRUSHES, wxITEM_CHECK, OnToolbars);
 	MAKE_ACTION(VIEW_TOOLBARS_POSITION, wxITEM_CHECK, OnToolbars);
@@ -257,6 +260,16 @@ MainMenuBar::~MainMenuBar() {
 	}
 }
 
+namespace {
+	// Load bar updates for the parallel map helpers, from the tiles done so far
+	std::function<void(uint64_t)> getMapProgress(const Map &map, unsigned int from = 0, unsigned int to = 100) {
+		const uint64_t total = std::max<uint64_t>(map.getTileCount(), 1);
+		return [=](uint64_t done) {
+			g_gui.SetLoadDone(from + static_cast<unsigned int>((to - from) * done / total));
+		};
+	}
+}
+
 namespace OnMapRemoveItems {
 	struct RemoveItemCondition {
 		RemoveItemCondition(uint16_t itemId) :
@@ -264,10 +277,7 @@ namespace OnMapRemoveItems {
 
 		uint16_t itemId;
 
-		bool operator()(Map &map, Item* item, int64_t removed, int64_t done) {
-			if (done % 0x8000 == 0) {
-				g_gui.SetLoadDone((uint32_t)(100 * done / map.getTileCount()));
-			}
+		bool operator()(Tile* tile, Item* item) const {
 			return item->getID() == itemId && !item->isComplex();
 		}
 	};
@@ -403,6 +413,7 @@ void MainMenuBar::Update() {
 	EnableItem(MAP_CLEANUP, is_local);
 	EnableItem(MAP_PROPERTIES, is_local);
 	EnableItem(MAP_STATISTICS, is_local);
+	EnableItem(MAP_BENCHMARK_LOADING, is_local);
 
 	EnableItem(NEW_VIEW, has_map);
 	EnableItem(ZOOM_IN, has_map);
@@ -1065,11 +1076,29 @@ void MainMenuBar::OnSearchForItem(wxCommandEvent &WXUNUSED(event)) {
 		g_settings.setInteger(Config::FIND_ITEM_MODE, static_cast<int>(dialog.getSearchMode()));
 		g_settings.setInteger(Config::FIND_TILE_TYPE, static_cast<int>(dialog.getSearchTileType()));
 
-		OnSearchForItem::Finder finder(dialog.getResultID(), (uint32_t)g_settings.getInteger(Config::REPLACE_SIZE), dialog.getSearchMode() == FindItemDialog::SearchMode::TileTypes);
+		const bool findTile = dialog.getSearchMode() == FindItemDialog::SearchMode::TileTypes;
+		OnSearchForItem::Finder finder(dialog.getResultID(), (uint32_t)g_settings.getInteger(Config::REPLACE_SIZE), findTile);
 
 		g_gui.CreateLoadBar("Searching map...");
 
-		foreach_ItemOnMap(g_gui.GetCurrentMap(), finder, false);
+		SearchResultWindow* window = g_gui.ShowSearchWindow();
+		window->Clear();
+
+		// Tile types aren't indexed, every tile has to be checked for them
+		Map &map = g_gui.GetCurrentMap();
+		if (findTile) {
+			foreach_ItemOnMap(map, finder, false);
+		} else {
+			// Indexed results go into the window as they are found
+			map.getItemIndex().find(map, ItemIndex::ItemId, finder.itemId, [&finder, window](Tile* tile, Item* item) {
+				if (finder.limitReached()) {
+					return false;
+				}
+				finder.result.emplace_back(tile, item);
+				window->AddPosition(wxstr(item->getName()), tile->getPosition());
+				return true;
+			});
+		}
 		std::vector<std::pair<Tile*, Item*>> &result = finder.result;
 
 		g_gui.DestroyLoadBar();
@@ -1080,15 +1109,11 @@ void MainMenuBar::OnSearchForItem(wxCommandEvent &WXUNUSED(event)) {
 			g_gui.PopupDialog("Notice", msg, wxOK);
 		}
 
-		SearchResultWindow* window = g_gui.ShowSearchWindow();
-		window->Clear();
-
 		const auto &searchTileType = dialog.getSearchTileType();
 
-		for (auto it = result.begin(); it != result.end(); ++it) {
-			const auto &tile = it->first;
-
-			if (dialog.getSearchMode() == FindItemDialog::SearchMode::TileTypes) {
+		// Items were put into the window while searching, tiles are listed now
+		if (findTile) {
+			for (const auto &[tile, item] : result) {
 				wxString tileType;
 
 				if (tile->isNoLogout() && searchTileType == FindItemDialog::SearchTileType::NoLogout) {
@@ -1102,8 +1127,6 @@ void MainMenuBar::OnSearchForItem(wxCommandEvent &WXUNUSED(event)) {
 				}
 
 				window->AddPosition(tileType, tile->getPosition());
-			} else {
-				window->AddPosition(wxstr(it->second->getName()), tile->getPosition());
 			}
 		}
 	}
@@ -1136,14 +1159,9 @@ namespace OnSearchForStuff {
 		bool search_writeable;
 		std::vector<std::pair<Tile*, Item*>> found;
 
-		void operator()(Map &map, Tile* tile, Item* item, long long done) {
-			if (done % 0x8000 == 0) {
-				g_gui.SetLoadDone((unsigned int)(100 * done / map.getTileCount()));
-			}
+		bool matches(Item* item) const {
 			Container* container;
-			if ((search_unique && item->getUniqueID() > 0) || (search_action && item->getActionID() > 0) || (search_container && ((container = dynamic_cast<Container*>(item)) && container->getItemCount())) || (search_writeable && item && item->getText().length() > 0)) {
-				found.push_back(std::make_pair(tile, item));
-			}
+			return (search_unique && item->getUniqueID() > 0) || (search_action && item->getActionID() > 0) || (search_container && ((container = dynamic_cast<Container*>(item)) && container->getItemCount())) || (search_writeable && item && item->getText().length() > 0);
 		}
 
 		wxString desc(Item* item) {
@@ -1287,7 +1305,8 @@ void MainMenuBar::OnRemoveItemOnSelection(wxCommandEvent &WXUNUSED(event)) {
 		g_gui.GetCurrentEditor()->clearActions();
 		g_gui.CreateLoadBar("Searching item on selection to remove...");
 		OnMapRemoveItems::RemoveItemCondition condition(dialog.getResultID());
-		const auto itemsRemoved = RemoveItemOnMap(g_gui.GetCurrentMap(), condition, true);
+		Map &map = g_gui.GetCurrentMap();
+		const auto itemsRemoved = parallel_RemoveItemOnMap(map, condition, true, getMapProgress(map));
 		g_gui.DestroyLoadBar();
 
 		g_gui.PopupDialog("Remove Item", wxString::Format("%d items removed.", itemsRemoved), wxOK);
@@ -1391,7 +1410,7 @@ void MainMenuBar::OnBorderizeMap(wxCommandEvent &WXUNUSED(event)) {
 		return;
 	}
 
-	int ret = g_gui.PopupDialog("Borderize Map", "Are you sure you want to borderize the entire map (this action cannot be undone)?", wxYES | wxNO);
+	int ret = g_gui.PopupDialog("Borderize Map", "Are you sure you want to borderize the entire map?", wxYES | wxNO);
 	if (ret == wxID_YES) {
 		g_gui.GetCurrentEditor()->borderizeMap(true);
 	}
@@ -1413,7 +1432,7 @@ void MainMenuBar::OnRandomizeMap(wxCommandEvent &WXUNUSED(event)) {
 		return;
 	}
 
-	int ret = g_gui.PopupDialog("Randomize Map", "Are you sure you want to randomize the entire map (this action cannot be undone)?", wxYES | wxNO);
+	int ret = g_gui.PopupDialog("Randomize Map", "Are you sure you want to randomize the entire map?", wxYES | wxNO);
 	if (ret == wxID_YES) {
 		g_gui.GetCurrentEditor()->randomizeMap(true);
 	}
@@ -1491,7 +1510,8 @@ void MainMenuBar::OnMapRemoveItems(wxCommandEvent &WXUNUSED(event)) {
 		OnMapRemoveItems::RemoveItemCondition condition(itemid);
 		g_gui.CreateLoadBar("Searching map for items to remove...");
 
-		int64_t count = RemoveItemOnMap(g_gui.GetCurrentMap(), condition, false);
+		Map &map = g_gui.GetCurrentMap();
+		int64_t count = parallel_RemoveItemOnMap(map, condition, false, getMapProgress(map));
 
 		g_gui.DestroyLoadBar();
 
@@ -1509,11 +1529,7 @@ namespace OnMapRemoveCorpses {
 	struct condition {
 		condition() { }
 
-		bool operator()(Map &map, Item* item, long long removed, long long done) {
-			if (done % 0x800 == 0) {
-				g_gui.SetLoadDone((unsigned int)(100 * done / map.getTileCount()));
-			}
-
+		bool operator()(Tile* tile, Item* item) const {
 			return g_materials.isInTileset(item, "Corpses") && !item->isComplex();
 		}
 	};
@@ -1533,7 +1549,8 @@ void MainMenuBar::OnMapRemoveCorpses(wxCommandEvent &WXUNUSED(event)) {
 		OnMapRemoveCorpses::condition func;
 		g_gui.CreateLoadBar("Searching map for items to remove...");
 
-		int64_t count = RemoveItemOnMap(g_gui.GetCurrentMap(), func, false);
+		Map &map = g_gui.GetCurrentMap();
+		int64_t count = parallel_RemoveItemOnMap(map, func, false, getMapProgress(map));
 
 		g_gui.DestroyLoadBar();
 
@@ -1545,31 +1562,32 @@ void MainMenuBar::OnMapRemoveCorpses(wxCommandEvent &WXUNUSED(event)) {
 }
 
 namespace OnMapRemoveUnreachable {
-	struct condition {
-		condition() { }
+	// A tile is reachable when a walkable tile lies within this range on one of
+	// the floors around it
+	constexpr int RangeX = 10;
+	constexpr int RangeY = 8;
 
-		bool isReachable(Tile* tile) {
-			if (tile == nullptr) {
-				return false;
-			}
-			if (!tile->isBlocking()) {
-				return true;
-			}
-			return false;
-		}
+	// Walkability is kept per floor in 256x256 blocks, the size of the map
+	// areas, so only the parts of the map that have tiles take memory
+	constexpr int BlockBits = 8;
+	constexpr int BlockSize = 1 << BlockBits;
+	using Block = std::bitset<BlockSize * BlockSize>;
+	using FloorBlocks = std::unordered_map<uint32_t, Block>;
 
-		bool operator()(Map &map, Tile* tile, long long removed, long long done, long long total) {
-			if (done % 0x1000 == 0) {
-				g_gui.SetLoadDone((unsigned int)(100 * done / total));
-			}
+	uint32_t getBlockKey(int block_x, int block_y) noexcept {
+		return static_cast<uint32_t>(block_x) << 16 | static_cast<uint32_t>(block_y);
+	}
+
+	class condition {
+	public:
+		condition(Map &map) {
+			buildWalkable(map);
+			buildReachable();
+		}
 
+		bool operator()(const Tile* tile) const {
 			const Position &pos = tile->getPosition();
-			int sx = std::max(pos.x - 10, 0);
-			int ex = std::min(pos.x + 10, 65535);
-			int sy = std::max(pos.y - 8, 0);
-			int ey = std::min(pos.y + 8, 65535);
 			int sz, ez;
-
 			if (pos.z < 8) {
 				sz = 0;
 				ez = 9;
@@ -1579,17 +1597,153 @@ namespace OnMapRemoveUnreachable {
 				ez = std::min(pos.z + 2, rme::MapMaxLayer);
 			}
 
+			const uint32_t key = getBlockKey(pos.x >> BlockBits, pos.y >> BlockBits);
+			const size_t bit = (pos.y & (BlockSize - 1)) * BlockSize + (pos.x & (BlockSize - 1));
 			for (int z = sz; z <= ez; ++z) {
-				for (int y = sy; y <= ey; ++y) {
-					for (int x = sx; x <= ex; ++x) {
-						if (isReachable(map.getTile(x, y, z))) {
-							return false;
+				const auto it = reachable[z].find(key);
+				if (it != reachable[z].end() && it->second.test(bit)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		// One pass over every map area on the worker threads
+		void buildWalkable(Map &map) {
+			const std::vector<MapArea> areas = map.getAreas();
+			std::vector<std::array<std::unique_ptr<Block>, rme::MapLayers>> blocks(areas.size());
+
+			rme::parallelFor(areas.size(), [&](size_t index) {
+				std::vector<QTreeNode*> leaves;
+				areas[index].node->getLeaves(leaves);
+				for (QTreeNode* leaf : leaves) {
+					for (int z = 0; z < rme::MapLayers; ++z) {
+						Floor* floor = leaf->getFloor(z);
+						if (!floor) {
+							continue;
+						}
+						for (TileLocation &location : floor->locs) {
+							const Tile* tile = location.get();
+							if (!tile || tile->isBlocking()) {
+								continue;
+							}
+
+							std::unique_ptr<Block> &block = blocks[index][z];
+							if (!block) {
+								block = std::make_unique<Block>();
+							}
+							const Position &pos = tile->getPosition();
+							block->set((pos.y & (BlockSize - 1)) * BlockSize + (pos.x & (BlockSize - 1)));
 						}
 					}
 				}
+			});
+
+			for (size_t index = 0; index < areas.size(); ++index) {
+				const uint32_t key = getBlockKey(areas[index].x >> BlockBits, areas[index].y >> BlockBits);
+				for (int z = 0; z < rme::MapLayers; ++z) {
+					if (blocks[index][z]) {
+						walkable[z].emplace(key, *blocks[index][z]);
+					}
+				}
+			}
+			g_gui.SetLoadDone(25);
+		}
+
+		// Spreads every walkable tile over the range around it, rows first
+		// and columns second, with a running count of walkable tiles
+		void buildReachable() {
+			std::vector<std::pair<int, uint32_t>> targets;
+			for (int z = 0; z < rme::MapLayers; ++z) {
+				std::set<uint32_t> keys;
+				for (const auto &[key, block] : walkable[z]) {
+					const int block_x = key >> 16;
+					const int block_y = key & 0xFFFF;
+					for (int y = std::max(block_y - 1, 0); y <= block_y + 1; ++y) {
+						for (int x = std::max(block_x - 1, 0); x <= block_x + 1; ++x) {
+							keys.insert(getBlockKey(x, y));
+						}
+					}
+				}
+				for (uint32_t key : keys) {
+					targets.emplace_back(z, key);
+				}
+			}
+
+			std::vector<std::unique_ptr<Block>> results(targets.size());
+			rme::parallelFor(targets.size(), [&](size_t index) {
+				const auto [z, key] = targets[index];
+				auto block = std::make_unique<Block>();
+				spreadBlock(z, key >> 16, key & 0xFFFF, *block);
+				if (block->any()) {
+					results[index] = std::move(block);
+				}
+			});
+
+			for (size_t index = 0; index < targets.size(); ++index) {
+				if (results[index]) {
+					reachable[targets[index].first].emplace(targets[index].second, *results[index]);
+				}
+			}
+			walkable = {};
+			g_gui.SetLoadDone(50);
+		}
+
+		void spreadBlock(int z, int block_x, int block_y, Block &result) const {
+			// The block and its neighbours, the range never reaches further
+			const Block* neighbours[3][3] = {};
+			for (int y = -1; y <= 1; ++y) {
+				for (int x = -1; x <= 1; ++x) {
+					if (block_x + x < 0 || block_y + y < 0) {
+						continue;
+					}
+					const auto it = walkable[z].find(getBlockKey(block_x + x, block_y + y));
+					if (it != walkable[z].end()) {
+						neighbours[y + 1][x + 1] = &it->second;
+					}
+				}
+			}
+
+			const auto isWalkable = [&neighbours](int x, int y) {
+				const Block* block = neighbours[(y >> BlockBits) + 1][(x >> BlockBits) + 1];
+				return block && block->test((y & (BlockSize - 1)) * BlockSize + (x & (BlockSize - 1)));
+			};
+
+			// Rows of the block and RangeY rows above and below it, coordinates
+			// are relative to the block
+			constexpr int Rows = BlockSize + 2 * RangeY;
+			std::vector<uint8_t> rows(Rows * BlockSize);
+			for (int row = 0; row < Rows; ++row) {
+				const int y = row - RangeY;
+				int count = 0;
+				for (int x = -RangeX; x < RangeX; ++x) {
+					count += isWalkable(x, y);
+				}
+				for (int x = 0; x < BlockSize; ++x) {
+					count += isWalkable(x + RangeX, y);
+					rows[row * BlockSize + x] = count > 0;
+					count -= isWalkable(x - RangeX, y);
+				}
+			}
+
+			for (int x = 0; x < BlockSize; ++x) {
+				int count = 0;
+				for (int row = 0; row < 2 * RangeY; ++row) {
+					count += rows[row * BlockSize + x];
+				}
+				for (int y = 0; y < BlockSize; ++y) {
+					count += rows[(y + 2 * RangeY) * BlockSize + x];
+					if (count > 0) {
+						result.set(y * BlockSize + x);
+					}
+					count -= rows[y * BlockSize + x];
+				}
 			}
-			return true;
 		}
+
+		std::array<FloorBlocks, rme::MapLayers> walkable;
+		std::array<FloorBlocks, rme::MapLayers> reachable;
 	};
 }
 
@@ -1604,10 +1758,11 @@ void MainMenuBar::OnMapRemoveUnreachable(wxCommandEvent &WXUNUSED(event)) {
 		g_gui.GetCurrentEditor()->getSelection().clear();
 		g_gui.GetCurrentEditor()->clearActions();
 
-		OnMapRemoveUnreachable::condition func;
 		g_gui.CreateLoadBar("Searching map for tiles to remove...");
+		Map &map = g_gui.GetCurrentMap();
+		OnMapRemoveUnreachable::condition func(map);
 
-		long long removed = remove_if_TileOnMap(g_gui.GetCurrentMap(), func);
+		long long removed = parallel_remove_if_TileOnMap(map, func, getMapProgress(map, 50, 100));
 
 		g_gui.DestroyLoadBar();
 
@@ -1851,6 +2006,94 @@ void MainMenuBar::OnMapEditMonsters(wxCommandEvent &WXUNUSED(event)) {
 	;
 }
 
+namespace OnMapStatistics {
+	// Counted for every tile area on its own, then summed up
+	struct TileCounts {
+		uint64_t tile_count = 0;
+		uint64_t detailed_tile_count = 0;
+		uint64_t blocking_tile_count = 0;
+		uint64_t walkable_tile_count = 0;
+		uint64_t spawn_monster_count = 0;
+		uint64_t spawn_npc_count = 0;
+		uint64_t monster_count = 0;
+		uint64_t npc_count = 0;
+		uint64_t item_count = 0;
+		uint64_t loose_item_count = 0;
+		uint64_t depot_count = 0;
+		uint64_t action_item_count = 0;
+		uint64_t unique_item_count = 0;
+		uint64_t container_count = 0; // Only includes containers containing more than 1 item
+
+		void add(Tile* tile) {
+			if (tile->empty()) {
+				return;
+			}
+
+			tile_count += 1;
+
+			bool is_detailed = false;
+			const auto analyzeItem = [&](Item* item) {
+				item_count += 1;
+				if (item->isGroundTile() || item->isBorder()) {
+					return;
+				}
+
+				is_detailed = true;
+				const ItemType &it = g_items.getItemType(item->getID());
+				if (it.moveable) {
+					loose_item_count += 1;
+				}
+				if (it.isDepot()) {
+					depot_count += 1;
+				}
+				if (item->getActionID() > 0) {
+					action_item_count += 1;
+				}
+				if (item->getUniqueID() > 0) {
+					unique_item_count += 1;
+				}
+				if (Container* c = dynamic_cast<Container*>(item)) {
+					if (c->getVector().size()) {
+						container_count += 1;
+					}
+				}
+			};
+
+			if (tile->ground) {
+				analyzeItem(tile->ground);
+			}
+
+			for (Item* item : tile->items) {
+				analyzeItem(item);
+			}
+
+			if (tile->spawnMonster) {
+				spawn_monster_count += 1;
+			}
+
+			if (tile->spawnNpc) {
+				spawn_npc_count += 1;
+			}
+
+			monster_count += tile->monsters.size();
+
+			if (tile->npc) {
+				npc_count += 1;
+			}
+
+			if (tile->isBlocking()) {
+				blocking_tile_count += 1;
+			} else {
+				walkable_tile_count += 1;
+			}
+
+			if (is_detailed) {
+				detailed_tile_count += 1;
+			}
+		}
+	};
+}
+
 void MainMenuBar::OnMapStatistics(wxCommandEvent &WXUNUSED(event)) {
 	if (!g_gui.IsEditorOpen()) {
 		return;
@@ -1894,79 +2137,30 @@ void MainMenuBar::OnMapStatistics(wxCommandEvent &WXUNUSED(event)) {
 	double sqm_per_house = 0.0;
 	double sqm_per_town = 0.0;
 
-	for (MapIterator mit = map->begin(); mit != map->end(); ++mit) {
-		Tile* tile = (*mit)->get();
-		if (load_counter % 8192 == 0) {
-			g_gui.SetLoadDone((unsigned int)(int64_t(load_counter) * 95ll / int64_t(map->getTileCount())));
-		}
-
-		if (tile->empty()) {
-			continue;
-		}
-
-		tile_count += 1;
-
-		bool is_detailed = false;
-#define ANALYZE_ITEM(_item)                                             \
-	{                                                                   \
-		item_count += 1;                                                \
-		if (!(_item)->isGroundTile() && !(_item)->isBorder()) {         \
-			is_detailed = true;                                         \
-			const ItemType &it = g_items.getItemType((_item)->getID()); \
-			if (it.moveable) {                                          \
-				loose_item_count += 1;                                  \
-			}                                                           \
-			if (it.isDepot()) {                                         \
-				depot_count += 1;                                       \
-			}                                                           \
-			if ((_item)->getActionID() > 0) {                           \
-				action_item_count += 1;                                 \
-			}                                                           \
-			if ((_item)->getUniqueID() > 0) {                           \
-				unique_item_count += 1;                                 \
-			}                                                           \
-			if (Container* c = dynamic_cast<Container*>((_item))) {     \
-				if (c->getVector().size()) {                            \
-					container_count += 1;                               \
-				}                                                       \
-			}                                                           \
-		}                                                               \
-	}
-		if (tile->ground) {
-			ANALYZE_ITEM(tile->ground);
-		}
-
-		for (Item* item : tile->items) {
-			ANALYZE_ITEM(item);
-		}
-#undef ANALYZE_ITEM
-
-		if (tile->spawnMonster) {
-			spawn_monster_count += 1;
-		}
-
-		if (tile->spawnNpc) {
-			spawn_npc_count += 1;
-		}
-
-		monster_count += tile->monsters.size();
-
-		if (tile->npc) {
-			npc_count += 1;
-		}
-
-		if (tile->isBlocking()) {
-			blocking_tile_count += 1;
-		} else {
-			walkable_tile_count += 1;
+	const auto progress = getMapProgress(*map, 0, 95);
+	parallel_foreach_TileOnMap<OnMapStatistics::TileCounts>(
+		*map,
+		[](Tile* tile, OnMapStatistics::TileCounts &counts) {
+			counts.add(tile);
+		},
+		[&](const OnMapStatistics::TileCounts &counts, uint64_t done) {
+			tile_count += counts.tile_count;
+			detailed_tile_count += counts.detailed_tile_count;
+			blocking_tile_count += counts.blocking_tile_count;
+			walkable_tile_count += counts.walkable_tile_count;
+			spawn_monster_count += counts.spawn_monster_count;
+			spawn_npc_count += counts.spawn_npc_count;
+			monster_count += counts.monster_count;
+			npc_count += counts.npc_count;
+			item_count += counts.item_count;
+			loose_item_count += counts.loose_item_count;
+			depot_count += counts.depot_count;
+			action_item_count += counts.action_item_count;
+			unique_item_count += counts.unique_item_count;
+			container_count += counts.container_count;
+			progress(done);
 		}
-
-		if (is_detailed) {
-			detailed_tile_count += 1;
-		}
-
-		load_counter += 1;
-	}
+	);
 
 	monsters_per_spawn = (spawn_monster_count != 0 ? double(monster_count) / double(spawn_monster_count) : -1.0);
 	npcs_per_spawn = (spawn_npc_count != 0 ? double(npc_count) / double(spawn_npc_count) : -1.0);
@@ -2070,6 +2264,18 @@ void MainMenuBar::OnMapStatistics(wxCommandEvent &WXUNUSED(event)) {
 		os << "\t\tLargest House: \"" << largest_house->name << "\" (" << largest_house_size << " sqm)\n";
 	}
 
+	const auto writeMemory = [&os](const MapMemoryStats &stats) {
+		os << "\t\t" << stats.name << ": " << stats.live_objects << " live, " << stats.live_bytes / 1024 << " KB used of " << stats.reserved_bytes / 1024 << " KB reserved\n";
+	};
+	os << "\tMemory (this map):\n";
+	for (const MapMemoryStats &stats : map->allocator.getArenaStats()) {
+		writeMemory(stats);
+	}
+	os << "\tMemory (all open maps):\n";
+	for (const MapMemoryStats &stats : MapAllocator::getPoolStats()) {
+		writeMemory(stats);
+	}
+
 	os << "\n";
 	os << "Generated by Canary's Map Editor version " + __RME_VERSION__ + "\n";
 
@@ -2097,6 +2303,34 @@ void MainMenuBar::OnMapStatistics(wxCommandEvent &WXUNUSED(event)) {
 	}
 }
 
+void MainMenuBar::OnMapBenchmarkLoading(wxCommandEvent &WXUNUSED(event)) {
+	if (!g_gui.IsEditorOpen()) {
+		return;
+	}
+
+	const Map &map = g_gui.GetCurrentMap();
+	if (!map.hasFile()) {
+		g_gui.PopupDialog("Benchmark Loading", "Save the map first, the benchmark loads it from its file.", wxOK);
+		return;
+	}
+
+	g_gui.CreateLoadBar("Benchmarking map loading...");
+	wxString report;
+	IOMapOTBM::benchmarkLoad(wxstr(map.getFilename()), report);
+	g_gui.DestroyLoadBar();
+
+	wxDialog* dg = newd wxDialog(frame, wxID_ANY, "Benchmark Loading", wxDefaultPosition, wxDefaultSize, wxRESIZE_BORDER | wxCAPTION | wxCLOSE_BOX);
+	wxSizer* topsizer = newd wxBoxSizer(wxVERTICAL);
+	wxTextCtrl* text_field = newd wxTextCtrl(dg, wxID_ANY, report, wxDefaultPosition, wxDefaultSize, wxTE_MULTILINE | wxTE_READONLY);
+	text_field->SetMinSize(wxSize(400, 250));
+	topsizer->Add(text_field, wxSizerFlags(5).Expand());
+	topsizer->Add(newd wxButton(dg, wxID_CANCEL, "OK"), wxSizerFlags(1).Center());
+	dg->SetSizerAndFit(topsizer);
+	dg->Centre(wxBOTH);
+	dg->ShowModal();
+	dg->Destroy();
+}
+
 void MainMenuBar::OnMapCleanup(wxCommandEvent &WXUNUSED(event)) {
 	int ok = g_gui.PopupDialog("Clean map", "Do you want to remove all invalid items from the map?", wxYES | wxNO);
 
@@ -2496,15 +2730,55 @@ void MainMenuBar::SearchItems(bool unique, bool action, bool container, bool wri
 	searcher.search_container = container;
 	searcher.search_writeable = writable;
 
-	foreach_ItemOnMap(g_gui.GetCurrentMap(), searcher, onSelection);
+	SearchResultWindow* result = g_gui.ShowSearchWindow();
+	result->Clear();
+
+	// Unique and action ids are indexed, containers and texts still need every item checked
+	Map &map = g_gui.GetCurrentMap();
+	if (!onSelection && !container && !writable) {
+		// Results go into the window as they are found, by unique id first and
+		// then by action id instead of being sorted
+		const auto any = [](uint16_t key) { return key != 0; };
+		ItemIndex &index = map.getItemIndex();
+		if (unique) {
+			index.find(map, ItemIndex::UniqueId, any, [&](Tile* tile, Item* item) {
+				result->AddPosition(searcher.desc(item), tile->getPosition());
+				return true;
+			});
+		}
+		if (action) {
+			index.find(map, ItemIndex::ActionId, any, [&](Tile* tile, Item* item) {
+				// Items with both ids were already found by their unique id
+				if (!unique || item->getUniqueID() == 0) {
+					result->AddPosition(searcher.desc(item), tile->getPosition());
+				}
+				return true;
+			});
+		}
+		g_gui.DestroyLoadBar();
+		return;
+	}
+
+	using Found = std::vector<std::pair<Tile*, Item*>>;
+	const auto progress = getMapProgress(map);
+	parallel_foreach_ItemOnMap<Found>(
+		map,
+		[&searcher](Tile* tile, Item* item, Found &found) {
+			if (searcher.matches(item)) {
+				found.emplace_back(tile, item);
+			}
+		},
+		[&](const Found &found, uint64_t done) {
+			searcher.found.insert(searcher.found.end(), found.begin(), found.end());
+			progress(done);
+		},
+		onSelection
+	);
 	searcher.sort();
 	std::vector<std::pair<Tile*, Item*>> &found = searcher.found;
 
 	g_gui.DestroyLoadBar();
 
-	SearchResultWindow* result = g_gui.ShowSearchWindow();
-	result->Clear();
-
 	for (std::vector<std::pair<Tile*, Item*>>::iterator iter = found.begin(); iter != found.end(); ++iter) {
 		result->AddPosition(searcher.desc(iter->second), iter->first->getPosition());
 	}
@@ -2538,11 +2812,7 @@ namespace SearchDuplicatedItems {
 	struct condition {
 		std::unordered_set<Tile*> foundTiles;
 
-		void operator()(Map &map, Tile* tile, Item* item, long long done) {
-			if (done % 0x8000 == 0) {
-				g_gui.SetLoadDone((unsigned int)(100 * done / map.getTileCount()));
-			}
-
+		void operator()(Tile* tile, Item* item) {
 			if (!tile) {
 				return;
 			}
@@ -2578,10 +2848,20 @@ void MainMenuBar::SearchDuplicatedItems(bool onSelection /* = false*/) {
 
 	g_gui.CreateLoadBar(wxString::Format("Searching on %s...", searchType));
 
-	SearchDuplicatedItems::condition finder;
-
-	foreach_ItemOnMap(g_gui.GetCurrentMap(), finder, onSelection);
-	std::unordered_set<Tile*> &foundTiles = finder.foundTiles;
+	std::unordered_set<Tile*> foundTiles;
+	Map &map = g_gui.GetCurrentMap();
+	const auto progress = getMapProgress(map);
+	parallel_foreach_ItemOnMap<SearchDuplicatedItems::condition>(
+		map,
+		[](Tile* tile, Item* item, SearchDuplicatedItems::condition &finder) {
+			finder(tile, item);
+		},
+		[&](const SearchDuplicatedItems::condition &finder, uint64_t done) {
+			foundTiles.insert(finder.foundTiles.begin(), finder.foundTiles.end());
+			progress(done);
+		},
+		onSelection
+	);
 
 	g_gui.DestroyLoadBar();
 
@@ -2598,11 +2878,7 @@ void MainMenuBar::SearchDuplicatedItems(bool onSelection /* = false*/) {
 
 namespace RemoveDuplicatesItems {
 	struct condition {
-		bool operator()(Map &map, Tile* tile, Item* item, long long removed, long long done) {
-			if (done % 0x8000 == 0) {
-				g_gui.SetLoadDone((unsigned int)(100 * done / map.getTileCount()));
-			}
-
+		bool operator()(Tile* tile, Item* item) const {
 			if (!tile) {
 				return false;
 			}
@@ -2656,7 +2932,8 @@ void MainMenuBar::RemoveDuplicatesItems(bool onSelection /* = false*/) {
 
 		g_gui.CreateLoadBar(wxString::Format("Searching on %s for items to remove...", removalType));
 
-		const auto removedAmount = RemoveItemDuplicateOnMap(g_gui.GetCurrentMap(), func, onSelection);
+		Map &map = g_gui.GetCurrentMap();
+		const auto removedAmount = parallel_RemoveItemOnMap(map, func, onSelection, getMapProgress(map));
 
 		g_gui.DestroyLoadBar();
 
@@ -2670,11 +2947,7 @@ namespace SearchWallsUponWalls {
 	struct condition {
 		std::unordered_set<Tile*> foundTiles;
 
-		void operator()(const Map &map, Tile* tile, const Item* item, long long done) {
-			if (done % 0x8000 == 0) {
-				g_gui.SetLoadDone(static_cast<unsigned int>(100 * done / map.getTileCount()));
-			}
-
+		void operator()(Tile* tile, const Item* item) {
 			if (!tile) {
 				return;
 			}
@@ -2720,11 +2993,20 @@ void MainMenuBar::SearchWallsUponWalls(bool onSelection /* = false*/) {
 
 	g_gui.CreateLoadBar(wxString::Format("Searching on %s...", searchType));
 
-	SearchWallsUponWalls::condition finder;
-
-	foreach_ItemOnMap(g_gui.GetCurrentMap(), finder, onSelection);
-
-	const std::unordered_set<Tile*> &foundTiles = finder.foundTiles;
+	std::unordered_set<Tile*> foundTiles;
+	Map &map = g_gui.GetCurrentMap();
+	const auto progress = getMapProgress(map);
+	parallel_foreach_ItemOnMap<SearchWallsUponWalls::condition>(
+		map,
+		[](Tile* tile, Item* item, SearchWallsUponWalls::condition &finder) {
+			finder(tile, item);
+		},
+		[&](const SearchWallsUponWalls::condition &finder, uint64_t done) {
+			foundTiles.insert(finder.foundTiles.begin(), finder.foundTiles.end());
+			progress(done);
+		},
+		onSelection
+	);
 
 	g_gui.DestroyLoadBar();
 
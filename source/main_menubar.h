@@ -89,6 +89,7 @@ namespace MenuBar {
 		MAP_CLEAN_HOUSE_ITEMS,
 		MAP_PROPERTIES,
 		MAP_STATISTICS,
+		MAP_BENCHMARK_LOADING,
 		VIEW_TOOLBARS_BRUSHES,
 		VIEW_TOOLBARS_POSITION,
 		VIEW_TOOLBARS_SIZES,
@@ -275,6 +276,7 @@ public:
 	void OnMapCleanup(wxCommandEvent &event);
 	void OnMapProperties(wxCommandEvent &event);
 	void OnMapStatistics(wxCommandEvent &event);
+	void OnMapBenchmarkLoading(wxCommandEvent &event);
 
 	// View Menu
 	void OnToolbars(wxCommandEvent &event);
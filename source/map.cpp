@@ -19,6 +19,7 @@
 
 #include "gui.h"
 #include "map.h"
+#include "iomap_otbm.h"
 
 #include "client_assets.h"
 
@@ -61,6 +62,7 @@ bool Map::open(const std::string file) {
 	}
 
 	has_changed = false;
+	itemIndex.build(*this);
 
 	wxFileName fn = wxstr(file);
 	filename = fn.GetFullPath().mb_str(wxConvUTF8);
@@ -120,6 +122,7 @@ bool Map::convert(MapVersion to, bool showdialog) {
 }
 
 bool Map::convert(const ConversionMap &rm, bool showdialog) {
+	clearSaveCache();
 	if (showdialog) {
 		g_gui.CreateLoadBar("Converting map ...");
 	}
@@ -253,34 +256,23 @@ bool Map::convert(const ConversionMap &rm, bool showdialog) {
 }
 
 void Map::cleanInvalidTiles(bool showdialog) {
+	clearSaveCache();
 	if (showdialog) {
 		g_gui.CreateLoadBar("Removing invalid tiles...");
 	}
 
-	uint64_t tiles_done = 0;
-
-	for (MapIterator miter = begin(); miter != end(); ++miter) {
-		Tile* tile = (*miter)->get();
-		ASSERT(tile);
-
-		if (tile->size() == 0) {
-			continue;
-		}
-
-		for (ItemVector::iterator item_iter = tile->items.begin(); item_iter != tile->items.end();) {
-			if (g_items.isValidID((*item_iter)->getID())) {
-				++item_iter;
-			} else {
-				delete *item_iter;
-				item_iter = tile->items.erase(item_iter);
+	parallel_RemoveItemOnMap(
+		*this,
+		[](Tile* tile, Item* item) {
+			return item != tile->ground && !g_items.isValidID(item->getID());
+		},
+		false,
+		[this, showdialog](uint64_t done) {
+			if (showdialog) {
+				g_gui.SetLoadDone(int(done / double(getTileCount()) * 100.0));
 			}
 		}
-
-		++tiles_done;
-		if (showdialog && tiles_done % 0x10000 == 0) {
-			g_gui.SetLoadDone(int(tiles_done / double(getTileCount()) * 100.0));
-		}
-	}
+	);
 
 	if (showdialog) {
 		g_gui.DestroyLoadBar();
@@ -288,6 +280,7 @@ void Map::cleanInvalidTiles(bool showdialog) {
 }
 
 void Map::cleanDeletedZones(bool showdialog) {
+	clearSaveCache();
 	if (showdialog) {
 		g_gui.CreateLoadBar("Removing deleted zones...");
 	}
@@ -340,11 +333,21 @@ Position Map::getZonePosition(unsigned int zoneId) {
 }
 
 bool Map::doChange() {
+	clearSaveCache();
+	return doTileChange();
+}
+
+bool Map::doTileChange() {
 	bool doupdate = !has_changed;
 	has_changed = true;
 	return doupdate;
 }
 
+void Map::clearSaveCache() {
+	save_cache.reset();
+	itemIndex.clear();
+}
+
 bool Map::clearChanges() {
 	bool doupdate = has_changed;
 	has_changed = false;
@@ -409,6 +412,7 @@ bool Map::addSpawnMonster(Tile* tile) {
 				ctile_loc->increaseSpawnCount();
 			}
 		}
+		spawnMonsterIndex.add(tile->getPosition(), spawnMonster->getSize());
 		spawnsMonster.addSpawnMonster(tile);
 		return true;
 	}
@@ -433,6 +437,7 @@ void Map::removeSpawnMonsterInternal(Tile* tile) {
 			}
 		}
 	}
+	spawnMonsterIndex.remove(tile->getPosition());
 }
 
 void Map::removeSpawnMonster(Tile* tile) {
@@ -453,77 +458,16 @@ SpawnMonsterList Map::getSpawnMonsterList(const Tile* tile) const {
 		return list;
 	}
 
-	uint32_t found = 0;
-	if (tile->spawnMonster) {
-		++found;
-		list.push_back(tile->spawnMonster);
-	}
-
-	// Scans the border tiles in an expanding square around the original spawn
 	const Position &position = tile->getPosition();
-	int start_x = position.x - 1;
-	int end_x = position.x + 1;
-	int start_y = position.y - 1;
-	int end_y = position.y + 1;
-
-	while (found != location->getSpawnMonsterCount()) {
-		for (int x = start_x; x <= end_x; ++x) {
-			const Tile* start_tile = getTile(x, start_y, position.z);
-			if (start_tile && start_tile->spawnMonster) {
-				list.push_back(start_tile->spawnMonster);
-				++found;
-			}
-
-			const Tile* end_tile = getTile(x, end_y, position.z);
-			if (end_tile && end_tile->spawnMonster) {
-				list.push_back(end_tile->spawnMonster);
-				++found;
-			}
+	for (const SpawnIndex::Area &area : spawnMonsterIndex.find(position.x, position.y, position.x, position.y, position.z)) {
+		const Tile* spawnTile = getTile(area.center);
+		if (spawnTile && spawnTile->spawnMonster) {
+			list.push_back(spawnTile->spawnMonster);
 		}
-
-		for (int y = start_y + 1; y < end_y; ++y) {
-			const Tile* start_tile = getTile(start_x, y, position.z);
-			if (start_tile && start_tile->spawnMonster) {
-				list.push_back(start_tile->spawnMonster);
-				++found;
-			}
-			const Tile* end_tile = getTile(end_x, y, position.z);
-			if (end_tile && end_tile->spawnMonster) {
-				list.push_back(end_tile->spawnMonster);
-				++found;
-			}
-		}
-
-		for (int y = start_y + 1; y < end_y; ++y) {
-			const Tile* start_tile = getTile(start_x, y, position.z);
-			if (start_tile && start_tile->spawnMonster) {
-				list.push_back(start_tile->spawnMonster);
-				++found;
-			}
-			const Tile* end_tile = getTile(end_x, y, position.z);
-			if (end_tile && end_tile->spawnMonster) {
-				list.push_back(end_tile->spawnMonster);
-				++found;
-			}
-		}
-		--start_x;
-		--start_y;
-		++end_x;
-		++end_y;
 	}
 	return list;
 }
 
-SpawnMonsterList Map::getSpawnMonsterList(const Position &position) const {
-	const Tile* tile = getTile(position);
-	return getSpawnMonsterList(tile);
-}
-
-SpawnMonsterList Map::getSpawnMonsterList(int x, int y, int z) const {
-	const Tile* tile = getTile(x, y, z);
-	return getSpawnMonsterList(tile);
-}
-
 bool Map::addSpawnNpc(Tile* tile) {
 	SpawnNpc* spawnNpc = tile->spawnNpc;
 	if (spawnNpc) {
@@ -539,6 +483,7 @@ bool Map::addSpawnNpc(Tile* tile) {
 				ctile_loc->increaseSpawnNpcCount();
 			}
 		}
+		spawnNpcIndex.add(tile->getPosition(), spawnNpc->getSize());
 		spawnsNpc.addSpawnNpc(tile);
 		return true;
 	}
@@ -563,6 +508,7 @@ void Map::removeSpawnNpcInternal(Tile* tile) {
 			}
 		}
 	}
+	spawnNpcIndex.remove(tile->getPosition());
 }
 
 void Map::removeSpawnNpc(Tile* tile) {
@@ -583,64 +529,16 @@ SpawnNpcList Map::getSpawnNpcList(const Tile* tile) const {
 		return listNpc;
 	}
 
-	uint32_t found = 0;
-	if (tile->spawnNpc) {
-		++found;
-		listNpc.push_back(tile->spawnNpc);
-	}
-
-	// Scans the border tiles in an expanding square around the original spawn
 	const Position &position = tile->getPosition();
-	int start_x = position.x - 1;
-	int end_x = position.x + 1;
-	int start_y = position.y - 1;
-	int end_y = position.y + 1;
-
-	while (found != location->getSpawnNpcCount()) {
-		for (int x = start_x; x <= end_x; ++x) {
-			const Tile* start_tile = getTile(x, start_y, position.z);
-			if (start_tile && start_tile->spawnNpc) {
-				listNpc.push_back(start_tile->spawnNpc);
-				++found;
-			}
-
-			const Tile* end_tile = getTile(x, end_y, position.z);
-			if (end_tile && end_tile->spawnNpc) {
-				listNpc.push_back(end_tile->spawnNpc);
-				++found;
-			}
+	for (const SpawnIndex::Area &area : spawnNpcIndex.find(position.x, position.y, position.x, position.y, position.z)) {
+		const Tile* spawnTile = getTile(area.center);
+		if (spawnTile && spawnTile->spawnNpc) {
+			listNpc.push_back(spawnTile->spawnNpc);
 		}
-
-		for (int y = start_y + 1; y < end_y; ++y) {
-			const Tile* start_tile = getTile(start_x, y, position.z);
-			if (start_tile && start_tile->spawnNpc) {
-				listNpc.push_back(start_tile->spawnNpc);
-				++found;
-			}
-			const Tile* end_tile = getTile(end_x, y, position.z);
-			if (end_tile && end_tile->spawnNpc) {
-				listNpc.push_back(end_tile->spawnNpc);
-				++found;
-			}
-		}
-		--start_x;
-		--start_y;
-		++end_x;
-		++end_y;
 	}
 	return listNpc;
 }
 
-SpawnNpcList Map::getSpawnNpcList(const Position &position) const {
-	const Tile* tile = getTile(position);
-	return getSpawnNpcList(tile);
-}
-
-SpawnNpcList Map::getSpawnNpcList(int x, int y, int z) const {
-	const Tile* tile = getTile(x, y, z);
-	return getSpawnNpcList(tile);
-}
-
 bool Map::exportMinimap(FileName filename, int floor /*= rme::MapGroundLayer*/, bool displaydialog) {
 	uint8_t* pic = nullptr;
 
@@ -799,6 +697,11 @@ bool Map::exportMinimap(FileName filename, int floor /*= rme::MapGroundLayer*/,
 	return true;
 }
 
+void Map::onTileReplaced(Tile* old_tile, Tile* new_tile) {
+	updateUniqueIds(old_tile, new_tile);
+	itemIndex.replaceTile(old_tile, new_tile);
+}
+
 void Map::updateUniqueIds(Tile* old_tile, Tile* new_tile) {
 	if (old_tile && old_tile->hasUniqueItem()) {
 		if (old_tile->ground) {
@@ -849,6 +752,13 @@ void Map::removeUniqueId(uint16_t uid) {
 	}
 }
 
+ItemIndex &Map::getItemIndex() {
+	if (!itemIndex.isBuilt()) {
+		itemIndex.build(*this);
+	}
+	return itemIndex;
+}
+
 bool Map::hasUniqueId(uint16_t uid) const {
 	if (uid < rme::MinUniqueId || uniqueIds.empty()) {
 		return false;
@@ -859,54 +769,44 @@ bool Map::hasUniqueId(uint16_t uid) const {
 }
 
 int64_t RemoveMonstersOnMap(Map &map, bool selectedOnly) {
-	int64_t done = 0;
 	int64_t removed = 0;
-
-	MapIterator it = map.begin();
-	MapIterator end = map.end();
-
-	while (it != end) {
-		++done;
-		Tile* tile = (*it)->get();
-		if (selectedOnly && !tile->isSelected()) {
-			++it;
-			continue;
-		}
-		for (auto monster : tile->monsters) {
-			delete monster;
-			++removed;
-		}
-
-		tile->monsters.clear();
-
-		++it;
-	}
+	parallel_foreach_TileOnMap<int64_t>(
+		map,
+		[](Tile* tile, int64_t &count) {
+			for (auto monster : tile->monsters) {
+				delete monster;
+				++count;
+			}
+
+			tile->monsters.clear();
+		},
+		[&removed](int64_t count, uint64_t) {
+			removed += count;
+		},
+		selectedOnly
+	);
 	return removed;
 }
 
 std::pair<int64_t, std::unordered_map<std::string, int64_t>> CountMonstersOnMap(Map &map, bool selectedOnly) {
-	int64_t done = 0;
-	int64_t total = 0;
-	std::unordered_map<std::string, int64_t> monsterCount;
-
-	MapIterator it = map.begin();
-	MapIterator end = map.end();
-
-	while (it != end) {
-		++done;
-		Tile* tile = (*it)->get();
-		if (selectedOnly && !tile->isSelected()) {
-			++it;
-			continue;
-		}
-
-		for (const auto monster : tile->monsters) {
-			++total;
-			++monsterCount[monster->getName()];
-		}
-
-		++it;
-	}
-
-	return std::make_pair(total, monsterCount);
+	using Counts = std::pair<int64_t, std::unordered_map<std::string, int64_t>>;
+
+	Counts counts;
+	parallel_foreach_TileOnMap<Counts>(
+		map,
+		[](Tile* tile, Counts &area) {
+			for (const auto monster : tile->monsters) {
+				++area.first;
+				++area.second[monster->getName()];
+			}
+		},
+		[&counts](const Counts &area, uint64_t) {
+			counts.first += area.first;
+			for (const auto &[name, count] : area.second) {
+				counts.second[name] += count;
+			}
+		},
+		selectedOnly
+	);
+	return counts;
 }
@@ -28,6 +28,14 @@
 #include "zones.h"
 #include "templates.h"
 #include "spawn_npc.h"
+#include "spawn_index.h"
+#include "item_index.h"
+#include "parallel.h"
+
+#include <atomic>
+#include <memory>
+
+struct OTBMSaveCache;
 
 class Map : public BaseMap {
 public:
@@ -55,7 +63,14 @@ public:
 		return has_changed;
 	}
 	// Makes a change, doesn't matter what. Just so that it asks when saving (Also adds a * to the window title)
+	// The tile areas kept from the last save are dropped, as it isn't known which of them changed
 	bool doChange();
+	// Same as doChange for changes that only replaced tiles through setTile or
+	// swapTile, the tile areas they touched are known from that
+	bool doTileChange();
+	// For edits that change tiles in place, the next save writes every tile area
+	// and the item index is built again when it is next used
+	void clearSaveCache();
 	// Clears any changes
 	bool clearChanges();
 
@@ -80,10 +95,11 @@ public:
 		removeSpawnMonster(getTile(position));
 	}
 
-	// Returns all possible spawnsMonster on the target tile
+	// Returns all spawnsMonster whose area covers the target tile
 	SpawnMonsterList getSpawnMonsterList(const Tile* tile) const;
-	SpawnMonsterList getSpawnMonsterList(const Position &position) const;
-	SpawnMonsterList getSpawnMonsterList(int x, int y, int z) const;
+	const SpawnIndex &getSpawnMonsterIndex() const noexcept {
+		return spawnMonsterIndex;
+	}
 
 	// Mess with npc spawns
 	bool addSpawnNpc(Tile* spawnMonster);
@@ -92,10 +108,11 @@ public:
 		removeSpawnNpc(getTile(position));
 	}
 
-	// Returns all possible npc spawns on the target tile
+	// Returns all npc spawns whose area covers the target tile
 	SpawnNpcList getSpawnNpcList(const Tile* tile) const;
-	SpawnNpcList getSpawnNpcList(const Position &position) const;
-	SpawnNpcList getSpawnNpcList(int x, int y, int z) const;
+	const SpawnIndex &getSpawnNpcIndex() const noexcept {
+		return spawnNpcIndex;
+	}
 
 	// Returns true if the map has been saved
 	// ie. it knows which file it should be saved to
@@ -150,6 +167,10 @@ public:
 
 	bool hasUniqueId(uint16_t uid) const;
 
+	// Item, action and unique ids of every item on the map, built again if an
+	// edit in place dropped it
+	ItemIndex &getItemIndex();
+
 protected:
 	// Loads a map
 	bool open(const std::string identifier);
@@ -182,13 +203,24 @@ public:
 	SpawnsNpc spawnsNpc;
 
 protected:
-	void updateUniqueIds(Tile* old_tile, Tile* new_tile) override;
+	// Areas of the spawns above, kept by addSpawn* and removeSpawn*
+	SpawnIndex spawnMonsterIndex;
+	SpawnIndex spawnNpcIndex;
+
+	// Tiles indexed by the ids of their items, kept through onTileReplaced
+	ItemIndex itemIndex;
+
+	void onTileReplaced(Tile* old_tile, Tile* new_tile) override;
+	void updateUniqueIds(Tile* old_tile, Tile* new_tile);
 	void addUniqueId(uint16_t uid);
 	void removeUniqueId(uint16_t uid);
 
 	bool has_changed; // If the map has changed
 	bool unnamed; // If the map has yet to receive a name
 
+	// Tile areas as written by the last save, reused for areas without changes
+	std::unique_ptr<OTBMSaveCache> save_cache;
+
 	friend class IOMapOTBM;
 	friend class IOMapOTMM;
 	friend class Editor;
@@ -249,117 +281,153 @@ inline void foreach_ItemOnMap(Map &map, ForeachType &foreach, bool selectedTiles
 	}
 }
 
-template <typename ForeachType>
-inline void foreach_TileOnMap(Map &map, ForeachType &foreach) {
-	MapIterator tileiter = map.begin();
-	MapIterator end = map.end();
-	long long done = 0;
-
-	while (tileiter != end) {
-		foreach (map, (*tileiter++)->get(), ++done)
-			;
-	}
-}
-
-template <typename RemoveIfType>
-inline long long remove_if_TileOnMap(Map &map, RemoveIfType &remove_if) {
-	MapIterator tileiter = map.begin();
-	MapIterator end = map.end();
-	long long done = 0;
-	long long removed = 0;
-	long long total = map.getTileCount();
+int64_t RemoveMonstersOnMap(Map &map, bool selectedOnly);
+std::pair<int64_t, std::unordered_map<std::string, int64_t>> CountMonstersOnMap(Map &map, bool selectedOnly);
 
-	while (tileiter != end) {
-		Tile* tile = (*tileiter)->get();
-		if (remove_if(map, tile, removed, done, total)) {
-			map.setTile(tile->getPosition(), nullptr, true);
-			++removed;
+// Parallel map traversal. The map is split into its tile areas, which the worker
+// threads take one at a time. Every area gets its own State, so visitors need no
+// locking as long as they only touch their tile and that state. Once an area and
+// all areas before it are done, its state is handed to merge(state, done) on the
+// calling thread, in the order the map iterator visits the areas. done is the
+// number of tiles visited so far, merging is the place to update the load bar.
+template <typename State, typename Visit, typename Merge>
+inline void parallel_foreach_TileOnMap(Map &map, Visit &&visit, Merge &&merge, bool selectedTiles = false) {
+	const std::vector<MapArea> areas = map.getAreas();
+	std::vector<State> states(areas.size());
+	std::vector<uint64_t> tile_counts(areas.size());
+	std::vector<std::atomic<bool>> finished(areas.size());
+
+	size_t merged = 0;
+	uint64_t done = 0;
+	const auto mergeFinished = [&]() {
+		while (merged < areas.size() && finished[merged]) {
+			done += tile_counts[merged];
+			merge(states[merged], done);
+			// Releases whatever the area collected
+			states[merged] = State();
+			++merged;
 		}
-		++tileiter;
-		++done;
-	}
+	};
+
+	rme::parallelFor(
+		areas.size(),
+		[&](size_t index) {
+			std::vector<QTreeNode*> leaves;
+			areas[index].node->getLeaves(leaves);
+
+			uint64_t count = 0;
+			for (QTreeNode* leaf : leaves) {
+				for (int z = 0; z < rme::MapLayers; ++z) {
+					Floor* floor = leaf->getFloor(z);
+					if (!floor) {
+						continue;
+					}
+					for (TileLocation &location : floor->locs) {
+						Tile* tile = location.get();
+						if (!tile) {
+							continue;
+						}
+						++count;
+						if (!selectedTiles || tile->isSelected()) {
+							visit(tile, states[index]);
+						}
+					}
+				}
+			}
 
-	return removed;
+			tile_counts[index] = count;
+			finished[index] = true;
+		},
+		[&](size_t) { mergeFinished(); }
+	);
+	mergeFinished();
 }
 
-template <typename RemoveIfType>
-inline int64_t RemoveItemOnMap(Map &map, RemoveIfType &condition, bool selectedOnly) {
-	int64_t done = 0;
-	int64_t removed = 0;
-
-	MapIterator it = map.begin();
-	MapIterator end = map.end();
-
-	while (it != end) {
-		++done;
-		Tile* tile = (*it)->get();
-		if (selectedOnly && !tile->isSelected()) {
-			++it;
-			continue;
-		}
+// Calls visit(tile, item, state) for the ground, items and container contents of every tile
+template <typename State, typename Visit, typename Merge>
+inline void parallel_foreach_ItemOnMap(Map &map, Visit &&visit, Merge &&merge, bool selectedTiles = false) {
+	parallel_foreach_TileOnMap<State>(
+		map,
+		[&visit](Tile* tile, State &state) {
+			const auto visitItem = [&](const auto &self, Item* item) -> void {
+				visit(tile, item, state);
+				if (Container* container = item->getContainer()) {
+					for (Item* content : container->getVector()) {
+						self(self, content);
+					}
+				}
+			};
 
-		if (tile->ground) {
-			if (condition(map, tile->ground, removed, done)) {
-				delete tile->ground;
-				tile->ground = nullptr;
-				++removed;
+			if (tile->ground) {
+				visitItem(visitItem, tile->ground);
 			}
-		}
+			for (Item* item : tile->items) {
+				visitItem(visitItem, item);
+			}
+		},
+		std::forward<Merge>(merge),
+		selectedTiles
+	);
+}
 
-		for (auto iit = tile->items.begin(); iit != tile->items.end();) {
-			Item* item = *iit;
-			if (condition(map, item, removed, done)) {
-				iit = tile->items.erase(iit);
-				delete item;
-				++removed;
-			} else {
-				++iit;
+// Removes the tiles for which condition(tile) holds. The conditions are checked on
+// the worker threads while the tiles are only queued, removing them changes the tree
+// the workers walk so it waits until all areas are done. progress(done) is called
+// on the calling thread.
+template <typename Condition, typename Progress>
+inline int64_t parallel_remove_if_TileOnMap(Map &map, Condition &&condition, Progress &&progress) {
+	std::vector<Position> removals;
+	parallel_foreach_TileOnMap<std::vector<Position>>(
+		map,
+		[&condition](Tile* tile, std::vector<Position> &positions) {
+			if (condition(tile)) {
+				positions.push_back(tile->getPosition());
 			}
+		},
+		[&](std::vector<Position> &positions, uint64_t done) {
+			removals.insert(removals.end(), positions.begin(), positions.end());
+			progress(done);
 		}
-		++it;
+	);
+
+	for (const Position &position : removals) {
+		map.setTile(position, nullptr, true);
 	}
-	return removed;
+	return static_cast<int64_t>(removals.size());
 }
 
-int64_t RemoveMonstersOnMap(Map &map, bool selectedOnly);
-std::pair<int64_t, std::unordered_map<std::string, int64_t>> CountMonstersOnMap(Map &map, bool selectedOnly);
-
-template <typename RemoveIfType>
-inline int64_t RemoveItemDuplicateOnMap(Map &map, RemoveIfType &condition, bool selectedOnly) {
-	int64_t done = 0;
+// Removes the ground and the items for which condition(tile, item) holds, container
+// contents are left alone. A tile only ever belongs to one area, so the items are
+// removed right away by the worker that checked them.
+template <typename Condition, typename Progress>
+inline int64_t parallel_RemoveItemOnMap(Map &map, Condition &&condition, bool selectedOnly, Progress &&progress) {
 	int64_t removed = 0;
-
-	MapIterator it = map.begin();
-	MapIterator end = map.end();
-
-	while (it != end) {
-		++done;
-		Tile* tile = (*it)->get();
-		if (selectedOnly && !tile->isSelected()) {
-			++it;
-			continue;
-		}
-
-		if (tile->ground) {
-			if (condition(map, tile, tile->ground, removed, done)) {
+	parallel_foreach_TileOnMap<int64_t>(
+		map,
+		[&condition](Tile* tile, int64_t &count) {
+			if (tile->ground && condition(tile, tile->ground)) {
 				delete tile->ground;
 				tile->ground = nullptr;
-				++removed;
+				++count;
 			}
-		}
 
-		for (auto iit = tile->items.begin(); iit != tile->items.end();) {
-			Item* item = *iit;
-			if (condition(map, tile, item, removed, done)) {
-				iit = tile->items.erase(iit);
-				delete item;
-				++removed;
-			} else {
-				++iit;
+			for (auto it = tile->items.begin(); it != tile->items.end();) {
+				Item* item = *it;
+				if (condition(tile, item)) {
+					it = tile->items.erase(it);
+					delete item;
+					++count;
+				} else {
+					++it;
+				}
 			}
-		}
-		++it;
-	}
+		},
+		[&](int64_t &count, uint64_t done) {
+			removed += count;
+			progress(done);
+		},
+		selectedOnly
+	);
 	return removed;
 }
 
@@ -0,0 +1,258 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "map_allocator.h"
+
+namespace {
+	constexpr size_t SlabBytes = 256 * 1024;
+	// Blocks a thread keeps for itself, half of them are traded with the pool at once
+	constexpr size_t CacheBlocks = 64;
+	constexpr size_t CacheBatch = CacheBlocks / 2;
+	constexpr size_t MaxPools = 4;
+
+	size_t alignedSize(size_t size) {
+		const size_t alignment = std::max(alignof(std::max_align_t), sizeof(void*));
+		return (std::max(size, sizeof(void*)) + alignment - 1) / alignment * alignment;
+	}
+
+	std::atomic<size_t> next_cache_slot = 0;
+}
+
+struct MapObjectPool::ThreadCache {
+	MapObjectPool* pool = nullptr;
+	FreeBlock* blocks = nullptr;
+	size_t count = 0;
+
+	// Blocks of exiting threads go back to the pool, which is never destroyed
+	~ThreadCache() {
+		if (pool && count > 0) {
+			pool->drain(*this, count);
+		}
+	}
+};
+
+MapObjectPool::MapObjectPool(const char* name, size_t object_size) :
+	name(name),
+	object_size(alignedSize(object_size)),
+	slab_objects(std::max<size_t>(SlabBytes / alignedSize(object_size), 1)),
+	cache_slot(next_cache_slot++) {
+	ASSERT(cache_slot < MaxPools);
+}
+
+MapObjectPool::~MapObjectPool() {
+	releaseSlabs();
+}
+
+MapObjectPool::ThreadCache &MapObjectPool::getThreadCache() {
+	thread_local ThreadCache caches[MaxPools];
+	ThreadCache &cache = caches[cache_slot];
+	cache.pool = this;
+	return cache;
+}
+
+void* MapObjectPool::allocate() {
+	ThreadCache &cache = getThreadCache();
+	if (!cache.blocks) {
+		fill(cache, CacheBatch);
+	}
+	FreeBlock* block = cache.blocks;
+	cache.blocks = block->next;
+	--cache.count;
+	cached_objects.fetch_sub(1, std::memory_order_relaxed);
+	return block;
+}
+
+void MapObjectPool::release(void* block) {
+	if (!block) {
+		return;
+	}
+	ThreadCache &cache = getThreadCache();
+	FreeBlock* free_block = static_cast<FreeBlock*>(block);
+	free_block->next = cache.blocks;
+	cache.blocks = free_block;
+	++cache.count;
+	cached_objects.fetch_add(1, std::memory_order_relaxed);
+	if (cache.count >= CacheBlocks) {
+		drain(cache, CacheBatch);
+	}
+}
+
+void MapObjectPool::fill(ThreadCache &cache, size_t count) {
+	std::scoped_lock lock(mutex);
+	for (size_t i = 0; i < count; ++i) {
+		if (!free_list) {
+			addSlab();
+		}
+		FreeBlock* block = free_list;
+		free_list = block->next;
+		block->next = cache.blocks;
+		cache.blocks = block;
+	}
+	cache.count += count;
+	live_objects += count;
+	cached_objects.fetch_add(count, std::memory_order_relaxed);
+}
+
+void MapObjectPool::drain(ThreadCache &cache, size_t count) {
+	std::scoped_lock lock(mutex);
+	for (size_t i = 0; i < count; ++i) {
+		FreeBlock* block = cache.blocks;
+		cache.blocks = block->next;
+		block->next = free_list;
+		free_list = block;
+	}
+	cache.count -= count;
+	live_objects -= count;
+	cached_objects.fetch_sub(count, std::memory_order_relaxed);
+}
+
+void MapObjectPool::addSlab() {
+	uint8_t* slab = static_cast<uint8_t*>(::operator new(object_size * slab_objects));
+	slabs.push_back(slab);
+	// Linked back to front so blocks are handed out in address order
+	for (size_t i = slab_objects; i-- > 0;) {
+		FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + i * object_size);
+		block->next = free_list;
+		free_list = block;
+	}
+}
+
+void MapObjectPool::releaseSlabs() {
+	for (uint8_t* slab : slabs) {
+		::operator delete(slab);
+	}
+	slabs.clear();
+	free_list = nullptr;
+}
+
+void MapObjectPool::releaseUnused() {
+	ThreadCache &cache = getThreadCache();
+	if (cache.count > 0) {
+		drain(cache, cache.count);
+	}
+
+	std::scoped_lock lock(mutex);
+	if (live_objects == 0) {
+		releaseSlabs();
+		return;
+	}
+
+	// Count the free blocks of every slab, a slab is unused once all of its
+	// blocks are on the free list
+	std::sort(slabs.begin(), slabs.end(), std::less<uint8_t*>());
+	const auto slabIndex = [this](FreeBlock* block) {
+		uint8_t* address = reinterpret_cast<uint8_t*>(block);
+		return static_cast<size_t>(std::upper_bound(slabs.begin(), slabs.end(), address, std::less<uint8_t*>()) - slabs.begin()) - 1;
+	};
+
+	std::vector<size_t> free_blocks(slabs.size(), 0);
+	for (FreeBlock* block = free_list; block; block = block->next) {
+		++free_blocks[slabIndex(block)];
+	}
+
+	FreeBlock* kept = nullptr;
+	FreeBlock* block = free_list;
+	while (block) {
+		FreeBlock* next = block->next;
+		if (free_blocks[slabIndex(block)] != slab_objects) {
+			block->next = kept;
+			kept = block;
+		}
+		block = next;
+	}
+	free_list = kept;
+
+	size_t used = 0;
+	for (size_t i = 0; i < slabs.size(); ++i) {
+		if (free_blocks[i] == slab_objects) {
+			::operator delete(slabs[i]);
+		} else {
+			slabs[used++] = slabs[i];
+		}
+	}
+	slabs.resize(used);
+}
+
+MapObjectPool::Stats MapObjectPool::getStats() const {
+	std::scoped_lock lock(mutex);
+	const size_t used = live_objects - std::min(live_objects, cached_objects.load(std::memory_order_relaxed));
+	return Stats {
+		name,
+		object_size,
+		used,
+		used * object_size,
+		slabs.size() * slab_objects * object_size,
+	};
+}
+
+MapArena::MapArena(const char* name, size_t object_size) :
+	name(name),
+	object_size(alignedSize(object_size)),
+	slab_objects(std::max<size_t>(SlabBytes / alignedSize(object_size), 1)),
+	slab_used(0) {
+	////
+}
+
+MapArena::~MapArena() {
+	releaseAll();
+}
+
+void* MapArena::allocate() {
+	if (slabs.empty() || slab_used == slab_objects) {
+		slabs.push_back(static_cast<uint8_t*>(::operator new(object_size * slab_objects)));
+		slab_used = 0;
+	}
+	return slabs.back() + object_size * slab_used++;
+}
+
+void MapArena::releaseAll() {
+	for (uint8_t* slab : slabs) {
+		::operator delete(slab);
+	}
+	slabs.clear();
+	slab_used = 0;
+}
+
+MapMemoryStats MapArena::getStats() const {
+	const size_t live_objects = slabs.empty() ? 0 : (slabs.size() - 1) * slab_objects + slab_used;
+	return MapMemoryStats {
+		name,
+		object_size,
+		live_objects,
+		live_objects * object_size,
+		slabs.size() * slab_objects * object_size,
+	};
+}
+
+// The pool is never destroyed, tiles may still be freed while the
+// application shuts down
+MapObjectPool &MapAllocator::getTilePool() {
+	static MapObjectPool* pool = newd MapObjectPool("Tiles", sizeof(Tile));
+	return *pool;
+}
+
+std::vector<MapMemoryStats> MapAllocator::getPoolStats() {
+	return {
+		getTilePool().getStats(),
+	};
+}
+
+void MapAllocator::releaseUnused() {
+	getTilePool().releaseUnused();
+}
@@ -21,12 +21,106 @@
 #include "tile.h"
 #include "map_region.h"
 
+#include <atomic>
+#include <mutex>
+
 class BaseMap;
 
+struct MapMemoryStats {
+	const char* name;
+	size_t object_size;
+	size_t live_objects;
+	size_t live_bytes;
+	size_t reserved_bytes;
+};
+
+// Hands out the memory of one type of map object. Blocks are cut from large
+// slabs, so there is no malloc header per object, and freed blocks are kept on
+// a free list for the next allocation. Slabs are only given back in bulk, see
+// releaseUnused. Tiles use one pool shared by all maps, since they move between
+// the maps, actions and the copy buffer.
+// Every thread keeps a few free blocks of its own and only takes the lock to
+// trade them with the pool in batches, so the parallel loader and the UI thread
+// rarely meet on it.
+class MapObjectPool {
+public:
+	using Stats = MapMemoryStats;
+
+	MapObjectPool(const char* name, size_t object_size);
+	~MapObjectPool();
+
+	MapObjectPool(const MapObjectPool &) = delete;
+	MapObjectPool &operator=(const MapObjectPool &) = delete;
+
+	void* allocate();
+	void release(void* block);
+
+	// Frees all slabs that have no object left in them, blocks cached by other
+	// threads than the calling one keep their slabs
+	void releaseUnused();
+
+	Stats getStats() const;
+
+private:
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	struct ThreadCache;
+	ThreadCache &getThreadCache();
+	// Moves count blocks from the pool to the cache, or back
+	void fill(ThreadCache &cache, size_t count);
+	void drain(ThreadCache &cache, size_t count);
+
+	void addSlab();
+	void releaseSlabs();
+
+	const char* name;
+	size_t object_size;
+	size_t slab_objects;
+	size_t cache_slot;
+
+	mutable std::mutex mutex;
+	std::vector<uint8_t*> slabs;
+	FreeBlock* free_list = nullptr;
+	// Blocks outside the free list, this includes the ones cached by threads
+	size_t live_objects = 0;
+	std::atomic<size_t> cached_objects = 0;
+};
+
+// Memory of the floors and tree nodes of one map. They never leave their map and
+// are never freed one by one, so they are cut from slabs front to back and the
+// slabs are dropped together once the map is cleared or destroyed.
+class MapArena {
+public:
+	MapArena(const char* name, size_t object_size);
+	~MapArena();
+
+	MapArena(const MapArena &) = delete;
+	MapArena &operator=(const MapArena &) = delete;
+
+	void* allocate();
+	// Drops every object at once, without running destructors
+	void releaseAll();
+
+	MapMemoryStats getStats() const;
+
+private:
+	const char* name;
+	size_t object_size;
+	size_t slab_objects;
+
+	std::vector<uint8_t*> slabs;
+	// Objects cut from the last slab
+	size_t slab_used;
+};
+
 class MapAllocator {
 
 public:
-	MapAllocator() { }
+	MapAllocator() :
+		floors("Floors", sizeof(Floor)),
+		nodes("Tree nodes", sizeof(QTreeNode)) { }
 	~MapAllocator() { }
 
 	// shorthands for tiles
@@ -46,21 +140,33 @@ public:
 		delete t;
 	}
 
-	//
+	// Floors and nodes live until releaseNodes
 	Floor* allocateFloor(int x, int y, int z) {
-		return newd Floor(x, y, z);
+		return new (floors.allocate()) Floor(x, y, z);
 	}
-	void freeFloor(Floor* f) {
-		delete f;
-	}
-
-	//
 	QTreeNode* allocateNode(BaseMap &map) {
-		return newd QTreeNode(map);
+		return new (nodes.allocate()) QTreeNode(map);
+	}
+	// Drops all floors and nodes of the map, their tiles have to be gone already
+	void releaseNodes() {
+		floors.releaseAll();
+		nodes.releaseAll();
 	}
-	void freeNode(QTreeNode* qt) {
-		delete qt;
+
+	std::vector<MapMemoryStats> getArenaStats() const {
+		return { floors.getStats(), nodes.getStats() };
 	}
+
+	// Tile takes its memory from this
+	static MapObjectPool &getTilePool();
+
+	static std::vector<MapMemoryStats> getPoolStats();
+	// Called after a map was closed, gives the emptied slabs back to the system
+	static void releaseUnused();
+
+private:
+	MapArena floors;
+	MapArena nodes;
 };
 
 #endif
@@ -49,6 +49,7 @@
 
 // Forward declare from map_drawer.cpp for telemetry
 extern int GetTextureBindsLastFrame();
+extern int GetSpriteDrawCallsLastFrame();
 
 BEGIN_EVENT_TABLE(MapCanvas, wxGLCanvas)
 EVT_KEY_DOWN(MapCanvas::OnKeyDown)
@@ -339,7 +340,8 @@ void MapCanvas::OnPaint(wxPaintEvent &event) {
 		// Update StatusBar slot 4 with redraws and texture binds (stable, doesn't touch title)
 		if (g_gui.root) {
 			int texBinds = GetTextureBindsLastFrame();
-			wxString telemetry = wxString::Format("Redraws:%d Binds:%d", current_fps, texBinds);
+			int drawCalls = GetSpriteDrawCallsLastFrame();
+			wxString telemetry = wxString::Format("Redraws:%d Binds:%d Batches:%d", current_fps, texBinds, drawCalls);
 			g_gui.root->SetStatusText(telemetry, 4);
 		}
 	}
@@ -17,8 +17,6 @@
 
 #include "main.h"
 
-#include <unordered_set>
-
 #if defined(__LINUX__) || defined(__WINDOWS__)
 	#include <GL/glut.h>
 #endif
@@ -47,25 +45,24 @@
 #include "waypoint_brush.h"
 #include "zone_brush.h"
 #include "light_drawer.h"
+#include "sprite_batch.h"
+#include "render_cache.h"
 
-// === Texture State Caching (Redundant State Filter) ===
-// Eliminates redundant glBindTexture calls when tiles use the same texture
-static GLuint g_currentTextureId = 0;
-static int g_textureBindsThisFrame = 0;
+// === Sprite Batch Telemetry ===
+// Texture binds and draw calls issued by the sprite batch during the last complete frame
 static int g_textureBindsLastFrame = 0;
-
-// Call at start of each frame to reset cache
-static void ResetTextureCache() {
-	g_currentTextureId = 0;
-	g_textureBindsLastFrame = g_textureBindsThisFrame;
-	g_textureBindsThisFrame = 0;
-}
+static int g_spriteDrawCallsLastFrame = 0;
 
 // Get binds from last complete frame (for telemetry)
 int GetTextureBindsLastFrame() {
 	return g_textureBindsLastFrame;
 }
 
+// Get sprite draw calls from last complete frame (for telemetry)
+int GetSpriteDrawCallsLastFrame() {
+	return g_spriteDrawCallsLastFrame;
+}
+
 DrawingOptions::DrawingOptions() {
 	SetDefault();
 }
@@ -155,8 +152,15 @@ bool DrawingOptions::isTooltips() const noexcept {
 }
 
 MapDrawer::MapDrawer(MapCanvas* canvas) :
-	canvas(canvas), editor(canvas->editor) {
+	canvas(canvas), editor(canvas->editor),
+	occlusion_x(0), occlusion_y(0),
+	occlusion_width(0), occlusion_height(0), occlusion_stride(0),
+	occlusion_enabled(false),
+	prefetch_x(-1), prefetch_y(-1), prefetch_floor(-1),
+	coverage_x(0), coverage_y(0), coverage_width(0), coverage_height(0) {
 	light_drawer = std::make_shared<LightDrawer>();
+	sprite_batch = std::make_shared<SpriteBatch>();
+	render_cache = std::make_shared<RenderCache>();
 }
 
 MapDrawer::~MapDrawer() {
@@ -263,12 +267,15 @@ void MapDrawer::Release() {
 }
 
 void MapDrawer::Draw() {
-	// Reset texture cache at start of each frame
-	ResetTextureCache();
-	
+	sprite_batch->resetStats();
+
+	g_spriteAppearances.collectPrefetchedSheets();
+	PrefetchSheets();
+
 	DrawBackground();
 	DrawMap();
 	if (options.show_lights) {
+		sprite_batch->flush();
 		light_drawer->draw(start_x, start_y, end_x, end_y, view_scroll_x, view_scroll_y);
 	}
 	DrawDraggingShadow();
@@ -289,6 +296,11 @@ void MapDrawer::Draw() {
 	if (should_draw_tooltips) {
 		DrawTooltips();
 	}
+
+	sprite_batch->flush();
+	render_cache->nextFrame();
+	g_textureBindsLastFrame = sprite_batch->getTextureBinds();
+	g_spriteDrawCallsLastFrame = sprite_batch->getDrawCalls();
 }
 
 void MapDrawer::DrawBackground() {
@@ -315,6 +327,8 @@ inline int getFloorAdjustment(int floor) {
 
 void MapDrawer::DrawShade(int map_z) {
 	if (map_z == end_z && start_z != end_z) {
+		sprite_batch->flush();
+
 		bool only_colors = options.isOnlyColors();
 		if (!only_colors) {
 			glDisable(GL_TEXTURE_2D);
@@ -362,11 +376,31 @@ void MapDrawer::DrawMap() {
 	bool only_colors = options.isOnlyColors();
 	bool tile_indicators = options.isTileIndicators();
 
+	// Leaves are only cached while everything DrawTile generates can be replayed later,
+	// tooltips and animations depend on more than the tiles themselves
+	const bool cache_leaves = !live_client && !options.isTooltips() && !options.show_containers_with_items && !options.show_preview && !options.show_only_modified;
+	if (cache_leaves) {
+		const bool hidden = only_colors || (options.hide_items_when_zoomed && zoom > 10.f);
+		const bool state_flags[] = {
+			hidden, options.show_as_minimap, options.show_only_colors, options.show_special_tiles, options.show_blocking,
+			options.highlight_items, options.show_spawns_monster, options.show_spawns_npc, options.show_houses,
+			options.transparent_items, options.show_items, options.show_monsters, options.show_npcs, options.ingame,
+			options.show_hooks, options.show_light_strength
+		};
+
+		RenderCache::State state;
+		for (size_t i = 0; i < std::size(state_flags); ++i) {
+			state.flags |= static_cast<uint32_t>(state_flags[i]) << i;
+		}
+		state.house_id = current_house_id;
+		state.zone = g_gui.zone_brush->getZone();
+		state.epoch = editor.getMap().getRenderEpoch();
+		render_cache->setState(state);
+	}
+
 	// === Z-Axis Occlusion Culling ===
-	// Track tiles that have been covered by opaque ground on higher floors
-	// Key: (X << 32) | Y, Value: presence in set = occluded
-	std::unordered_set<uint64_t> occluded_tiles;
-	occluded_tiles.reserve(8192);  // Pre-allocate for typical viewport
+	// Floors are drawn bottom up, so find what the floors above will cover first
+	BuildOcclusion(live_client);
 
 	for (int map_z = start_z; map_z >= superend_z; map_z--) {
 		if (options.show_shade) {
@@ -383,6 +417,8 @@ void MapDrawer::DrawMap() {
 			int nd_end_x = (end_x & ~3) + 4;
 			int nd_end_y = (end_y & ~3) + 4;
 
+			BuildSpawnCoverage(nd_start_x, nd_start_y, nd_end_x + 3, nd_end_y + 3, map_z);
+
 			for (int nd_map_x = nd_start_x; nd_map_x <= nd_end_x; nd_map_x += 4) {
 				for (int nd_map_y = nd_start_y; nd_map_y <= nd_end_y; nd_map_y += 4) {
 					QTreeNode* nd = editor.getMap().getLeaf(nd_map_x, nd_map_y);
@@ -395,40 +431,14 @@ void MapDrawer::DrawMap() {
 					}
 
 					if (!live_client || nd->isVisible(map_z > rme::MapGroundLayer)) {
-						for (int map_x = 0; map_x < 4; ++map_x) {
-							for (int map_y = 0; map_y < 4; ++map_y) {
-								TileLocation* location = nd->getTile(map_x, map_y, map_z);
-
-								// === Z-Axis Occlusion Culling ===
-								if (location && location->get()) {
-									Tile* tile = location->get();
-									const Position& pos = location->getPosition();
-									uint64_t tile_key = (uint64_t(pos.x) << 32) | uint64_t(pos.y);
-
-									// Check if this tile is occluded by an opaque ground above
-									bool is_occluded = occluded_tiles.find(tile_key) != occluded_tiles.end();
-
-									// Skip rendering if:
-									// 1. Tile is occluded by floor above
-									// 2. Not the current visible floor (always show current floor)
-									// 3. transparent_floors is disabled (user doesn't want to see through)
-									if (is_occluded && map_z < end_z && !options.transparent_floors) {
-										continue;  // Skip this tile - it's hidden by opaque ground above
-									}
-
-									// Mark this tile as occluding if it has opaque ground
-									// Safety: hasGround() filters out empty tiles (which are also isBlocking())
-									if (tile->hasGround() && tile->isBlocking()) {
-										occluded_tiles.insert(tile_key);
-									}
-								}
+						if (isLeafOccluded(nd_map_x, nd_map_y, map_z)) {
+							continue;
+						}
 
-								DrawTile(location);
-								// draw light, but only if not zoomed too far
-								if (location && options.show_lights && zoom <= 10) {
-									AddLight(location);
-								}
-							}
+						if (cache_leaves) {
+							DrawCachedLeaf(nd, nd_map_x, nd_map_y, map_z);
+						} else {
+							DrawLeafTiles(nd, map_z);
 						}
 						if (tile_indicators) {
 							for (int map_x = 0; map_x < 4; ++map_x) {
@@ -446,6 +456,7 @@ void MapDrawer::DrawMap() {
 						int cy = (nd_map_y)*rme::TileSize - view_scroll_y - getFloorAdjustment(floor);
 						int cx = (nd_map_x)*rme::TileSize - view_scroll_x - getFloorAdjustment(floor);
 
+						sprite_batch->flush();
 						glColor4ub(255, 0, 255, 128);
 						glBegin(GL_QUADS);
 						glVertex2f(cx, cy + rme::TileSize * 4);
@@ -478,6 +489,333 @@ void MapDrawer::DrawMap() {
 	}
 }
 
+void MapDrawer::DrawLeafTiles(QTreeNode* nd, int map_z) {
+	for (int map_x = 0; map_x < 4; ++map_x) {
+		for (int map_y = 0; map_y < 4; ++map_y) {
+			TileLocation* location = nd->getTile(map_x, map_y, map_z);
+			if (!location) {
+				continue;
+			}
+
+			// Skip tiles hidden below opaque ground of the floors above
+			const Position &pos = location->getPosition();
+			if (isOccluded(pos.x, pos.y, map_z)) {
+				continue;
+			}
+
+			DrawTile(location);
+			// draw light, but only if not zoomed too far
+			if (location && options.show_lights && zoom <= 10) {
+				AddLight(location);
+			}
+		}
+	}
+}
+
+void MapDrawer::DrawCachedLeaf(QTreeNode* nd, int nd_map_x, int nd_map_y, int map_z) {
+	// Same translation as getDrawPosition, cached commands don't depend on the view scroll
+	const int offset = map_z <= rme::MapGroundLayer ? (rme::MapGroundLayer - map_z) * rme::TileSize : rme::TileSize * (floor - map_z);
+	const int offset_x = view_scroll_x + offset;
+	const int offset_y = view_scroll_y + offset;
+
+	TextureAtlas &atlas = g_gui.gfx.getTextureAtlas();
+	RenderCache::Entry &entry = render_cache->get(nd_map_x, nd_map_y, map_z);
+	const uint32_t revision = RenderCache::getRevision(nd, map_z);
+
+	bool valid = render_cache->isValid(entry, revision);
+	if (valid && entry.cacheable) {
+		// Atlas pages might have been recycled since the leaf was recorded
+		for (const RenderCache::Command &command : entry.commands) {
+			if (command.sprite != 0 && !atlas.isResident(command.sprite)) {
+				valid = false;
+				break;
+			}
+		}
+	}
+
+	if (!valid) {
+		render_cache->startRecording(entry, revision, offset_x, offset_y);
+		for (int map_x = 0; map_x < 4; ++map_x) {
+			for (int map_y = 0; map_y < 4; ++map_y) {
+				render_cache->setRecordingTile(map_x * 4 + map_y);
+				TileLocation* location = nd->getTile(map_x, map_y, map_z);
+				DrawTile(location);
+				RecordLights(location);
+			}
+		}
+		render_cache->stopRecording();
+	}
+
+	if (!entry.cacheable) {
+		DrawLeafTiles(nd, map_z);
+		return;
+	}
+
+	// Same culling as DrawLeafTiles, commands know which tile of the leaf they belong to
+	uint16_t skipped = 0;
+	for (int index = 0; index < 16; ++index) {
+		if (isOccluded(nd_map_x + (index >> 2), nd_map_y + (index & 3), map_z)) {
+			skipped |= 1 << index;
+		}
+	}
+
+	for (const RenderCache::Command &command : entry.commands) {
+		if (skipped & (1 << command.tile)) {
+			continue;
+		}
+
+		const float x = command.x - offset_x;
+		const float y = command.y - offset_y;
+		if (command.sprite == 0) {
+			glDisable(GL_TEXTURE_2D);
+			glBlitSquare(static_cast<int>(x), static_cast<int>(y), command.red, command.green, command.blue, command.alpha, static_cast<int>(command.width));
+			glEnable(GL_TEXTURE_2D);
+			continue;
+		}
+
+		const TextureAtlas::Region* region = atlas.getRegion(command.sprite);
+		sprite_batch->add(region->texture, x, y, command.width, command.height, command.red, command.green, command.blue, command.alpha, region->u0, region->v0, region->u1, region->v1);
+	}
+
+	if (options.show_lights && zoom <= 10) {
+		// The lights of a leaf only change with its tiles, so they are kept with the commands
+		for (const RenderCache::Light &light : entry.lights) {
+			if ((skipped & (1 << light.tile)) == 0) {
+				light_drawer->addLight(nd_map_x + (light.tile >> 2), nd_map_y + (light.tile & 3), map_z, SpriteLight { light.intensity, light.color });
+			}
+		}
+	}
+}
+
+void MapDrawer::PrefetchSheets() {
+	if (options.isOnlyColors()) {
+		return;
+	}
+
+	// Walked again whenever the view reaches another leaf
+	if ((start_x >> 2) == prefetch_x && (start_y >> 2) == prefetch_y && floor == prefetch_floor) {
+		return;
+	}
+	prefetch_x = start_x >> 2;
+	prefetch_y = start_y >> 2;
+	prefetch_floor = floor;
+
+	// Two leaves past every edge, plus the floor offset of the lowest floor drawn
+	const int margin = 8 + std::max(0, rme::MapGroundLayer - end_z);
+	const int nd_start_x = (start_x - margin) & ~3;
+	const int nd_start_y = (start_y - margin) & ~3;
+	const int nd_end_x = (end_x + margin) & ~3;
+	const int nd_end_y = (end_y + margin) & ~3;
+
+	const bool show_items = options.show_items && !(options.hide_items_when_zoomed && zoom > 10.f);
+	const auto prefetch = [](const Item* item) {
+		const GameSprite* sprite = g_items.getItemType(item->getID()).sprite;
+		if (sprite) {
+			sprite->prefetchSheets();
+		}
+	};
+
+	for (int nd_map_x = nd_start_x; nd_map_x <= nd_end_x; nd_map_x += 4) {
+		for (int nd_map_y = nd_start_y; nd_map_y <= nd_end_y; nd_map_y += 4) {
+			QTreeNode* nd = editor.getMap().getLeaf(nd_map_x, nd_map_y);
+			if (!nd) {
+				continue;
+			}
+
+			for (int map_z = start_z; map_z >= end_z; --map_z) {
+				Floor* leaf_floor = nd->getFloor(map_z);
+				if (!leaf_floor) {
+					continue;
+				}
+
+				for (TileLocation &location : leaf_floor->locs) {
+					const Tile* tile = location.get();
+					if (!tile) {
+						continue;
+					}
+					if (tile->ground) {
+						prefetch(tile->ground);
+					}
+					if (show_items) {
+						for (const Item* item : tile->items) {
+							prefetch(item);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void MapDrawer::BuildOcclusion(bool live_client) {
+	// Nothing can be hidden with a single floor, or when the floors above are see-through
+	occlusion_enabled = start_z > end_z && !options.transparent_floors && !options.isOnlyColors();
+	if (!occlusion_enabled) {
+		return;
+	}
+
+	// Cells are tiles shifted by their floor offset, i.e. where they end up on screen
+	occlusion_x = view_scroll_x / rme::TileSize - 2;
+	occlusion_y = view_scroll_y / rme::TileSize - 2;
+	occlusion_width = screensize_x / tile_size + 6;
+	occlusion_height = screensize_y / tile_size + 6;
+	occlusion_stride = (occlusion_width + 63) / 64;
+
+	const size_t plane_size = static_cast<size_t>(occlusion_stride) * occlusion_height;
+	const int planes = start_z - end_z + 1;
+	occlusion.assign(plane_size * planes, 0);
+
+	// Plane 0 belongs to the top floor with nothing above it. Every other plane starts
+	// with the plane above and adds the opaque ground of the floor right above it.
+	for (int plane = 1; plane < planes; ++plane) {
+		uint64_t* covered = &occlusion[plane * plane_size];
+		std::copy_n(covered - plane_size, plane_size, covered);
+
+		const int map_z = end_z + plane - 1;
+		const int shift = getFloorShift(map_z);
+		// DrawMap widens the view by one tile for every floor below start_z
+		const int spread = start_z - map_z;
+		const int nd_start_x = (start_x - spread) & ~3;
+		const int nd_start_y = (start_y - spread) & ~3;
+		const int nd_end_x = ((end_x + spread) & ~3) + 4;
+		const int nd_end_y = ((end_y + spread) & ~3) + 4;
+
+		for (int nd_map_x = nd_start_x; nd_map_x <= nd_end_x; nd_map_x += 4) {
+			for (int nd_map_y = nd_start_y; nd_map_y <= nd_end_y; nd_map_y += 4) {
+				QTreeNode* nd = editor.getMap().getLeaf(nd_map_x, nd_map_y);
+				if (!nd || (live_client && !nd->isVisible(map_z > rme::MapGroundLayer))) {
+					continue;
+				}
+
+				Floor* map_floor = nd->getFloor(map_z);
+				if (!map_floor) {
+					continue;
+				}
+
+				for (TileLocation &location : map_floor->locs) {
+					const Tile* tile = location.get();
+					// hasGround() filters out empty tiles, which are blocking as well
+					if (!tile || !tile->hasGround() || !tile->isBlocking()) {
+						continue;
+					}
+
+					const int cell_x = location.getX() - shift - occlusion_x;
+					const int cell_y = location.getY() - shift - occlusion_y;
+					if (cell_x >= 0 && cell_y >= 0 && cell_x < occlusion_width && cell_y < occlusion_height) {
+						covered[cell_y * occlusion_stride + (cell_x >> 6)] |= uint64_t(1) << (cell_x & 63);
+					}
+				}
+			}
+		}
+	}
+}
+
+void MapDrawer::BuildSpawnCoverage(int start_x, int start_y, int end_x, int end_y, int z) {
+	spawn_monster_coverage.clear();
+	spawn_npc_coverage.clear();
+	if (!options.show_spawns_monster && !options.show_spawns_npc) {
+		return;
+	}
+
+	coverage_x = start_x;
+	coverage_y = start_y;
+	coverage_width = end_x - start_x + 1;
+	coverage_height = end_y - start_y + 1;
+
+	const Map &map = editor.getMap();
+	if (options.show_spawns_monster) {
+		FillSpawnCoverage(map.getSpawnMonsterIndex(), z, spawn_monster_coverage);
+	}
+	if (options.show_spawns_npc) {
+		FillSpawnCoverage(map.getSpawnNpcIndex(), z, spawn_npc_coverage);
+	}
+}
+
+void MapDrawer::FillSpawnCoverage(const SpawnIndex &index, int z, std::vector<uint8_t> &coverage) {
+	const int end_x = coverage_x + coverage_width - 1;
+	const int end_y = coverage_y + coverage_height - 1;
+	const auto areas = index.find(coverage_x, coverage_y, end_x, end_y, z);
+	if (areas.empty()) {
+		return;
+	}
+
+	// Every area adds one at its top left corner and takes it back past its other
+	// corners, the running sums then give the count of each tile
+	const int stride = coverage_width + 1;
+	coverage_sums.assign(static_cast<size_t>(stride) * (coverage_height + 1), 0);
+	for (const SpawnIndex::Area &area : areas) {
+		const int left = std::max(area.center.x - area.radius, coverage_x) - coverage_x;
+		const int top = std::max(area.center.y - area.radius, coverage_y) - coverage_y;
+		const int right = std::min(area.center.x + area.radius, end_x) - coverage_x + 1;
+		const int bottom = std::min(area.center.y + area.radius, end_y) - coverage_y + 1;
+		++coverage_sums[top * stride + left];
+		--coverage_sums[top * stride + right];
+		--coverage_sums[bottom * stride + left];
+		++coverage_sums[bottom * stride + right];
+	}
+
+	coverage.resize(static_cast<size_t>(coverage_width) * coverage_height);
+	for (int y = 0; y < coverage_height; ++y) {
+		for (int x = 0; x < coverage_width; ++x) {
+			int &sum = coverage_sums[y * stride + x];
+			if (x > 0) {
+				sum += coverage_sums[y * stride + x - 1];
+			}
+			if (y > 0) {
+				sum += coverage_sums[(y - 1) * stride + x];
+			}
+			if (x > 0 && y > 0) {
+				sum -= coverage_sums[(y - 1) * stride + x - 1];
+			}
+			coverage[y * coverage_width + x] = static_cast<uint8_t>(std::min(sum, 255));
+		}
+	}
+}
+
+uint8_t MapDrawer::getSpawnCoverage(const std::vector<uint8_t> &coverage, const Position &position) const {
+	const int x = position.x - coverage_x;
+	const int y = position.y - coverage_y;
+	if (coverage.empty() || x < 0 || y < 0 || x >= coverage_width || y >= coverage_height) {
+		return 0;
+	}
+	return coverage[y * coverage_width + x];
+}
+
+bool MapDrawer::isOccluded(int x, int y, int z) const {
+	if (!occlusion_enabled || z <= end_z) {
+		return false;
+	}
+
+	// Large sprites reach one tile to the left and top, those cells must be covered too
+	const int shift = getFloorShift(z);
+	const int cell_x = x - shift - occlusion_x;
+	const int cell_y = y - shift - occlusion_y;
+	if (cell_x < 1 || cell_y < 1 || cell_x >= occlusion_width || cell_y >= occlusion_height) {
+		return false;
+	}
+
+	const uint64_t* covered = &occlusion[static_cast<size_t>(z - end_z) * occlusion_stride * occlusion_height];
+	auto isCovered = [&](int cx, int cy) {
+		return (covered[cy * occlusion_stride + (cx >> 6)] >> (cx & 63)) & 1;
+	};
+	return isCovered(cell_x, cell_y) && isCovered(cell_x - 1, cell_y) && isCovered(cell_x, cell_y - 1) && isCovered(cell_x - 1, cell_y - 1);
+}
+
+bool MapDrawer::isLeafOccluded(int nd_map_x, int nd_map_y, int z) const {
+	if (!occlusion_enabled || z <= end_z) {
+		return false;
+	}
+
+	for (int map_x = 0; map_x < 4; ++map_x) {
+		for (int map_y = 0; map_y < 4; ++map_y) {
+			if (!isOccluded(nd_map_x + map_x, nd_map_y + map_y, z)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 void MapDrawer::DrawSecondaryMap(int map_z) {
 	if (options.ingame) {
 		return;
@@ -643,6 +981,7 @@ void MapDrawer::DrawIngameBox() {
 }
 
 void MapDrawer::DrawGrid() {
+	sprite_batch->flush();
 	glDisable(GL_TEXTURE_2D);
 	glColor4ub(255, 255, 255, 128);
 	glBegin(GL_LINES);
@@ -803,6 +1142,7 @@ void MapDrawer::DrawSelectionBox() {
 	lines[3][2] = last_click_rx;
 	lines[3][3] = last_click_ry;
 
+	sprite_batch->flush();
 	glDisable(GL_TEXTURE_2D);
 	glEnable(GL_LINE_STIPPLE);
 	glLineStipple(2, 0xAAAA);
@@ -823,6 +1163,8 @@ void MapDrawer::DrawLiveCursors() {
 		return;
 	}
 
+	sprite_batch->flush();
+
 	LiveSocket &live = editor.GetLive();
 	for (LiveCursor &cursor : live.getCursorList()) {
 		if (cursor.pos.z <= rme::MapGroundLayer && floor > rme::MapGroundLayer) {
@@ -867,6 +1209,8 @@ void MapDrawer::DrawBrush() {
 		return;
 	}
 
+	sprite_batch->flush();
+
 	Brush* brush = g_gui.GetCurrentBrush();
 
 	BrushColor brushColor = COLOR_BLANK;
@@ -1625,18 +1969,20 @@ void MapDrawer::DrawTile(TileLocation* location) {
 				r = int(r * factor[idx]);
 			}
 
-			if (options.show_spawns_monster && location->getSpawnMonsterCount() > 0) {
+			const uint8_t spawn_monster_count = options.show_spawns_monster ? getSpawnCoverage(spawn_monster_coverage, position) : 0;
+			if (spawn_monster_count > 0) {
 				float f = 1.0f;
-				for (uint32_t i = 0; i < location->getSpawnMonsterCount(); ++i) {
+				for (uint32_t i = 0; i < spawn_monster_count; ++i) {
 					f *= 0.7f;
 				}
 				g = uint8_t(g * f);
 				b = uint8_t(b * f);
 			}
 
-			if (options.show_spawns_npc && location->getSpawnNpcCount() > 0) {
+			const uint8_t spawn_npc_count = options.show_spawns_npc ? getSpawnCoverage(spawn_npc_coverage, position) : 0;
+			if (spawn_npc_count > 0) {
 				float f = 1.0f;
-				for (uint32_t i = 0; i < location->getSpawnNpcCount(); ++i) {
+				for (uint32_t i = 0; i < spawn_npc_count; ++i) {
 					f *= 0.7f;
 				}
 				g = uint8_t(g * f);
@@ -1777,6 +2123,8 @@ void MapDrawer::DrawBrushIndicator(int x, int y, Brush* brush, uint8_t r, uint8_
 	// 6--5  3--2
 	//     \/
 	//     4
+	sprite_batch->flush();
+
 	static int vertexes[9][2] = {
 		{ -15, -20 }, // 0
 		{ 15, -20 }, // 1
@@ -1819,6 +2167,12 @@ void MapDrawer::DrawBrushIndicator(int x, int y, Brush* brush, uint8_t r, uint8_
 }
 
 void MapDrawer::DrawHookIndicator(int x, int y, const ItemType &type) {
+	if (render_cache->isRecording()) {
+		render_cache->discard();
+		return;
+	}
+
+	sprite_batch->flush();
 	glDisable(GL_TEXTURE_2D);
 	glColor4ub(uint8_t(0), uint8_t(0), uint8_t(255), uint8_t(200));
 	glBegin(GL_QUADS);
@@ -1970,6 +2324,7 @@ void MapDrawer::DrawTooltips() {
 		return;
 	}
 
+	sprite_batch->flush();
 	glDisable(GL_TEXTURE_2D);
 
 	for (MapTooltip* tooltip : tooltips) {
@@ -2122,6 +2477,25 @@ void MapDrawer::AddLight(TileLocation* location) {
 	}
 }
 
+void MapDrawer::RecordLights(TileLocation* location) {
+	Tile* tile = location ? location->get() : nullptr;
+	if (!tile) {
+		return;
+	}
+
+	// Lights are only drawn up to zoom 10, where items are never hidden
+	if (tile->ground && tile->ground->hasLight()) {
+		const SpriteLight &light = tile->ground->getLight();
+		render_cache->recordLight(light.color, light.intensity);
+	}
+	for (const Item* item : tile->items) {
+		if (item->hasLight()) {
+			const SpriteLight &light = item->getLight();
+			render_cache->recordLight(light.color, light.intensity);
+		}
+	}
+}
+
 void MapDrawer::getColor(Brush* brush, const Position &position, uint8_t &r, uint8_t &g, uint8_t &b) {
 	if (brush->canDraw(&editor.getMap(), position)) {
 		if (brush->isWaypoint()) {
@@ -2161,7 +2535,7 @@ void MapDrawer::glBlitTexture(int sx, int sy, int textureId, int red, int green,
 	auto height = rme::TileSize;
 	// Adjusts the offset of normal sprites
 	if (!isEditorSprite) {
-		SpriteSheetPtr sheet = g_spriteAppearances.getSheetBySpriteId(spriteId > 0 ? spriteId : textureId);
+		SpriteSheetPtr sheet = g_spriteAppearances.getSheetBySpriteId(spriteId > 0 ? spriteId : textureId, false);
 		if (!sheet) {
 			return;
 		}
@@ -2200,24 +2574,24 @@ void MapDrawer::glBlitTexture(int sx, int sy, int textureId, int red, int green,
 		spdlog::debug("Blitting outfit {} at ({}, {})", outfit.name, sx, sy);
 	}
 
-	// Texture State Caching: Only bind if different from current
-	if (g_currentTextureId != textureId) {
-		glBindTexture(GL_TEXTURE_2D, textureId);
-		g_currentTextureId = textureId;
-		g_textureBindsThisFrame++;
+	// Game sprites are addressed by sprite id and drawn from their atlas page
+	const TextureAtlas::Region* region = g_gui.gfx.getTextureAtlas().getRegion(textureId);
+	if (render_cache->isRecording()) {
+		// Only atlas sprites can be replayed, other textures may be gone by then
+		if (region) {
+			render_cache->record(textureId, sx, sy, width, height, uint8_t(red), uint8_t(green), uint8_t(blue), uint8_t(alpha));
+		} else {
+			render_cache->discard();
+		}
+		return;
 	}
-	
-	glColor4ub(uint8_t(red), uint8_t(green), uint8_t(blue), uint8_t(alpha));
-	glBegin(GL_QUADS);
-	glTexCoord2f(0.f, 0.f);
-	glVertex2f(sx, sy);
-	glTexCoord2f(1.f, 0.f);
-	glVertex2f(sx + width, sy);
-	glTexCoord2f(1.f, 1.f);
-	glVertex2f(sx + width, sy + height);
-	glTexCoord2f(0.f, 1.f);
-	glVertex2f(sx, sy + height);
-	glEnd();
+
+	if (region) {
+		sprite_batch->add(region->texture, sx, sy, width, height, uint8_t(red), uint8_t(green), uint8_t(blue), uint8_t(alpha), region->u0, region->v0, region->u1, region->v1);
+		return;
+	}
+
+	sprite_batch->add(textureId, sx, sy, width, height, uint8_t(red), uint8_t(green), uint8_t(blue), uint8_t(alpha));
 }
 
 void MapDrawer::glBlitSquare(int x, int y, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha, int size /* = rme::TileSize */) const {
@@ -2225,6 +2599,12 @@ void MapDrawer::glBlitSquare(int x, int y, uint8_t red, uint8_t green, uint8_t b
 	const auto dy = static_cast<double>(y);
 	const auto dSize = static_cast<double>(size);
 
+	if (render_cache->isRecording()) {
+		render_cache->record(0, x, y, size, size, red, green, blue, alpha);
+		return;
+	}
+
+	sprite_batch->flush();
 	glColor4ub(red, green, blue, alpha);
 	glBegin(GL_QUADS);
 	glVertex2f(dx, dy);
@@ -2239,6 +2619,12 @@ void MapDrawer::glBlitSquare(int x, int y, const wxColor &color, int size /* = r
 	const auto dy = static_cast<double>(y);
 	const auto dSize = static_cast<double>(size);
 
+	if (render_cache->isRecording()) {
+		render_cache->record(0, x, y, size, size, color.Red(), color.Green(), color.Blue(), color.Alpha());
+		return;
+	}
+
+	sprite_batch->flush();
 	glColor4ub(color.Red(), color.Green(), color.Blue(), color.Alpha());
 	glBegin(GL_QUADS);
 	glVertex2f(dx, dy);
@@ -2308,6 +2694,7 @@ void MapDrawer::glColorCheck(Brush* brush, const Position &pos) {
 }
 
 void MapDrawer::drawRect(int x, int y, int w, int h, const wxColor &color, int width) {
+	sprite_batch->flush();
 	glLineWidth(width);
 	glColor4ub(color.Red(), color.Green(), color.Blue(), color.Alpha());
 	glBegin(GL_LINE_STRIP);
@@ -2320,6 +2707,7 @@ void MapDrawer::drawRect(int x, int y, int w, int h, const wxColor &color, int w
 }
 
 void MapDrawer::drawFilledRect(int x, int y, int w, int h, const wxColor &color) {
+	sprite_batch->flush();
 	glColor4ub(color.Red(), color.Green(), color.Blue(), color.Alpha());
 	glBegin(GL_QUADS);
 	glVertex2f(x, y);
@@ -2329,6 +2717,14 @@ void MapDrawer::drawFilledRect(int x, int y, int w, int h, const wxColor &color)
 	glEnd();
 }
 
+int MapDrawer::getFloorShift(int z) const noexcept {
+	// Offset of a floor in tiles, see getDrawPosition
+	if (z <= rme::MapGroundLayer) {
+		return rme::MapGroundLayer - z;
+	}
+	return floor - z;
+}
+
 void MapDrawer::getDrawPosition(const Position &position, int &x, int &y) {
 	int offset;
 	if (position.z <= rme::MapGroundLayer) {
@@ -91,12 +91,17 @@ public:
 
 class MapCanvas;
 class LightDrawer;
+class SpriteBatch;
+class RenderCache;
+class SpawnIndex;
 
 class MapDrawer {
 	MapCanvas* canvas;
 	Editor &editor;
 	DrawingOptions options;
 	std::shared_ptr<LightDrawer> light_drawer;
+	std::shared_ptr<SpriteBatch> sprite_batch;
+	std::shared_ptr<RenderCache> render_cache;
 
 	float zoom;
 
@@ -110,6 +115,22 @@ class MapDrawer {
 	int tile_size;
 	int floor;
 
+	// Top-down occlusion of the lower floors, one bit per screen cell and floor,
+	// the storage is kept between frames and only rebuilt in place
+	std::vector<uint64_t> occlusion;
+	int occlusion_x, occlusion_y;
+	int occlusion_width, occlusion_height, occlusion_stride;
+	bool occlusion_enabled;
+
+	// Leaf and floor the sprite sheets were last prefetched around
+	int prefetch_x, prefetch_y, prefetch_floor;
+
+	// Number of spawn areas covering each tile of the floor being drawn, read from
+	// the spawn indexes once per floor instead of keeping a counter in every tile
+	std::vector<uint8_t> spawn_monster_coverage, spawn_npc_coverage;
+	std::vector<int> coverage_sums;
+	int coverage_x, coverage_y, coverage_width, coverage_height;
+
 protected:
 	std::vector<MapTooltip*> tooltips;
 	std::ostringstream tooltip;
@@ -166,6 +187,8 @@ protected:
 	void BlitCreature(int screenx, int screeny, const Npc* c, int red = 255, int green = 255, int blue = 255, int alpha = 255);
 	void BlitCreature(int screenx, int screeny, const Outfit &outfit, const Direction &dir, int red = 255, int green = 255, int blue = 255, int alpha = 255);
 	void DrawTile(TileLocation* tile);
+	void DrawLeafTiles(QTreeNode* node, int map_z);
+	void DrawCachedLeaf(QTreeNode* node, int nd_map_x, int nd_map_y, int map_z);
 	void DrawBrushIndicator(int x, int y, Brush* brush, uint8_t r, uint8_t g, uint8_t b);
 	void DrawHookIndicator(int x, int y, const ItemType &type);
 	void DrawLightStrength(int x, int y, const Item*&item);
@@ -178,6 +201,8 @@ protected:
 	void WriteTooltip(Container* container, std::ostringstream &stream);
 	void MakeTooltip(int screenx, int screeny, const std::string &text, uint8_t r = 255, uint8_t g = 255, uint8_t b = 255);
 	void AddLight(TileLocation* location);
+	// Stores the lights of a tile with the leaf being recorded by the render cache
+	void RecordLights(TileLocation* location);
 
 	enum BrushColor {
 		COLOR_BRUSH,
@@ -203,6 +228,17 @@ protected:
 
 private:
 	void getDrawPosition(const Position &position, int &x, int &y);
+	int getFloorShift(int z) const noexcept;
+
+	void BuildOcclusion(bool live_client);
+	// Queues the sprite sheets of the view and the area around it for background decoding
+	void PrefetchSheets();
+	bool isOccluded(int x, int y, int z) const;
+	bool isLeafOccluded(int nd_map_x, int nd_map_y, int z) const;
+
+	void BuildSpawnCoverage(int start_x, int start_y, int end_x, int end_y, int z);
+	void FillSpawnCoverage(const SpawnIndex &index, int z, std::vector<uint8_t> &coverage);
+	uint8_t getSpawnCoverage(const std::vector<uint8_t> &coverage, const Position &position) const;
 };
 
 #endif
@@ -22,15 +22,20 @@
 #include "position.h"
 #include "tile.h"
 
+#include <atomic>
+
 //**************** Tile Location **********************
 
+static std::atomic<uint32_t> g_tileLocationRevision { 0 };
+
 TileLocation::TileLocation() :
 	tile(nullptr),
 	position(0, 0, 0),
 	spawn_monster_count(0),
 	spawn_npc_count(0),
 	waypoint_count(0),
-	house_exits(nullptr) {
+	house_exits(nullptr),
+	revision(0) {
 	////
 }
 
@@ -50,6 +55,10 @@ bool TileLocation::empty() const {
 	return size() == 0;
 }
 
+void TileLocation::touch() noexcept {
+	revision = g_tileLocationRevision.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 HouseExitList* TileLocation::createHouseExits() {
 	if (!house_exits) {
 		house_exits = new HouseExitList();
@@ -67,6 +76,7 @@ Floor::Floor(int sx, int sy, int z) {
 		locs[i].position.x = sx + (i >> 2);
 		locs[i].position.y = sy + (i & 3);
 		locs[i].position.z = z;
+		locs[i].touch();
 	}
 }
 
@@ -75,7 +85,8 @@ Floor::Floor(int sx, int sy, int z) {
 QTreeNode::QTreeNode(BaseMap &map) :
 	map(map),
 	visible(0),
-	isLeaf(false) {
+	isLeaf(false),
+	changed_floors(0) {
 	// Doesn't matter if we're leaf or node
 	for (int i = 0; i < rme::MapLayers; ++i) {
 		child[i] = nullptr;
@@ -83,15 +94,7 @@ QTreeNode::QTreeNode(BaseMap &map) :
 }
 
 QTreeNode::~QTreeNode() {
-	if (isLeaf) {
-		for (int i = 0; i < rme::MapLayers; ++i) {
-			delete array[i];
-		}
-	} else {
-		for (int i = 0; i < rme::MapLayers; ++i) {
-			delete child[i];
-		}
-	}
+	////
 }
 
 QTreeNode* QTreeNode::getLeaf(int x, int y) {
@@ -129,11 +132,12 @@ QTreeNode* QTreeNode::getLeafForce(int x, int y) {
 
 		} else {
 			if (level == 0) {
-				qt = newd QTreeNode(map);
+				qt = map.allocator.allocateNode(map);
 				qt->isLeaf = true;
+				map.leaf_directory_outdated = true;
 				return qt;
 			} else {
-				qt = newd QTreeNode(map);
+				qt = map.allocator.allocateNode(map);
 			}
 		}
 		node = node->child[index];
@@ -145,10 +149,53 @@ QTreeNode* QTreeNode::getLeafForce(int x, int y) {
 	return nullptr;
 }
 
+void QTreeNode::setChanged(int x, int y, int z) {
+	const uint16_t floor = 1 << z;
+	QTreeNode* node = this;
+	uint32_t cx = x, cy = y;
+	while (node) {
+		node->changed_floors |= floor;
+		if (node->isLeaf) {
+			return;
+		}
+		uint32_t index = ((cx & 0xC000) >> 14) | ((cy & 0xC000) >> 12);
+		node = node->child[index];
+		cx <<= 2;
+		cy <<= 2;
+	}
+}
+
+void QTreeNode::clearChanged() {
+	// Nodes below an unchanged node are unchanged as well
+	if (changed_floors == 0) {
+		return;
+	}
+	changed_floors = 0;
+	if (!isLeaf) {
+		for (int i = 0; i < rme::MapLayers; ++i) {
+			if (child[i]) {
+				child[i]->clearChanged();
+			}
+		}
+	}
+}
+
+void QTreeNode::getLeaves(std::vector<QTreeNode*> &leaves) {
+	if (isLeaf) {
+		leaves.push_back(this);
+		return;
+	}
+	for (int i = 0; i < rme::MapLayers; ++i) {
+		if (child[i]) {
+			child[i]->getLeaves(leaves);
+		}
+	}
+}
+
 Floor* QTreeNode::createFloor(int x, int y, int z) {
 	ASSERT(isLeaf);
 	if (!array[z]) {
-		array[z] = newd Floor(x, y, z);
+		array[z] = map.allocator.allocateFloor(x, y, z);
 	}
 	return array[z];
 }
@@ -242,6 +289,7 @@ Tile* QTreeNode::setTile(int x, int y, int z, Tile* newtile) {
 	TileLocation* tmp = &f->locs[offset_x * 4 + offset_y];
 	Tile* oldtile = tmp->tile;
 	tmp->tile = newtile;
+	tmp->touch();
 
 	if (newtile && !oldtile) {
 		++map.tilecount;
@@ -262,4 +310,5 @@ void QTreeNode::clearTile(int x, int y, int z) {
 	TileLocation* tmp = &f->locs[offset_x * 4 + offset_y];
 	delete tmp->tile;
 	tmp->tile = map.allocator(tmp);
+	tmp->touch();
 }
@@ -41,6 +41,7 @@ protected:
 	size_t spawn_npc_count;
 	size_t waypoint_count;
 	HouseExitList* house_exits; // Any house exits pointing here
+	uint32_t revision;
 
 public:
 	// Access tile
@@ -68,14 +69,23 @@ public:
 		return position.z;
 	}
 
+	// Changes whenever the tile or anything drawn along with it is replaced,
+	// revisions are unique across the map so cached render data can be validated
+	uint32_t getRevision() const noexcept {
+		return revision;
+	}
+	void touch() noexcept;
+
 	size_t getSpawnMonsterCount() const noexcept {
 		return spawn_monster_count;
 	}
 	void increaseSpawnCount() noexcept {
 		spawn_monster_count++;
+		touch();
 	}
 	void decreaseSpawnMonsterCount() noexcept {
 		spawn_monster_count--;
+		touch();
 	}
 
 	size_t getSpawnNpcCount() const noexcept {
@@ -83,9 +93,11 @@ public:
 	}
 	void increaseSpawnNpcCount() noexcept {
 		spawn_npc_count++;
+		touch();
 	}
 	void decreaseSpawnNpcCount() noexcept {
 		spawn_npc_count--;
+		touch();
 	}
 
 	size_t getWaypointCount() const noexcept {
@@ -105,15 +117,20 @@ public:
 	friend class Floor;
 	friend class QTreeNode;
 	friend class Waypoints;
+	friend class BaseMap;
 };
 
 class Floor {
 public:
+	// Only created by MapAllocator, and dropped together with the other floors of the map
 	Floor(int x, int y, int z);
+
 	TileLocation locs[rme::MapLayers];
 };
 
 // This is not a QuadTree, but a HexTree (16 child nodes to every node), so the name is abit misleading
+// Nodes below the root are created by MapAllocator and dropped together with the
+// floors, see BaseMap::releaseTree
 class QTreeNode {
 public:
 	QTreeNode(BaseMap &map);
@@ -149,11 +166,23 @@ public:
 	bool isVisible(bool underground);
 	bool isRequested(bool underground);
 
+	// Bit z is set while a tile on floor z below this node was replaced since the
+	// map was last saved. Coordinates of setChanged are NOT relative.
+	uint16_t getChangedFloors() const noexcept {
+		return changed_floors;
+	}
+	void setChanged(int x, int y, int z);
+	void clearChanged();
+
+	// Appends the leaves below this node in the order the map iterator visits them
+	void getLeaves(std::vector<QTreeNode*> &leaves);
+
 protected:
 	BaseMap &map;
 	uint32_t visible;
 
 	bool isLeaf;
+	uint16_t changed_floors;
 
 	union {
 		QTreeNode* child[rme::MapLayers];
@@ -55,6 +55,7 @@ MapTab::~MapTab() {
 	if (iref->owner_count <= 0) {
 		delete iref->editor;
 		delete iref;
+		MapAllocator::releaseUnused();
 	}
 }
 
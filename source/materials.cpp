@@ -27,9 +27,61 @@
 #include "monster_brush.h"
 #include "npc_brush.h"
 #include "raw_brush.h"
+#include "startup_cache.h"
 
 Materials g_materials;
 
+namespace {
+	// Startup cache section of the materials files, a node for every file that
+	// was read with the nodes of its document below it
+	constexpr uint8_t MaterialsCacheFileNode = 1;
+
+	void writeXmlNodes(NodeFileWriteHandle &writer, pugi::xml_node parent) {
+		for (pugi::xml_node node = parent.first_child(); node; node = node.next_sibling()) {
+			writer.addNode(static_cast<uint8_t>(node.type()));
+			writer.addString(std::string(node.name()));
+			writer.addLongString(std::string(node.value()));
+			const auto attributes = node.attributes();
+			writer.addU16(static_cast<uint16_t>(std::distance(attributes.begin(), attributes.end())));
+			for (const pugi::xml_attribute &attribute : attributes) {
+				writer.addString(std::string(attribute.name()));
+				writer.addLongString(std::string(attribute.value()));
+			}
+			writeXmlNodes(writer, node);
+			writer.endNode();
+		}
+	}
+
+	bool readXmlNodes(BinaryNode* parent, pugi::xml_node target) {
+		for (BinaryNode* child = parent->getChild(); child != nullptr; child = child->advance()) {
+			uint8_t type = 0;
+			std::string name;
+			std::string value;
+			uint16_t attributes = 0;
+			if (!child->getU8(type) || !child->getString(name) || !child->getLongString(value) || !child->getU16(attributes)) {
+				return false;
+			}
+
+			pugi::xml_node node = target.append_child(static_cast<pugi::xml_node_type>(type));
+			if (!node || (!name.empty() && !node.set_name(name.c_str())) || (!value.empty() && !node.set_value(value.c_str()))) {
+				return false;
+			}
+
+			for (uint16_t i = 0; i < attributes; ++i) {
+				if (!child->getString(name) || !child->getLongString(value)) {
+					return false;
+				}
+				node.append_attribute(name.c_str()).set_value(value.c_str());
+			}
+
+			if (!readXmlNodes(child, node)) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
 Materials::Materials() {
 	////
 }
@@ -47,14 +99,46 @@ void Materials::clear() {
 }
 
 bool Materials::loadMaterials(const FileName &identifier, wxString &error, wxArrayString &warnings) {
-	pugi::xml_document doc;
-	pugi::xml_parse_result result = doc.load_file(identifier.GetFullPath().mb_str());
-	if (!result) {
-		warnings.push_back("Could not open " + identifier.GetFullName() + " (file not found or syntax error)");
-		return false;
+	// The brushes and tilesets point into the item database and each other,
+	// they are made again from the documents on every launch
+	BinaryNode* root = g_startupCache.getSection(StartupCache::SECTION_MATERIALS, identifier);
+	const bool cached = root && readMaterialsCache(root);
+	if (cached) {
+		spdlog::info("[Materials::loadMaterials] Read {} files from the startup cache", documents.size());
+	}
+
+	const bool loaded = loadMaterialsFile(identifier, error, warnings);
+	if (!cached && loaded) {
+		MemoryNodeFileWriteHandle writer;
+		writeMaterialsCache(writer);
+		g_startupCache.setSection(StartupCache::SECTION_MATERIALS, documentSources, writer);
 	}
 
-	pugi::xml_node node = doc.child("materials");
+	documents.clear();
+	documentSources.clear();
+	return loaded;
+}
+
+bool Materials::loadMaterialsFile(const FileName &identifier, wxString &error, wxArrayString &warnings) {
+	const std::string path = nstr(identifier.GetFullPath());
+	auto document = documents.find(path);
+	if (document == documents.end()) {
+		// Files that couldn't be read are listed as well, the cache is
+		// outdated once they appear
+		if (std::find(documentSources.begin(), documentSources.end(), identifier) == documentSources.end()) {
+			documentSources.push_back(identifier);
+		}
+
+		document = documents.try_emplace(path).first;
+		pugi::xml_parse_result result = document->second.load_file(identifier.GetFullPath().mb_str());
+		if (!result) {
+			documents.erase(document);
+			warnings.push_back("Could not open " + identifier.GetFullName() + " (file not found or syntax error)");
+			return false;
+		}
+	}
+
+	pugi::xml_node node = document->second.child("materials");
 	if (!node) {
 		warnings.push_back(identifier.GetFullName() + ": Invalid rootheader.");
 		return false;
@@ -64,6 +148,34 @@ bool Materials::loadMaterials(const FileName &identifier, wxString &error, wxArr
 	return true;
 }
 
+bool Materials::readMaterialsCache(BinaryNode* root) {
+	for (BinaryNode* fileNode = root->getChild(); fileNode != nullptr; fileNode = fileNode->advance()) {
+		uint8_t type = 0;
+		std::string path;
+		if (!fileNode->getU8(type) || type != MaterialsCacheFileNode || !fileNode->getString(path) || !readXmlNodes(fileNode, documents[path])) {
+			documents.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+void Materials::writeMaterialsCache(NodeFileWriteHandle &writer) const {
+	writer.addNode(0);
+	for (const FileName &source : documentSources) {
+		const auto document = documents.find(nstr(source.GetFullPath()));
+		if (document == documents.end()) {
+			continue;
+		}
+
+		writer.addNode(MaterialsCacheFileNode);
+		writer.addString(document->first);
+		writeXmlNodes(writer, document->second);
+		writer.endNode();
+	}
+	writer.endNode();
+}
+
 bool Materials::unserializeMaterials(const FileName &filename, pugi::xml_node node, wxString &error, wxArrayString &warnings) {
 	wxString warning;
 	pugi::xml_attribute attribute;
@@ -79,7 +191,7 @@ bool Materials::unserializeMaterials(const FileName &filename, pugi::xml_node no
 			includeName.SetName(wxString(attribute.as_string(), wxConvUTF8));
 
 			wxString subError;
-			if (!loadMaterials(includeName, subError, warnings)) {
+			if (!loadMaterialsFile(includeName, subError, warnings)) {
 				warnings.push_back("Error while loading file \"" + includeName.GetFullName() + "\": " + subError);
 			}
 		} else if (childName == "metaitem") {
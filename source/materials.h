@@ -20,6 +20,9 @@
 
 #include "tileset.h"
 
+class BinaryNode;
+class NodeFileWriteHandle;
+
 using TilesetContainer = std::map<std::string, Tileset*>;
 
 class Materials {
@@ -47,11 +50,21 @@ public:
 	}
 
 protected:
+	bool loadMaterialsFile(const FileName &identifier, wxString &error, wxArrayString &warnings);
+	bool readMaterialsCache(BinaryNode* root);
+	void writeMaterialsCache(NodeFileWriteHandle &writer) const;
+
 	bool unserializeMaterials(const FileName &filename, pugi::xml_node node, wxString &error, wxArrayString &warnings);
 	bool unserializeTileset(pugi::xml_node node, wxArrayString &warnings);
 
 private:
 	bool modified = false;
+
+	// Documents of the materials files while they are loaded, read from the
+	// startup cache or from the files, and every file that was read from disk
+	std::map<std::string, pugi::xml_document> documents;
+	std::vector<FileName> documentSources;
+
 	Materials(const Materials &);
 	Materials &operator=(const Materials &);
 };
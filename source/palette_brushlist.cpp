@@ -429,6 +429,14 @@ void BrushPanel::LoadContents() {
 	}
 	loaded = true;
 	ASSERT(tileset != nullptr);
+
+	// The icons are drawn right away, let the sheets they need decode in parallel meanwhile
+	for (const Brush* brush : tileset->brushlist) {
+		if (const auto sprite = dynamic_cast<GameSprite*>(g_gui.gfx.getSprite(brush->getLookID())); sprite) {
+			sprite->prefetchSheets();
+		}
+	}
+
 	switch (listType) {
 		case BRUSHLIST_LARGE_ICONS:
 			brushbox = newd BrushIconBox(this, tileset, RENDER_SIZE_32x32);
@@ -329,12 +329,12 @@ void HousePalettePanel::OnListBoxDoubleClick(wxCommandEvent &event) {
 			return;
 		}
 
-		// find a valid tile position
-		for (const Position &tilePosition : house->getTiles()) {
-			if (tilePosition.isValid()) {
-				g_gui.SetScreenCenterPosition(tilePosition);
-				break;
-			}
+		// no exit, look at the middle of the house instead
+		const Position &start = house->getBoundsStart();
+		const Position &end = house->getBoundsEnd();
+		const Position center((start.x + end.x) / 2, (start.y + end.y) / 2, end.z);
+		if (center.isValid()) {
+			g_gui.SetScreenCenterPosition(center);
 		}
 	}
 }
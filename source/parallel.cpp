@@ -0,0 +1,101 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "parallel.h"
+#include "settings.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+size_t rme::getWorkerThreadCount() {
+	return static_cast<size_t>(std::max(g_settings.getInteger(Config::PARALLEL_THREADS), 1));
+}
+
+void rme::parallelFor(size_t count, const std::function<void(size_t)> &task, const std::function<void(size_t)> &progress) {
+	if (count == 0) {
+		return;
+	}
+
+	const size_t threads = std::min(getWorkerThreadCount(), count);
+	if (threads == 1) {
+		for (size_t i = 0; i < count; ++i) {
+			task(i);
+			if (progress) {
+				progress(i + 1);
+			}
+		}
+		return;
+	}
+
+	std::atomic<size_t> next = 0;
+	std::atomic<size_t> done = 0;
+	std::mutex mutex;
+	std::condition_variable task_done;
+	std::exception_ptr failure;
+
+	const auto work = [&]() {
+		size_t index;
+		while ((index = next.fetch_add(1)) < count) {
+			try {
+				task(index);
+			} catch (...) {
+				std::scoped_lock lock(mutex);
+				if (!failure) {
+					failure = std::current_exception();
+				}
+				// Nothing else is started once a task failed
+				next = count;
+			}
+			done.fetch_add(1);
+			if (progress) {
+				std::scoped_lock lock(mutex);
+				task_done.notify_one();
+			}
+		}
+	};
+
+	// Without a progress callback the calling thread takes a share of the work
+	std::vector<std::thread> workers;
+	workers.reserve(threads);
+	for (size_t i = progress ? 0 : 1; i < threads; ++i) {
+		workers.emplace_back(work);
+	}
+
+	if (progress) {
+		std::unique_lock lock(mutex);
+		while (done < count && !failure) {
+			task_done.wait_for(lock, std::chrono::milliseconds(50));
+			lock.unlock();
+			progress(done);
+			lock.lock();
+		}
+	} else {
+		work();
+	}
+
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+
+	if (failure) {
+		std::rethrow_exception(failure);
+	}
+}
@@ -0,0 +1,37 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_PARALLEL_H_
+#define RME_PARALLEL_H_
+
+#include <functional>
+
+namespace rme {
+	// Number of threads parallelFor may use, taken from the "Parallel Threads"
+	// preference and never less than one.
+	size_t getWorkerThreadCount();
+
+	// Runs task(i) for every i in [0, count) on up to getWorkerThreadCount()
+	// threads and returns once all of them are done. Tasks are handed out in
+	// increasing order but may finish in any order, a single thread or task runs
+	// inline. progress(done) is only called on the calling thread, which then just
+	// waits for the workers, whenever a task finished or at least every 50 ms.
+	// It is safe to update the load bar or consume finished results from it.
+	void parallelFor(size_t count, const std::function<void(size_t)> &task, const std::function<void(size_t)> &progress = nullptr);
+}
+
+#endif
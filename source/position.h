@@ -22,6 +22,7 @@
 #include <cstdint>
 #include <vector>
 #include <list>
+#include <functional>
 
 class Position {
 public:
@@ -141,4 +142,13 @@ inline Position abs(const Position &position) {
 typedef std::vector<Position> PositionVector;
 typedef std::list<Position> PositionList;
 
+namespace std {
+	template <>
+	struct hash<Position> {
+		size_t operator()(const Position &position) const noexcept {
+			return hash<uint64_t>()(static_cast<uint64_t>(position.x & 0xFFFF) << 24 | static_cast<uint64_t>(position.y & 0xFFFF) << 8 | static_cast<uint64_t>(position.z & 0xFF));
+		}
+	};
+}
+
 #endif
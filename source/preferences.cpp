@@ -23,6 +23,7 @@
 #include "gui.h"
 
 #include "preferences.h"
+#include "sprite_appearances.h"
 
 BEGIN_EVENT_TABLE(PreferencesWindow, wxDialog)
 EVT_BUTTON(wxID_OK, PreferencesWindow::OnClickOK)
@@ -77,6 +78,11 @@ wxNotebookPage* PreferencesWindow::CreateGeneralPage() {
 	always_make_backup_chkbox->SetValue(g_settings.getInteger(Config::ALWAYS_MAKE_BACKUP) == 1);
 	sizer->Add(always_make_backup_chkbox, 0, wxLEFT | wxTOP, 5);
 
+	incremental_save_chkbox = newd wxCheckBox(general_page, wxID_ANY, "Only save changed map areas again");
+	incremental_save_chkbox->SetValue(g_settings.getInteger(Config::INCREMENTAL_SAVE) == 1);
+	incremental_save_chkbox->SetToolTip("Keeps the map data of the last save in memory and reuses it for areas that weren't edited since, which makes saving big maps much faster. This costs about as much memory as the size of the map file for as long as the map is open, and the map file is written with one tile area node per 256x256 area and floor.");
+	sizer->Add(incremental_save_chkbox, 0, wxLEFT | wxTOP, 5);
+
 	update_check_on_startup_chkbox = newd wxCheckBox(general_page, wxID_ANY, "Check for updates on startup");
 	update_check_on_startup_chkbox->SetValue(g_settings.getInteger(Config::USE_UPDATER) == 1);
 	sizer->Add(update_check_on_startup_chkbox, 0, wxLEFT | wxTOP, 5);
@@ -109,13 +115,23 @@ wxNotebookPage* PreferencesWindow::CreateGeneralPage() {
 	grid_sizer->Add(tmptext = newd wxStaticText(general_page, wxID_ANY, "Undo maximum memory size (MB): "), 0);
 	undo_mem_size_spin = newd wxSpinCtrl(general_page, wxID_ANY, i2ws(g_settings.getInteger(Config::UNDO_MEM_SIZE)), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 4096);
 	grid_sizer->Add(undo_mem_size_spin, 0);
-	SetWindowToolTip(tmptext, undo_mem_size_spin, "The approximite limit for the memory usage of the undo queue.");
+	SetWindowToolTip(tmptext, undo_mem_size_spin, "The approximite limit for the memory usage of the undo queue, steps kept on disk don't count.");
+
+	grid_sizer->Add(tmptext = newd wxStaticText(general_page, wxID_ANY, "Undo resident memory size (MB): "), 0);
+	undo_resident_size_spin = newd wxSpinCtrl(general_page, wxID_ANY, i2ws(g_settings.getInteger(Config::UNDO_RESIDENT_SIZE)), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 4096);
+	grid_sizer->Add(undo_resident_size_spin, 0);
+	SetWindowToolTip(tmptext, undo_resident_size_spin, "Once the undo queue uses more memory than this, older steps are compressed into a temporary file. 0 keeps all steps in memory.");
 
 	grid_sizer->Add(tmptext = newd wxStaticText(general_page, wxID_ANY, "Worker Threads: "), 0);
 	worker_threads_spin = newd wxSpinCtrl(general_page, wxID_ANY, i2ws(g_settings.getInteger(Config::WORKER_THREADS)), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 1, 64);
 	grid_sizer->Add(worker_threads_spin, 0);
 	SetWindowToolTip(tmptext, worker_threads_spin, "How many threads the editor will use for intensive operations. This should be equivalent to the amount of logical processors in your system.");
 
+	grid_sizer->Add(tmptext = newd wxStaticText(general_page, wxID_ANY, "Parallel Threads: "), 0);
+	parallel_threads_spin = newd wxSpinCtrl(general_page, wxID_ANY, i2ws(g_settings.getInteger(Config::PARALLEL_THREADS)), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 1, 256);
+	grid_sizer->Add(parallel_threads_spin, 0);
+	SetWindowToolTip(tmptext, parallel_threads_spin, "How many threads loading maps and map wide operations such as searches and cleanups run on. Defaults to the amount of logical processors in your system.");
+
 	grid_sizer->Add(tmptext = newd wxStaticText(general_page, wxID_ANY, "Replace count: "), 0);
 	replace_size_spin = newd wxSpinCtrl(general_page, wxID_ANY, i2ws(g_settings.getInteger(Config::REPLACE_SIZE)), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 100000);
 	grid_sizer->Add(replace_size_spin, 0);
@@ -255,6 +271,11 @@ wxNotebookPage* PreferencesWindow::CreateGraphicsPage() {
 	sizer->Add(hide_items_when_zoomed_chkbox, 0, wxLEFT | wxTOP, 5);
 	SetWindowToolTip(hide_items_when_zoomed_chkbox, "When this option is checked, \"loose\" items will be hidden when you zoom very far out.");
 
+	use_vertex_buffers_chkbox = newd wxCheckBox(graphics_page, wxID_ANY, "Use vertex buffers for map rendering");
+	use_vertex_buffers_chkbox->SetValue(g_settings.getBoolean(Config::USE_VERTEX_BUFFERS));
+	sizer->Add(use_vertex_buffers_chkbox, 0, wxLEFT | wxTOP, 5);
+	SetWindowToolTip(use_vertex_buffers_chkbox, "Upload batched sprites through a vertex buffer object. Disable this if the map renders incorrectly with your graphics driver. Takes effect on newly opened maps.");
+
 	icon_selection_shadow_chkbox = newd wxCheckBox(graphics_page, wxID_ANY, "Use icon selection shadow");
 	icon_selection_shadow_chkbox->SetValue(g_settings.getBoolean(Config::USE_GUI_SELECTION_SHADOW));
 	sizer->Add(icon_selection_shadow_chkbox, 0, wxLEFT | wxTOP, 5);
@@ -304,6 +325,19 @@ wxNotebookPage* PreferencesWindow::CreateGraphicsPage() {
 	subsizer->Add(cursor_alt_color_pick = newd wxColourPickerCtrl(graphics_page, wxID_ANY, wxColor(g_settings.getInteger(Config::CURSOR_ALT_RED), g_settings.getInteger(Config::CURSOR_ALT_GREEN), g_settings.getInteger(Config::CURSOR_ALT_BLUE), g_settings.getInteger(Config::CURSOR_ALT_ALPHA))), 0);
 	SetWindowToolTip(icon_background_choice, tmp, "The color of the secondary cursor on the map (for houses and flags).");
 
+	// Sprite sheet cache
+	subsizer->Add(tmp = newd wxStaticText(graphics_page, wxID_ANY, "Sprite sheet memory (MB): "), 0);
+	sprite_sheet_memory_spin = newd wxSpinCtrl(graphics_page, wxID_ANY, i2ws(g_settings.getInteger(Config::SPRITE_SHEET_MEMORY)), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 0x10000);
+	subsizer->Add(sprite_sheet_memory_spin, 0);
+	SetWindowToolTip(sprite_sheet_memory_spin, tmp, "How much memory decoded sprite sheets and the single sprites cut out of them may use. The least recently used ones are released when it is exceeded, 0 keeps everything.");
+
+	const SpriteAppearances::SheetCacheStats stats = g_spriteAppearances.getSheetCacheStats();
+	const uint64_t lookups = stats.hits + stats.misses;
+	subsizer->Add(newd wxStaticText(graphics_page, wxID_ANY, "Sprite sheet cache: "), 0);
+	subsizer->Add(newd wxStaticText(graphics_page, wxID_ANY, wxString::Format("%zu sheets resident (%zu MB), %.1f%% hit rate", stats.residentSheets, stats.residentBytes / (1024 * 1024), lookups > 0 ? stats.hits * 100.0 / lookups : 0.0)), 0);
+	subsizer->Add(newd wxStaticText(graphics_page, wxID_ANY, "Sprite cache: "), 0);
+	subsizer->Add(newd wxStaticText(graphics_page, wxID_ANY, wxString::Format("%zu sprites (%zu MB)", stats.cachedSprites, stats.cachedSpriteBytes / (1024 * 1024))), 0);
+
 	// Screenshot dir
 	subsizer->Add(tmp = newd wxStaticText(graphics_page, wxID_ANY, "Screenshot directory: "), 0);
 	screenshot_directory_picker = newd wxDirPickerCtrl(graphics_page, wxID_ANY);
@@ -603,11 +637,14 @@ void PreferencesWindow::Apply() {
 	// General
 	g_settings.setInteger(Config::WELCOME_DIALOG, show_welcome_dialog_chkbox->GetValue());
 	g_settings.setInteger(Config::ALWAYS_MAKE_BACKUP, always_make_backup_chkbox->GetValue());
+	g_settings.setInteger(Config::INCREMENTAL_SAVE, incremental_save_chkbox->GetValue());
 	g_settings.setInteger(Config::USE_UPDATER, update_check_on_startup_chkbox->GetValue());
 	g_settings.setInteger(Config::ONLY_ONE_INSTANCE, only_one_instance_chkbox->GetValue());
 	g_settings.setInteger(Config::UNDO_SIZE, undo_size_spin->GetValue());
 	g_settings.setInteger(Config::UNDO_MEM_SIZE, undo_mem_size_spin->GetValue());
+	g_settings.setInteger(Config::UNDO_RESIDENT_SIZE, undo_resident_size_spin->GetValue());
 	g_settings.setInteger(Config::WORKER_THREADS, worker_threads_spin->GetValue());
+	g_settings.setInteger(Config::PARALLEL_THREADS, parallel_threads_spin->GetValue());
 	g_settings.setInteger(Config::REPLACE_SIZE, replace_size_spin->GetValue());
 	g_settings.setInteger(Config::DELETE_BACKUP_DAYS, delete_backup_days_spin->GetValue());
 	g_settings.setInteger(Config::COPY_POSITION_FORMAT, position_format->GetSelection());
@@ -678,6 +715,11 @@ void PreferencesWindow::Apply() {
 	// g_settings.setInteger(Config::CURSOR_ALT_ALPHA, clr.Alpha());
 
 	g_settings.setInteger(Config::HIDE_ITEMS_WHEN_ZOOMED, hide_items_when_zoomed_chkbox->GetValue());
+	g_settings.setInteger(Config::USE_VERTEX_BUFFERS, use_vertex_buffers_chkbox->GetValue());
+	if (g_settings.getInteger(Config::SPRITE_SHEET_MEMORY) != sprite_sheet_memory_spin->GetValue()) {
+		g_settings.setInteger(Config::SPRITE_SHEET_MEMORY, sprite_sheet_memory_spin->GetValue());
+		g_spriteAppearances.trimSheets();
+	}
 	/*
 	g_settings.setInteger(Config::TEXTURE_MANAGEMENT, texture_managment_chkbox->GetValue());
 	g_settings.setInteger(Config::TEXTURE_CLEAN_PULSE, clean_interval_spin->GetValue());
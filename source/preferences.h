@@ -43,6 +43,7 @@ protected:
 
 	// General
 	wxCheckBox* always_make_backup_chkbox;
+	wxCheckBox* incremental_save_chkbox;
 	wxCheckBox* create_on_startup_chkbox;
 	wxCheckBox* update_check_on_startup_chkbox;
 	wxCheckBox* only_one_instance_chkbox;
@@ -51,7 +52,9 @@ protected:
 	wxCheckBox* use_old_item_properties_window;
 	wxSpinCtrl* undo_size_spin;
 	wxSpinCtrl* undo_mem_size_spin;
+	wxSpinCtrl* undo_resident_size_spin;
 	wxSpinCtrl* worker_threads_spin;
+	wxSpinCtrl* parallel_threads_spin;
 	wxSpinCtrl* replace_size_spin;
 	wxSpinCtrl* delete_backup_days_spin;
 	wxRadioBox* position_format;
@@ -78,6 +81,8 @@ protected:
 	wxDirPickerCtrl* screenshot_directory_picker;
 	wxChoice* screenshot_format_choice;
 	wxCheckBox* hide_items_when_zoomed_chkbox;
+	wxCheckBox* use_vertex_buffers_chkbox;
+	wxSpinCtrl* sprite_sheet_memory_spin;
 	wxColourPickerCtrl* cursor_color_pick;
 	wxColourPickerCtrl* cursor_alt_color_pick;
 	wxTextCtrl* palette_icons_col_size;
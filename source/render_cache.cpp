@@ -0,0 +1,116 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "render_cache.h"
+#include "map_region.h"
+
+namespace {
+	// Entries that weren't drawn for this many frames are dropped
+	constexpr uint32_t EntryLifetime = 600;
+	constexpr uint32_t PurgeInterval = 120;
+}
+
+RenderCache::RenderCache() :
+	recording(nullptr),
+	recording_tile(0),
+	offset_x(0),
+	offset_y(0),
+	frame(0) {
+	////
+}
+
+RenderCache::Entry &RenderCache::get(int x, int y, int z) {
+	const uint64_t key = (static_cast<uint64_t>(x >> 2) << 32) | (static_cast<uint64_t>(y >> 2) << 8) | static_cast<uint64_t>(z);
+	Entry &entry = entries[key];
+	entry.lastframe = frame;
+	return entry;
+}
+
+void RenderCache::nextFrame() {
+	++frame;
+	if (frame % PurgeInterval != 0) {
+		return;
+	}
+
+	for (auto it = entries.begin(); it != entries.end();) {
+		if (frame - it->second.lastframe > EntryLifetime) {
+			it = entries.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void RenderCache::clear() {
+	entries.clear();
+	recording = nullptr;
+}
+
+uint32_t RenderCache::getRevision(QTreeNode* node, int z) {
+	Floor* floor = node->getFloor(z);
+	if (!floor) {
+		return 0;
+	}
+
+	uint32_t revision = 0;
+	for (const TileLocation &location : floor->locs) {
+		revision = std::max(revision, location.getRevision());
+	}
+	return revision;
+}
+
+void RenderCache::startRecording(Entry &entry, uint32_t revision, int x, int y) {
+	entry.state = state;
+	entry.revision = revision;
+	entry.commands.clear();
+	entry.lights.clear();
+	entry.valid = true;
+	entry.cacheable = true;
+
+	recording = &entry;
+	recording_tile = 0;
+	offset_x = x;
+	offset_y = y;
+}
+
+void RenderCache::record(uint32_t sprite, float x, float y, float width, float height, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) {
+	if (!recording || !recording->cacheable) {
+		return;
+	}
+	recording->commands.push_back(Command { sprite, x + offset_x, y + offset_y, width, height, red, green, blue, alpha, recording_tile });
+}
+
+void RenderCache::recordLight(uint8_t color, uint8_t intensity) {
+	if (!recording || !recording->cacheable) {
+		return;
+	}
+	recording->lights.push_back(Light { recording_tile, color, intensity });
+}
+
+void RenderCache::discard() noexcept {
+	if (recording) {
+		recording->cacheable = false;
+		recording->commands.clear();
+		recording->lights.clear();
+	}
+}
+
+void RenderCache::stopRecording() noexcept {
+	recording = nullptr;
+}
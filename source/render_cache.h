@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_RENDER_CACHE_H_
+#define RME_RENDER_CACHE_H_
+
+#include <unordered_map>
+
+class QTreeNode;
+
+// Keeps the draw commands generated for every 4x4 leaf and floor, so an
+// unchanged part of the map can be submitted again without walking its tiles.
+// Commands are stored in map pixel space and translated by the view scroll when
+// they are replayed, panning therefore reuses them as they are.
+class RenderCache {
+public:
+	// Everything besides the tiles themselves that changes what DrawTile generates
+	struct State {
+		uint32_t flags = 0;
+		uint32_t house_id = 0;
+		uint32_t zone = 0;
+		uint32_t epoch = 0;
+
+		bool operator==(const State &other) const noexcept {
+			return flags == other.flags && house_id == other.house_id && zone == other.zone && epoch == other.epoch;
+		}
+		bool operator!=(const State &other) const noexcept {
+			return !(*this == other);
+		}
+	};
+
+	// A textured quad, or an untextured square when sprite is 0
+	struct Command {
+		uint32_t sprite;
+		float x, y;
+		float width, height;
+		uint8_t red, green, blue, alpha;
+		// Index of the tile inside the leaf, like Floor::locs
+		uint8_t tile;
+	};
+
+	// A light emitted by a tile of the leaf, replayed into the LightDrawer
+	struct Light {
+		uint8_t tile;
+		uint8_t color;
+		uint8_t intensity;
+	};
+
+	struct Entry {
+		State state;
+		uint32_t revision = 0;
+		uint32_t lastframe = 0;
+		bool valid = false;
+		bool cacheable = false;
+		std::vector<Command> commands;
+		std::vector<Light> lights;
+	};
+
+	RenderCache();
+
+	// Entries recorded under a different state are recorded again
+	void setState(const State &new_state) noexcept {
+		state = new_state;
+	}
+	bool isValid(const Entry &entry, uint32_t revision) const noexcept {
+		return entry.valid && entry.revision == revision && entry.state == state;
+	}
+
+	Entry &get(int x, int y, int z);
+	void nextFrame();
+	void clear();
+
+	// Newest revision of the 16 locations of a leaf floor, 0 if the floor doesn't exist
+	static uint32_t getRevision(QTreeNode* node, int z);
+
+	// While recording, blits are appended to the entry instead of being drawn
+	bool isRecording() const noexcept {
+		return recording != nullptr;
+	}
+	void startRecording(Entry &entry, uint32_t revision, int x, int y);
+	void setRecordingTile(int tile) noexcept {
+		recording_tile = static_cast<uint8_t>(tile);
+	}
+	void recordLight(uint8_t color, uint8_t intensity);
+	void record(uint32_t sprite, float x, float y, float width, float height, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha);
+	// Called for output that can't be replayed, the leaf will be drawn directly until it changes
+	void discard() noexcept;
+	void stopRecording() noexcept;
+
+private:
+	std::unordered_map<uint64_t, Entry> entries;
+	State state;
+	Entry* recording;
+	uint8_t recording_tile;
+	int offset_x;
+	int offset_y;
+	uint32_t frame;
+};
+
+#endif
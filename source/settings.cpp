@@ -22,6 +22,8 @@
 #include "gui_ids.h"
 #include "client_assets.h"
 
+#include <thread>
+
 Settings g_settings;
 
 Settings::Settings() :
@@ -231,10 +233,12 @@ void Settings::IO(IOMode mode) {
 	section("Editor");
 	String(RECENT_FILES, "");
 	Int(WORKER_THREADS, 1);
+	Int(PARALLEL_THREADS, std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
 	Int(MERGE_MOVE, 0);
 	Int(MERGE_PASTE, 0);
 	Int(UNDO_SIZE, 2000); // Increased for modern systems (was 400)
 	Int(UNDO_MEM_SIZE, 2048); // 2GB for modern systems (was 40MB)
+	Int(UNDO_RESIDENT_SIZE, 256); // Older steps are spilled to disk, 0 keeps everything in memory
 	Int(GROUP_ACTIONS, 1);
 	Int(SELECTION_TYPE, SELECT_CURRENT_FLOOR);
 	Int(COMPENSATED_SELECT, 1);
@@ -249,6 +253,7 @@ void Settings::IO(IOMode mode) {
 	Int(BORDERIZE_DRAG_THRESHOLD, 6000);
 	Int(BORDERIZE_PASTE_THRESHOLD, 10000);
 	Int(ALWAYS_MAKE_BACKUP, 0);
+	Int(INCREMENTAL_SAVE, 0);
 	Int(USE_AUTOMAGIC, 1);
 	Int(HOUSE_BRUSH_REMOVE_ITEMS, 0);
 	Int(AUTO_ASSIGN_DOORID, 1);
@@ -287,6 +292,8 @@ void Settings::IO(IOMode mode) {
 	Int(ICON_BACKGROUND, 0);
 	Int(HARD_REFRESH_RATE, 16); // Throttle Update() to 16ms intervals (NOT a frame rate cap - see ARCHITECTURE.md)
 	Int(HIDE_ITEMS_WHEN_ZOOMED, 1);
+	Int(USE_VERTEX_BUFFERS, 1);
+	Int(SPRITE_SHEET_MEMORY, 512); // MB of decoded sprite sheets and sprites cut from them kept in memory, 0 for no limit
 	String(SCREENSHOT_DIRECTORY, "");
 	String(SCREENSHOT_FORMAT, "png");
 	Int(MINIMAP_UPDATE_DELAY, 333);
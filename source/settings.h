@@ -34,6 +34,8 @@ namespace Config {
 		TEXTURE_CLEAN_THRESHOLD,
 		TEXTURE_LONGEVITY,
 		HARD_REFRESH_RATE,
+		USE_VERTEX_BUFFERS,
+		SPRITE_SHEET_MEMORY,
 		SOFTWARE_CLEAN_THRESHOLD,
 		SOFTWARE_CLEAN_SIZE,
 		TRANSPARENT_FLOORS,
@@ -70,6 +72,7 @@ namespace Config {
 		ZOOM_SPEED,
 		UNDO_SIZE,
 		UNDO_MEM_SIZE,
+		UNDO_RESIDENT_SIZE,
 		MERGE_PASTE,
 		SELECTION_TYPE,
 		COMPENSATED_SELECT,
@@ -80,6 +83,7 @@ namespace Config {
 		BORDERIZE_PASTE_THRESHOLD,
 		ICON_BACKGROUND,
 		ALWAYS_MAKE_BACKUP,
+		INCREMENTAL_SAVE,
 		USE_AUTOMAGIC,
 		HOUSE_BRUSH_REMOVE_ITEMS,
 		AUTO_ASSIGN_DOORID,
@@ -144,6 +148,7 @@ namespace Config {
 		LISTBOX_EATS_ALL_EVENTS,
 		RAW_LIKE_SIMONE,
 		WORKER_THREADS,
+		PARALLEL_THREADS,
 		COPY_POSITION_FORMAT,
 		COPY_AREA_FORMAT,
 
@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "spawn_index.h"
+
+uint64_t SpawnIndex::getCellKey(int cell_x, int cell_y, int z) noexcept {
+	return static_cast<uint64_t>(z) << 32 | static_cast<uint64_t>(cell_x & 0xFFFF) << 16 | static_cast<uint64_t>(cell_y & 0xFFFF);
+}
+
+template <typename Callback>
+void SpawnIndex::forEachCell(const Position &center, int radius, Callback &&callback) {
+	const int start_x = std::max(center.x - radius, 0) >> CellBits;
+	const int start_y = std::max(center.y - radius, 0) >> CellBits;
+	const int end_x = std::max(center.x + radius, 0) >> CellBits;
+	const int end_y = std::max(center.y + radius, 0) >> CellBits;
+	for (int cell_y = start_y; cell_y <= end_y; ++cell_y) {
+		for (int cell_x = start_x; cell_x <= end_x; ++cell_x) {
+			callback(getCellKey(cell_x, cell_y, center.z));
+		}
+	}
+}
+
+void SpawnIndex::add(const Position &center, int radius) {
+	remove(center);
+	radii.emplace(center, radius);
+	forEachCell(center, radius, [&](uint64_t key) {
+		cells[key].push_back({ center, radius });
+	});
+}
+
+void SpawnIndex::remove(const Position &center) {
+	const auto it = radii.find(center);
+	if (it == radii.end()) {
+		return;
+	}
+
+	forEachCell(center, it->second, [&](uint64_t key) {
+		const auto cell = cells.find(key);
+		if (cell == cells.end()) {
+			return;
+		}
+		std::vector<Entry> &entries = cell->second;
+		std::erase_if(entries, [&center](const Entry &entry) { return entry.center == center; });
+		if (entries.empty()) {
+			cells.erase(cell);
+		}
+	});
+	radii.erase(it);
+}
+
+std::vector<SpawnIndex::Area> SpawnIndex::find(int start_x, int start_y, int end_x, int end_y, int z) const {
+	std::vector<Area> areas;
+	if (end_x < 0 || end_y < 0 || cells.empty()) {
+		return areas;
+	}
+
+	const int cell_start_x = std::max(start_x, 0) >> CellBits;
+	const int cell_start_y = std::max(start_y, 0) >> CellBits;
+	for (int cell_y = cell_start_y; cell_y <= end_y >> CellBits; ++cell_y) {
+		for (int cell_x = cell_start_x; cell_x <= end_x >> CellBits; ++cell_x) {
+			const auto cell = cells.find(getCellKey(cell_x, cell_y, z));
+			if (cell == cells.end()) {
+				continue;
+			}
+			for (const Entry &entry : cell->second) {
+				if (entry.center.x + entry.radius >= start_x && entry.center.x - entry.radius <= end_x && entry.center.y + entry.radius >= start_y && entry.center.y - entry.radius <= end_y) {
+					areas.push_back(entry);
+				}
+			}
+		}
+	}
+
+	// Spawns spanning several cells were found once per cell
+	std::sort(areas.begin(), areas.end(), [](const Area &left, const Area &right) { return left.center < right.center; });
+	areas.erase(std::unique(areas.begin(), areas.end(), [](const Area &left, const Area &right) { return left.center == right.center; }), areas.end());
+	return areas;
+}
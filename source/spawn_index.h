@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_SPAWN_INDEX_H_
+#define RME_SPAWN_INDEX_H_
+
+#include "position.h"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Spawn areas of one kind, every floor is split into cells of 32x32 tiles that
+// list the spawns whose area overlaps them. Finding the spawns around an area
+// only looks at the spawns of the cells it covers.
+class SpawnIndex {
+public:
+	struct Area {
+		Position center;
+		int radius;
+	};
+
+	// Replaces the spawn at center if there already is one
+	void add(const Position &center, int radius);
+	void remove(const Position &center);
+
+	// Spawns whose area overlaps the tiles from start to end on floor z, each once
+	std::vector<Area> find(int start_x, int start_y, int end_x, int end_y, int z) const;
+
+private:
+	using Entry = Area;
+
+	static constexpr int CellBits = 5;
+
+	static uint64_t getCellKey(int cell_x, int cell_y, int z) noexcept;
+	template <typename Callback>
+	static void forEachCell(const Position &center, int radius, Callback &&callback);
+
+	std::unordered_map<uint64_t, std::vector<Entry>> cells;
+	std::map<Position, int> radii;
+};
+
+#endif
@@ -34,6 +34,7 @@ void SpriteAppearances::init() {
 }
 
 void SpriteAppearances::terminate() {
+	prefetcher.stop();
 	unload();
 }
 
@@ -64,122 +65,335 @@ bool SpriteAppearances::loadCatalogContent(const std::string &dir, bool loadData
 
 			SpriteSheetPtr sheet = SpriteSheetPtr(new SpriteSheet(obj["firstspriteid"].get<int>(), lastSpriteId, static_cast<SpriteLayout>(obj["spritetype"].get<int>()), (fs::path(dir) / fs::path(obj["file"].get<std::string>())).string()));
 			sheets.push_back(sheet);
+			sheetsSorted = false;
 
 			spritesCount = std::max<int>(spritesCount, lastSpriteId);
+		}
+	}
 
-			if (loadData) {
-				if (!loadSpriteSheet(sheet)) {
-					spdlog::error("[SpriteAppearances::loadCatalogContent] - Unable to load sprite sheet");
-					return false;
-				}
+	if (loadData) {
+		// Every sheet is decoded by the prefetcher workers, loadSpriteSheet picks them up in order
+		for (const SpriteSheetPtr &sheet : sheets) {
+			if (!sheet->loaded && !sheet->prefetching) {
+				sheet->prefetching = true;
+				prefetcher.request(sheet);
+			}
+		}
+		for (const SpriteSheetPtr &sheet : sheets) {
+			if (!sheet->loaded && !loadSpriteSheet(sheet)) {
+				spdlog::error("[SpriteAppearances::loadCatalogContent] - Unable to load sprite sheet");
+				return false;
 			}
 		}
 	}
 	return true;
 }
 
-bool SpriteAppearances::loadSpriteSheet(const SpriteSheetPtr &sheet) {
-	if (sheet->loaded) {
-		return false;
-	}
+namespace {
+	// Reads and decompresses a sheet file, safe to call from any thread
+	std::unique_ptr<uint8_t[]> decodeSpriteSheet(const std::string &path) {
+		std::ifstream file(path, std::ios::binary | std::ios::in);
+		if (!file.is_open()) {
+			spdlog::error("[SpriteAppearances::decodeSpriteSheet] - Unable to open given sheets files");
+			return nullptr;
+		}
 
-	std::ifstream file(sheet->path, std::ios::binary | std::ios::in);
-	if (!file.is_open()) {
-		spdlog::error("[SpriteAppearances::loadSpriteSheet] - Unable to open given sheets files");
-		return false;
-	}
+		std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
 
-	std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
+		int pos = 0;
 
-	int pos = 0;
+		file.close();
 
-	file.close();
+		/*
+		   CIP's header, always 32 (0x20) bytes.
+		   Header format:
+		   [0x00, X):		  A variable number of NULL (0x00) bytes. The amount of pad-bytes can vary depending on how many
+							   bytes the "7-bit integer encoded LZMA file size" take.
+		   [X, X + 0x05):	  The constant byte sequence [0x70 0x0A 0xFA 0x80 0x24]
+		   [X + 0x05, 0x20]:   LZMA file size (Note: excluding the 32 bytes of this header) encoded as a 7-bit integer
+	   */
+
+		while (buffer[pos++] == 0x00)
+			;
+		pos += 4;
+		while ((buffer[pos++] & 0x80) == 0x80)
+			;
+
+		uint8_t lclppb = buffer[pos++];
+
+		lzma_options_lzma options {};
+		options.lc = lclppb % 9;
+
+		int remainder = lclppb / 9;
+		options.lp = remainder % 5;
+		options.pb = remainder / 5;
+
+		uint32_t dictionarySize = 0;
+		for (uint8_t i = 0; i < 4; ++i) {
+			dictionarySize += buffer[pos++] << (i * 8);
+		}
+
+		options.dict_size = dictionarySize;
+
+		pos += 8; // cip compressed size
+
+		lzma_stream stream = LZMA_STREAM_INIT;
+
+		lzma_filter filters[2] = {
+			lzma_filter { LZMA_FILTER_LZMA1, &options },
+			lzma_filter { LZMA_VLI_UNKNOWN, NULL }
+		};
 
-	/*
-	   CIP's header, always 32 (0x20) bytes.
-	   Header format:
-	   [0x00, X):		  A variable number of NULL (0x00) bytes. The amount of pad-bytes can vary depending on how many
-						   bytes the "7-bit integer encoded LZMA file size" take.
-	   [X, X + 0x05):	  The constant byte sequence [0x70 0x0A 0xFA 0x80 0x24]
-	   [X + 0x05, 0x20]:   LZMA file size (Note: excluding the 32 bytes of this header) encoded as a 7-bit integer
-   */
+		lzma_ret ret = lzma_raw_decoder(&stream, filters);
+		if (ret != LZMA_OK) {
+			spdlog::error("Failed to initialize lzma raw decoder result: {}", static_cast<int>(ret));
+			return nullptr;
+		}
+
+		std::unique_ptr<uint8_t[]> decompressed = std::make_unique<uint8_t[]>(LZMA_UNCOMPRESSED_SIZE); // uncompressed size, bmp file + 122 bytes header
+
+		stream.next_in = &buffer[pos];
+		stream.next_out = decompressed.get();
+		stream.avail_in = buffer.size() - pos;
+		stream.avail_out = LZMA_UNCOMPRESSED_SIZE;
+
+		ret = lzma_code(&stream, LZMA_RUN);
+		if (ret != LZMA_STREAM_END) {
+			spdlog::error("Failed to decode lzma buffer result: {}", static_cast<int>(ret));
+			lzma_end(&stream);
+			return nullptr;
+		}
+
+		lzma_end(&stream); // free memory
 
-	while (buffer[pos++] == 0x00)
-		;
-	pos += 4;
-	while ((buffer[pos++] & 0x80) == 0x80)
-		;
+		// pixel data start (bmp header end offset)
+		uint32_t data;
+		std::memcpy(&data, decompressed.get() + 10, sizeof(uint32_t));
 
-	uint8_t lclppb = buffer[pos++];
+		uint8_t* bufferStart = decompressed.get() + data;
 
-	lzma_options_lzma options {};
-	options.lc = lclppb % 9;
+		// Flip vertically
+		for (int y = 0; y < SPRITE_SHEET_HEIGHT / 2; ++y) {
+			uint8_t* itr1 = &bufferStart[y * SPRITE_SHEET_WIDTH_BYTES];
+			uint8_t* itr2 = &bufferStart[(SPRITE_SHEET_WIDTH - y - 1) * SPRITE_SHEET_WIDTH_BYTES];
 
-	int remainder = lclppb / 9;
-	options.lp = remainder % 5;
-	options.pb = remainder / 5;
+			std::swap_ranges(itr1, itr1 + SPRITE_SHEET_WIDTH_BYTES, itr2);
+		}
 
-	uint32_t dictionarySize = 0;
-	for (uint8_t i = 0; i < 4; ++i) {
-		dictionarySize += buffer[pos++] << (i * 8);
+		// Move the pixels to the start of the buffer, the bmp header isn't needed anymore
+		std::memmove(decompressed.get(), bufferStart, BYTES_IN_SPRITE_SHEET);
+		return decompressed;
 	}
 
-	options.dict_size = dictionarySize;
+	// Decoded pixel data kept per loaded sheet
+	constexpr size_t SpriteSheetBytes = LZMA_UNCOMPRESSED_SIZE;
 
-	pos += 8; // cip compressed size
+	size_t prefetchWorkerCount() {
+		const unsigned int cores = std::thread::hardware_concurrency();
+		return std::clamp<size_t>(cores > 1 ? cores - 1 : 1, 1, 4);
+	}
+}
 
-	lzma_stream stream = LZMA_STREAM_INIT;
+SpriteSheetPrefetcher::~SpriteSheetPrefetcher() {
+	stop();
+}
 
-	lzma_filter filters[2] = {
-		lzma_filter { LZMA_FILTER_LZMA1, &options },
-		lzma_filter { LZMA_VLI_UNKNOWN, NULL }
-	};
+void SpriteSheetPrefetcher::start() {
+	stopping = false;
+	const size_t count = prefetchWorkerCount();
+	for (size_t i = 0; i < count; ++i) {
+		workers.emplace_back(&SpriteSheetPrefetcher::work, this);
+	}
+}
 
-	lzma_ret ret = lzma_raw_decoder(&stream, filters);
-	if (ret != LZMA_OK) {
-		spdlog::error("Failed to initialize lzma raw decoder result: {}", static_cast<int>(ret));
-		return false;
+void SpriteSheetPrefetcher::request(const SpriteSheetPtr &sheet) {
+	if (workers.empty()) {
+		start();
 	}
 
-	std::unique_ptr<uint8_t[]> decompressed = std::make_unique<uint8_t[]>(LZMA_UNCOMPRESSED_SIZE); // uncompressed size, bmp file + 122 bytes header
+	{
+		std::scoped_lock lock(mutex);
+		pending.push_back(sheet);
+	}
+	wakeup.notify_one();
+}
 
-	stream.next_in = &buffer[pos];
-	stream.next_out = decompressed.get();
-	stream.avail_in = buffer.size();
-	stream.avail_out = LZMA_UNCOMPRESSED_SIZE;
+bool SpriteSheetPrefetcher::take(const SpriteSheetPtr &sheet, std::unique_ptr<uint8_t[]> &data) {
+	std::unique_lock lock(mutex);
+	auto it = std::find(pending.begin(), pending.end(), sheet);
+	if (it != pending.end()) {
+		pending.erase(it);
+		return false;
+	}
 
-	ret = lzma_code(&stream, LZMA_RUN);
-	if (ret != LZMA_STREAM_END) {
-		spdlog::error("Failed to decode lzma buffer result: {}", static_cast<int>(ret));
+	const auto isDecoded = [&]() {
+		return std::ranges::any_of(decoded, [&](const Decoded &result) { return result.sheet == sheet; });
+	};
+	if (!isDecoded() && std::ranges::find(decoding, sheet.get()) == decoding.end()) {
+		// Dropped by cancel()
 		return false;
 	}
+	finished.wait(lock, isDecoded);
 
-	lzma_end(&stream); // free memory
+	auto result = std::ranges::find_if(decoded, [&](const Decoded &result) { return result.sheet == sheet; });
+	data = std::move(result->data);
+	decoded.erase(result);
+	return true;
+}
 
-	// pixel data start (bmp header end offset)
-	uint32_t data;
-	std::memcpy(&data, decompressed.get() + 10, sizeof(uint32_t));
+std::vector<SpriteSheetPrefetcher::Decoded> SpriteSheetPrefetcher::collect() {
+	std::vector<Decoded> results;
+	std::scoped_lock lock(mutex);
+	results.swap(decoded);
+	return results;
+}
 
-	uint8_t* bufferStart = decompressed.get() + data;
+void SpriteSheetPrefetcher::cancel() {
+	std::scoped_lock lock(mutex);
+	pending.clear();
+	decoded.clear();
+}
+
+void SpriteSheetPrefetcher::stop() {
+	{
+		std::scoped_lock lock(mutex);
+		stopping = true;
+		pending.clear();
+	}
+	wakeup.notify_all();
+
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	decoded.clear();
+}
+
+void SpriteSheetPrefetcher::work() {
+	std::unique_lock lock(mutex);
+	while (true) {
+		wakeup.wait(lock, [this]() { return stopping || !pending.empty(); });
+		if (stopping) {
+			return;
+		}
+
+		SpriteSheetPtr sheet = std::move(pending.front());
+		pending.pop_front();
+		decoding.push_back(sheet.get());
+
+		lock.unlock();
+		std::unique_ptr<uint8_t[]> data = decodeSpriteSheet(sheet->path);
+		lock.lock();
+
+		std::erase(decoding, sheet.get());
+		decoded.push_back(Decoded { std::move(sheet), std::move(data) });
+		finished.notify_all();
+	}
+}
 
-	// Flip vertically
-	for (int y = 0; y < SPRITE_SHEET_HEIGHT / 2; ++y) {
-		uint8_t* itr1 = &bufferStart[y * SPRITE_SHEET_WIDTH_BYTES];
-		uint8_t* itr2 = &bufferStart[(SPRITE_SHEET_WIDTH - y - 1) * SPRITE_SHEET_WIDTH_BYTES];
+bool SpriteAppearances::loadSpriteSheet(const SpriteSheetPtr &sheet) {
+	if (sheet->loaded) {
+		return false;
+	}
 
-		std::swap_ranges(itr1, itr1 + SPRITE_SHEET_WIDTH_BYTES, itr2);
+	std::unique_ptr<uint8_t[]> data;
+	if (!sheet->prefetching || !prefetcher.take(sheet, data)) {
+		data = decodeSpriteSheet(sheet->path);
 	}
+	sheet->prefetching = false;
 
-	sheet->data = std::make_unique<uint8_t[]>(LZMA_UNCOMPRESSED_SIZE);
-	std::memcpy(sheet->data.get(), bufferStart, BYTES_IN_SPRITE_SHEET);
+	if (!data) {
+		return false;
+	}
 
+	sheet->data = std::move(data);
 	sheet->loaded = true;
+	++residentSheets;
+	trimSheets();
 	return true;
 }
 
+void SpriteAppearances::prefetchSheet(int spriteId) {
+	const SpriteSheetPtr &sheet = getSheetBySpriteId(spriteId, false);
+	if (!sheet || sheet->loaded || sheet->prefetching) {
+		return;
+	}
+
+	sheet->prefetching = true;
+	prefetcher.request(sheet);
+}
+
+void SpriteAppearances::collectPrefetchedSheets() {
+	for (SpriteSheetPrefetcher::Decoded &result : prefetcher.collect()) {
+		const SpriteSheetPtr &sheet = result.sheet;
+		sheet->prefetching = false;
+		if (result.data && !sheet->loaded) {
+			sheet->data = std::move(result.data);
+			sheet->loaded = true;
+			// Ranked with the sheets in use, the view is about to need it
+			sheet->lastUse = sheetUseCounter;
+			++residentSheets;
+		}
+	}
+	trimSheets();
+}
+
+void SpriteAppearances::trimSheets() {
+	const size_t budget = static_cast<size_t>(std::max(0, g_settings.getInteger(Config::SPRITE_SHEET_MEMORY))) * 1024 * 1024;
+	const auto residentBytes = [&] {
+		return residentSheets * SpriteSheetBytes + spriteBytes;
+	};
+	if (budget == 0 || residentBytes() <= budget) {
+		return;
+	}
+
+	std::vector<SpriteSheet*> resident;
+	resident.reserve(residentSheets);
+	for (const SpriteSheetPtr &sheet : sheets) {
+		if (sheet->loaded) {
+			resident.push_back(sheet.get());
+		}
+	}
+	std::ranges::sort(resident, {}, &SpriteSheet::lastUse);
+
+	// Sheets and sprite copies share the use counter, whichever was used longer ago
+	// goes first. Textures don't reference the sheets, uploads read the sprites through
+	// getSprite, so only the sheet that is being read right now is kept.
+	auto sheet = resident.begin();
+	while (residentBytes() > budget) {
+		const bool spritesLeft = !spriteRecency.empty();
+		if (sheet != resident.end() && (!spritesLeft || (*sheet)->lastUse < sprites.at(spriteRecency.front()).lastUse)) {
+			if ((*sheet)->lastUse != sheetUseCounter) {
+				(*sheet)->data.reset();
+				(*sheet)->loaded = false;
+				--residentSheets;
+			}
+			++sheet;
+		} else if (spritesLeft) {
+			const auto it = sprites.find(spriteRecency.front());
+			spriteBytes -= it->second.sprite->pixels.size();
+			sprites.erase(it);
+			spriteRecency.pop_front();
+		} else {
+			break;
+		}
+	}
+}
+
+SpriteAppearances::SheetCacheStats SpriteAppearances::getSheetCacheStats() const {
+	return SheetCacheStats { residentSheets, residentSheets * SpriteSheetBytes, sprites.size(), spriteBytes, sheetHits, sheetMisses };
+}
+
 void SpriteAppearances::unload() {
+	prefetcher.cancel();
 	spritesCount = 0;
 	sheets.clear();
+	sheetsSorted = true;
+	lastSheet = nullptr;
+	residentSheets = 0;
+	sprites.clear();
+	spriteRecency.clear();
+	spriteBytes = 0;
 }
 
 SpriteSheetPtr SpriteAppearances::getSheetBySpriteId(int id, bool load /* = true */) {
@@ -187,18 +401,34 @@ SpriteSheetPtr SpriteAppearances::getSheetBySpriteId(int id, bool load /* = true
 		return nullptr;
 	}
 
-	// find sheet
-	auto sheetIt = std::find_if(sheets.begin(), sheets.end(), [=](const SpriteSheetPtr &sheet) {
-		return id >= sheet->firstId && id <= sheet->lastId;
-	});
+	if (!lastSheet || id < lastSheet->firstId || id > lastSheet->lastId) {
+		if (!sheetsSorted) {
+			std::ranges::sort(sheets, {}, &SpriteSheet::firstId);
+			sheetsSorted = true;
+		}
 
-	if (sheetIt == sheets.end()) {
-		return nullptr;
+		// Last sheet starting at or before the id
+		auto sheetIt = std::ranges::upper_bound(sheets, id, {}, &SpriteSheet::firstId);
+		if (sheetIt == sheets.begin()) {
+			return nullptr;
+		}
+		--sheetIt;
+
+		if (id > (*sheetIt)->lastId) {
+			return nullptr;
+		}
+		lastSheet = *sheetIt;
 	}
 
-	const SpriteSheetPtr &sheet = *sheetIt;
-	if (load && !sheet->loaded) {
-		loadSpriteSheet(sheet);
+	const SpriteSheetPtr &sheet = lastSheet;
+	if (load) {
+		sheet->lastUse = ++sheetUseCounter;
+		if (sheet->loaded) {
+			++sheetHits;
+		} else {
+			++sheetMisses;
+			loadSpriteSheet(sheet);
+		}
 	}
 
 	return sheet;
@@ -261,7 +491,10 @@ SpritePtr SpriteAppearances::getSprite(int spriteId) {
 	auto it = sprites.find(spriteId);
 	if (it != sprites.end()) {
 		spdlog::debug("Sprite {} found in cache.", spriteId);
-		return it->second;
+		CachedSprite &cached = it->second;
+		cached.lastUse = ++sheetUseCounter;
+		spriteRecency.splice(spriteRecency.end(), spriteRecency, cached.recency);
+		return cached.sprite;
 	}
 
 	// Retrieve sprite sheet
@@ -341,8 +574,9 @@ SpritePtr SpriteAppearances::getSprite(int spriteId) {
 		std::ranges::copy(std::span(bufferData, spriteWidthBytes), dest);
 	}
 
-	// Cache the sprite
-	sprites[spriteId] = sprite;
+	// Cache the sprite, it is trimmed together with the sheets
+	sprites.emplace(spriteId, CachedSprite { sprite, ++sheetUseCounter, spriteRecency.insert(spriteRecency.end(), spriteId) });
+	spriteBytes += sprite->pixels.size();
 
 	return sprite;
 }
@@ -22,6 +22,13 @@
 #include "main.h"
 #include "graphics.h"
 
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
 class GameSprite;
 
 // APPEARANCES
@@ -146,14 +153,65 @@ public:
 	std::unique_ptr<uint8_t[]> data;
 	std::string path;
 	bool loaded = false;
+	// Queued for or being decoded by the prefetcher, only touched by the UI thread
+	bool prefetching = false;
+	// Value of the use counter when the pixel data was last read, orders eviction
+	uint64_t lastUse = 0;
 };
 
 using SpritePtr = std::shared_ptr<Sprites>;
 using SpriteSheetPtr = std::shared_ptr<SpriteSheet>;
 
+// Decodes sprite sheets on a small pool of worker threads before they are needed.
+// Workers never touch the sheets themselves, the decoded data is handed back to the
+// UI thread through collect() or take().
+class SpriteSheetPrefetcher {
+public:
+	struct Decoded {
+		SpriteSheetPtr sheet;
+		// Null if the sheet couldn't be decoded
+		std::unique_ptr<uint8_t[]> data;
+	};
+
+	SpriteSheetPrefetcher() = default;
+	~SpriteSheetPrefetcher();
+
+	void request(const SpriteSheetPtr &sheet);
+	// Removes the sheet if no worker started on it yet and returns false, otherwise
+	// waits until it is decoded and moves its data out
+	bool take(const SpriteSheetPtr &sheet, std::unique_ptr<uint8_t[]> &data);
+	// Moves out everything decoded so far
+	std::vector<Decoded> collect();
+	// Drops pending requests and results, in-flight decodes are still finished
+	void cancel();
+	void stop();
+
+private:
+	void start();
+	void work();
+
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::condition_variable finished;
+	std::deque<SpriteSheetPtr> pending;
+	std::vector<const SpriteSheet*> decoding;
+	std::vector<Decoded> decoded;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+};
+
 //@bindsingleton g_spriteAppearances
 class SpriteAppearances {
 public:
+	struct SheetCacheStats {
+		size_t residentSheets = 0;
+		size_t residentBytes = 0;
+		size_t cachedSprites = 0;
+		size_t cachedSpriteBytes = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+
 	void init();
 	void terminate();
 
@@ -190,20 +248,49 @@ public:
 
 	bool loadCatalogContent(const std::string &dir, bool loadData = true);
 	bool loadSpriteSheet(const SpriteSheetPtr &sheet);
+	// Decodes the sheet of the sprite in the background if it isn't loaded yet
+	void prefetchSheet(int spriteId);
+	// Installs the sheets the prefetcher finished, called once per frame
+	void collectPrefetchedSheets();
+	// Drops the least recently used sheets and sprite copies until they fit in
+	// Config::SPRITE_SHEET_MEMORY again
+	void trimSheets();
+	SheetCacheStats getSheetCacheStats() const;
 	void saveSheetToFileBySprite(int id, const std::string &file);
 	void saveSheetToFile(const SpriteSheetPtr &sheet, const std::string &file);
 	SpriteSheetPtr getSheetBySpriteId(int id, bool load = true);
 
 	void addSpriteSheet(SpriteSheetPtr sheet) {
 		sheets.push_back(sheet);
+		sheetsSorted = false;
 	}
 
 	void saveSpriteToFile(int id, const std::string &file);
 
 private:
 	int spritesCount = 0;
+	// Sorted by first sprite id on the first lookup after sheets were added
 	std::vector<SpriteSheetPtr> sheets;
-	std::map<int, SpritePtr> sprites;
+	bool sheetsSorted = true;
+	// Sprites of neighbouring draws usually share a sheet
+	SpriteSheetPtr lastSheet;
+	uint64_t sheetUseCounter = 0;
+	size_t residentSheets = 0;
+	uint64_t sheetHits = 0;
+	uint64_t sheetMisses = 0;
+	SpriteSheetPrefetcher prefetcher;
+
+	// Pixels of single sprites cut out of their sheets by getSprite, dropping one
+	// only frees it once no image holds it anymore
+	struct CachedSprite {
+		SpritePtr sprite;
+		uint64_t lastUse;
+		std::list<int>::iterator recency;
+	};
+	std::unordered_map<int, CachedSprite> sprites;
+	// Sprite ids, least recently used first
+	std::list<int> spriteRecency;
+	size_t spriteBytes = 0;
 	std::string appearanceFile;
 };
 
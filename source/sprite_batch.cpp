@@ -0,0 +1,201 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include <cstddef>
+
+#if defined(__LINUX__)
+	#include <GL/glx.h>
+#endif
+
+#include "sprite_batch.h"
+#include "settings.h"
+
+// Buffer object entry points are not part of OpenGL 1.1, so they are resolved at runtime
+namespace {
+	constexpr GLenum BATCH_ARRAY_BUFFER = 0x8892; // GL_ARRAY_BUFFER
+	constexpr GLenum BATCH_STREAM_DRAW = 0x88E0; // GL_STREAM_DRAW
+
+	using GenBuffersProc = void(APIENTRY*)(GLsizei, GLuint*);
+	using DeleteBuffersProc = void(APIENTRY*)(GLsizei, const GLuint*);
+	using BindBufferProc = void(APIENTRY*)(GLenum, GLuint);
+	using BufferDataProc = void(APIENTRY*)(GLenum, std::ptrdiff_t, const void*, GLenum);
+	using BufferSubDataProc = void(APIENTRY*)(GLenum, std::ptrdiff_t, std::ptrdiff_t, const void*);
+
+	GenBuffersProc batchGenBuffers = nullptr;
+	DeleteBuffersProc batchDeleteBuffers = nullptr;
+	BindBufferProc batchBindBuffer = nullptr;
+	BufferDataProc batchBufferData = nullptr;
+	BufferSubDataProc batchBufferSubData = nullptr;
+
+	void* getBatchProcAddress(const char* name) {
+#if defined(__WINDOWS__)
+		return reinterpret_cast<void*>(wglGetProcAddress(name));
+#elif defined(__LINUX__)
+		return reinterpret_cast<void*>(glXGetProcAddressARB(reinterpret_cast<const GLubyte*>(name)));
+#else
+		return nullptr;
+#endif
+	}
+
+	// glXGetProcAddress never fails, so the context itself has to report buffer object support
+	bool contextSupportsBuffers() {
+		const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+		int major = 0, minor = 0;
+		if (!version || sscanf(version, "%d.%d", &major, &minor) != 2) {
+			return false;
+		}
+		return major > 1 || (major == 1 && minor >= 5);
+	}
+
+	bool loadBufferFunctions() {
+		static bool tried = false;
+		static bool loaded = false;
+		if (tried) {
+			return loaded;
+		}
+		tried = true;
+
+		if (!contextSupportsBuffers()) {
+			return false;
+		}
+
+		batchGenBuffers = reinterpret_cast<GenBuffersProc>(getBatchProcAddress("glGenBuffers"));
+		batchDeleteBuffers = reinterpret_cast<DeleteBuffersProc>(getBatchProcAddress("glDeleteBuffers"));
+		batchBindBuffer = reinterpret_cast<BindBufferProc>(getBatchProcAddress("glBindBuffer"));
+		batchBufferData = reinterpret_cast<BufferDataProc>(getBatchProcAddress("glBufferData"));
+		batchBufferSubData = reinterpret_cast<BufferSubDataProc>(getBatchProcAddress("glBufferSubData"));
+
+		loaded = batchGenBuffers && batchDeleteBuffers && batchBindBuffer && batchBufferData && batchBufferSubData;
+		return loaded;
+	}
+}
+
+SpriteBatch::SpriteBatch() :
+	buffer(0),
+	buffer_size(0),
+	initialized(false),
+	texture_binds(0),
+	draw_calls(0) {
+	// A fully zoomed out view easily queues tens of thousands of sprites
+	vertices.reserve(4096 * 4);
+	ranges.reserve(1024);
+}
+
+SpriteBatch::~SpriteBatch() {
+	releaseBuffer();
+}
+
+void SpriteBatch::add(GLuint texture, float x, float y, float width, float height, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha, float u0, float v0, float u1, float v1) {
+	if (ranges.empty() || ranges.back().texture != texture) {
+		ranges.push_back(Range { texture, static_cast<GLint>(vertices.size()), 0 });
+	}
+
+	vertices.push_back(Vertex { x, y, u0, v0, red, green, blue, alpha });
+	vertices.push_back(Vertex { x + width, y, u1, v0, red, green, blue, alpha });
+	vertices.push_back(Vertex { x + width, y + height, u1, v1, red, green, blue, alpha });
+	vertices.push_back(Vertex { x, y + height, u0, v1, red, green, blue, alpha });
+	ranges.back().count += 4;
+}
+
+void SpriteBatch::flush() {
+	if (vertices.empty()) {
+		return;
+	}
+
+	if (!initialized) {
+		createBuffer();
+	}
+
+	// Sprites are always textured, no matter what state the caller left behind
+	const bool texturing = glIsEnabled(GL_TEXTURE_2D);
+	if (!texturing) {
+		glEnable(GL_TEXTURE_2D);
+	}
+
+	const uint8_t* base = reinterpret_cast<const uint8_t*>(vertices.data());
+	if (buffer != 0) {
+		const size_t bytes = vertices.size() * sizeof(Vertex);
+		batchBindBuffer(BATCH_ARRAY_BUFFER, buffer);
+		if (bytes > buffer_size) {
+			buffer_size = bytes;
+			batchBufferData(BATCH_ARRAY_BUFFER, buffer_size, vertices.data(), BATCH_STREAM_DRAW);
+		} else {
+			// Orphan the previous storage so the driver doesn't stall on the last frame
+			batchBufferData(BATCH_ARRAY_BUFFER, buffer_size, nullptr, BATCH_STREAM_DRAW);
+			batchBufferSubData(BATCH_ARRAY_BUFFER, 0, bytes, vertices.data());
+		}
+		base = nullptr;
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, x));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, u));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), base + offsetof(Vertex, r));
+
+	for (const Range &range : ranges) {
+		glBindTexture(GL_TEXTURE_2D, range.texture);
+		glDrawArrays(GL_QUADS, range.first, range.count);
+		++texture_binds;
+		++draw_calls;
+	}
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	// The current color is undefined after drawing with a color array
+	glColor4ub(255, 255, 255, 255);
+
+	if (buffer != 0) {
+		batchBindBuffer(BATCH_ARRAY_BUFFER, 0);
+	}
+
+	if (!texturing) {
+		glDisable(GL_TEXTURE_2D);
+	}
+
+	vertices.clear();
+	ranges.clear();
+}
+
+void SpriteBatch::resetStats() noexcept {
+	texture_binds = 0;
+	draw_calls = 0;
+}
+
+void SpriteBatch::createBuffer() {
+	initialized = true;
+
+	if (!g_settings.getBoolean(Config::USE_VERTEX_BUFFERS) || !loadBufferFunctions()) {
+		spdlog::info("Sprite batching uses client side vertex arrays");
+		return;
+	}
+
+	batchGenBuffers(1, &buffer);
+	spdlog::info("Sprite batching uses vertex buffer objects");
+}
+
+void SpriteBatch::releaseBuffer() {
+	if (buffer != 0) {
+		batchDeleteBuffers(1, &buffer);
+		buffer = 0;
+		buffer_size = 0;
+	}
+}
@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_SPRITE_BATCH_H_
+#define RME_SPRITE_BATCH_H_
+
+// Collects textured quads for a frame and submits them with as few draw calls as possible.
+// Quads are drawn in the order they were added (the map relies on painter's order for
+// stacking and alpha), consecutive quads sharing a texture are merged into one draw call.
+// Vertices are streamed through a VBO when the driver exposes one, otherwise plain
+// client side vertex arrays (OpenGL 1.1) are used, which also works on software renderers.
+class SpriteBatch {
+	struct Vertex {
+		float x, y;
+		float u, v;
+		uint8_t r, g, b, a;
+	};
+
+	struct Range {
+		GLuint texture;
+		GLint first;
+		GLsizei count;
+	};
+
+public:
+	SpriteBatch();
+	~SpriteBatch();
+
+	SpriteBatch(const SpriteBatch &) = delete;
+	SpriteBatch &operator=(const SpriteBatch &) = delete;
+
+	void add(GLuint texture, float x, float y, float width, float height, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha, float u0 = 0.f, float v0 = 0.f, float u1 = 1.f, float v1 = 1.f);
+
+	// Must be called before any immediate mode drawing, so queued sprites end up below it
+	void flush();
+
+	bool empty() const noexcept {
+		return vertices.empty();
+	}
+
+	// Telemetry
+	void resetStats() noexcept;
+	int getTextureBinds() const noexcept {
+		return texture_binds;
+	}
+	int getDrawCalls() const noexcept {
+		return draw_calls;
+	}
+	bool isUsingVBO() const noexcept {
+		return buffer != 0;
+	}
+
+private:
+	void createBuffer();
+	void releaseBuffer();
+
+	std::vector<Vertex> vertices;
+	std::vector<Range> ranges;
+
+	GLuint buffer;
+	size_t buffer_size;
+	bool initialized;
+
+	int texture_binds;
+	int draw_calls;
+};
+
+#endif
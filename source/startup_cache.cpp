@@ -0,0 +1,280 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "startup_cache.h"
+
+StartupCache g_startupCache;
+
+namespace {
+	// Bump when the layout of the cache or of any of its sections changes
+	constexpr uint32_t StartupCacheVersion = 1;
+
+	// Followed by the directory, a node tree with the files and the place of
+	// every section, and then the sections themselves
+	struct StartupCacheHeader {
+		char identifier[4];
+		uint32_t version;
+		uint64_t directorySize;
+		uint32_t directoryChecksum;
+	};
+}
+
+uint32_t StartupCache::checksum(const uint8_t* data, size_t size) {
+	uint32_t hash = 2166136261U;
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ data[i]) * 16777619U;
+	}
+	return hash;
+}
+
+std::string StartupCache::getPath(const FileName &filename) {
+	FileName path(filename);
+	path.MakeAbsolute();
+	return nstr(path.GetFullPath());
+}
+
+StartupCache::Source StartupCache::stat(const std::string &path) {
+	Source source;
+	source.path = path;
+
+	// Files that were missing are kept as empty ones, creating them makes the section outdated
+	const FileName filename(wxstr(path));
+	if (!filename.FileExists()) {
+		return source;
+	}
+
+	const wxULongLong size = filename.GetSize();
+	if (size != wxInvalidSize) {
+		source.size = size.GetValue();
+	}
+	const wxDateTime modified = filename.GetModificationTime();
+	if (modified.IsValid()) {
+		source.modified = modified.GetValue().GetValue();
+	}
+	return source;
+}
+
+uint32_t StartupCache::checksumOf(const std::string &path) {
+	MappedFile file(path);
+	return file.isOk() ? checksum(file.getData(), file.size()) : 0;
+}
+
+void StartupCache::open(const FileName &cachefile) {
+	close();
+	this->cachefile = cachefile;
+	if (!cachefile.FileExists()) {
+		return;
+	}
+
+	file = std::make_unique<MappedFile>(nstr(cachefile.GetFullPath()));
+	StartupCacheHeader header {};
+	if (!file->isOk() || file->size() < sizeof(header)) {
+		file.reset();
+		return;
+	}
+
+	memcpy(&header, file->getData(), sizeof(header));
+	if (memcmp(header.identifier, "RMEC", 4) != 0 || header.version != StartupCacheVersion) {
+		// Made by another version, it is replaced on save
+		file.reset();
+		return;
+	}
+
+	const uint8_t* directory = file->getData() + sizeof(header);
+	if (header.directorySize < 2 || header.directorySize > file->size() - sizeof(header) || checksum(directory, header.directorySize) != header.directoryChecksum || !readDirectory(directory, header.directorySize, sizeof(header) + header.directorySize)) {
+		spdlog::warn("[StartupCache::open] {} is damaged and is ignored", nstr(cachefile.GetFullPath()));
+		close();
+	}
+}
+
+bool StartupCache::readDirectory(const uint8_t* data, size_t size, size_t payloadOffset) {
+	MemoryNodeFileReadHandle reader(data, size);
+	BinaryNode* root = reader.getRootNode();
+	if (!root) {
+		return false;
+	}
+
+	const size_t payloadArea = file->size() - payloadOffset;
+	for (BinaryNode* sectionNode = root->getChild(); sectionNode != nullptr; sectionNode = sectionNode->advance()) {
+		uint8_t section = 0;
+		uint16_t sources = 0;
+		if (!sectionNode->getU8(section) || section >= SECTION_COUNT || !sectionNode->getU16(sources)) {
+			return false;
+		}
+
+		Entry &entry = entries[section];
+		entry.sources.resize(sources);
+		for (Source &source : entry.sources) {
+			uint64_t modified = 0;
+			if (!sectionNode->getString(source.path) || !sectionNode->getU64(source.size) || !sectionNode->getU64(modified) || !sectionNode->getU32(source.checksum)) {
+				return false;
+			}
+			source.modified = static_cast<int64_t>(modified);
+		}
+
+		uint64_t offset = 0;
+		uint64_t payloadSize = 0;
+		if (!sectionNode->getU64(offset) || !sectionNode->getU64(payloadSize) || !sectionNode->getU32(entry.checksum)) {
+			return false;
+		}
+		if (offset > payloadArea || payloadSize > payloadArea - offset) {
+			return false;
+		}
+		entry.payload = file->getData() + payloadOffset + offset;
+		entry.size = payloadSize;
+	}
+	return true;
+}
+
+bool StartupCache::isCurrent(Entry &entry, const std::string &primary) {
+	if (entry.sources.empty() || entry.sources.front().path != primary) {
+		return false;
+	}
+
+	for (Source &source : entry.sources) {
+		const Source current = stat(source.path);
+		if (current.size != source.size) {
+			return false;
+		}
+		if (current.modified != source.modified) {
+			// Copied or saved without changes, the file still has to be read once
+			if (checksumOf(source.path) != source.checksum) {
+				return false;
+			}
+			source.modified = current.modified;
+			entry.changed = true;
+		}
+	}
+	return true;
+}
+
+BinaryNode* StartupCache::getSection(Section section, const FileName &primary) {
+	Entry &entry = entries[section];
+	if (!entry.payload) {
+		return nullptr;
+	}
+
+	if (!isCurrent(entry, getPath(primary))) {
+		entry = Entry();
+		entry.changed = true;
+		return nullptr;
+	}
+
+	if (entry.size < 2 || checksum(entry.payload, entry.size) != entry.checksum) {
+		spdlog::warn("[StartupCache::getSection] Section {} of {} is damaged and is ignored", static_cast<int>(section), nstr(cachefile.GetFullPath()));
+		entry = Entry();
+		entry.changed = true;
+		return nullptr;
+	}
+
+	entry.reader = std::make_unique<MemoryNodeFileReadHandle>(entry.payload, entry.size);
+	return entry.reader->getRootNode();
+}
+
+void StartupCache::setSection(Section section, const std::vector<FileName> &sources, MemoryNodeFileWriteHandle &payload) {
+	Entry &entry = entries[section];
+	entry = Entry();
+	entry.changed = true;
+	if (payload.error_code != FILE_NO_ERROR) {
+		// A string too long for the node format, the section is made from the files every time
+		return;
+	}
+
+	entry.sources.reserve(sources.size());
+	for (const FileName &filename : sources) {
+		Source &source = entry.sources.emplace_back(stat(getPath(filename)));
+		source.checksum = checksumOf(source.path);
+	}
+
+	entry.data.assign(payload.getMemory(), payload.getMemory() + payload.getSize());
+	entry.payload = entry.data.data();
+	entry.size = entry.data.size();
+	entry.checksum = checksum(entry.payload, entry.size);
+}
+
+void StartupCache::save() {
+	const bool changed = std::any_of(entries.begin(), entries.end(), [](const Entry &entry) { return entry.changed; });
+	if (!changed || !cachefile.IsOk()) {
+		close();
+		return;
+	}
+
+	MemoryNodeFileWriteHandle directory;
+	directory.addNode(0);
+	uint64_t offset = 0;
+	for (size_t section = 0; section < SECTION_COUNT; ++section) {
+		const Entry &entry = entries[section];
+		if (!entry.payload) {
+			continue;
+		}
+
+		directory.addNode(static_cast<uint8_t>(section));
+		directory.addU16(static_cast<uint16_t>(entry.sources.size()));
+		for (const Source &source : entry.sources) {
+			directory.addString(source.path);
+			directory.addU64(source.size);
+			directory.addU64(static_cast<uint64_t>(source.modified));
+			directory.addU32(source.checksum);
+		}
+		directory.addU64(offset);
+		directory.addU64(entry.size);
+		directory.addU32(entry.checksum);
+		directory.endNode();
+		offset += entry.size;
+	}
+	directory.endNode();
+
+	StartupCacheHeader header {};
+	memcpy(header.identifier, "RMEC", 4);
+	header.version = StartupCacheVersion;
+	header.directorySize = directory.getSize();
+	header.directoryChecksum = checksum(directory.getMemory(), directory.getSize());
+
+	// Written under another name first, a crash never leaves half a cache behind.
+	// The old cache has to be unmapped before it can be replaced.
+	const std::string path = nstr(cachefile.GetFullPath());
+	const std::string temporaryPath = path + ".tmp";
+	bool written;
+	{
+		FileWriteHandle output(temporaryPath);
+		written = output.isOk() && output.addRAW(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) && output.addRAW(directory.getMemory(), directory.getSize());
+		for (const Entry &entry : entries) {
+			if (written && entry.payload) {
+				written = output.addRAW(entry.payload, entry.size);
+			}
+		}
+		output.close();
+	}
+	close();
+
+	if (!written) {
+		spdlog::warn("[StartupCache::save] Couldn't write {}", temporaryPath);
+		wxRemoveFile(wxstr(temporaryPath));
+	} else if (!wxRenameFile(wxstr(temporaryPath), wxstr(path), true)) {
+		wxRemoveFile(wxstr(temporaryPath));
+	}
+}
+
+void StartupCache::close() {
+	// The readers point into the mapping
+	for (Entry &entry : entries) {
+		entry = Entry();
+	}
+	file.reset();
+}
@@ -0,0 +1,97 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_STARTUP_CACHE_H_
+#define RME_STARTUP_CACHE_H_
+
+#include "filehandle.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Binary snapshot of the data files read on every launch: the appearances file,
+// items.xml and the materials files the brushes and tilesets are made of. It is
+// kept in the user data directory and mapped into memory on the next launch.
+//
+// Every section lists the files it was made from with their size, modification
+// time and checksum, and is only handed out while none of them changed. Files
+// whose time changed are hashed again, so copies with the same contents keep
+// their section. Sections made again from the files are written out by save.
+class StartupCache {
+public:
+	enum Section : uint8_t {
+		SECTION_APPEARANCES,
+		SECTION_ITEMS_XML,
+		SECTION_MATERIALS,
+		SECTION_COUNT
+	};
+
+	StartupCache() = default;
+	StartupCache(const StartupCache &) = delete;
+	StartupCache &operator=(const StartupCache &) = delete;
+
+	void open(const FileName &cachefile);
+	// Writes the cache again if a section was replaced or checked again, then closes it
+	void save();
+	void close();
+
+	// Root node of the section, nullptr if there's none or the files it was made
+	// from changed. primary has to be the first of those files.
+	// Every section may be read and replaced on its own thread.
+	BinaryNode* getSection(Section section, const FileName &primary);
+	// payload holds one root node, sources start with the primary file
+	void setSection(Section section, const std::vector<FileName> &sources, MemoryNodeFileWriteHandle &payload);
+
+	static uint32_t checksum(const uint8_t* data, size_t size);
+
+private:
+	struct Source {
+		std::string path;
+		uint64_t size = 0;
+		int64_t modified = 0;
+		uint32_t checksum = 0;
+	};
+
+	struct Entry {
+		std::vector<Source> sources;
+		// Points into the mapped file, or into data once the section was replaced
+		const uint8_t* payload = nullptr;
+		size_t size = 0;
+		uint32_t checksum = 0;
+		std::vector<uint8_t> data;
+		std::unique_ptr<MemoryNodeFileReadHandle> reader;
+		bool changed = false;
+	};
+
+	static std::string getPath(const FileName &filename);
+	// Leaves the checksum out, it takes reading the whole file
+	static Source stat(const std::string &path);
+	static uint32_t checksumOf(const std::string &path);
+
+	bool readDirectory(const uint8_t* data, size_t size, size_t payloadOffset);
+	bool isCurrent(Entry &entry, const std::string &primary);
+
+	FileName cachefile;
+	std::unique_ptr<MappedFile> file;
+	std::array<Entry, SECTION_COUNT> entries;
+};
+
+extern StartupCache g_startupCache;
+
+#endif
@@ -0,0 +1,234 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#include "main.h"
+
+#include "texture_atlas.h"
+
+namespace {
+	// 2048x2048 RGBA pages are 16 MB each, this keeps the atlas around 256 MB before pages get recycled
+	constexpr int MaxAtlasPageSize = 2048;
+	constexpr size_t MaxAtlasPages = 16;
+	// Each cell has a one pixel border with the sprite edges repeated, so scaled quads never sample a neighbour
+	constexpr int CellGutter = 1;
+}
+
+TextureAtlas::TextureAtlas() :
+	page_size(0),
+	resident(0),
+	current_time(0),
+	current_frame(1) {
+	////
+}
+
+TextureAtlas::~TextureAtlas() {
+	clear();
+}
+
+const TextureAtlas::Region* TextureAtlas::getRegion(uint32_t spriteId) {
+	if (!isResident(spriteId)) {
+		return nullptr;
+	}
+
+	Entry &entry = entries[spriteId];
+	Page &page = pages[entry.page];
+	page.lastaccess = current_time;
+	page.lastframe = current_frame;
+	return &entry.region;
+}
+
+bool TextureAtlas::insert(uint32_t spriteId, int width, int height, const uint8_t* rgba) {
+	if (!rgba || width <= 0 || height <= 0) {
+		return false;
+	}
+
+	if (isResident(spriteId)) {
+		return true;
+	}
+
+	if (page_size == 0) {
+		GLint max_size = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+		page_size = std::min<int>(MaxAtlasPageSize, max_size);
+	}
+
+	const int cell_width = width + CellGutter * 2;
+	const int cell_height = height + CellGutter * 2;
+	if (cell_width > page_size || cell_height > page_size) {
+		return false;
+	}
+
+	int index = findPage(width, height);
+	if (index < 0) {
+		index = createPage(width, height);
+	}
+	if (index < 0) {
+		return false;
+	}
+
+	if (spriteId >= entries.size()) {
+		entries.resize(std::max<size_t>(spriteId + 1, entries.size() * 2));
+	}
+
+	Page &page = pages[index];
+	const int columns = page_size / cell_width;
+	const int slot = static_cast<int>(page.sprites.size());
+	const int cell_x = (slot % columns) * cell_width;
+	const int cell_y = (slot / columns) * cell_height;
+
+	// Copy the sprite into the middle of the cell and repeat its edges into the gutter
+	upload_buffer.resize(static_cast<size_t>(cell_width) * cell_height * 4);
+	for (int y = 0; y < cell_height; ++y) {
+		const int source_y = std::clamp(y - CellGutter, 0, height - 1);
+		for (int x = 0; x < cell_width; ++x) {
+			const int source_x = std::clamp(x - CellGutter, 0, width - 1);
+			memcpy(&upload_buffer[(static_cast<size_t>(y) * cell_width + x) * 4], &rgba[(static_cast<size_t>(source_y) * width + source_x) * 4], 4);
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, page.texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, cell_x, cell_y, cell_width, cell_height, GL_RGBA, GL_UNSIGNED_BYTE, upload_buffer.data());
+
+	const float scale = 1.0f / page_size;
+	Entry &entry = entries[spriteId];
+	entry.page = index;
+	entry.region.texture = page.texture;
+	entry.region.u0 = (cell_x + CellGutter) * scale;
+	entry.region.v0 = (cell_y + CellGutter) * scale;
+	entry.region.u1 = (cell_x + CellGutter + width) * scale;
+	entry.region.v1 = (cell_y + CellGutter + height) * scale;
+
+	page.sprites.push_back(spriteId);
+	page.lastaccess = current_time;
+	page.lastframe = current_frame;
+	++resident;
+	return true;
+}
+
+void TextureAtlas::nextFrame(int time) noexcept {
+	current_time = time;
+	++current_frame;
+}
+
+void TextureAtlas::collect(int time, int longevity) {
+	for (size_t index = 0; index < pages.size(); ++index) {
+		const Page &page = pages[index];
+		if (page.texture != 0 && time - page.lastaccess > longevity) {
+			releasePage(static_cast<int>(index));
+		}
+	}
+}
+
+void TextureAtlas::clear() {
+	for (size_t index = 0; index < pages.size(); ++index) {
+		releasePage(static_cast<int>(index));
+	}
+	pages.clear();
+	entries.clear();
+	upload_buffer.clear();
+	upload_buffer.shrink_to_fit();
+	resident = 0;
+}
+
+size_t TextureAtlas::getPageCount() const noexcept {
+	return std::count_if(pages.begin(), pages.end(), [](const Page &page) { return page.texture != 0; });
+}
+
+int TextureAtlas::findPage(int width, int height) {
+	for (size_t index = 0; index < pages.size(); ++index) {
+		const Page &page = pages[index];
+		if (page.texture != 0 && page.sprite_width == width && page.sprite_height == height && static_cast<int>(page.sprites.size()) < page.capacity) {
+			return static_cast<int>(index);
+		}
+	}
+	return -1;
+}
+
+int TextureAtlas::createPage(int width, int height) {
+	int free_index = -1;
+	int lru_index = -1;
+	size_t live_pages = 0;
+	for (size_t index = 0; index < pages.size(); ++index) {
+		const Page &page = pages[index];
+		if (page.texture == 0) {
+			if (free_index < 0) {
+				free_index = static_cast<int>(index);
+			}
+			continue;
+		}
+
+		++live_pages;
+		// Sprites packed during this frame may still be waiting in the sprite batch
+		if (page.lastframe != current_frame && (lru_index < 0 || page.lastframe < pages[lru_index].lastframe)) {
+			lru_index = static_cast<int>(index);
+		}
+	}
+
+	if (live_pages >= MaxAtlasPages && lru_index >= 0) {
+		resetPage(lru_index, width, height);
+		return lru_index;
+	}
+
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	if (texture == 0) {
+		return -1;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, 0x812F); // GL_CLAMP_TO_EDGE
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, 0x812F); // GL_CLAMP_TO_EDGE
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, page_size, page_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	if (free_index < 0) {
+		free_index = static_cast<int>(pages.size());
+		pages.emplace_back();
+	}
+
+	pages[free_index].texture = texture;
+	resetPage(free_index, width, height);
+	return free_index;
+}
+
+void TextureAtlas::resetPage(int index, int width, int height) {
+	Page &page = pages[index];
+	for (uint32_t spriteId : page.sprites) {
+		entries[spriteId].page = -1;
+	}
+	resident -= page.sprites.size();
+	page.sprites.clear();
+
+	page.sprite_width = width;
+	page.sprite_height = height;
+	page.capacity = (page_size / (width + CellGutter * 2)) * (page_size / (height + CellGutter * 2));
+	page.lastaccess = current_time;
+	page.lastframe = current_frame;
+}
+
+void TextureAtlas::releasePage(int index) {
+	Page &page = pages[index];
+	if (page.texture == 0) {
+		return;
+	}
+
+	resetPage(index, 0, 0);
+	page.capacity = 0;
+	glDeleteTextures(1, &page.texture);
+	page.texture = 0;
+}
@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////
+// This file is part of Remere's Map Editor
+//////////////////////////////////////////////////////////////////////
+// Remere's Map Editor is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Remere's Map Editor is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef RME_TEXTURE_ATLAS_H_
+#define RME_TEXTURE_ATLAS_H_
+
+// Packs game sprites into large shared textures so a frame only needs a
+// handful of texture binds. Every page holds a grid of equally sized cells
+// (one page per sprite size), and pages are evicted as a whole.
+class TextureAtlas {
+public:
+	struct Region {
+		GLuint texture = 0;
+		float u0 = 0.0f;
+		float v0 = 0.0f;
+		float u1 = 0.0f;
+		float v1 = 0.0f;
+	};
+
+	TextureAtlas();
+	~TextureAtlas();
+
+	// Returns the region of a resident sprite, or nullptr if it isn't packed
+	const Region* getRegion(uint32_t spriteId);
+	bool isResident(uint32_t spriteId) const noexcept {
+		return spriteId < entries.size() && entries[spriteId].page >= 0;
+	}
+
+	// Uploads a RGBA sprite into a free cell, evicting the least recently used page if needed
+	bool insert(uint32_t spriteId, int width, int height, const uint8_t* rgba);
+
+	// Marks the end of a frame; pages touched during the current frame are never evicted
+	void nextFrame(int time) noexcept;
+	// Releases pages that haven't been used for longer than `longevity` seconds
+	void collect(int time, int longevity);
+	void clear();
+
+	size_t getPageCount() const noexcept;
+	size_t getResidentCount() const noexcept {
+		return resident;
+	}
+
+private:
+	struct Entry {
+		int page = -1;
+		Region region;
+	};
+
+	struct Page {
+		GLuint texture = 0;
+		int sprite_width = 0;
+		int sprite_height = 0;
+		int capacity = 0;
+		int lastaccess = 0;
+		uint32_t lastframe = 0;
+		std::vector<uint32_t> sprites;
+	};
+
+	int findPage(int width, int height);
+	int createPage(int width, int height);
+	void resetPage(int index, int width, int height);
+	void releasePage(int index);
+
+	std::vector<Entry> entries;
+	std::vector<Page> pages;
+	std::vector<uint8_t> upload_buffer;
+	int page_size;
+	size_t resident;
+	int current_time;
+	uint32_t current_frame;
+};
+
+#endif
@@ -74,6 +74,21 @@ Tile::~Tile() {
 	delete spawnNpc;
 }
 
+void* Tile::operator new(size_t size) {
+	if (size != sizeof(Tile)) {
+		return ::operator new(size);
+	}
+	return MapAllocator::getTilePool().allocate();
+}
+
+void Tile::operator delete(void* block, size_t size) {
+	if (size != sizeof(Tile)) {
+		::operator delete(block);
+		return;
+	}
+	MapAllocator::getTilePool().release(block);
+}
+
 Tile* Tile::deepCopy(BaseMap &map) const {
 	Tile* copy = map.allocator.allocateTile(location);
 	copy->flags = flags;
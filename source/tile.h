@@ -67,6 +67,15 @@ public:
 
 	~Tile();
 
+	// Memory comes from the tile pool of MapAllocator
+	static void* operator new(size_t size);
+	static void operator delete(void* block, size_t size);
+#ifdef DEBUG_MEM
+	static void* operator new(size_t size, const char*, int) {
+		return operator new(size);
+	}
+#endif
+
 	// Argument is a the map to allocate the tile from
 	Tile* deepCopy(BaseMap &map) const;
 